@@ -0,0 +1,87 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware revisions. Each PlatformIO environment selects one with
+// -DBOARD_PROFILE=<id>; the default is the original SunToy board.
+#define BOARD_PROFILE_SUNTOY_V1   1
+#define BOARD_PROFILE_SUNTOY_LITE 2
+#define BOARD_PROFILE_SUNTOY_GLOW 3
+
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE BOARD_PROFILE_SUNTOY_V1
+#endif
+
+// Feature switches stay macros: they guard #includes, which lets the
+// chain+ dependency finder drop the disabled libraries from the build.
+// The traits below are the source of truth; static_asserts keep the two in step.
+#if BOARD_PROFILE == BOARD_PROFILE_SUNTOY_V1
+    #define FEATURE_BLUETOOTH   1
+    #define FEATURE_WIFI_PORTAL 1
+    #define FEATURE_OTA         1
+#elif BOARD_PROFILE == BOARD_PROFILE_SUNTOY_LITE
+    #define FEATURE_BLUETOOTH   0
+    #define FEATURE_WIFI_PORTAL 1
+    #define FEATURE_OTA         1
+#elif BOARD_PROFILE == BOARD_PROFILE_SUNTOY_GLOW
+    #define FEATURE_BLUETOOTH   1
+    #define FEATURE_WIFI_PORTAL 1
+    #define FEATURE_OTA         1
+#else
+    #error "Unknown BOARD_PROFILE"
+#endif
+
+#if FEATURE_OTA && !FEATURE_WIFI_PORTAL
+    #error "FEATURE_OTA requires FEATURE_WIFI_PORTAL"
+#endif
+
+template <int Profile> struct BoardTraits;
+
+template <> struct BoardTraits<BOARD_PROFILE_SUNTOY_V1> {
+    static constexpr const char* name = "suntoy-v1";
+
+    static constexpr uint8_t pinSdCs   = 5;
+    static constexpr uint8_t pinSdSck  = 18;
+    static constexpr uint8_t pinSdMiso = 19;
+    static constexpr uint8_t pinSdMosi = 23;
+
+    static constexpr uint8_t pinI2sBclk = 26;
+    static constexpr uint8_t pinI2sLrc  = 25;
+    static constexpr uint8_t pinI2sDout = 22;
+
+    static constexpr uint8_t pinNfcSda = 21;
+    static constexpr uint8_t pinNfcScl = 14;
+
+    static constexpr uint8_t pinLed     = 2;
+    static constexpr uint16_t ledCount  = 1;
+    static constexpr uint8_t ledBrightness = 50;
+    static constexpr uint8_t pinBtnVol  = 4;
+    static constexpr uint8_t pinBtnCtrl = 13;
+
+    static constexpr size_t arenaInternalBytes = 8 * 1024;
+    static constexpr size_t arenaPsramBytes    = 1536 * 1024;
+    static constexpr size_t themeJsonBytes     = 4096;
+
+    static constexpr bool hasBluetooth  = true;
+    static constexpr bool hasWifiPortal = true;
+    static constexpr bool hasOta        = true;
+};
+
+// Same PCB without the A2DP speaker mode.
+template <> struct BoardTraits<BOARD_PROFILE_SUNTOY_LITE> : BoardTraits<BOARD_PROFILE_SUNTOY_V1> {
+    static constexpr const char* name = "suntoy-lite";
+    static constexpr bool hasBluetooth = false;
+};
+
+// Figurine base with a 12-pixel ring instead of the single status LED.
+template <> struct BoardTraits<BOARD_PROFILE_SUNTOY_GLOW> : BoardTraits<BOARD_PROFILE_SUNTOY_V1> {
+    static constexpr const char* name = "suntoy-glow";
+    static constexpr uint16_t ledCount = 12;
+    static constexpr uint8_t ledBrightness = 40;
+};
+
+typedef BoardTraits<BOARD_PROFILE> Board;
+
+static_assert(Board::hasBluetooth == FEATURE_BLUETOOTH, "FEATURE_BLUETOOTH does not match the board profile");
+static_assert(Board::hasWifiPortal == FEATURE_WIFI_PORTAL, "FEATURE_WIFI_PORTAL does not match the board profile");
+static_assert(Board::hasOta == FEATURE_OTA, "FEATURE_OTA does not match the board profile");
@@ -1,4 +1,5 @@
 #pragma once
+#include "BoardProfile.h"
 
 // FIRMWARE VERSION
 #define FIRMWARE_VERSION "1.0.0"
@@ -7,29 +8,29 @@
 #define WIFI_SSID "SunToy"
 #define WIFI_PASS "" 
 
-// SD 
-#define PIN_SD_CS   5
-#define PIN_SD_SCK  18
-#define PIN_SD_MISO 19
-#define PIN_SD_MOSI 23
+// MEMORY
+#ifndef SUNTOY_STATIC_ALLOC
+#define SUNTOY_STATIC_ALLOC 0
+#endif
 
-// AUDIO 
-#define PIN_I2S_BCLK 26
-#define PIN_I2S_LRC  25 
-#define PIN_I2S_DOUT 22
-
-// NFC
-#define PIN_NFC_SDA 21
-#define PIN_NFC_SCL 14
-
-// PERIPHERALS
-#define PIN_LED 2
-#define PIN_BTN_VOL 4
-#define PIN_BTN_CTRL 13
+// PROFILING
+// Sampling profiler on the serial console and at /profile; see
+// utils/SampleProfiler.h.
+#ifndef SUNTOY_PROFILER
+#define SUNTOY_PROFILER 0
+#endif
 
+#define DIR_TALES     "/tales"
 #define DIR_TALE_1    "/tales/01"
 #define DIR_TALE_2    "/tales/02"
 #define DIR_TALE_3    "/tales/03"
+#define DIR_RECORDS   "/records"
 #define FILE_CUSTOM_STORY      "/records/custom_story.wav"
-
-#define TAG_CMD_CUSTOM "cmd:rec" 
\ No newline at end of file
+#define FILE_RECORD_INDEX      "/records/index.bin"
+#define RECORD_SLOTS           32
+
+#define TAG_CMD_CUSTOM "cmd:rec"
+#define TAG_CMD_VOLUME "cmd:vol:"
+#define TAG_CMD_TALE   "cmd:"
+#define TAG_PORTAL_HOST "192.168."
+#define TALE_NAME_MAX  32
\ No newline at end of file
@@ -0,0 +1,102 @@
+# Packs fallback cues and the portal index page into the firmware image.
+#
+# Files under assets/embedded/ mirror their SD card paths:
+#   assets/embedded/system/*.wav  -> mono 8-bit mu-law cues
+#   assets/embedded/web/*.html    -> gzip-compressed pages
+# The generated arrays are const, so they stay in memory-mapped flash and are
+# read in place at runtime.
+
+import gzip
+import os
+import struct
+import wave
+
+Import("env")
+
+ASSET_DIR = os.path.join(env.subst("$PROJECT_DIR"), "assets", "embedded")
+GEN_DIR = os.path.join(env.subst("$BUILD_DIR"), "embedded_src")
+
+BIAS = 0x84
+CLIP = 32635
+
+
+def ulaw_encode(sample):
+    sign = 0x80 if sample < 0 else 0
+    if sign:
+        sample = -sample
+    sample = min(sample, CLIP) + BIAS
+    exponent = 7
+    mask = 0x4000
+    while exponent > 0 and not (sample & mask):
+        exponent -= 1
+        mask >>= 1
+    mantissa = (sample >> (exponent + 3)) & 0x0F
+    return ~(sign | (exponent << 4) | mantissa) & 0xFF
+
+
+def encode_cue(path):
+    with wave.open(path, "rb") as wav:
+        if wav.getsampwidth() != 2:
+            raise ValueError("%s: only 16-bit PCM cues can be embedded" % path)
+        channels = wav.getnchannels()
+        rate = wav.getframerate()
+        raw = wav.readframes(wav.getnframes())
+    samples = struct.unpack("<%dh" % (len(raw) // 2), raw)
+    if channels == 2:
+        samples = [(samples[i] + samples[i + 1]) // 2 for i in range(0, len(samples) - 1, 2)]
+    return bytes(ulaw_encode(s) for s in samples), rate
+
+
+def collect_assets():
+    assets = []
+    if not os.path.isdir(ASSET_DIR):
+        return assets
+    for root, _, files in os.walk(ASSET_DIR):
+        for name in sorted(files):
+            src = os.path.join(root, name)
+            key = "/" + os.path.relpath(src, ASSET_DIR).replace(os.sep, "/")
+            lower = name.lower()
+            if lower.endswith(".wav"):
+                data, rate = encode_cue(src)
+                assets.append((key, data, rate, "EMBED_CUE_ULAW"))
+            elif lower.endswith((".html", ".css", ".js")):
+                with open(src, "rb") as f:
+                    data = gzip.compress(f.read(), 9)
+                assets.append((key, data, 0, "EMBED_WEB_GZIP"))
+    return assets
+
+
+def write_source(assets):
+    os.makedirs(GEN_DIR, exist_ok=True)
+    lines = [
+        "// Generated by scripts/embed_assets.py - do not edit.",
+        '#include "modules/EmbeddedAssets.h"',
+        "",
+    ]
+    for i, (key, data, _, _) in enumerate(assets):
+        lines.append("static const uint8_t ASSET_%d[%d] = {" % (i, len(data)))
+        for off in range(0, len(data), 24):
+            lines.append("    " + ",".join("0x%02x" % b for b in data[off:off + 24]) + ",")
+        lines.append("};")
+    lines.append("")
+    lines.append("const EmbeddedAsset EMBEDDED_ASSETS[] = {")
+    for i, (key, data, rate, kind) in enumerate(assets):
+        lines.append('    { "%s", ASSET_%d, %d, %d, %s },' % (key, i, len(data), rate, kind))
+    lines.append("    { nullptr, nullptr, 0, 0, EMBED_CUE_ULAW },")
+    lines.append("};")
+    lines.append("const size_t EMBEDDED_ASSET_COUNT = %d;" % len(assets))
+    content = "\n".join(lines) + "\n"
+
+    out = os.path.join(GEN_DIR, "EmbeddedAssetData.cpp")
+    if os.path.exists(out):
+        with open(out) as f:
+            if f.read() == content:
+                return
+    with open(out, "w") as f:
+        f.write(content)
+
+
+assets = collect_assets()
+write_source(assets)
+print("Embedded %d assets (%d bytes)" % (len(assets), sum(len(a[1]) for a in assets)))
+env.BuildSources(os.path.join("$BUILD_DIR", "embedded"), GEN_DIR)
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Builds every board profile and reports flash, static RAM and boot time.
+
+Usage: scripts/profile_report.py [--port /dev/ttyUSB0] [env ...]
+
+Sizes come from the firmware ELF of each environment. Boot time needs a
+board on --port flashed with that environment; the firmware prints
+"Boot complete on <profile> in <ms> ms" at the end of setup().
+"""
+
+import argparse
+import configparser
+import os
+import re
+import subprocess
+import sys
+import time
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BOOT_RE = re.compile(r"Boot complete on (\S+) in (\d+) ms")
+
+
+def list_envs():
+    cfg = configparser.ConfigParser()
+    cfg.read(os.path.join(PROJECT_DIR, "platformio.ini"))
+    return [s.split(":", 1)[1] for s in cfg.sections() if s.startswith("env:") and s != "env:native"]
+
+
+def section_sizes(elf):
+    out = subprocess.check_output(["xtensa-esp32-elf-size", "-A", elf], text=True)
+    sizes = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith("."):
+            sizes[parts[0]] = int(parts[1])
+    flash = sum(v for k, v in sizes.items() if k.startswith((".flash", ".iram0.text", ".dram0.data")))
+    ram = sum(v for k, v in sizes.items() if k in (".dram0.data", ".dram0.bss", ".iram0.text", ".iram0.vectors"))
+    return flash, ram
+
+
+def boot_time(env, port):
+    subprocess.check_call(["pio", "run", "-e", env, "-t", "upload", "--upload-port", port], cwd=PROJECT_DIR)
+    import serial
+    with serial.Serial(port, 115200, timeout=1) as ser:
+        ser.dtr = False
+        ser.rts = True
+        time.sleep(0.1)
+        ser.rts = False
+        deadline = time.time() + 20
+        while time.time() < deadline:
+            match = BOOT_RE.search(ser.readline().decode(errors="ignore"))
+            if match:
+                return int(match.group(2))
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port")
+    parser.add_argument("envs", nargs="*")
+    args = parser.parse_args()
+    envs = args.envs or list_envs()
+
+    rows = []
+    for env in envs:
+        subprocess.check_call(["pio", "run", "-e", env], cwd=PROJECT_DIR)
+        elf = os.path.join(PROJECT_DIR, ".pio", "build", env, "firmware.elf")
+        flash, ram = section_sizes(elf)
+        boot = boot_time(env, args.port) if args.port else None
+        rows.append((env, flash, ram, boot))
+
+    base = rows[0]
+    print("%-22s %10s %10s %10s %10s %8s" % ("env", "flash", "d-flash", "static RAM", "d-RAM", "boot ms"))
+    for env, flash, ram, boot in rows:
+        print("%-22s %10d %+10d %10d %+10d %8s" % (env, flash, flash - base[1], ram, ram - base[2],
+                                                   boot if boot is not None else "-"))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
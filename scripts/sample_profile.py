@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""Captures and symbolizes dumps of the firmware's sampling profiler.
+
+Usage:
+  scripts/sample_profile.py capture --port /dev/ttyUSB0 [--seconds 10] [--hz 997] -o profile.bin
+  scripts/sample_profile.py capture --host 192.168.4.1 [--seconds 10] [--hz 997] -o profile.bin
+  scripts/sample_profile.py report profile.bin [--elf firmware.elf] [--core N] [--task NAME]
+                                   [--top 25] [--callers 10] [--folded stacks.txt]
+
+The profiler is only in firmware built with SUNTOY_PROFILER (the
+esp32wrover_profile environment). "capture" starts it, waits, then reads
+the dump over the serial console ("prof dump") or from the portal's
+/profile route. "report" also takes a saved serial log that contains a
+dump. Addresses are resolved with xtensa-esp32-elf-addr2line against the
+ELF the board was flashed with, by default that environment's build.
+
+The flat profile lists self samples (the function that was running) and
+total samples (the function was anywhere on the call chain). The call
+graph shows, for the busiest functions, who called them and what they
+called. --folded writes one "task;outer;...;leaf count" line per stack,
+the input flamegraph.pl expects.
+"""
+
+import argparse
+import collections
+import os
+import re
+import struct
+import subprocess
+import sys
+import time
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_ELF = os.path.join(PROJECT_DIR, ".pio", "build", "esp32wrover_profile", "firmware.elf")
+HEADER = struct.Struct("<IBBBBIIIII")
+MAGIC = 0x31465250
+TASK_LEN = 16
+HEX_RE = re.compile(r"\[PROF\] ([0-9a-f]{8}) ([0-9a-f]+)$")
+SIZE_RE = re.compile(r"\[PROF\] dump (\d+) bytes$")
+
+
+def parse_dump(data):
+    """Returns (header dict, task names, samples); a sample is (core, task, pcs)."""
+    magic, version, depth, ntasks, _, hz, count, dropped, duration, size = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError("not a profiler dump")
+    header = {"version": version, "depth": depth, "hz": hz, "samples": count, "dropped": dropped,
+              "duration_ms": duration}
+    pos = HEADER.size
+    tasks = []
+    for _ in range(ntasks):
+        tasks.append(data[pos:pos + TASK_LEN].split(b"\0")[0].decode(errors="replace"))
+        pos += TASK_LEN
+    samples, end = [], min(pos + size, len(data))
+    while pos + 4 <= end:
+        core, task, n = data[pos], data[pos + 1], data[pos + 2]
+        pcs = struct.unpack_from("<%dI" % n, data, pos + 4)
+        pos += 4 + 4 * n
+        name = tasks[task] if task < len(tasks) else "(other)"
+        samples.append((core, name, pcs))
+    return header, tasks, samples
+
+
+def dump_from_log(text):
+    """Pulls the last hex dump out of a serial capture.
+
+    Each line carries its offset, so other log output between lines does
+    no harm; a dump with missing lines is rejected.
+    """
+    data, size = None, 0
+    for line in text.splitlines():
+        line = line.strip()
+        match = SIZE_RE.search(line)
+        if match:
+            size = int(match.group(1))
+            data, filled = bytearray(size), bytearray(size)
+            continue
+        match = HEX_RE.search(line) if data is not None else None
+        if match:
+            offset, chunk = int(match.group(1), 16), bytes.fromhex(match.group(2))
+            if offset + len(chunk) <= size:
+                data[offset:offset + len(chunk)] = chunk
+                filled[offset:offset + len(chunk)] = b"\1" * len(chunk)
+    if data is None:
+        return None
+    missing = filled.find(b"\0")
+    if missing >= 0:
+        raise ValueError("dump incomplete: byte %d of %d missing" % (missing, size))
+    return bytes(data)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == MAGIC:
+        return data
+    data = dump_from_log(data.decode(errors="ignore"))
+    if not data:
+        raise ValueError("%s holds no profiler dump" % path)
+    return data
+
+
+def capture_serial(args):
+    import serial
+    with serial.Serial(args.port, 115200, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"prof clear\n")
+        ser.write(("prof start %d\n" % args.hz).encode())
+        time.sleep(args.seconds)
+        ser.reset_input_buffer()
+        ser.write(b"prof dump\n")
+        lines, deadline = [], time.time() + args.timeout
+        while time.time() < deadline:
+            line = ser.readline().decode(errors="ignore").strip()
+            lines.append(line)
+            if line == "[PROF] dump end":
+                break
+    return dump_from_log("\n".join(lines))
+
+
+def capture_http(args):
+    import urllib.request
+    base = "http://%s" % args.host
+    urllib.request.urlopen(urllib.request.Request(base + "/profile?clear", method="POST"), timeout=10)
+    urllib.request.urlopen(urllib.request.Request(base + "/profile?hz=%d" % args.hz, method="POST"), timeout=10)
+    time.sleep(args.seconds)
+    with urllib.request.urlopen(base + "/profile", timeout=args.timeout) as response:
+        return response.read()
+
+
+def capture(args):
+    data = capture_serial(args) if args.port else capture_http(args)
+    if not data:
+        print("no dump received", file=sys.stderr)
+        return 1
+    with open(args.output, "wb") as f:
+        f.write(data)
+    header, _, samples = parse_dump(data)
+    print("%d samples at %d Hz over %d ms written to %s" % (len(samples), header["hz"], header["duration_ms"],
+                                                           args.output))
+    return 0
+
+
+def symbolize(elf, addresses):
+    """Maps each address to (function, file:line) with one addr2line run."""
+    addresses = sorted(addresses)
+    symbols = {}
+    if not addresses:
+        return symbols
+    out = subprocess.run(["xtensa-esp32-elf-addr2line", "-e", elf, "-f", "-C", "-a"],
+                         input="\n".join("0x%08x" % a for a in addresses), capture_output=True, text=True,
+                         check=True).stdout.splitlines()
+    for i in range(0, len(out) - 2, 3):
+        address = int(out[i], 16)
+        function = out[i + 1] if out[i + 1] != "??" else "0x%08x" % address
+        location = out[i + 2]
+        location = os.path.basename(location.split(" ")[0]) if not location.startswith("??") else "?"
+        symbols[address] = (function, location)
+    return symbols
+
+
+def report(args):
+    header, tasks, samples = parse_dump(load(args.dump))
+    if args.core is not None:
+        samples = [s for s in samples if s[0] == args.core]
+    if args.task:
+        samples = [s for s in samples if s[1] == args.task]
+    print("%d samples at %d Hz over %d ms, %d dropped" % (header["samples"], header["hz"], header["duration_ms"],
+                                                        header["dropped"]))
+    if not samples:
+        return 0
+    symbols = symbolize(args.elf, {pc for s in samples for pc in s[2]})
+
+    def func(pc):
+        return symbols.get(pc, ("0x%08x" % pc, "?"))[0]
+
+    total = len(samples)
+    per_task = collections.Counter((core, task) for core, task, _ in samples)
+    print("\ntasks")
+    for (core, task), n in sorted(per_task.items()):
+        print("  core %d %-16s %6d %5.1f%%" % (core, task, n, 100.0 * n / total))
+
+    self_counts, total_counts = collections.Counter(), collections.Counter()
+    self_lines = collections.Counter()
+    callers, callees = collections.defaultdict(collections.Counter), collections.defaultdict(collections.Counter)
+    stacks = collections.Counter()
+    for _, task, pcs in samples:
+        chain = [func(pc) for pc in pcs]
+        self_counts[chain[0]] += 1
+        self_lines[(symbols.get(pcs[0], ("", "?"))[1], chain[0])] += 1
+        for name in set(chain):
+            total_counts[name] += 1
+        # chain[0] is the leaf; chain[i + 1] called chain[i].
+        for callee, caller in zip(chain, chain[1:]):
+            callers[callee][caller] += 1
+            callees[caller][callee] += 1
+        stacks[";".join([task] + chain[::-1])] += 1
+
+    print("\nflat profile")
+    print("  %6s %6s %6s %6s  %s" % ("self", "self%", "total", "total%", "function"))
+    for name, n in self_counts.most_common(args.top):
+        print("  %6d %5.1f%% %6d %5.1f%%  %s" % (n, 100.0 * n / total, total_counts[name],
+                                                100.0 * total_counts[name] / total, name))
+
+    print("\nhot lines")
+    for (location, name), n in self_lines.most_common(args.top):
+        print("  %6d %5.1f%%  %-28s %s" % (n, 100.0 * n / total, location, name))
+
+    print("\ncall graph")
+    for name, n in total_counts.most_common(args.callers):
+        print("  %s  (total %d, self %d)" % (name, n, self_counts[name]))
+        for caller, m in callers[name].most_common(5):
+            print("      <- %6d  %s" % (m, caller))
+        for callee, m in callees[name].most_common(5):
+            print("      -> %6d  %s" % (m, callee))
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, n in stacks.most_common():
+                f.write("%s %d\n" % (stack, n))
+        print("\nfolded stacks written to %s" % args.folded)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    sub = parser.add_subparsers(dest="command")
+    p = sub.add_parser("capture")
+    source = p.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port")
+    source.add_argument("--host")
+    p.add_argument("--seconds", type=float, default=10)
+    p.add_argument("--hz", type=int, default=997)
+    p.add_argument("--timeout", type=float, default=600)
+    p.add_argument("-o", "--output", default="profile.bin")
+    p = sub.add_parser("report")
+    p.add_argument("dump")
+    p.add_argument("--elf", default=DEFAULT_ELF)
+    p.add_argument("--core", type=int)
+    p.add_argument("--task")
+    p.add_argument("--top", type=int, default=25)
+    p.add_argument("--callers", type=int, default=10)
+    p.add_argument("--folded")
+    args = parser.parse_args()
+    if args.command == "capture":
+        return capture(args)
+    if args.command == "report":
+        return report(args)
+    parser.print_help()
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
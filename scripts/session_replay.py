@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Decodes field session logs and replays them on a board.
+
+Usage:
+  scripts/session_replay.py decode session.bin [--boot N]
+  scripts/session_replay.py replay --port /dev/ttyUSB0 [--speed 20] [--boots-back 1] [--log session.bin]
+
+The log is /system/session.bin on the SD card (also served by the portal
+at /session). "decode" prints the state-transition timeline and the
+handling latency of every input for each boot in the file. "replay" asks
+the firmware to feed a previous boot's inputs back through the real state
+machine at --speed times real time, collects the "[SES]" lines it echoes,
+prints the same report on the field time scale and, given the field log,
+lists where the replayed transitions diverge from the recorded ones.
+
+Past 64 KB the log moves to /system/session.old (/session?old); decode
+the two concatenated, old first, to see a boot cut by the move.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+HEADER = struct.Struct("<IIBBB")
+
+TYPES = ["boot", "tag", "presence", "button", "audio", "web", "state", "command", "replay"]
+INPUTS = {"tag", "presence", "button", "audio", "web"}
+STATES = ["IDLE", "PLAYING", "PAUSED", "WIFI_MODE", "BT_MODE", "WAITING_FOR_PLAY", "WIFI_TRANSITION"]
+COMMANDS = ["PLAY_FILE", "PLAY_FOLDER", "PLAY_CUE", "PLAY_STREAM", "STOP", "TOGGLE_PAUSE", "PAUSE",
+            "RESUME", "NEXT", "VOLUME", "VOLUME_STEP", "SPEED", "LED_COLOR", "LED_LOADING",
+            "LED_BLINK_ERROR"]
+BUTTONS = ["vol click", "vol long", "ctrl click", "ctrl long", "combo"]
+WEB = ["volume", "speed", "led", "stream", "upload"]
+PRESENCE = ["removed", "returned"]
+
+
+def name(table, index):
+    return table[index] if index < len(table) else str(index)
+
+
+def read_log(path):
+    """Returns a list of boots, each a list of (ms, type, arg, value, text)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    boots, pos = [], 0
+    while pos + HEADER.size <= len(data):
+        ms, value, kind, arg, length = HEADER.unpack_from(data, pos)
+        pos += HEADER.size
+        text = data[pos:pos + length].decode(errors="replace").split("\0")
+        pos += length
+        kind = name(TYPES, kind)
+        if kind == "boot" or not boots:
+            boots.append([])
+        boots[-1].append((ms, kind, arg, value, text))
+    return boots
+
+
+def parse_echo(line):
+    parts = line.split(None, 6)
+    if len(parts) < 5 or parts[0] != "[SES]" or not parts[1].isdigit():
+        return None
+    text = parts[5:7] if parts[2] == "tag" else []
+    return int(parts[1]), parts[2], int(parts[3]), int(parts[4]), text
+
+
+def describe(kind, arg, value, text):
+    if kind == "tag":
+        return "tag %s %s" % (text[0], text[1] if len(text) > 1 else "")
+    if kind == "presence":
+        return "figurine %s" % name(PRESENCE, arg)
+    if kind == "button":
+        return "button %s" % name(BUTTONS, arg)
+    if kind == "audio":
+        return "audio %s" % ("track end" if arg == 2 else "playing" if arg else "stopped")
+    if kind == "web":
+        return "web %s %d" % (name(WEB, arg), value)
+    if kind == "state":
+        return "%s -> %s" % (name(STATES, arg >> 4), name(STATES, arg & 0x0F))
+    if kind == "command":
+        return "cmd %s" % name(COMMANDS, arg)
+    if kind == "replay":
+        return "replay %s" % ("start x%d" % value if arg else "end, %d inputs" % value)
+    return kind
+
+
+def input_key(kind, arg):
+    if kind == "button":
+        return "button " + name(BUTTONS, arg)
+    if kind == "web":
+        return "web " + name(WEB, arg)
+    if kind == "presence":
+        return "figurine " + name(PRESENCE, arg)
+    return kind
+
+
+def report(events, scale=1):
+    """Prints a timeline; times are relative to the first event, times scale."""
+    if not events:
+        print("  (empty)")
+        return
+    base = events[0][0]
+    latencies = {}
+    last_input = None
+    for ms, kind, arg, value, text in events:
+        t = (ms - base) * scale / 1000.0
+        line = "  %9.3f s  %-34s" % (t, describe(kind, arg, value, text))
+        if kind in INPUTS:
+            last_input = input_key(kind, arg)
+        elif kind in ("state", "command") and value:
+            line += " %7.1f ms" % (value / 1000.0)
+            if last_input:
+                latencies.setdefault(last_input, []).append(value)
+                last_input = None
+        print(line)
+    if latencies:
+        print("  latency by input (ms):  count   avg     max")
+        for key in sorted(latencies):
+            values = latencies[key]
+            print("    %-20s %7d %7.1f %7.1f" % (key, len(values), sum(values) / len(values) / 1000.0,
+                                                max(values) / 1000.0))
+
+
+def transitions(events):
+    return [describe(k, a, v, t) for _, k, a, v, t in events if k == "state"]
+
+
+def decode(args):
+    boots = read_log(args.log)
+    for i, events in enumerate(boots):
+        if args.boot is not None and i != args.boot:
+            continue
+        print("boot %d (%d records)" % (i, len(events)))
+        report(events)
+    return 0
+
+
+def replay(args):
+    import serial
+    events = []
+    with serial.Serial(args.port, 115200, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(("replay %d %d\n" % (args.speed, args.boots_back)).encode())
+        deadline = time.time() + args.timeout
+        started = False
+        while time.time() < deadline:
+            line = ser.readline().decode(errors="ignore").strip()
+            if "Replay not started" in line:
+                print(line)
+                return 1
+            event = parse_echo(line)
+            if not event:
+                continue
+            if event[1] == "replay":
+                if event[2]:
+                    started = True
+                    continue
+                if started:
+                    break
+            if started:
+                events.append(event)
+    print("replay at x%d, field time scale" % args.speed)
+    report(events, args.speed)
+
+    if args.log:
+        boots = read_log(args.log)
+        index = len(boots) - 1 - args.boots_back
+        if 0 <= index < len(boots):
+            field, replayed = transitions(boots[index]), transitions(events)
+            print("divergence from field log (boot %d):" % index)
+            diverged = False
+            for i in range(max(len(field), len(replayed))):
+                a = field[i] if i < len(field) else "-"
+                b = replayed[i] if i < len(replayed) else "-"
+                if a != b:
+                    print("  #%d field %-30s replay %s" % (i, a, b))
+                    diverged = True
+            if not diverged:
+                print("  none, %d transitions match" % len(field))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    sub = parser.add_subparsers(dest="command")
+    p = sub.add_parser("decode")
+    p.add_argument("log")
+    p.add_argument("--boot", type=int)
+    p = sub.add_parser("replay")
+    p.add_argument("--port", required=True)
+    p.add_argument("--speed", type=int, default=20)
+    p.add_argument("--boots-back", type=int, default=1)
+    p.add_argument("--log")
+    p.add_argument("--timeout", type=float, default=600)
+    args = parser.parse_args()
+    if args.command == "decode":
+        return decode(args)
+    if args.command == "replay":
+        return replay(args)
+    parser.print_help()
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Brings the toy's tale library in line with a local folder over the portal.
+
+Usage: scripts/tale_sync.py LOCAL_DIR [--host 192.168.4.1] [--delete] [--chunk 32768]
+                             [--pack tar|gz] [--all]
+
+LOCAL_DIR mirrors /tales on the card (LOCAL_DIR/01/001.mp3 -> /tales/01/001.mp3).
+The device manifest (/sync/manifest) is compared with CRC-32s of the local
+files; only missing or changed files are uploaded, in CRC-checked chunks
+that resume from the device's part file after a dropped connection.
+--delete also removes device files that are not in LOCAL_DIR.
+
+--pack sends the changed files as one tar (or tar.gz) stream to /sync/pack,
+which the device unpacks as it arrives, instead of one request per chunk.
+--all uploads every file regardless of the manifest, so both modes can be
+timed on the same library. Both the file-data rate and the rate of bytes
+actually sent are printed; the device log has its own end-to-end rate.
+"""
+
+import argparse
+import os
+import sys
+import tarfile
+import tempfile
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+import zlib
+
+RETRIES = 20
+
+
+def request(host, method, path, params=None, body=None, timeout=30):
+    url = "http://%s%s" % (host, path)
+    if params:
+        url += "?" + urllib.parse.urlencode(params)
+    req = urllib.request.Request(url, data=body, method=method)
+    if body is not None:
+        req.add_header("Content-Type", "application/octet-stream")
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as resp:
+            return resp.status, resp.read()
+    except urllib.error.HTTPError as err:
+        return err.code, err.read()
+
+
+def file_crc(path):
+    crc = 0
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(65536), b""):
+            crc = zlib.crc32(block, crc)
+    return crc & 0xFFFFFFFF
+
+
+def local_manifest(root):
+    files = {}
+    for dirpath, _, names in os.walk(root):
+        for name in names:
+            full = os.path.join(dirpath, name)
+            rel = os.path.relpath(full, root).replace(os.sep, "/")
+            files["/tales/" + rel] = (os.path.getsize(full), file_crc(full), full)
+    return files
+
+
+def remote_manifest(host):
+    while True:
+        status, body = request(host, "GET", "/sync/manifest")
+        if status == 200:
+            break
+        if status != 503:
+            raise RuntimeError("manifest: HTTP %d" % status)
+        print("  device hashing library: %s" % body.decode(errors="ignore"))
+        time.sleep(2)
+    files = {}
+    for line in body.decode(errors="replace").splitlines():
+        parts = line.split(" ", 3)
+        if len(parts) == 4:
+            files[parts[3]] = (int(parts[1]), int(parts[0], 16))
+    return files
+
+
+def upload(host, path, size, crc, full, chunk):
+    sent = 0
+    attempts = 0
+    with open(full, "rb") as f:
+        offset = None
+        while True:
+            try:
+                if offset is None:
+                    status, body = request(host, "GET", "/sync/status", {"path": path})
+                    offset = int(body.decode().split(":")[1].rstrip("}")) if status == 200 else 0
+                    if offset > size:
+                        offset = 0
+                f.seek(offset)
+                data = f.read(chunk)
+                params = {"path": path, "size": size, "crc": "%08x" % crc, "offset": offset,
+                          "chunk": "%08x" % (zlib.crc32(data) & 0xFFFFFFFF)}
+                sent += len(data)
+                status, body = request(host, "POST", "/sync/file", params, data)
+            except (OSError, urllib.error.URLError) as err:
+                attempts += 1
+                if attempts > RETRIES:
+                    raise
+                print("  %s: %s, resuming" % (path, err))
+                time.sleep(min(2 * attempts, 10))
+                offset = None
+                continue
+            reply = body.decode(errors="ignore")
+            if status == 200 and '"done"' in reply:
+                return sent
+            if status == 200:
+                offset += len(data)
+            elif status == 409:
+                if '"busy"' in reply:
+                    time.sleep(0.5)
+                offset = None
+            elif status == 422 and "bad_file" in reply:
+                offset = 0
+                attempts += 1
+            elif status == 422:
+                attempts += 1
+            else:
+                raise RuntimeError("%s: HTTP %d %s" % (path, status, reply))
+            if attempts > RETRIES:
+                raise RuntimeError("%s: too many failed chunks" % path)
+
+
+def upload_pack(host, changed, local, compress):
+    with tempfile.TemporaryFile() as spool:
+        with tarfile.open(fileobj=spool, mode="w:gz" if compress else "w", format=tarfile.GNU_FORMAT) as tar:
+            for path in changed:
+                tar.add(local[path][2], arcname=path.lstrip("/"), recursive=False)
+        length = spool.tell()
+        spool.seek(0)
+        req = urllib.request.Request("http://%s/sync/pack" % host, data=spool, method="POST")
+        req.add_header("Content-Type", "application/octet-stream")
+        req.add_header("Content-Length", str(length))
+        try:
+            with urllib.request.urlopen(req, timeout=600) as resp:
+                status, body = resp.status, resp.read()
+        except urllib.error.HTTPError as err:
+            status, body = err.code, err.read()
+    if status != 200:
+        raise RuntimeError("pack: HTTP %d %s" % (status, body.decode(errors="ignore")))
+    print("  device: %s" % body.decode(errors="ignore"))
+    return length
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("local")
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--delete", action="store_true")
+    parser.add_argument("--chunk", type=int, default=32768)
+    parser.add_argument("--pack", choices=("tar", "gz"))
+    parser.add_argument("--all", action="store_true")
+    args = parser.parse_args()
+
+    start = time.time()
+    local = local_manifest(args.local)
+    remote = remote_manifest(args.host)
+    changed = [p for p, (size, crc, _) in sorted(local.items()) if args.all or remote.get(p) != (size, crc)]
+    extra = sorted(p for p in remote if p not in local) if args.delete else []
+    library = sum(size for size, _, _ in local.values())
+    print("%d local files, %d on device, %d to upload, %d to delete" %
+          (len(local), len(remote), len(changed), len(extra)))
+
+    transferred = 0
+    upload_start = time.time()
+    if args.pack and changed:
+        transferred = upload_pack(args.host, changed, local, args.pack == "gz")
+    else:
+        for path in changed:
+            size, crc, full = local[path]
+            print("  %s (%d bytes)" % (path, size))
+            transferred += upload(args.host, path, size, crc, full, args.chunk)
+    upload_time = time.time() - upload_start
+    payload = sum(local[p][0] for p in changed)
+    if payload:
+        # File bytes and wire bytes differ for gz packs and for resumed uploads.
+        print("uploaded %d bytes of files (%d sent) in %.1f s: %.2f MB/s of files, %.2f MB/s sent (%s)" %
+              (payload, transferred, upload_time, payload / upload_time / 1e6 if upload_time else 0,
+               transferred / upload_time / 1e6 if upload_time else 0,
+               "pack, " + args.pack if args.pack else "per file"))
+    for path in extra:
+        request(args.host, "POST", "/sync/delete", {"path": path})
+        print("  deleted %s" % path)
+
+    elapsed = time.time() - start
+    print("synced in %.1f s, %d bytes sent for a %d byte library (%.1f%%)" %
+          (elapsed, transferred, library, 100.0 * transferred / library if library else 0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -7,6 +7,17 @@
 #include "modules/ThemeManager.h"
 #include "modules/WebPortal.h"
 #include "modules/ButtonManager.h"
+#include "modules/TagRouter.h"
+#include "modules/CommandBus.h"
+#include "modules/SessionLog.h"
+#include "modules/RecordingStore.h"
+#include "modules/ContentSync.h"
+#include "modules/TarExtractor.h"
+#include "modules/CardScanner.h"
+#include "utils/MemoryArena.h"
+#include "utils/HeapMonitor.h"
+#include "utils/LoopWatchdog.h"
+#include "utils/SampleProfiler.h"
 #include <Preferences.h>
 
 #define DEBUG_MAIN 1
@@ -19,13 +30,20 @@
 #endif
 
 AudioManager audioManager;
-NfcManager nfcManager(PIN_NFC_SDA, PIN_NFC_SCL);
+NfcManager nfcManager(Board::pinNfcSda, Board::pinNfcScl);
 ThemeManager theme;
 WebPortal webPortal;
 LedController led; 
-
-Button btnVol(PIN_BTN_VOL);
-Button btnCtrl(PIN_BTN_CTRL);
+TagRouter tagRouter;
+CommandBus commandBus;
+SessionLog sessionLog;
+RecordingStore recordings;
+ContentSync contentSync;
+TarExtractor packExtractor;
+CardScanner cardScanner;
+
+Button btnVol(Board::pinBtnVol);
+Button btnCtrl(Board::pinBtnCtrl);
 SemaphoreHandle_t nfcMutex = NULL;
 
 enum AppState {
@@ -42,17 +60,45 @@ AppState currentState = STATE_IDLE;
 String lastScannedTag = "";
 unsigned long stateEnterTime = 0;
 unsigned long lastNfcTime = 0; 
+unsigned long trackEndTime = 0;
 bool isCustomFigurineActive = false;
 volatile bool nfcEventPending = false;
 volatile bool pendingCustomPlayback = false;
+volatile int8_t pendingPresence = -1;
+bool pausedByRemoval = false;
 String pendingUid = "";
 String pendingContent = "";
 bool isComboMode = false; 
 bool ignoreButtonsUntilRelease = false; 
+bool sdAvailable = false;
+char currentFigurine[16] = "";
+// Figurine the last portal upload was recorded for; "" for the shared file.
+char uploadedFigurine[16] = "";
 void changeState(AppState newState);
 const char* stateToString(AppState state);
 void processNfcTag();
+void processPresence();
 void handleCustomFigurine();
+void setupTagRoutes();
+void playCustomRoute(const TagView& uid, const TagView& arg);
+void playCueAndWait(const char* path);
+void applyFigurineSpeed(const TagView& uid);
+void saveFigurineSpeed(int percent);
+void executeCommand(const BusCommand& cmd);
+void onButton(uint8_t button);
+void handleButton(uint8_t button);
+void onWebAction(uint8_t action, uint32_t value);
+void handleWebAction(uint8_t action, uint32_t value);
+void replaySessionEvent(const SessionEvent& event);
+void processConsole();
+void playCustomRecording(const char* uid = currentFigurine);
+
+static const char* SYSTEM_CUES[] = {
+    "/system/bt_on.wav",
+    "/system/bt_off.wav",
+    "/system/wifi_off.wav",
+    "/system/no_sd.wav",
+};
 
 const char* stateToString(AppState state) {
     switch(state) {
@@ -67,37 +113,78 @@ const char* stateToString(AppState state) {
     }
 }
 
+void executeCommand(const BusCommand& cmd) {
+    sessionLog.recordEffect(SES_COMMAND, cmd.type);
+    switch (cmd.type) {
+        case CMD_AUDIO_PLAY_FILE: audioManager.playFile(cmd.path); break;
+        case CMD_AUDIO_PLAY_FOLDER: audioManager.playFolder(cmd.path); break;
+        case CMD_AUDIO_PLAY_CUE: audioManager.playCue(cmd.path); break;
+        case CMD_AUDIO_PLAY_STREAM: audioManager.playStream(); break;
+        case CMD_AUDIO_STOP: audioManager.stop(); break;
+        case CMD_AUDIO_TOGGLE_PAUSE: audioManager.togglePause(); break;
+        case CMD_AUDIO_PAUSE: audioManager.pause(); break;
+        case CMD_AUDIO_RESUME: audioManager.resume(); break;
+        case CMD_AUDIO_NEXT: audioManager.playNext(); break;
+        case CMD_AUDIO_VOLUME: audioManager.setVolume(cmd.arg); break;
+        case CMD_AUDIO_VOLUME_STEP: {
+            int v = audioManager.getVolume() + cmd.arg;
+            if (v > 21) v = 4;
+            audioManager.setVolume(v);
+            break;
+        }
+        case CMD_AUDIO_SPEED:
+            audioManager.setSpeed(cmd.arg);
+            if (cmd.path[0]) saveFigurineSpeed(cmd.arg);
+            break;
+        case CMD_LED_COLOR: led.setColor((cmd.arg >> 16) & 0xFF, (cmd.arg >> 8) & 0xFF, cmd.arg & 0xFF); break;
+        case CMD_LED_LOADING: led.setLoading(cmd.arg != 0); break;
+        case CMD_LED_BLINK_ERROR: led.blinkError(cmd.arg); break;
+        default: break;
+    }
+}
+
+void playCueAndWait(const char* path) {
+    if (!audioManager.playCue(path)) return;
+    unsigned long cueStart = millis();
+    while (audioManager.isCuePlaying() && millis() - cueStart < 3000) {
+        audioManager.loop();
+        delay(10);
+    }
+}
+
 void changeState(AppState newState) {
     LOG_MAIN_F("changeState: %s -> %s", stateToString(currentState), stateToString(newState));
     
     if (currentState == newState) return;
+    sessionLog.recordEffect(SES_STATE, (currentState << 4) | newState);
     if (currentState == STATE_BT_MODE) {
         audioManager.stopBluetooth();
         lastScannedTag = "";
+        nfcManager.forgetTag();
     }
 
     if (currentState == STATE_WIFI_MODE) {
         webPortal.stop();
         delay(100);
-        if (SD.exists("/system/wifi_off.wav")) {
-            audioManager.playFile("/system/wifi_off.wav");
-            unsigned long wifiSoundStart = millis();
-            while (audioManager.isPlaying() && millis() - wifiSoundStart < 3000) {
-                audioManager.loop();
-                delay(10);
-            }
-        }
+        playCueAndWait("/system/wifi_off.wav");
         
         WiFi.disconnect(true);
         WiFi.mode(WIFI_OFF);
+        audioManager.setWifiActive(false);
         delay(100);
         lastScannedTag = "";
+        nfcManager.cancelWrite();
+        nfcManager.forgetTag();
         isCustomFigurineActive = false;
         pendingCustomPlayback = false;
+        webPortal.setUploadTarget("");
     }
     
+    if (!(currentState == STATE_PLAYING && newState == STATE_PAUSED)) pausedByRemoval = false;
     currentState = newState;
-    stateEnterTime = millis();
+    stateEnterTime = sessionLog.now();
+    audioManager.setVisualizer(currentState == STATE_PLAYING);
+    led.setVisualizer(currentState == STATE_PLAYING);
 
     switch (currentState) {
         case STATE_IDLE:
@@ -111,14 +198,7 @@ void changeState(AppState newState) {
             break;
         case STATE_BT_MODE:
             theme.setLed("bt_mode", led);
-            if (SD.exists("/system/bt_on.wav")) {
-                audioManager.playFile("/system/bt_on.wav");
-                unsigned long btSoundStart = millis();
-                while (audioManager.isPlaying() && millis() - btSoundStart < 3000) {
-                    audioManager.loop();
-                    delay(10);
-                }
-            }
+            playCueAndWait("/system/bt_on.wav");
             audioManager.startBluetooth();
             break;
             
@@ -131,7 +211,9 @@ void changeState(AppState newState) {
             delay(100);
             theme.setLed("wifi_start", led); 
             webPortal.begin(); 
-            audioManager.playFile("/system/connect.mp3"); 
+            audioManager.setWifiActive(true);
+            contentSync.refresh();
+            audioManager.playCue("/system/connect.mp3"); 
             break;
             
         case STATE_WAITING_FOR_PLAY:
@@ -141,14 +223,13 @@ void changeState(AppState newState) {
     }
 }
 
-void onAudioStateChanged(bool isPlaying) {
-    LOG_MAIN_F("Audio State Callback: isPlaying=%d", isPlaying);
-    
+void handleAudioState(bool isPlaying) {
     if (currentState == STATE_BT_MODE) return; 
     if (currentState == STATE_WIFI_TRANSITION || currentState == STATE_WIFI_MODE) {
         return;
     }
 
+    if (isPlaying) trackEndTime = 0;
     if (isPlaying && currentState != STATE_PLAYING) {
         changeState(STATE_PLAYING);
     } else if (!isPlaying && currentState == STATE_PLAYING) {
@@ -156,31 +237,47 @@ void onAudioStateChanged(bool isPlaying) {
     }
 }
 
+void handleTrackEnd() {
+    if (currentState == STATE_PLAYING && trackEndTime == 0) trackEndTime = sessionLog.now() | 1;
+}
+
+// During a replay the state machine follows the recorded audio events, not
+// the decoder, which plays in real time behind a faster replay.
+void onAudioStateChanged(bool isPlaying) {
+    LOG_MAIN_F("Audio State Callback: isPlaying=%d", isPlaying);
+    if (sessionLog.isReplaying()) return;
+    sessionLog.record(SES_AUDIO, isPlaying);
+    handleAudioState(isPlaying);
+}
+
 void handleCustomFigurine() {
     if (currentState == STATE_BT_MODE) {
         led.blinkError(3);
         return;
     }
 
-    LOG_MAIN_F("Checking custom file: %s", FILE_CUSTOM_STORY);
+    char path[RECORD_PATH_LEN];
+    LOG_MAIN_F("Checking recording for figurine %s", currentFigurine);
 
-    if (SD.exists(FILE_CUSTOM_STORY)) {
-        LOG_MAIN(">>> FILE FOUND. Playing custom story.");
+    if (recordings.resolve(currentFigurine, path, sizeof(path))) {
+        LOG_MAIN_F(">>> FILE FOUND. Playing %s", path);
         changeState(STATE_PLAYING); 
-        audioManager.playFile(FILE_CUSTOM_STORY);
+        audioManager.playFile(path);
         
+    } else if (!Board::hasWifiPortal) {
+        LOG_MAIN(">>> FILE MISSING. No portal on this board.");
+        led.blinkError(3);
     } else {
         LOG_MAIN(">>> FILE MISSING. Starting WiFi Sequence.");
-        if (SD.exists("/system/need_rec.mp3")) {
-            audioManager.playFile("/system/need_rec.mp3");
-        } else {
+        webPortal.setUploadTarget(currentFigurine);
+        if (!audioManager.playCue("/system/need_rec.mp3")) {
             LOG_MAIN("WARNING: /system/need_rec.mp3 not found!");
         }
         changeState(STATE_WIFI_TRANSITION);
     }
 }
 
-void onTagDetected(String uid, String content) {
+void queueTag(const String& uid, const String& content) {
     if (xSemaphoreTake(nfcMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
         if (!nfcEventPending) {
             pendingUid = uid;
@@ -191,8 +288,15 @@ void onTagDetected(String uid, String content) {
     }
 }
 
+void onTagDetected(String uid, String content) {
+    if (sessionLog.isReplaying()) return;
+    sessionLog.recordTag(uid.c_str(), content.c_str());
+    queueTag(uid, content);
+}
+
 void processNfcTag() {
-    if (millis() - lastNfcTime < 500) return;
+    if (sessionLog.now() - lastNfcTime < 500) return;
+    HEAP_SCOPE(MEM_NFC);
 
     String uid = "";
     String content = "";
@@ -210,7 +314,7 @@ void processNfcTag() {
 
     if (!hasEvent) return;
     
-    lastNfcTime = millis(); 
+    lastNfcTime = sessionLog.now(); 
     
     LOG_MAIN_F("NFC Tag: %s", content.c_str());
     
@@ -224,82 +328,313 @@ void processNfcTag() {
     }
 
     lastScannedTag = content;
-    if (content.indexOf("192.168") != -1 || content.indexOf("cmd:rec") != -1) {
-        isCustomFigurineActive = true;
-        handleCustomFigurine();
-    } 
-    else if (content.indexOf("cmd:") != -1) {
+    TagView uidView = { uid.c_str(), uid.length() };
+    TagView contentView = { content.c_str(), content.length() };
+    if (!tagRouter.dispatch(uidView, contentView)) {
+        LOG_MAIN_F("No route for tag: %s", content.c_str());
+    }
+}
+
+// Lifting the figurine pauses its story; putting the same one back resumes.
+// Anything else that changes the state in between cancels the resume.
+void processPresence() {
+    int8_t event = pendingPresence;
+    if (event < 0) return;
+    pendingPresence = -1;
+
+    if (event == NFC_TAG_REMOVED) {
+        if (currentState != STATE_PLAYING) return;
+        pausedByRemoval = true;
+        commandBus.post(CMD_AUDIO_PAUSE);
+        LOG_MAIN_F("Figurine removed, pausing %lu ms after last contact", millis() - nfcManager.getLastSeenMs());
+    } else if (event == NFC_TAG_RETURNED) {
+        if (!pausedByRemoval || currentState != STATE_PAUSED) return;
+        pausedByRemoval = false;
+        commandBus.post(CMD_AUDIO_RESUME);
+        LOG_MAIN("Figurine returned, resuming");
+    }
+}
+
+// Speeds are kept per figurine UID in NVS; unknown figurines play at 100%.
+void applyFigurineSpeed(const TagView& uid) {
+    snprintf(currentFigurine, sizeof(currentFigurine), "%.*s", (int)uid.len, uid.data);
+    Preferences prefs;
+    prefs.begin("speed", true);
+    uint8_t percent = prefs.getUChar(currentFigurine, 100);
+    prefs.end();
+    commandBus.post(CMD_AUDIO_SPEED, percent);
+}
+
+void saveFigurineSpeed(int percent) {
+    if (!currentFigurine[0]) return;
+    Preferences prefs;
+    prefs.begin("speed", false);
+    prefs.putUChar(currentFigurine, percent);
+    prefs.end();
+    LOG_MAIN_F("Speed %d%% saved for figurine %s", percent, currentFigurine);
+}
+
+// Falls back to the pre-slot shared file when the figurine has no slot yet,
+// e.g. after an upload that did not say which figurine it was for.
+void playCustomRecording(const char* uid) {
+    char path[RECORD_PATH_LEN];
+    if (!recordings.resolve(uid, path, sizeof(path))) {
+        snprintf(path, sizeof(path), "%s", FILE_CUSTOM_STORY);
+    }
+    audioManager.playFile(path);
+}
+
+void handleButton(uint8_t button) {
+    switch (button) {
+        case SES_BTN_VOL_CLICK:
+            commandBus.post(CMD_AUDIO_VOLUME_STEP, 2);
+            break;
+        case SES_BTN_VOL_LONG:
+            if (!Board::hasBluetooth) break;
+            if (currentState != STATE_WIFI_MODE && currentState != STATE_WIFI_TRANSITION) {
+                if (currentState == STATE_BT_MODE) changeState(STATE_IDLE);
+                else changeState(STATE_BT_MODE);
+            }
+            break;
+        case SES_BTN_CTRL_CLICK:
+            if (currentState == STATE_PLAYING || currentState == STATE_PAUSED || currentState == STATE_BT_MODE) {
+                commandBus.post(CMD_AUDIO_TOGGLE_PAUSE);
+            }
+            else if (currentState == STATE_WAITING_FOR_PLAY) {
+                playCustomRecording();
+            }
+            break;
+        case SES_BTN_CTRL_LONG:
+            if (currentState == STATE_PLAYING && !isCustomFigurineActive) {
+                commandBus.post(CMD_AUDIO_NEXT);
+            }
+            else if (currentState == STATE_BT_MODE) {
+                audioManager.btNext();
+            }
+            break;
+        case SES_BTN_COMBO:
+            if (currentState == STATE_BT_MODE || !Board::hasWifiPortal) {
+                led.setColor(255, 0, 0); 
+            } else {
+                changeState(STATE_WIFI_MODE);
+            }
+            break;
+    }
+}
+
+void onButton(uint8_t button) {
+    if (isComboMode || ignoreButtonsUntilRelease || sessionLog.isReplaying()) return;
+    sessionLog.record(SES_BUTTON, button);
+    handleButton(button);
+}
+
+void handleWebAction(uint8_t action, uint32_t value) {
+    switch (action) {
+        case SES_WEB_VOLUME: commandBus.postVolume(value); break;
+        case SES_WEB_SPEED: commandBus.post(CMD_AUDIO_SPEED, value, "save"); break;
+        case SES_WEB_LED: commandBus.postLedColor(value >> 16, value >> 8, value); break;
+        case SES_WEB_STREAM:
+            // Not a figurine's story, so not at its speed either.
+            commandBus.post(CMD_AUDIO_SPEED, 100);
+            commandBus.post(CMD_AUDIO_PLAY_STREAM);
+            break;
+        case SES_WEB_UPLOAD:
+            LOG_MAIN("Upload Complete. Pending playback.");
+            pendingCustomPlayback = true;
+            break;
+    }
+}
+
+void onWebAction(uint8_t action, uint32_t value) {
+    if (sessionLog.isReplaying()) return;
+    sessionLog.record(SES_WEB, action, value);
+    handleWebAction(action, value);
+}
+
+// Replayed inputs take the same paths as live ones, minus the recording.
+void replaySessionEvent(const SessionEvent& event) {
+    switch (event.type) {
+        case SES_TAG: queueTag(event.uid, event.content); break;
+        case SES_PRESENCE: pendingPresence = event.arg; break;
+        case SES_BUTTON: handleButton(event.arg); break;
+        case SES_AUDIO:
+            if (event.arg == SES_AUDIO_TRACK_END) handleTrackEnd();
+            else handleAudioState(event.arg);
+            break;
+        case SES_WEB: handleWebAction(event.arg, event.value); break;
+    }
+}
+
+// Line-based serial console for field diagnostics.
+void processConsole() {
+    static char line[24];
+    static uint8_t len = 0;
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (len < sizeof(line) - 1) line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        if (len && !LoopWatchdog::handleCommand(line) && !sessionLog.handleCommand(line) &&
+#if SUNTOY_PROFILER
+            !SampleProfiler::handleCommand(line) &&
+#endif
+            !audioManager.handleCommand(line)) {
+            LOG_MAIN_F("Unknown command: %s", line);
+        }
+        len = 0;
+    }
+}
+
+void playCustomRoute(const TagView& uid, const TagView& arg) {
+    isCustomFigurineActive = true;
+    applyFigurineSpeed(uid);
+    handleCustomFigurine();
+}
+
+// The rest of a portal link's host: two more octets, then the end, a port
+// or a path.
+bool isPortalHost(const TagView& arg) {
+    size_t i = 0;
+    for (uint8_t octet = 0; octet < 2; octet++) {
+        if (octet && (i == arg.len || arg.data[i++] != '.')) return false;
+        size_t start = i;
+        while (i < arg.len && i - start < 3 && isdigit((unsigned char)arg.data[i])) i++;
+        if (i == start) return false;
+    }
+    return i == arg.len || arg.data[i] == '/' || arg.data[i] == ':';
+}
+
+// Tale folders are a single path component of [0-9A-Za-z_-].
+bool isTaleName(const TagView& arg) {
+    if (arg.len == 0 || arg.len > TALE_NAME_MAX) return false;
+    for (size_t i = 0; i < arg.len; i++) {
+        char c = arg.data[i];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-') return false;
+    }
+    return true;
+}
+
+// Volume argument: one or two digits, 0-21.
+int parseTagVolume(const TagView& arg) {
+    if (arg.len == 0 || arg.len > 2) return -1;
+    int value = 0;
+    for (size_t i = 0; i < arg.len; i++) {
+        if (!isdigit((unsigned char)arg.data[i])) return -1;
+        value = value * 10 + (arg.data[i] - '0');
+    }
+    return value <= 21 ? value : -1;
+}
+
+void setupTagRoutes() {
+    tagRouter.add(TAG_CMD_CUSTOM, playCustomRoute);
+
+    // Portal links are written with and without a scheme.
+    static const char* const PORTAL_LINKS[] = { TAG_PORTAL_HOST, "http://" TAG_PORTAL_HOST, "https://" TAG_PORTAL_HOST };
+    for (const char* link : PORTAL_LINKS) {
+        tagRouter.add(link, [](const TagView& uid, const TagView& arg) {
+            if (!isPortalHost(arg)) {
+                LOG_MAIN_F("Rejected portal link: %.*s", (int)arg.len, arg.data);
+                return;
+            }
+            playCustomRoute(uid, arg);
+        });
+    }
+
+    tagRouter.add(TAG_CMD_TALE, [](const TagView& uid, const TagView& arg) {
+        if (!isTaleName(arg)) {
+            LOG_MAIN_F("Rejected tale name: %.*s", (int)arg.len, arg.data);
+            return;
+        }
         isCustomFigurineActive = false;
-        String folderCode = content.substring(content.indexOf("cmd:") + 4); 
-        String folderPath = "/tales/" + folderCode;
-        audioManager.playFolder(folderPath);
+        applyFigurineSpeed(uid);
+        char folderPath[48];
+        snprintf(folderPath, sizeof(folderPath), "%s/%.*s", DIR_TALES, (int)arg.len, arg.data);
+        commandBus.post(CMD_AUDIO_PLAY_FOLDER, 0, folderPath);
+    });
+
+    tagRouter.add(TAG_CMD_VOLUME, [](const TagView& uid, const TagView& arg) {
+        int volume = parseTagVolume(arg);
+        if (volume < 0) {
+            LOG_MAIN_F("Rejected volume: %.*s", (int)arg.len, arg.data);
+            return;
+        }
+        commandBus.postVolume(volume);
+    });
+
+    if (!tagRouter.compile()) {
+        LOG_MAIN("ERROR: Tag route table overflow");
     }
 }
 
 void setup() {
     Serial.begin(115200);
+    LoopWatchdog::begin();
+    MemoryArena::begin();
     nfcMutex = xSemaphoreCreateMutex();
+    commandBus.begin();
+    commandBus.onCommand(executeCommand);
 
     led.begin(); 
     led.setColor(255, 100, 0); 
     btnVol.begin(); 
     btnCtrl.begin();
     
-    btnVol.attachClick([]() {
-        if (isComboMode || ignoreButtonsUntilRelease) return;
-        int oldVol = audioManager.getVolume();
-        int v = oldVol + 2;
-        if (v > 21) v = 4;
-        audioManager.setVolume(v);
-    });
+    btnVol.attachClick([]() { onButton(SES_BTN_VOL_CLICK); });
+    btnVol.attachLongPress([]() { onButton(SES_BTN_VOL_LONG); });
+    btnCtrl.attachClick([]() { onButton(SES_BTN_CTRL_CLICK); });
+    btnCtrl.attachLongPress([]() { onButton(SES_BTN_CTRL_LONG); });
 
-    btnVol.attachLongPress([]() {
-        if (isComboMode || ignoreButtonsUntilRelease) return;
-        if (currentState != STATE_WIFI_MODE && currentState != STATE_WIFI_TRANSITION) {
-            if (currentState == STATE_BT_MODE) changeState(STATE_IDLE);
-            else changeState(STATE_BT_MODE);
-        }
-    });
-
-    btnCtrl.attachClick([]() {
-        if (isComboMode || ignoreButtonsUntilRelease) return;
-        
-        if (currentState == STATE_PLAYING || currentState == STATE_PAUSED || currentState == STATE_BT_MODE) {
-            audioManager.togglePause();
-        }
-        else if (currentState == STATE_WAITING_FOR_PLAY) {
-            audioManager.playFile(FILE_CUSTOM_STORY);
-        }
-    });
-
-    btnCtrl.attachLongPress([]() {
-        if (isComboMode || ignoreButtonsUntilRelease) return;
-         if (currentState == STATE_PLAYING && !isCustomFigurineActive) {
-             audioManager.playNext();
-         }
-         else if (currentState == STATE_BT_MODE) {
-             BluetoothA2DPSink* sink = audioManager.getBtSink();
-             if (sink) sink->next();
-         }
-    });
+    // Audio comes up before the card so the flash-embedded cues are usable
+    // even when the SD mount is slow or fails.
+    audioManager.begin();
+    audioManager.onStateChange(onAudioStateChanged);
+    for (const char* cue : SYSTEM_CUES) audioManager.preloadEmbeddedCue(cue);
 
-    SPI.begin(PIN_SD_SCK, PIN_SD_MISO, PIN_SD_MOSI, PIN_SD_CS);
-    if(!SD.begin(PIN_SD_CS)) { 
-        Serial.println("SD Card Mount Failed");
+    SPI.begin(Board::pinSdSck, Board::pinSdMiso, Board::pinSdMosi, Board::pinSdCs);
+    sdAvailable = SD.begin(Board::pinSdCs);
+    if (!sdAvailable) { 
+        Serial.println("SD Card Mount Failed - running on embedded assets");
         led.setColor(255,0,0); 
-        return; 
+        playCueAndWait("/system/no_sd.wav");
+    } else {
+        for (const char* cue : SYSTEM_CUES) audioManager.preloadCue(cue);
+        sessionLog.begin();
+        sessionLog.onReplay(replaySessionEvent);
+        recordings.begin();
+        contentSync.begin();
+        packExtractor.begin(&contentSync);
+        cardScanner.begin();
+        audioManager.beginWarmCache();
     }
 
     theme.begin();
+    setupTagRoutes();
     nfcManager.onTagDetected(onTagDetected);
+    nfcManager.onPresenceChange([](NfcPresenceEvent event) {
+        if (sessionLog.isReplaying()) return;
+        sessionLog.record(SES_PRESENCE, event);
+        pendingPresence = event;
+    });
     nfcManager.begin();
+    theme.preloadSounds(audioManager);
     
-    audioManager.begin();
-    audioManager.onStateChange(onAudioStateChanged);
-    
-    webPortal.onUploadComplete([]() {
-        LOG_MAIN("Upload Complete. Pending playback.");
-        pendingCustomPlayback = true;
+    webPortal.onVolumeChange([](int v) { onWebAction(SES_WEB_VOLUME, v); });
+    webPortal.onSpeedChange([](int percent) { onWebAction(SES_WEB_SPEED, percent); });
+    webPortal.onLedChange([](int r, int g, int b) {
+        onWebAction(SES_WEB_LED, ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b);
+    });
+    webPortal.setStreamSink(audioManager.getStreamBuffer());
+    webPortal.setRecordingStore(&recordings);
+    webPortal.setContentSync(&contentSync);
+    webPortal.setPackExtractor(&packExtractor);
+    webPortal.setTagWriter(&nfcManager);
+    webPortal.setCardScanner(&cardScanner);
+    webPortal.onStreamStart([]() { onWebAction(SES_WEB_STREAM, 0); });
+    webPortal.onUploadComplete([](const char* uid) {
+        if (!sessionLog.isReplaying()) snprintf(uploadedFigurine, sizeof(uploadedFigurine), "%s", uid);
+        onWebAction(SES_WEB_UPLOAD, 0);
     });
     Preferences bootPrefs;
     bootPrefs.begin("audio", false);
@@ -309,14 +644,7 @@ void setup() {
         bootPrefs.putBool("bt_exit", false);
         LOG_MAIN("Boot after BT exit - playing bt_off sound");
         led.setColor(128, 0, 128); 
-        if (SD.exists("/system/bt_off.wav")) {
-            audioManager.playFile("/system/bt_off.wav");
-            unsigned long btOffStart = millis();
-            while (audioManager.isPlaying() && millis() - btOffStart < 3000) {
-                audioManager.loop();
-                delay(10);
-            }
-        }
+        playCueAndWait("/system/bt_off.wav");
         theme.setLed("idle", led);
     } else {
         theme.apply("boot", audioManager, led);
@@ -324,17 +652,44 @@ void setup() {
     bootPrefs.end();
     
     changeState(STATE_IDLE);
+    LOG_MAIN_F("Boot complete on %s in %lu ms", Board::name, millis());
 }
 
 void loop() {
-    processNfcTag();
-    btnVol.loop();
-    btnCtrl.loop();
-    led.loop();
+    HeapMonitor::loop();
+#if SUNTOY_PROFILER
+    SampleProfiler::loop();
+#endif
+    processConsole();
+    {
+        LOOP_SCOPE(LOOP_MAIN);
+        sessionLog.loop();
+        recordings.collect(audioManager.getCurrentTrack());
+    }
+    {
+        HEAP_SCOPE(MEM_MAIN);
+        LOOP_SCOPE(LOOP_COMMANDS);
+        commandBus.dispatch();
+    }
+    {
+        LOOP_SCOPE(LOOP_NFC);
+        processNfcTag();
+        processPresence();
+    }
+    {
+        LOOP_SCOPE(LOOP_BUTTONS);
+        btnVol.loop();
+        btnCtrl.loop();
+    }
+    {
+        LOOP_SCOPE(LOOP_LED);
+        led.setVisualLevel(audioManager.getVisualLevel());
+        led.loop();
+    }
     
     static unsigned long comboStart = 0;
-    bool volPressed = (digitalRead(PIN_BTN_VOL) == HIGH);
-    bool ctrlPressed = (digitalRead(PIN_BTN_CTRL) == HIGH);
+    bool volPressed = (digitalRead(Board::pinBtnVol) == HIGH);
+    bool ctrlPressed = (digitalRead(Board::pinBtnCtrl) == HIGH);
     bool bothPressed = volPressed && ctrlPressed;
     
     if (ignoreButtonsUntilRelease) {
@@ -352,10 +707,9 @@ void loop() {
         }
         
         if (millis() - comboStart > 3000) { 
-            if (currentState == STATE_BT_MODE) {
-                led.setColor(255, 0, 0); 
-            } else {
-                changeState(STATE_WIFI_MODE);
+            if (!sessionLog.isReplaying()) {
+                sessionLog.record(SES_BUTTON, SES_BTN_COMBO);
+                handleButton(SES_BTN_COMBO);
             }
             ignoreButtonsUntilRelease = true; 
             comboStart = 0;
@@ -367,13 +721,21 @@ void loop() {
         }
     }
     if (currentState == STATE_WIFI_MODE) {
-        webPortal.loop();
-        if (webPortal.isClientConnected()) led.setLoading(true);
-        else theme.setLed("wifi_start", led);
-        if (audioManager.isPlaying()) {
+        {
+            LOOP_SCOPE(LOOP_WEB);
+            webPortal.loop();
+            contentSync.loop();
+            webPortal.publishStatus(stateToString(currentState), audioManager.getVolume(), audioManager.getSpeed(),
+                                    audioManager.getCurrentTrack(), audioManager.getPosition());
+            if (webPortal.isClientConnected()) led.setLoading(true);
+            else theme.setLed("wifi_start", led);
+        }
+        if (audioManager.isPlaying() || audioManager.isCuePlaying()) {
+            LOOP_SCOPE(LOOP_AUDIO);
             audioManager.loop();
         }
         if (pendingCustomPlayback) {
+            LOOP_SCOPE(LOOP_MAIN);
             pendingCustomPlayback = false;
             LOG_MAIN("Processing pending playback...");
             delay(300); 
@@ -382,41 +744,56 @@ void loop() {
             isCustomFigurineActive = true;
             changeState(STATE_PLAYING);
             delay(100);
-            audioManager.playFile(FILE_CUSTOM_STORY);
+            playCustomRecording(uploadedFigurine[0] ? uploadedFigurine : currentFigurine);
         }
     } 
     else if (currentState == STATE_WIFI_TRANSITION) {
-        audioManager.loop();
-        if (!audioManager.isPlaying()) {
+        {
+            LOOP_SCOPE(LOOP_AUDIO);
+            audioManager.loop();
+        }
+        if (!audioManager.isPlaying() && !audioManager.isCuePlaying()) {
             LOG_MAIN("Prompt finished. Switching to WiFi Mode.");
             changeState(STATE_WIFI_MODE);
         }
     }
     else {
-        audioManager.loop();
+        {
+            LOOP_SCOPE(LOOP_AUDIO);
+            audioManager.loop();
+        }
 
         if (currentState == STATE_WAITING_FOR_PLAY) {
-            if (millis() - stateEnterTime > 10000) {
-                audioManager.playFile(FILE_CUSTOM_STORY);
+            if (sessionLog.now() - stateEnterTime > 10000) {
+                playCustomRecording();
             }
         }
 
-        static unsigned long lastTrackEndTime = 0;
-        if (currentState == STATE_PLAYING && !audioManager.isPlaying()) {
-            if (lastTrackEndTime == 0) {
-                lastTrackEndTime = millis();
-            }
+        if (currentState == STATE_PLAYING && trackEndTime == 0 && !audioManager.isPlaying() &&
+            !sessionLog.isReplaying()) {
+            sessionLog.record(SES_AUDIO, SES_AUDIO_TRACK_END);
+            handleTrackEnd();
+        }
 
-            if (millis() - lastTrackEndTime > 500) {
-                lastTrackEndTime = 0; 
-                if (!isCustomFigurineActive) {
-                    audioManager.playNext(); 
-                } else {
-                    changeState(STATE_IDLE); 
-                }
+        if (currentState != STATE_PLAYING) {
+            trackEndTime = 0;
+        } else if (trackEndTime && sessionLog.now() - trackEndTime > SESSION_TRACK_GAP_MS) {
+            trackEndTime = 0; 
+            if (!isCustomFigurineActive) {
+                LOOP_SCOPE(LOOP_AUDIO);
+                audioManager.playNext(); 
+            } else {
+                changeState(STATE_IDLE); 
             }
-        } else {
-            lastTrackEndTime = 0;
+        }
+
+        {
+            LOOP_SCOPE(LOOP_MAIN);
+            bool idle = (currentState == STATE_IDLE || currentState == STATE_PAUSED) &&
+                        !audioManager.isPlaying() && !audioManager.isCuePlaying();
+            cardScanner.loop(idle);
+            // Five red blinks: the card has damaged files, see /scan.
+            if (cardScanner.takeNewBad()) led.blinkError(5);
         }
     }
 }
\ No newline at end of file
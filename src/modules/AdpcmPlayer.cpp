@@ -0,0 +1,85 @@
+#include "AdpcmPlayer.h"
+#include "../utils/WavHeader.h"
+
+bool AdpcmPlayer::probe(const char* path) {
+    File file = SD.open(path);
+    if (!file) return false;
+    WavInfo info;
+    bool isAdpcm = WavHeader::read(file, info) && info.format == WAV_FORMAT_IMA_ADPCM;
+    file.close();
+    return isAdpcm;
+}
+
+bool AdpcmPlayer::open(const char* path) {
+    close();
+    _file = SD.open(path);
+    if (!_file) return false;
+
+    WavInfo info;
+    if (!WavHeader::read(_file, info) || info.format != WAV_FORMAT_IMA_ADPCM ||
+        info.channels < 1 || info.channels > 2 || info.blockAlign < 4 * info.channels ||
+        info.blockAlign > ADPCM_MAX_BLOCK_ALIGN || info.sampleRate == 0 ||
+        ImaAdpcm::framesPerBlock(info.blockAlign, info.channels) > ADPCM_MAX_BLOCK_FRAMES) {
+        _file.close();
+        return false;
+    }
+
+    _channels = info.channels;
+    _blockAlign = info.blockAlign;
+    _sampleRate = info.sampleRate;
+    _dataLeft = info.dataBytes;
+    _framesLeft = info.factFrames ? info.factFrames : 0xFFFFFFFF;
+    _framesPlayed = 0;
+    _pcmFrames = _pcmPos = 0;
+    _open = true;
+    return true;
+}
+
+void AdpcmPlayer::close() {
+    if (_file) _file.close();
+    _open = false;
+}
+
+bool AdpcmPlayer::isOpen() {
+    return _open;
+}
+
+bool AdpcmPlayer::decodeNextBlock() {
+    if (_dataLeft == 0 || _framesLeft == 0) return false;
+    size_t want = min((uint32_t)_blockAlign, _dataLeft);
+    size_t got = _file.read(_block, want);
+    if (got < 4u * _channels) return false;
+    _dataLeft -= want;
+
+    _pcmFrames = ImaAdpcm::decodeBlock(_block, got, _channels, _pcm);
+    if (_pcmFrames > _framesLeft) _pcmFrames = _framesLeft;
+    _framesLeft -= _pcmFrames;
+    _pcmPos = 0;
+    return _pcmFrames > 0;
+}
+
+size_t AdpcmPlayer::read(int16_t* stereo, size_t frames) {
+    if (!_open) return 0;
+    size_t n = 0;
+    while (n < frames) {
+        if (_pcmPos >= _pcmFrames && !decodeNextBlock()) break;
+        size_t take = min(frames - n, _pcmFrames - _pcmPos);
+        for (size_t i = 0; i < take; i++) {
+            const int16_t* src = _pcm + (_pcmPos + i) * _channels;
+            stereo[2 * (n + i)] = src[0];
+            stereo[2 * (n + i) + 1] = src[_channels - 1];
+        }
+        _pcmPos += take;
+        n += take;
+    }
+    _framesPlayed += n;
+    return n;
+}
+
+uint32_t AdpcmPlayer::getSampleRate() {
+    return _sampleRate;
+}
+
+uint32_t AdpcmPlayer::getPositionSec() {
+    return _sampleRate ? _framesPlayed / _sampleRate : 0;
+}
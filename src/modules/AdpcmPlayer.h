@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "ImaAdpcm.h"
+
+// Streams an IMA ADPCM WAV from SD and decodes it block by block into
+// interleaved stereo PCM16 for the direct I2S path.
+class AdpcmPlayer {
+public:
+    static bool probe(const char* path);
+
+    bool open(const char* path);
+    void close();
+    bool isOpen();
+    size_t read(int16_t* stereo, size_t frames);
+
+    uint32_t getSampleRate();
+    uint32_t getPositionSec();
+
+private:
+    File _file;
+    bool _open = false;
+    uint16_t _channels = 0;
+    uint16_t _blockAlign = 0;
+    uint32_t _sampleRate = 0;
+    uint32_t _dataLeft = 0;
+    uint32_t _framesLeft = 0;
+    uint32_t _framesPlayed = 0;
+
+    uint8_t _block[ADPCM_MAX_BLOCK_ALIGN];
+    int16_t _pcm[ADPCM_MAX_BLOCK_FRAMES * 2];
+    size_t _pcmFrames = 0;
+    size_t _pcmPos = 0;
+
+    bool decodeNextBlock();
+};
@@ -0,0 +1,205 @@
+#include "AdpcmTranscoder.h"
+#include "../utils/WavHeader.h"
+
+void AdpcmTranscoder::begin(File* out) {
+    _out = out;
+    _mode = MODE_HEADER;
+    _headerLen = 0;
+    _headerPos = 0;
+    _chunkLen = 0;
+    _skip = 0;
+    _pcmFill = 0;
+    _framesOut = 0;
+    _dataOut = 0;
+    _bytesIn = 0;
+    _bytesOut = 0;
+    _encodeMicros = 0;
+}
+
+bool AdpcmTranscoder::emit(const uint8_t* data, size_t len) {
+    if (!_out || !*_out) return false;
+    size_t written = _out->write(data, len);
+    _bytesOut += written;
+    return written == len;
+}
+
+bool AdpcmTranscoder::write(const uint8_t* data, size_t len) {
+    _bytesIn += len;
+    if (_mode == MODE_PASSTHROUGH) return emit(data, len);
+    if (_mode == MODE_ENCODE) return feedPcm(data, len);
+    if (_mode == MODE_CHUNKS) return walkChunks(data, len);
+
+    size_t take = min(len, sizeof(_header) - _headerLen);
+    memcpy(_header + _headerLen, data, take);
+    _headerLen += take;
+    HeaderStatus status = parseHeader();
+    if (status == HEADER_MORE && _headerLen < sizeof(_header)) return true;
+    if (status != HEADER_ACCEPT) {
+        _mode = MODE_PASSTHROUGH;
+        return emit(_header, _headerLen) && emit(data + take, len - take);
+    }
+
+    // _headerPos is the first chunk after "fmt ", possibly past the buffer.
+    _mode = MODE_CHUNKS;
+    _chunkLen = 0;
+    _skip = 0;
+    if (_headerPos > _headerLen) {
+        _skip = _headerPos - _headerLen;
+    } else if (!walkChunks(_header + _headerPos, _headerLen - _headerPos)) {
+        return false;
+    }
+    data += take;
+    len -= take;
+    return _mode == MODE_ENCODE ? feedPcm(data, len) : walkChunks(data, len);
+}
+
+// Accepts once a PCM16 mono/stereo "fmt " chunk is complete in the buffer.
+AdpcmTranscoder::HeaderStatus AdpcmTranscoder::parseHeader() {
+    if (_headerLen < 12) return HEADER_MORE;
+    if (memcmp(_header, "RIFF", 4) != 0 || memcmp(_header + 8, "WAVE", 4) != 0) return HEADER_REJECT;
+
+    size_t pos = 12;
+    while (pos + 8 <= _headerLen) {
+        uint32_t chunkLen = WavHeader::le32(_header + pos + 4);
+        if (memcmp(_header + pos, "data", 4) == 0) return HEADER_REJECT;
+        if (memcmp(_header + pos, "fmt ", 4) == 0) {
+            if (chunkLen < 16) return HEADER_REJECT;
+            if (pos + 24 > _headerLen) return HEADER_MORE;
+            uint16_t format = WavHeader::le16(_header + pos + 8);
+            _channels = WavHeader::le16(_header + pos + 10);
+            _sampleRate = WavHeader::le32(_header + pos + 12);
+            uint16_t bits = WavHeader::le16(_header + pos + 22);
+            if (format != WAV_FORMAT_PCM || bits != 16 || _channels < 1 || _channels > 2) return HEADER_REJECT;
+            _headerPos = pos + 8 + chunkLen + (chunkLen & 1);
+            return HEADER_ACCEPT;
+        }
+        pos += 8 + chunkLen + (chunkLen & 1);
+    }
+    return HEADER_MORE;
+}
+
+// Skips chunk bodies until "data", then hands the rest to the encoder.
+bool AdpcmTranscoder::walkChunks(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        if (_skip) {
+            size_t n = min((size_t)_skip, len);
+            _skip -= n;
+            data += n;
+            len -= n;
+            continue;
+        }
+        size_t n = min(len, sizeof(_chunk) - _chunkLen);
+        memcpy(_chunk + _chunkLen, data, n);
+        _chunkLen += n;
+        data += n;
+        len -= n;
+        if (_chunkLen < sizeof(_chunk)) break;
+
+        _chunkLen = 0;
+        uint32_t chunkLen = WavHeader::le32(_chunk + 4);
+        if (memcmp(_chunk, "data", 4) == 0) {
+            return startEncode(chunkLen) && feedPcm(data, len);
+        }
+        _skip = chunkLen + (chunkLen & 1);
+    }
+    return true;
+}
+
+bool AdpcmTranscoder::startEncode(uint32_t dataBytes) {
+    // Streaming recorders often leave the size as 0 or 0xFFFFFFFF.
+    _pcmRemaining = (dataBytes == 0) ? 0xFFFFFFFF : dataBytes;
+    _blockAlign = ImaAdpcm::blockAlign(_channels);
+    _blockFrames = ImaAdpcm::framesPerBlock(_blockAlign, _channels);
+    _state[0] = { 0, 0 };
+    _state[1] = { 0, 0 };
+    _mode = MODE_ENCODE;
+
+    uint8_t h[ADPCM_WAV_HEADER_BYTES];
+    buildHeader(h);
+    return emit(h, sizeof(h));
+}
+
+bool AdpcmTranscoder::feedPcm(const uint8_t* data, size_t len) {
+    if (len > _pcmRemaining) len = _pcmRemaining;
+    _pcmRemaining -= len;
+
+    size_t blockBytes = (size_t)_blockFrames * _channels * sizeof(int16_t);
+    uint8_t* pcmBytes = (uint8_t*)_pcm;
+    while (len > 0) {
+        size_t take = min(len, blockBytes - _pcmFill);
+        memcpy(pcmBytes + _pcmFill, data, take);
+        _pcmFill += take;
+        data += take;
+        len -= take;
+        if (_pcmFill == blockBytes && !flushBlock()) return false;
+    }
+    return true;
+}
+
+bool AdpcmTranscoder::flushBlock() {
+    size_t frames = _pcmFill / (_channels * sizeof(int16_t));
+    _pcmFill = 0;
+    if (frames == 0) return true;
+
+    uint32_t start = micros();
+    ImaAdpcm::encodeBlock(_pcm, frames, _channels, _state, _block, _blockAlign);
+    _encodeMicros += micros() - start;
+
+    _framesOut += frames;
+    _dataOut += _blockAlign;
+    return emit(_block, _blockAlign);
+}
+
+void AdpcmTranscoder::buildHeader(uint8_t* h) {
+    memcpy(h, "RIFF", 4);
+    WavHeader::put32(h + 4, ADPCM_WAV_HEADER_BYTES - 8 + _dataOut);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    WavHeader::put32(h + 16, 20);
+    WavHeader::put16(h + 20, WAV_FORMAT_IMA_ADPCM);
+    WavHeader::put16(h + 22, _channels);
+    WavHeader::put32(h + 24, _sampleRate);
+    WavHeader::put32(h + 28, (uint32_t)((uint64_t)_sampleRate * _blockAlign / _blockFrames));
+    WavHeader::put16(h + 32, _blockAlign);
+    WavHeader::put16(h + 34, 4);
+    WavHeader::put16(h + 36, 2);
+    WavHeader::put16(h + 38, _blockFrames);
+    memcpy(h + 40, "fact", 4);
+    WavHeader::put32(h + 44, 4);
+    WavHeader::put32(h + 48, _framesOut);
+    memcpy(h + 52, "data", 4);
+    WavHeader::put32(h + 56, _dataOut);
+}
+
+bool AdpcmTranscoder::finish() {
+    if (_mode == MODE_HEADER && _headerLen > 0) {
+        _mode = MODE_PASSTHROUGH;
+        return emit(_header, _headerLen);
+    }
+    // A PCM header without a "data" chunk has nothing to keep.
+    if (_mode == MODE_CHUNKS) return false;
+    if (_mode != MODE_ENCODE) return true;
+    if (!flushBlock()) return false;
+
+    uint8_t h[ADPCM_WAV_HEADER_BYTES];
+    buildHeader(h);
+    size_t end = _out->position();
+    bool ok = _out->seek(0) && _out->write(h, sizeof(h)) == sizeof(h);
+    _out->seek(end);
+    return ok;
+}
+
+bool AdpcmTranscoder::isTranscoding() {
+    return _mode == MODE_ENCODE;
+}
+
+uint32_t AdpcmTranscoder::getBytesIn() {
+    return _bytesIn;
+}
+
+uint32_t AdpcmTranscoder::getBytesOut() {
+    return _bytesOut;
+}
+
+uint32_t AdpcmTranscoder::getEncodeMicros() {
+    return _encodeMicros;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include "ImaAdpcm.h"
+
+#define ADPCM_HEADER_SCAN_BYTES 256
+#define ADPCM_WAV_HEADER_BYTES  60
+
+// Converts an incoming PCM16 WAV byte stream to IMA ADPCM WAV chunk by
+// chunk, as upload data arrives. Anything that is not PCM16 mono/stereo is
+// passed through unchanged. The bytes up to the end of "fmt " are buffered
+// to make that call; chunks between it and "data" (LIST, bext, ...) are
+// skipped as they stream past, whatever their size.
+class AdpcmTranscoder {
+public:
+    void begin(File* out);
+    bool write(const uint8_t* data, size_t len);
+    bool finish();
+
+    bool isTranscoding();
+    uint32_t getBytesIn();
+    uint32_t getBytesOut();
+    uint32_t getEncodeMicros();
+
+private:
+    enum Mode : uint8_t { MODE_HEADER, MODE_CHUNKS, MODE_ENCODE, MODE_PASSTHROUGH };
+    enum HeaderStatus : uint8_t { HEADER_MORE, HEADER_REJECT, HEADER_ACCEPT };
+
+    File* _out = nullptr;
+    Mode _mode = MODE_HEADER;
+    uint8_t _header[ADPCM_HEADER_SCAN_BYTES];
+    size_t _headerLen = 0;
+    size_t _headerPos = 0;
+    uint8_t _chunk[8];
+    uint8_t _chunkLen = 0;
+    uint32_t _skip = 0;
+
+    uint16_t _channels = 0;
+    uint32_t _sampleRate = 0;
+    uint16_t _blockAlign = 0;
+    uint16_t _blockFrames = 0;
+    uint32_t _pcmRemaining = 0;
+    ImaAdpcmChannel _state[2];
+
+    int16_t _pcm[ADPCM_MAX_BLOCK_FRAMES * 2];
+    size_t _pcmFill = 0;
+    uint8_t _block[ADPCM_MAX_BLOCK_ALIGN];
+
+    uint32_t _framesOut = 0;
+    uint32_t _dataOut = 0;
+    uint32_t _bytesIn = 0;
+    uint32_t _bytesOut = 0;
+    uint32_t _encodeMicros = 0;
+
+    HeaderStatus parseHeader();
+    bool walkChunks(const uint8_t* data, size_t len);
+    bool startEncode(uint32_t dataBytes);
+    bool feedPcm(const uint8_t* data, size_t len);
+    bool flushBlock();
+    bool emit(const uint8_t* data, size_t len);
+    void buildHeader(uint8_t* h);
+};
@@ -1,5 +1,8 @@
 #include "AudioManager.h"
 #include <driver/i2s.h>
+#include <math.h>
+#include "../utils/HeapMonitor.h"
+#include "../utils/MemoryArena.h"
 
 #define DEBUG_AUDIO 1
 
@@ -11,7 +14,26 @@
     #define LOG_AUDIO_F(fmt, ...)
 #endif
 
-AudioManager::AudioManager() : _currentVolume(10), _trackIndex(0), _isBtMode(false), _btInitialized(false), _stateCallback(nullptr) {
+static AudioManager* _audioInstance = nullptr;
+
+// Weak hook in ESP32-audioI2S, invoked with each volume-scaled stereo frame
+// just before it is written to I2S.
+void audio_process_i2s(uint32_t* sample, bool* continueI2S) {
+    *continueI2S = _audioInstance ? _audioInstance->processSample(sample) : true;
+}
+
+AudioManager::AudioManager() : _currentVolume(10), _trackIndex(0), _isBtMode(false), _btInitialized(false), _stateCallback(nullptr),
+    _fileCueActive(false), _pumpLen(0), _pumpOff(0), _sourceRate(0), _adpcmPaused(false),
+    _volumeDirty(false), _volumeChangedAt(0), _metering(false), _meterFileSize(0), _meterMicros(0), _meterBuf(nullptr), _meterFill(0),
+    _meterDropped(0), _meterUpdatedAt(0), _trackGainMb(0), _trackGainQ12(4096),
+    _stretchMicros(0), _stretchFrames(0), _hookBuf(nullptr), _hookHead(0), _hookTail(0), _hookDropped(0), _outLen(0), _outOff(0),
+    _visEnabled(false), _visLevel(0), _visPeak(0), _visFrameMs(VIS_FRAME_MS), _visLastFrame(0),
+    _streamActive(false), _dmaInstalled(), _i2sEvents(nullptr), _wifiActive(false),
+    _warmSlot(nullptr), _warmRate(0), _warmVolume(0), _warmFilled(0), _warmWritten(0), _warmDecoded(0), _warmStartUs(0),
+    _warmCatchUp(false), _warmClocked(false), _capture(nullptr), _captureFrames(0), _captureTarget(0),
+    _tapUs(0), _playStartUs(0), _awaitFirst(false),
+    _resampleQuality(RESAMPLE_MEDIUM), _srcBlock(CUE_PUMP_FRAMES), _resampleMicros(0), _resampleBlocks(0), _resampleFrames(0),
+    _clockCheck(false) {
     LOG_AUDIO("Constructor called");
 }
 
@@ -20,16 +42,790 @@ void AudioManager::begin() {
     _prefs.begin("audio", false);
     _currentVolume = _prefs.getInt("volume", 10); 
     LOG_AUDIO_F("Loaded volume: %d", _currentVolume);
+    _resampleQuality = (ResampleQuality)_prefs.getUChar("resample", RESAMPLE_MEDIUM);
+    if (_resampleQuality >= RESAMPLE_QUALITY_COUNT) _resampleQuality = RESAMPLE_MEDIUM;
     
-    _audio.setPinout(PIN_I2S_BCLK, PIN_I2S_LRC, PIN_I2S_DOUT);
+    _dma.begin(&_prefs);
+    installI2s(_dma.profile(DMA_MODE_SD));
     _audio.setVolume(_currentVolume);
+    updateCueLevel();
+    _cues.setOutputRate(AUDIO_OUTPUT_RATE);
+    if (!_resampler.begin()) LOG_AUDIO("Resampler unavailable, sources play at the output rate");
+    _hookBuf = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, HOOK_BUFFER_FRAMES * 2 * sizeof(int16_t), MEM_AUDIO);
+    if (!_hookBuf || !_stretch.begin()) LOG_AUDIO("Time-stretch buffers unavailable");
+    _spectrum.begin();
+    if (!_stream.begin()) LOG_AUDIO("Stream buffer unavailable");
+    _meterBuf = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, LOUDNESS_HOOK_FRAMES * 2 * sizeof(int16_t), MEM_AUDIO);
+    if (!_meterBuf) LOG_AUDIO("Loudness buffer unavailable, tracks are not measured");
+    _audioInstance = this;
     LOG_AUDIO("begin() - Complete");
 }
 
+bool AudioManager::beginWarmCache() {
+    return _warm.begin();
+}
+
+bool AudioManager::handleCommand(const char* line) {
+    if (strncmp(line, "resample", 8) == 0) return resampleCommand(line + 8);
+    return _warm.handleCommand(line);
+}
+
+// ESP32-audioI2S scales decoded samples by volumetable[volume] / 64 in
+// Audio::Gain(); the direct paths, cues and the meter use the same steps.
+static const uint8_t VOLUME_TABLE[22] = {
+    0, 1, 2, 3, 4, 6, 8, 10, 12, 14, 17, 20, 23, 27, 30, 34, 38, 43, 48, 52, 58, 64
+};
+
+static inline int32_t volumeQ8(int volume) {
+    return VOLUME_TABLE[constrain(volume, 0, 21)] * 4;
+}
+
+static inline int16_t scaleSample(int16_t s, int32_t gain, int shift) {
+    int32_t v = (s * gain) >> shift;
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return (int16_t)v;
+}
+
 void AudioManager::loop() {
+    HEAP_SCOPE(MEM_AUDIO);
+    if (_volumeDirty && millis() - _volumeChangedAt > VOLUME_SAVE_DELAY_MS) saveVolume();
     if (!_isBtMode) {
-        _audio.loop();
+        drainHook();
+        if (hookSpace() >= LOUDNESS_HOOK_FRAMES) {
+            _audio.loop();
+            drainMeter();
+            drainHook();
+        }
+        if (_metering && _meter.measuredSeconds() >= LOUDNESS_MAX_SECONDS) commitLoudness();
+        else if (_metering && millis() - _meterUpdatedAt >= LOUDNESS_UPDATE_MS) followLoudness();
+        if (_warmSlot && _audio.isRunning()) {
+            pumpWarm();
+        } else if (_audio.isRunning()) {
+            _pumpLen = _pumpOff = 0;
+        } else {
+            // Paused or failed to open: the cached start has nothing to hand over to.
+            if (_warmSlot) resetWarm();
+            if (!hookPending()) pumpDirect();
+        }
+        if (_visEnabled) updateVisualizer();
+        _warm.loop(!isPlaying() && !_cues.isActive());
+    }
+    updateDma();
+}
+
+// Same format the decoder library installs; only the ring differs.
+static i2s_config_t i2sConfig(const DmaProfile& profile) {
+    i2s_config_t config = {};
+    config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+    config.sample_rate = AUDIO_OUTPUT_RATE;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    config.dma_buf_count = profile.count;
+    config.dma_buf_len = profile.len;
+    config.use_apll = false;
+    config.tx_desc_auto_clear = true;
+    return config;
+}
+
+void AudioManager::installI2s(const DmaProfile& profile) {
+    i2s_config_t config = i2sConfig(profile);
+    i2s_driver_uninstall(I2S_NUM_0);
+    _i2sEvents = nullptr;
+    if (i2s_driver_install(I2S_NUM_0, &config, DMA_EVENT_QUEUE_LEN, &_i2sEvents) != ESP_OK) {
+        _i2sEvents = nullptr;
+        LOG_AUDIO_F("I2S install with %u x %u DMA frames failed", profile.count, profile.len);
+        return;
+    }
+    _audio.setPinout(Board::pinI2sBclk, Board::pinI2sLrc, Board::pinI2sDout);
+    _dmaInstalled = profile;
+}
+
+// Between tracks: the ring of the current mode is installed if the last
+// track (or a mode change) moved it, then a new measurement starts.
+void AudioManager::applyDmaProfile() {
+    DmaMode mode = _wifiActive ? DMA_MODE_WIFI : DMA_MODE_SD;
+    DmaProfile profile = _dma.profile(mode);
+    if (profile.count != _dmaInstalled.count || profile.len != _dmaInstalled.len) installI2s(profile);
+    _dma.startTrack(mode, _dmaInstalled);
+}
+
+void AudioManager::updateDma() {
+#if FEATURE_BLUETOOTH
+    if (_isBtMode) {
+        if (!_btInitialized) return;
+        _dma.setActive(_a2dp_sink.get_audio_state() == ESP_A2D_AUDIO_STATE_STARTED, _a2dp_sink.sample_rate());
+        _dma.poll(nullptr);
+        // A2DP has no track boundaries and its ring is only installed when
+        // Bluetooth starts, so it is judged per window for the next session.
+        if (_dma.activeMs() >= DMA_BT_EVAL_MS) {
+            _dma.endTrack();
+            _dma.startTrack(DMA_MODE_A2DP, _dmaInstalled);
+        }
+        return;
+    }
+#endif
+    if (_isBtMode) return;
+    _dma.setActive(_audio.isRunning() || directActive() || _streamActive, AUDIO_OUTPUT_RATE);
+    _dma.poll(_i2sEvents);
+}
+
+void AudioManager::setWifiActive(bool active) {
+    _wifiActive = active;
+}
+
+void AudioManager::setResampleQuality(ResampleQuality quality) {
+    if (quality >= RESAMPLE_QUALITY_COUNT || quality == _resampleQuality) return;
+    _resampleQuality = quality;
+    _prefs.putUChar("resample", quality);
+    LOG_AUDIO_F("Resampling quality %s from the next track", Resampler::qualityName(quality));
+}
+
+ResampleQuality AudioManager::getResampleQuality() {
+    return _resampleQuality;
+}
+
+// "resample" shows the conversion in use, "resample low|medium|high" picks
+// the quality, "resample bench" times every quality while nothing plays.
+bool AudioManager::resampleCommand(const char* args) {
+    if (*args == '\0') {
+        Serial.printf("Output %u Hz, %s quality, source %u Hz", AUDIO_OUTPUT_RATE,
+                      Resampler::qualityName(_resampleQuality), (unsigned)_sourceRate);
+        if (_resampler.isBypass()) Serial.println(", not resampled");
+        else Serial.printf(", %u taps x %u phases\n", _resampler.getTaps(), _resampler.getPhases());
+        return true;
+    }
+    if (*args++ != ' ') return false;
+    if (strcmp(args, "bench") == 0) {
+        benchResampler();
+        return true;
+    }
+    for (uint8_t q = 0; q < RESAMPLE_QUALITY_COUNT; q++) {
+        if (strcmp(args, Resampler::qualityName((ResampleQuality)q)) == 0) {
+            setResampleQuality((ResampleQuality)q);
+            return true;
+        }
+    }
+    return false;
+}
+
+// One second of output per quality and source rate, converted in the same
+// blocks playback uses.
+void AudioManager::benchResampler() {
+    if (isPlaying()) {
+        Serial.println("Stop playback to benchmark the resampler");
+        return;
+    }
+    static const uint32_t RATES[] = { 22050, 32000, 48000 };
+    uint32_t seed = 1;
+    for (size_t i = 0; i < CUE_PUMP_FRAMES * 2; i++) {
+        seed = seed * 1103515245 + 12345;
+        _srcBuf[i] = (int16_t)(seed >> 16) >> 2;
+    }
+    for (uint8_t q = 0; q < RESAMPLE_QUALITY_COUNT; q++) {
+        for (uint32_t rate : RATES) {
+            uint32_t start = micros();
+            _resampler.configure(rate, AUDIO_OUTPUT_RATE, (ResampleQuality)q);
+            uint32_t buildUs = micros() - start;
+            size_t block = min(_resampler.maxInput(CUE_PUMP_FRAMES), (size_t)CUE_PUMP_FRAMES);
+            uint32_t frames = 0;
+            uint32_t blocks = 0;
+            uint32_t totalUs = 0;
+            uint32_t maxUs = 0;
+            while (frames < AUDIO_OUTPUT_RATE) {
+                start = micros();
+                frames += _resampler.process(_srcBuf, block, _outBuf, CUE_PUMP_FRAMES);
+                uint32_t us = micros() - start;
+                totalUs += us;
+                if (us > maxUs) maxUs = us;
+                blocks++;
+            }
+            Serial.printf("  %-6s %5u -> %u Hz: %2u taps x %3u phases, table %u us, %u us per %u-frame block (max %u), %.1f%% CPU\n",
+                          Resampler::qualityName((ResampleQuality)q), (unsigned)rate, AUDIO_OUTPUT_RATE,
+                          _resampler.getTaps(), _resampler.getPhases(), (unsigned)buildUs, (unsigned)(totalUs / blocks),
+                          CUE_PUMP_FRAMES, (unsigned)maxUs, totalUs / 10000.0f);
+        }
+    }
+    // The next source configures the resampler again.
+    _sourceRate = 0;
+}
+
+void AudioManager::setVisualizer(bool enabled) {
+    _visEnabled = enabled;
+    _visLevel = 0;
+    if (enabled) _spectrum.arm();
+}
+
+uint8_t AudioManager::getVisualLevel() {
+    return _visLevel;
+}
+
+// The loudest band against a slowly decaying peak gives a level that
+// follows the story's dynamics regardless of volume or track loudness.
+// Bass gets one log2 unit on top since that is what reads as "pulse" on a
+// single LED.
+void AudioManager::updateVisualizer() {
+    if (millis() - _visLastFrame < _visFrameMs) return;
+    if (!_spectrum.captured()) {
+        if (!isPlaying()) _visLevel = _visLevel > 8 ? _visLevel - 8 : 0;
+        return;
     }
+    _visLastFrame = millis();
+
+    uint32_t start = micros();
+    uint16_t bands[SPECTRUM_BANDS];
+    _spectrum.analyze(AUDIO_OUTPUT_RATE, bands);
+    uint16_t energy = bands[0] + 16;
+    for (int b = 1; b < SPECTRUM_BANDS; b++) {
+        if (bands[b] > energy) energy = bands[b];
+    }
+
+    if (energy > _visPeak) _visPeak = energy;
+    else if (_visPeak > 0) _visPeak--;
+    // Map the top 8 log2 units (about 24 dB) below the peak onto 0-255.
+    int level = 255 - (int)(_visPeak - energy) * 2;
+    if (level < 0) level = 0;
+    if (level > _visLevel) _visLevel = level;
+    else _visLevel = _visLevel - (_visLevel - level) / 4;
+
+    _spectrum.arm();
+    uint32_t elapsed = micros() - start;
+    if (elapsed > VIS_BUDGET_US && _visFrameMs < VIS_MAX_FRAME_MS) {
+        _visFrameMs *= 2;
+        LOG_AUDIO_F("Visualizer took %u us, frame interval now %u ms", (unsigned)elapsed, _visFrameMs);
+    } else if (elapsed < VIS_BUDGET_US / 2 && _visFrameMs > VIS_FRAME_MS) {
+        _visFrameMs /= 2;
+    }
+}
+
+// Frames arrive already volume-scaled by the library. The meter only gets
+// a copy here; it is filtered after the decoder's loop() returns.
+bool AudioManager::processSample(uint32_t* sample) {
+    if (_clockCheck) {
+        _clockCheck = false;
+        restoreClock(true);
+    }
+    if (_capture) captureFrame(*sample);
+    int16_t frame[2] = { (int16_t)(*sample & 0xFFFF), (int16_t)(*sample >> 16) };
+    if (_metering && _meterBuf) {
+        if (_meterFill < LOUDNESS_HOOK_FRAMES) {
+            _meterBuf[2 * _meterFill] = frame[0];
+            _meterBuf[2 * _meterFill + 1] = frame[1];
+            _meterFill++;
+        } else {
+            _meterDropped++;
+        }
+    }
+    // Frames the cached start already played are decoded but not written.
+    if (_warmCatchUp) {
+        if (!_warmClocked) warmClocked();
+        if (_warmCatchUp) {
+            if (++_warmDecoded <= _warmFilled) return false;
+            LOG_AUDIO_F("Warm start handed over to the decoder after %u ms",
+                        (unsigned)((uint64_t)_warmFilled * 1000 / _warmRate));
+            // The rest of the cached output becomes the hook's pending block,
+            // so drainHook() writes it ahead of the decoder's frames.
+            if (_pumpOff < _pumpLen && _outOff >= _outLen) {
+                memcpy(_outBuf, (const uint8_t*)_pumpBuf + _pumpOff, _pumpLen - _pumpOff);
+                _outLen = _pumpLen - _pumpOff;
+                _outOff = 0;
+            }
+            resetWarm();
+        }
+    }
+    if (_trackGainQ12 != 4096) {
+        frame[0] = scaleSample(frame[0], _trackGainQ12, 12);
+        frame[1] = scaleSample(frame[1], _trackGainQ12, 12);
+    }
+    setSourceRate(_audio.getSampleRate());
+    // The library is never left to write: when I2S refuses a frame it calls
+    // the hook again for it. loop() stretches, resamples, mixes and writes
+    // these without blocking and counts only what I2S took.
+    if (_hookTail < HOOK_BUFFER_FRAMES) {
+        _hookBuf[2 * _hookTail] = frame[0];
+        _hookBuf[2 * _hookTail + 1] = frame[1];
+        _hookTail++;
+    } else {
+        _hookDropped++;
+    }
+    return false;
+}
+
+void AudioManager::runStretch(uint32_t rate) {
+    if (rate != _stretch.getSampleRate()) _stretch.configure(rate);
+    if (!_stretch.ready()) return;
+
+    uint32_t start = micros();
+    _stretch.process();
+    _stretchMicros += micros() - start;
+    _stretchFrames += _stretch.available();
+    if (_stretchFrames >= rate * STRETCH_REPORT_SEC) {
+        LOG_AUDIO_F("Time-stretch %u%%: %u us per s of audio, %u hook frames dropped", _stretch.getSpeed(),
+                    (unsigned)((uint64_t)_stretchMicros * rate / _stretchFrames), (unsigned)_hookDropped);
+        _stretchMicros = 0;
+        _stretchFrames = 0;
+        _hookDropped = 0;
+    }
+}
+
+bool AudioManager::hookPending() {
+    return _hookHead < _hookTail || _outOff < _outLen;
+}
+
+// Room for the decoder's next block; unread frames move to the front first.
+size_t AudioManager::hookSpace() {
+    if (_hookHead > 0 && HOOK_BUFFER_FRAMES - _hookTail < LOUDNESS_HOOK_FRAMES) {
+        memmove(_hookBuf, _hookBuf + 2 * _hookHead, (_hookTail - _hookHead) * 2 * sizeof(int16_t));
+        _hookTail -= _hookHead;
+        _hookHead = 0;
+    }
+    return HOOK_BUFFER_FRAMES - _hookTail;
+}
+
+// Next block for the resampler in _stretchBuf: stretched output while the
+// stretch is on, the hook's frames as they are after it was turned off.
+size_t AudioManager::nextHookBlock() {
+    if (!_stretch.isActive()) {
+        size_t frames = min(_hookTail - _hookHead, _srcBlock);
+        memcpy(_stretchBuf, _hookBuf + 2 * _hookHead, frames * 2 * sizeof(int16_t));
+        _hookHead += frames;
+        return frames;
+    }
+    while (_stretch.available() == 0) {
+        runStretch(_sourceRate);
+        if (_stretch.available()) break;
+        size_t frames = _stretch.put(_hookBuf + 2 * _hookHead, _hookTail - _hookHead);
+        if (frames == 0) return 0;
+        _hookHead += frames;
+    }
+    return _stretch.get(_stretchBuf, _srcBlock);
+}
+
+// Same as pumpDirect() for the hook's frames: a block the DMA ring has no
+// room for stays in _outBuf until the next call.
+void AudioManager::drainHook() {
+    while (true) {
+        if (_outOff < _outLen) {
+            size_t written = 0;
+            i2s_write(I2S_NUM_0, (const char*)_outBuf + _outOff, _outLen - _outOff, &written, 0);
+            if (written && _awaitFirst) noteFirstSample(false);
+            _dma.noteFrames(written / (2 * sizeof(int16_t)));
+            _outOff += written;
+            if (_outOff < _outLen) return;
+        }
+        size_t frames = nextHookBlock();
+        if (frames == 0) break;
+        frames = resample(_stretchBuf, frames, _outBuf);
+        _spectrum.tap(_outBuf, frames);
+        for (size_t i = 0; i < frames; i++) _cues.mix(_outBuf + 2 * i);
+        _outLen = frames * 2 * sizeof(int16_t);
+        _outOff = 0;
+    }
+    if (_hookHead == _hookTail) _hookHead = _hookTail = 0;
+}
+
+void AudioManager::clearHook() {
+    _hookHead = _hookTail = 0;
+    _outLen = _outOff = 0;
+}
+
+// The decoder library sets the I2S clock to each track's own rate when it
+// starts decoding; it is put back before the first frame is written.
+// `restarted` when the library has just set a rate, even a matching one.
+void AudioManager::restoreClock(bool restarted) {
+    float clock = i2s_get_clk(I2S_NUM_0);
+    bool moved = fabsf(clock - AUDIO_OUTPUT_RATE) > AUDIO_OUTPUT_RATE / 100;
+    if (moved) i2s_set_sample_rates(I2S_NUM_0, AUDIO_OUTPUT_RATE);
+    // Setting a rate (the library's or this one) restarts the ring.
+    if (moved || restarted) _dma.restart(_i2sEvents);
+}
+
+// A new source rate only retunes the resampler (and resets its history).
+// The decoder re-clocks I2S whenever its rate changes, so the clock is put
+// back to AUDIO_OUTPUT_RATE here as well.
+void AudioManager::setSourceRate(uint32_t rate) {
+    if (rate == _sourceRate || rate == 0) return;
+    _sourceRate = rate;
+    restoreClock(false);
+    uint32_t start = micros();
+    _resampler.configure(rate, AUDIO_OUTPUT_RATE, _resampleQuality);
+    _srcBlock = min(_resampler.maxInput(CUE_PUMP_FRAMES), (size_t)CUE_PUMP_FRAMES);
+    if (!_resampler.isBypass()) {
+        LOG_AUDIO_F("Resampling %u -> %u Hz, %s quality (%u taps, %u phases, built in %u us)", (unsigned)rate,
+                    AUDIO_OUTPUT_RATE, Resampler::qualityName(_resampleQuality), _resampler.getTaps(),
+                    _resampler.getPhases(), (unsigned)(micros() - start));
+    }
+}
+
+// At most CUE_PUMP_FRAMES out; callers pass at most _srcBlock frames in,
+// which the resampler always takes whole.
+size_t AudioManager::resample(const int16_t* stereo, size_t frames, int16_t* out) {
+    size_t used = frames;
+    uint32_t start = micros();
+    size_t produced = _resampler.process(stereo, frames, out, CUE_PUMP_FRAMES, &used);
+    if (used < frames) LOG_AUDIO_F("Resampler left %u of %u frames", (unsigned)(frames - used), (unsigned)frames);
+    if (_resampler.isBypass()) return produced;
+    _resampleMicros += micros() - start;
+    _resampleBlocks++;
+    _resampleFrames += produced;
+    if (_resampleFrames >= AUDIO_OUTPUT_RATE * RESAMPLE_REPORT_SEC) {
+        LOG_AUDIO_F("Resampling %u -> %u Hz (%s): %u us per block, %u us per s of audio", (unsigned)_sourceRate,
+                    AUDIO_OUTPUT_RATE, Resampler::qualityName(_resampler.getQuality()),
+                    (unsigned)(_resampleMicros / _resampleBlocks),
+                    (unsigned)((uint64_t)_resampleMicros * AUDIO_OUTPUT_RATE / _resampleFrames));
+        _resampleMicros = 0;
+        _resampleBlocks = 0;
+        _resampleFrames = 0;
+    }
+    return produced;
+}
+
+void AudioManager::setSpeed(uint8_t percent) {
+    _stretch.setSpeed(percent);
+    LOG_AUDIO_F("Speed: %u%%", _stretch.getSpeed());
+}
+
+uint8_t AudioManager::getSpeed() {
+    return _stretch.getSpeed();
+}
+
+// Needs the card mounted; an SD copy replaces the embedded one.
+bool AudioManager::preloadCue(const char* path) {
+    if (_cues.load(path)) return true;
+    return preloadEmbeddedCue(path);
+}
+
+bool AudioManager::preloadEmbeddedCue(const char* path) {
+    return _cues.loadEmbedded(findEmbeddedAsset(path, EMBED_CUE_ULAW)) || _cues.has(path);
+}
+
+bool AudioManager::playCue(const char* path) {
+    if (_isBtMode) return false;
+    if (_cues.play(path)) return true;
+
+    if (!SD.exists(path)) return false;
+    // System sounds are not stretched with the last figurine's speed.
+    setSpeed(100);
+    playFile(path);
+    _fileCueActive = true;
+    return true;
+}
+
+bool AudioManager::isCuePlaying() {
+    return _cues.isActive() || (_fileCueActive && (_audio.isRunning() || directActive()));
+}
+
+bool AudioManager::directActive() {
+    return _adpcm.isOpen() && !_adpcmPaused;
+}
+
+// Reads ADPCM frames with the same volume scaling the decoder applies.
+// Closes the player at the end of the file.
+size_t AudioManager::readDirect(int16_t* stereo, size_t frames) {
+    frames = _adpcm.read(stereo, frames);
+    if (frames == 0) {
+        _adpcm.close();
+        _fileCueActive = false;
+        return 0;
+    }
+    meterFrames(stereo, frames, _adpcm.getSampleRate(), 1.0f);
+    applyDirectGain(stereo, frames);
+    return frames;
+}
+
+void AudioManager::applyDirectGain(int16_t* stereo, size_t frames) {
+    int32_t gain = (volumeQ8(_currentVolume) * _trackGainQ12) >> 12;
+    for (size_t i = 0; i < frames; i++) {
+        stereo[2 * i] = scaleSample(stereo[2 * i], gain, 8);
+        stereo[2 * i + 1] = scaleSample(stereo[2 * i + 1], gain, 8);
+    }
+}
+
+size_t AudioManager::stretchDirect(size_t frames) {
+    while (_stretch.available() == 0) {
+        runStretch(_adpcm.getSampleRate());
+        if (_stretch.available()) break;
+        size_t read = readDirect(_stretchBuf, min((size_t)CUE_PUMP_FRAMES, _stretch.space()));
+        if (read == 0) return 0;
+        _stretch.put(_stretchBuf, read);
+    }
+    return _stretch.get(_srcBuf, frames);
+}
+
+// With the decoder idle nothing drives I2S, so ADPCM recordings, the live
+// stream and cues are written directly, resampled to the output rate. A
+// stream that is (re)buffering keeps the DMA fed with silence.
+void AudioManager::pumpDirect() {
+    while (true) {
+        if (_pumpOff >= _pumpLen) {
+            size_t frames = 0;
+            if (directActive()) {
+                setSourceRate(_adpcm.getSampleRate());
+                if (_stretch.isActive()) frames = stretchDirect(_srcBlock);
+                else frames = readDirect(_srcBuf, _srcBlock);
+                if (frames == 0) continue;
+                frames = resample(_srcBuf, frames, _pumpBuf);
+                if (frames == 0) continue;
+                _spectrum.tap(_pumpBuf, frames);
+                for (size_t i = 0; i < frames; i++) _cues.mix(_pumpBuf + 2 * i);
+            } else if (_streamActive) {
+                setSourceRate(_stream.getSampleRate());
+                frames = _stream.pop(_srcBuf, _srcBlock);
+                if (frames > 0) {
+                    applyDirectGain(_srcBuf, frames);
+                    frames = resample(_srcBuf, frames, _pumpBuf);
+                    if (frames == 0) continue;
+                    _spectrum.tap(_pumpBuf, frames);
+                } else if (_stream.isDrained()) {
+                    endStream();
+                    continue;
+                } else {
+                    frames = CUE_PUMP_FRAMES;
+                    memset(_pumpBuf, 0, sizeof(_pumpBuf));
+                }
+                for (size_t i = 0; i < frames; i++) _cues.mix(_pumpBuf + 2 * i);
+            } else if (_cues.isActive()) {
+                frames = _cues.render(_pumpBuf, CUE_PUMP_FRAMES);
+            } else {
+                return;
+            }
+            _pumpLen = frames * 2 * sizeof(int16_t);
+            _pumpOff = 0;
+        }
+        size_t written = 0;
+        i2s_write(I2S_NUM_0, (const char*)_pumpBuf + _pumpOff, _pumpLen - _pumpOff, &written, 0);
+        if (written && _awaitFirst) noteFirstSample(false);
+        _dma.noteFrames(written / (2 * sizeof(int16_t)));
+        _pumpOff += written;
+        if (_pumpOff < _pumpLen) return;
+    }
+}
+
+// A cached start goes out at once at its own rate; connecttoFS() and the
+// first decode then happen while it plays. Tracks among the most tapped
+// are recorded from the decoder's output for the next time.
+void AudioManager::startWarm(const String& path, uint32_t fileSize) {
+    if (!_stretch.isActive() && _currentVolume > 0) {
+        const WarmSlot* slot = _warm.lookup(path.c_str(), fileSize);
+        if (slot && slot->volume) {
+            _warmSlot = slot;
+            _warmRate = slot->rate;
+            _warmVolume = slot->volume;
+            _warmCatchUp = true;
+            setSourceRate(_warmRate);
+            pumpWarm();
+        }
+    }
+    _capture = _warm.beginCapture(path.c_str(), fileSize, _currentVolume);
+    _captureFrames = 0;
+    _captureTarget = 0;
+}
+
+// Writes the cached start without blocking. Until the decoder's first frame
+// re-clocks I2S it stays at most WARM_LEAD_BUFFERS ahead of the DAC, which
+// bounds what has to be sent again afterwards. _warmFilled counts cached
+// frames handed to the resampler, _warmWritten output frames written.
+void AudioManager::pumpWarm() {
+    while (_warmSlot) {
+        if (_pumpOff >= _pumpLen) {
+            uint32_t end = _warmSlot->frames;
+            if (!_warmClocked) {
+                uint32_t played = _warmWritten ? (uint64_t)(micros() - _warmStartUs) * _warmRate / 1000000 : 0;
+                uint32_t lead = played + (uint32_t)WARM_LEAD_BUFFERS * _dmaInstalled.len * _warmRate / AUDIO_OUTPUT_RATE;
+                if (lead < end) end = lead;
+            }
+            if (_warmFilled >= end) return;
+            size_t frames = min((uint32_t)_srcBlock, end - _warmFilled);
+            memcpy(_srcBuf, _warmSlot->pcm + _warmFilled, frames * sizeof(uint32_t));
+            _warmFilled += frames;
+            // Captured with the volume of the time; the track gain comes on top.
+            int32_t gain = _trackGainQ12;
+            if (_currentVolume != _warmVolume) {
+                gain = gain * volumeQ8(_currentVolume) / volumeQ8(_warmVolume);
+                if (gain > 0xFFFF) gain = 0xFFFF;
+            }
+            if (gain != 4096) {
+                for (size_t i = 0; i < frames * 2; i++) _srcBuf[i] = scaleSample(_srcBuf[i], gain, 12);
+            }
+            frames = resample(_srcBuf, frames, _pumpBuf);
+            _spectrum.tap(_pumpBuf, frames);
+            for (size_t i = 0; i < frames; i++) _cues.mix(_pumpBuf + 2 * i);
+            _pumpLen = frames * 2 * sizeof(int16_t);
+            _pumpOff = 0;
+        }
+        size_t written = 0;
+        i2s_write(I2S_NUM_0, (const char*)_pumpBuf + _pumpOff, _pumpLen - _pumpOff, &written, 0);
+        if (!written) return;
+        if (_warmWritten == 0) {
+            _warmStartUs = micros();
+            if (_awaitFirst) noteFirstSample(true);
+        }
+        _warmWritten += written / (2 * sizeof(int16_t));
+        _dma.noteFrames(written / (2 * sizeof(int16_t)));
+        _pumpOff += written;
+        if (_pumpOff < _pumpLen) return;
+    }
+}
+
+// The decoder sets its sample rate with its first frame and restoreClock()
+// sets it back, which restarts I2S. What the ring still held is estimated
+// from the time played, cleared and sent again; the decoder then skips
+// everything the cache has handed on.
+void AudioManager::warmClocked() {
+    _warmClocked = true;
+    uint32_t rate = _audio.getSampleRate();
+    if (rate != _warmRate) {
+        LOG_AUDIO_F("Warm start dropped: cached at %u Hz, track is %u Hz", (unsigned)_warmRate, (unsigned)rate);
+        resetWarm();
+        return;
+    }
+    uint32_t played = _warmWritten ? (uint64_t)(micros() - _warmStartUs) * rate / 1000000 : 0;
+    uint32_t ring = (uint32_t)_dmaInstalled.count * _dmaInstalled.len * rate / AUDIO_OUTPUT_RATE;
+    if (played + ring < _warmFilled) played = _warmFilled - ring;
+    if (played > _warmFilled) played = _warmFilled;
+    clearBuffer();
+    _warmFilled = played;
+    _pumpLen = _pumpOff = 0;
+    _resampler.reset();
+}
+
+void AudioManager::resetWarm() {
+    if (_warmSlot) _pumpLen = _pumpOff = 0;
+    _warmSlot = nullptr;
+    _warmCatchUp = false;
+    _warmClocked = false;
+    _warmFilled = 0;
+    _warmWritten = 0;
+    _warmDecoded = 0;
+    _awaitFirst = false;
+}
+
+// Frames are kept as the hook got them: volume applied, track gain not.
+void AudioManager::captureFrame(uint32_t sample) {
+    if (!_captureTarget) {
+        uint32_t rate = _audio.getSampleRate();
+        if (!rate || rate > WARM_MAX_RATE) {
+            endCapture(false);
+            return;
+        }
+        _captureTarget = rate * WARM_MS / 1000;
+    }
+    _capture->pcm[_captureFrames++] = sample;
+    if (_captureFrames >= _captureTarget) endCapture(true);
+}
+
+void AudioManager::endCapture(bool complete) {
+    if (!_capture) return;
+    _warm.endCapture(_capture, complete, _audio.getSampleRate(), _captureFrames);
+    _capture = nullptr;
+}
+
+void AudioManager::noteFirstSample(bool warm) {
+    _awaitFirst = false;
+    _warm.noteLatency(warm, micros() - _playStartUs);
+}
+
+// Looks up the stored gain for a track. Tracks without one are measured
+// while they play: they start at the library's average gain and follow
+// their own measurement from LOUDNESS_MIN_SECONDS on.
+uint32_t AudioManager::startTrackGain(const String& path) {
+    commitLoudness();
+    setTrackGain(0);
+
+    File file = SD.open(path);
+    if (!file) return 0;
+    uint32_t size = file.size();
+    file.close();
+
+    int16_t gainMb;
+    if (_gains.lookup(path.c_str(), size, &gainMb)) {
+        setTrackGain(gainMb);
+        LOG_AUDIO_F("Track gain %+.1f dB", gainMb / 100.0f);
+        return size;
+    }
+    if (_gains.average(&gainMb)) setTrackGain(gainMb);
+    _metering = _meterBuf != nullptr;
+    _meterPath = path;
+    _meterFileSize = size;
+    _meterMicros = 0;
+    _meterFill = 0;
+    _meterDropped = 0;
+    _meterUpdatedAt = millis();
+    _meter.reset();
+    return size;
+}
+
+void AudioManager::setTrackGain(int16_t gainMb) {
+    _trackGainMb = gainMb;
+    _trackGainQ12 = gainMb ? (int32_t)(4096.0f * powf(10.0f, gainMb / 2000.0f)) : 4096;
+}
+
+void AudioManager::meterFrames(const int16_t* stereo, size_t frames, uint32_t rate, float scale) {
+    if (!_metering || rate == 0) return;
+    if (_meter.getSampleRate() != rate) _meter.begin(rate, 2);
+    _meter.setInputScale(scale);
+
+    uint32_t start = micros();
+    _meter.add(stereo, frames);
+    _meterMicros += micros() - start;
+}
+
+// Filters what the hook collected during the decoder's loop(), undoing the
+// library's volume step so the result does not depend on the volume.
+void AudioManager::drainMeter() {
+    if (!_meterFill) return;
+    if (_metering && _currentVolume > 0) {
+        meterFrames(_meterBuf, _meterFill, _audio.getSampleRate(), 64.0f / VOLUME_TABLE[_currentVolume]);
+    }
+    _meterFill = 0;
+}
+
+float AudioManager::measuredGainDb() {
+    float gainDb = LOUDNESS_TARGET_LUFS - _meter.integratedLufs();
+    float peak = _meter.peak();
+    if (peak > 0.0f) {
+        float headroomDb = -20.0f * log10f(peak);
+        if (gainDb > headroomDb) gainDb = headroomDb;
+    }
+    if (gainDb > LOUDNESS_MAX_GAIN_DB) gainDb = LOUDNESS_MAX_GAIN_DB;
+    if (gainDb < LOUDNESS_MIN_GAIN_DB) gainDb = LOUDNESS_MIN_GAIN_DB;
+    return gainDb;
+}
+
+// First play of a track: moves the gain towards the running measurement in
+// small steps so the correction is not heard as a jump.
+void AudioManager::followLoudness() {
+    _meterUpdatedAt = millis();
+    if (_meter.measuredSeconds() < LOUDNESS_MIN_SECONDS || !_meter.hasResult()) return;
+    int32_t target = lroundf(measuredGainDb() * 100.0f);
+    int32_t step = constrain(target - _trackGainMb, -LOUDNESS_SLEW_MB, LOUDNESS_SLEW_MB);
+    if (step) setTrackGain(_trackGainMb + step);
+}
+
+void AudioManager::commitLoudness() {
+    if (!_metering) return;
+    drainMeter();
+    _metering = false;
+    float seconds = _meter.measuredSeconds();
+    if (seconds < LOUDNESS_MIN_SECONDS || !_meter.hasResult()) return;
+
+    float lufs = _meter.integratedLufs();
+    float gainDb = measuredGainDb();
+    _gains.store(_meterPath.c_str(), _meterFileSize, (int16_t)lroundf(gainDb * 100.0f));
+    LOG_AUDIO_F("Loudness %s: %.1f LUFS over %.0f s, gain %+.1f dB (%u us per s of audio, %u frames skipped)",
+                _meterPath.c_str(), lufs, seconds, gainDb, (unsigned)(_meterMicros / seconds), (unsigned)_meterDropped);
+}
+
+void AudioManager::saveVolume() {
+    _volumeDirty = false;
+    _prefs.putInt("volume", _currentVolume);
+    LOG_AUDIO_F("Volume saved: %d", _currentVolume);
+}
+
+void AudioManager::updateCueLevel() {
+    _cues.setLevel((uint16_t)volumeQ8(_currentVolume));
 }
 
 void AudioManager::onStateChange(AudioStateCallback cb) {
@@ -46,14 +842,20 @@ void AudioManager::setVolume(int volume) {
     if (volume < 0) volume = 0;
     if (volume > 21) volume = 21;
     
+    if (_capture && volume != _capture->volume) endCapture(false);
     _currentVolume = volume;
-    _prefs.putInt("volume", _currentVolume);
-    LOG_AUDIO_F("Volume saved: %d", _currentVolume);
+    updateCueLevel();
+    // Button presses come in bursts; only the settled value goes to NVS.
+    _volumeDirty = true;
+    _volumeChangedAt = millis();
     
+#if FEATURE_BLUETOOTH
     if (_isBtMode && _btInitialized) {
         int btVol = map(_currentVolume, 0, 21, 0, 127);
         _a2dp_sink.set_volume(btVol);
-    } else if (!_isBtMode) {
+    } else
+#endif
+    if (!_isBtMode) {
         _audio.setVolume(_currentVolume);
     }
 }
@@ -64,6 +866,11 @@ int AudioManager::getVolume() {
 
 void AudioManager::playFile(String filename) {
     if (_isBtMode) return;
+    _dma.endTrack();
+    _fileCueActive = false;
+    endStream();
+    endCapture(false);
+    resetWarm();
     
     if (_audio.isRunning()) {
         fadeOut(50);
@@ -72,17 +879,80 @@ void AudioManager::playFile(String filename) {
         delay(20);
     }
     
+    _adpcm.close();
+    _adpcmPaused = false;
+    _pumpLen = _pumpOff = 0;
+    _sourceRate = 0;
+    _stretch.clear();
+    clearHook();
+    applyDmaProfile();
+    
     _audio.setVolume(_currentVolume);  // Restore volume after fadeout
     
     if (!filename.startsWith("/")) filename = "/" + filename;
     LOG_AUDIO_F(" Playing: %s", filename.c_str());
-    _audio.connecttoFS(SD, filename.c_str());
+    _currentFile = filename;
+    _playStartUs = _tapUs ? _tapUs : micros();
+    _awaitFirst = _tapUs != 0;
+    _tapUs = 0;
+    uint32_t size = startTrackGain(filename);
+    // The decoder library has no IMA ADPCM support; those go through the direct path.
+    String ext = filename.substring(filename.length() - 4);
+    ext.toLowerCase();
+    if (ext == ".wav" && AdpcmPlayer::probe(filename.c_str())) {
+        _adpcm.open(filename.c_str());
+    } else {
+        _clockCheck = true;
+        if (size) startWarm(filename, size);
+        _audio.connecttoFS(SD, filename.c_str());
+        if (_warmSlot) pumpWarm();
+    }
     
     notifyStateChange(true); 
 }
 
+// Posted by the portal after a stream start; the buffer is reset here, on
+// the task that reads it.
+void AudioManager::playStream() {
+    if (_isBtMode || !_stream.open()) return;
+    _dma.endTrack();
+    _fileCueActive = false;
+    endCapture(false);
+    resetWarm();
+    if (_audio.isRunning()) {
+        _audio.stopSong();
+        clearBuffer();
+    }
+    _adpcm.close();
+    _adpcmPaused = false;
+    _pumpLen = _pumpOff = 0;
+    _sourceRate = 0;
+    _stretch.clear();
+    clearHook();
+    applyDmaProfile();
+    commitLoudness();
+    setTrackGain(0);
+
+    _streamActive = true;
+    _currentFile = "stream";
+    LOG_AUDIO("Playing network stream");
+    notifyStateChange(true);
+}
+
+JitterBuffer* AudioManager::getStreamBuffer() {
+    return &_stream;
+}
+
+void AudioManager::endStream() {
+    if (!_streamActive) return;
+    _streamActive = false;
+    _stream.report();
+    _stream.close();
+}
+
 void AudioManager::playFolder(String folderPath) {
     if (_isBtMode) return;
+    _tapUs = micros();
     
     if (_audio.isRunning()) {
         _audio.stopSong();
@@ -91,8 +961,10 @@ void AudioManager::playFolder(String folderPath) {
     loadPlaylist(folderPath);
     if (_playlist.size() > 0) {
         _trackIndex = 0;
+        _warm.noteTap(_playlist[0].c_str());
         playFile(_playlist[_trackIndex]);
     }
+    _tapUs = 0;
 }
 
 void AudioManager::playNext() {
@@ -107,7 +979,16 @@ void AudioManager::playNext() {
 
 void AudioManager::stop() {
     if (!_isBtMode) {
+        _dma.endTrack();
+        endCapture(false);
+        resetWarm();
         _audio.stopSong();
+        _adpcm.close();
+        _adpcmPaused = false;
+        _stretch.clear();
+        clearHook();
+        endStream();
+        commitLoudness();
         notifyStateChange(false); 
     }
 }
@@ -128,16 +1009,23 @@ void AudioManager::fadeOut(int durationMs) {
 
 void AudioManager::clearBuffer() {
     i2s_zero_dma_buffer(I2S_NUM_0);
+    _dma.restart(_i2sEvents);
 }
 
 void AudioManager::pause() {
+#if FEATURE_BLUETOOTH
     if (_isBtMode && _btInitialized) {
         if (_a2dp_sink.get_audio_state() == ESP_A2D_AUDIO_STATE_STARTED) {
             _a2dp_sink.pause();
             notifyStateChange(false);
         }
-    } else if (!_isBtMode) {
-        if (_audio.isRunning()) {
+    } else
+#endif
+    if (!_isBtMode) {
+        if (directActive()) {
+            _adpcmPaused = true;
+            notifyStateChange(false);
+        } else if (_audio.isRunning()) {
             _audio.pauseResume();
             notifyStateChange(false);
         }
@@ -145,13 +1033,21 @@ void AudioManager::pause() {
 }
 
 void AudioManager::resume() {
+#if FEATURE_BLUETOOTH
     if (_isBtMode && _btInitialized) {
         if (_a2dp_sink.get_audio_state() != ESP_A2D_AUDIO_STATE_STARTED) {
             _a2dp_sink.play();
             notifyStateChange(true);
         }
-    } else if (!_isBtMode) {
-        if (!_audio.isRunning()) {
+    } else
+#endif
+    if (!_isBtMode) {
+        if (_adpcm.isOpen()) {
+            if (_adpcmPaused) {
+                _adpcmPaused = false;
+                notifyStateChange(true);
+            }
+        } else if (!_audio.isRunning()) {
             _audio.pauseResume();
             notifyStateChange(true);
         }
@@ -161,6 +1057,7 @@ void AudioManager::resume() {
 void AudioManager::togglePause() {
     bool newState = false;
     
+#if FEATURE_BLUETOOTH
     if (_isBtMode && _btInitialized) {
         if (_a2dp_sink.get_audio_state() == ESP_A2D_AUDIO_STATE_STARTED) {
             _a2dp_sink.pause();
@@ -169,28 +1066,56 @@ void AudioManager::togglePause() {
             _a2dp_sink.play();
             newState = true;
         }
-    } else if (!_isBtMode) {
-        _audio.pauseResume(); 
-        newState = _audio.isRunning();
+    } else
+#endif
+    if (!_isBtMode) {
+        if (_adpcm.isOpen()) {
+            _adpcmPaused = !_adpcmPaused;
+            newState = !_adpcmPaused;
+        } else {
+            _audio.pauseResume(); 
+            newState = _audio.isRunning();
+        }
     }
     
     notifyStateChange(newState);
 }
 
 bool AudioManager::isPlaying() {
+#if FEATURE_BLUETOOTH
     if (_isBtMode && _btInitialized) {
         return (_a2dp_sink.get_audio_state() == ESP_A2D_AUDIO_STATE_STARTED);
-    } else if (_isBtMode) {
+    } else
+#endif
+    if (_isBtMode) {
         return false;
     } else {
-        return _audio.isRunning();
+        return _audio.isRunning() || directActive() || _streamActive;
     }
 }
 
+const char* AudioManager::getCurrentTrack() {
+    return _currentFile.c_str();
+}
+
+uint32_t AudioManager::getPosition() {
+    if (_isBtMode) return 0;
+    if (_adpcm.isOpen()) return _adpcm.getPositionSec();
+    return _audio.getAudioCurrentTime();
+}
+
 void AudioManager::startBluetooth() {
+#if FEATURE_BLUETOOTH
     if (_isBtMode) return;
     
+    _dma.endTrack();
+    _cues.stop();
+    endCapture(false);
+    resetWarm();
+    _adpcm.close();
+    endStream();
     _audio.stopSong();
+    commitLoudness();
     delay(100);
     i2s_driver_uninstall(I2S_NUM_0);
     delay(100);
@@ -198,23 +1123,33 @@ void AudioManager::startBluetooth() {
     _isBtMode = true;
     
     i2s_pin_config_t my_pin_config = {
-        .bck_io_num = PIN_I2S_BCLK,
-        .ws_io_num = PIN_I2S_LRC,
-        .data_out_num = PIN_I2S_DOUT,
+        .bck_io_num = Board::pinI2sBclk,
+        .ws_io_num = Board::pinI2sLrc,
+        .data_out_num = Board::pinI2sDout,
         .data_in_num = I2S_PIN_NO_CHANGE
     };
     _a2dp_sink.set_pin_config(my_pin_config);
+    _dmaInstalled = _dma.profile(DMA_MODE_A2DP);
+    _i2sEvents = nullptr;
+    _a2dp_sink.set_i2s_config(i2sConfig(_dmaInstalled));
+    _a2dp_sink.set_stream_reader(a2dpStreamReader, true);
+    _dma.startTrack(DMA_MODE_A2DP, _dmaInstalled);
     _a2dp_sink.start("SunToy Speaker");
     
     delay(500);
     _btInitialized = true;
     setVolume(_currentVolume);
+#endif
 }
 
 void AudioManager::stopBluetooth() {
+#if FEATURE_BLUETOOTH
     if (!_isBtMode) return;
     
     LOG_AUDIO("BT exit - saving flag and restarting");
+    if (_volumeDirty) saveVolume();
+    _dma.setActive(false, 0);
+    _dma.endTrack();
     Preferences exitPrefs;
     exitPrefs.begin("audio", false);
     exitPrefs.putBool("bt_exit", true);
@@ -225,11 +1160,20 @@ void AudioManager::stopBluetooth() {
     delay(200);
     
     ESP.restart();
+#endif
+}
+
+#if FEATURE_BLUETOOTH
+// Runs on the Bluetooth task with each decoded block before it goes to I2S.
+void AudioManager::a2dpStreamReader(const uint8_t* data, uint32_t len) {
+    if (_audioInstance) _audioInstance->_dma.noteFrames(len / (2 * sizeof(int16_t)));
 }
+#endif
 
-BluetoothA2DPSink* AudioManager::getBtSink() {
-    if (!_btInitialized) return nullptr;
-    return &_a2dp_sink;
+void AudioManager::btNext() {
+#if FEATURE_BLUETOOTH
+    if (_btInitialized) _a2dp_sink.next();
+#endif
 }
 
 void AudioManager::loadPlaylist(String folder) {
@@ -4,8 +4,56 @@
 #include <vector>
 #include <SD.h>
 #include <Preferences.h>
-#include "BluetoothA2DPSink.h"
 #include "Config.h"
+#if FEATURE_BLUETOOTH
+#include "BluetoothA2DPSink.h"
+#endif
+#include "CueMixer.h"
+#include "AdpcmPlayer.h"
+#include "LoudnessMeter.h"
+#include "TrackGains.h"
+#include "TimeStretch.h"
+#include "SpectrumAnalyzer.h"
+#include "JitterBuffer.h"
+#include "DmaTuner.h"
+#include "WarmCache.h"
+#include "Resampler.h"
+
+#define CUE_PUMP_FRAMES 256
+
+// I2S always runs at this rate; every source is resampled to it.
+#define AUDIO_OUTPUT_RATE     44100
+#define RESAMPLE_REPORT_SEC   30
+
+#define LOUDNESS_TARGET_LUFS  -18.0f
+#define LOUDNESS_MAX_GAIN_DB  9.0f
+#define LOUDNESS_MIN_GAIN_DB  -12.0f
+#define LOUDNESS_MIN_SECONDS  3.0f
+#define LOUDNESS_MAX_SECONDS  120.0f
+// Hook frames collected for the meter during one decoder loop() call;
+// covers the largest FLAC block.
+#define LOUDNESS_HOOK_FRAMES  4608
+// Until a track has a stored gain, the gain follows its running
+// measurement at most this fast.
+#define LOUDNESS_UPDATE_MS    1000
+#define LOUDNESS_SLEW_MB      100
+
+#define VOLUME_SAVE_DELAY_MS  2000
+#define STRETCH_REPORT_SEC    30
+// The hook only collects the decoder's frames here; loop() stretches,
+// resamples and writes them. The decoder runs only when its largest block
+// (LOUDNESS_HOOK_FRAMES) still fits.
+#define HOOK_BUFFER_FRAMES    8192
+
+// A warm start stays this many DMA buffers ahead of the DAC until the
+// decoder's first frame (which re-clocks I2S and restarts the ring).
+#define WARM_LEAD_BUFFERS     2
+
+// Visualizer analysis runs at most every VIS_FRAME_MS; a frame that
+// exceeds VIS_BUDGET_US halves the rate until it fits again.
+#define VIS_FRAME_MS          40
+#define VIS_MAX_FRAME_MS      320
+#define VIS_BUDGET_US         300
 
 typedef std::function<void(bool)> AudioStateCallback;
 
@@ -13,11 +61,16 @@ class AudioManager {
 public:
     AudioManager();
     void begin();
+    // Needs the SD card: loads tap statistics and cached track starts.
+    bool beginWarmCache();
     void loop();
     
     void playFile(String filename);
     void playFolder(String folderPath);
     void playNext();
+    // Plays the live stream fed into getStreamBuffer() by the network side.
+    void playStream();
+    JitterBuffer* getStreamBuffer();
     void stop();
     void fadeOut(int durationMs = 100);
     void clearBuffer();
@@ -27,27 +80,174 @@ public:
     void togglePause();
     
     bool isPlaying();
+    const char* getCurrentTrack();
+    uint32_t getPosition();
+
+    bool preloadCue(const char* path);
+    bool preloadEmbeddedCue(const char* path);
+    bool playCue(const char* path);
+    bool isCuePlaying();
     
     void setVolume(int volume); 
     int getVolume();
+
+    // Playback speed in percent (75-150), pitch preserved.
+    void setSpeed(uint8_t percent);
+    uint8_t getSpeed();
     
     void startBluetooth(); 
     void stopBluetooth();  
     
-    BluetoothA2DPSink* getBtSink(); 
+    void btNext();
+    // Selects the WiFi DMA profile from the next track on.
+    void setWifiActive(bool active);
+    // Saved; applies from the next track on.
+    void setResampleQuality(ResampleQuality quality);
+    ResampleQuality getResampleQuality();
+
+    // Audio-reactive level 0-255 for the LEDs, updated while enabled.
+    void setVisualizer(bool enabled);
+    uint8_t getVisualLevel();
     void onStateChange(AudioStateCallback cb);
 
+    // Serial console: "warm" reports cache slots and tap latency,
+    // "resample" the output conversion.
+    bool handleCommand(const char* line);
+
+    // Called from the decoder's I2S hook for every output frame. Returns
+    // false when the frame was taken over (buffered for loop() or resampled).
+    bool processSample(uint32_t* sample);
+
 private:
     Audio _audio;
+#if FEATURE_BLUETOOTH
     BluetoothA2DPSink _a2dp_sink;
+#endif
     int _currentVolume;
     std::vector<String> _playlist;
+    String _currentFile;
     int _trackIndex;
     bool _isBtMode;
     bool _btInitialized;
     AudioStateCallback _stateCallback;
     Preferences _prefs;
+    CueMixer _cues;
+    bool _fileCueActive;
+    int16_t _pumpBuf[CUE_PUMP_FRAMES * 2];
+    size_t _pumpLen;
+    size_t _pumpOff;
+    uint32_t _sourceRate;
+    AdpcmPlayer _adpcm;
+    bool _adpcmPaused;
+    bool _volumeDirty;
+    unsigned long _volumeChangedAt;
+
+    TrackGains _gains;
+    LoudnessMeter _meter;
+    bool _metering;
+    String _meterPath;
+    uint32_t _meterFileSize;
+    uint32_t _meterMicros;
+    int16_t* _meterBuf;
+    size_t _meterFill;
+    uint32_t _meterDropped;
+    unsigned long _meterUpdatedAt;
+    int16_t _trackGainMb;
+    int32_t _trackGainQ12;
+
+    TimeStretch _stretch;
+    int16_t _stretchBuf[CUE_PUMP_FRAMES * 2];
+    uint32_t _stretchMicros;
+    uint32_t _stretchFrames;
+    int16_t* _hookBuf;
+    size_t _hookHead;
+    size_t _hookTail;
+    uint32_t _hookDropped;
+    size_t _outLen;
+    size_t _outOff;
+
+    SpectrumAnalyzer _spectrum;
+    bool _visEnabled;
+    uint8_t _visLevel;
+    uint16_t _visPeak;
+    uint16_t _visFrameMs;
+    unsigned long _visLastFrame;
+
+    JitterBuffer _stream;
+    bool _streamActive;
+
+    DmaTuner _dma;
+    DmaProfile _dmaInstalled;
+    QueueHandle_t _i2sEvents;
+    bool _wifiActive;
+
+    WarmCache _warm;
+    const WarmSlot* _warmSlot;
+    uint32_t _warmRate;
+    uint8_t _warmVolume;
+    uint32_t _warmFilled;
+    uint32_t _warmWritten;
+    uint32_t _warmDecoded;
+    uint32_t _warmStartUs;
+    bool _warmCatchUp;
+    bool _warmClocked;
+    WarmSlot* _capture;
+    uint32_t _captureFrames;
+    uint32_t _captureTarget;
+    uint32_t _tapUs;
+    uint32_t _playStartUs;
+    bool _awaitFirst;
+
+    Resampler _resampler;
+    ResampleQuality _resampleQuality;
+    int16_t _srcBuf[CUE_PUMP_FRAMES * 2];
+    size_t _srcBlock;
+    int16_t _outBuf[CUE_PUMP_FRAMES * 2];
+    uint32_t _resampleMicros;
+    uint32_t _resampleBlocks;
+    uint32_t _resampleFrames;
+    bool _clockCheck;
     
     void loadPlaylist(String folder);
+    bool directActive();
+    void pumpDirect();
+    void setSourceRate(uint32_t rate);
+    void restoreClock(bool restarted);
+    size_t resample(const int16_t* stereo, size_t frames, int16_t* out);
+    bool resampleCommand(const char* args);
+    void benchResampler();
+    size_t readDirect(int16_t* stereo, size_t frames);
+    void applyDirectGain(int16_t* stereo, size_t frames);
+    void endStream();
+    size_t stretchDirect(size_t frames);
+    void runStretch(uint32_t rate);
+    bool hookPending();
+    size_t hookSpace();
+    size_t nextHookBlock();
+    void drainHook();
+    void clearHook();
+    void updateVisualizer();
+    void updateCueLevel();
+    void saveVolume();
+    uint32_t startTrackGain(const String& path);
+    void meterFrames(const int16_t* stereo, size_t frames, uint32_t rate, float scale);
+    void drainMeter();
+    void setTrackGain(int16_t gainMb);
+    void followLoudness();
+    float measuredGainDb();
+    void commitLoudness();
     void notifyStateChange(bool isPlaying);
+    void installI2s(const DmaProfile& profile);
+    void applyDmaProfile();
+    void updateDma();
+    void startWarm(const String& path, uint32_t fileSize);
+    void pumpWarm();
+    void warmClocked();
+    void resetWarm();
+    void captureFrame(uint32_t sample);
+    void endCapture(bool complete);
+    void noteFirstSample(bool warm);
+#if FEATURE_BLUETOOTH
+    static void a2dpStreamReader(const uint8_t* data, uint32_t len);
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "CardScanner.h"
+#include <algorithm>
+#include <rom/crc.h>
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_SCAN 1
+#if DEBUG_SCAN
+    #define LOG_SCAN(msg) Serial.println("[SCAN] " msg)
+    #define LOG_SCAN_F(fmt, ...) Serial.printf("[SCAN] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_SCAN(msg)
+    #define LOG_SCAN_F(fmt, ...)
+#endif
+
+// How far into an MP3 the first two consecutive frames may start (after
+// any ID3v2 tag) before the file is taken as not being MP3 at all.
+#define SCAN_SYNC_SEARCH  65536
+
+static const char* const SCAN_ROOTS[] = { DIR_TALES, DIR_RECORDS, "/system" };
+
+static const char* const RESULT_NAMES[] = {
+    "ok", "unreadable", "bad_header", "bad_format", "no_frames", "lost_sync", "truncated", "changed"
+};
+
+static const char* const STATE_NAMES[] = { "waiting", "listing", "checking", "saving" };
+
+// Kilobits per second by [MPEG-1?][layer 1..3][index].
+static const uint16_t MP3_BITRATES[2][3][15] = {
+    {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+    {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+};
+static const uint32_t MP3_RATES[3] = { 44100, 48000, 32000 };
+
+// Length of the frame starting with header `h`, 0 for free format (no
+// length in the header), -1 if it is not a frame header.
+static int32_t mp3FrameLength(const uint8_t* h) {
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return -1;
+    uint8_t version = (h[1] >> 3) & 3;
+    uint8_t layer = (h[1] >> 1) & 3;
+    uint8_t bitrate = h[2] >> 4;
+    uint8_t rate = (h[2] >> 2) & 3;
+    if (version == 1 || layer == 0 || bitrate == 15 || rate == 3 || (h[3] & 3) == 2) return -1;
+    if (bitrate == 0) return 0;
+
+    bool mpeg1 = version == 3;
+    uint8_t layerIndex = 3 - layer;
+    uint32_t kbps = MP3_BITRATES[mpeg1][layerIndex][bitrate];
+    uint32_t sampleRate = MP3_RATES[rate] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    uint32_t padding = (h[2] >> 1) & 1;
+    if (layerIndex == 0) return (12 * kbps * 1000 / sampleRate + padding) * 4;
+    if (layerIndex == 2 && !mpeg1) return 72 * kbps * 1000 / sampleRate + padding;
+    return 144 * kbps * 1000 / sampleRate + padding;
+}
+
+static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const char* CardScanner::resultName(ScanResult result) {
+    return result <= SCAN_CHANGED ? RESULT_NAMES[result] : "?";
+}
+
+bool CardScanner::begin() {
+    if (!_block) _block = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, SCAN_BLOCK, MEM_MAIN);
+    if (!_lock) _lock = xSemaphoreCreateMutex();
+    if (!_block || !_lock) return false;
+    loadIndex();
+    publish();
+    if (_badCount) LOG_SCAN_F("%u damaged files from earlier scans", _badCount);
+    return true;
+}
+
+static bool pathBefore(const String& a, const String& b) {
+    return strcmp(a.c_str(), b.c_str()) < 0;
+}
+
+bool CardScanner::wanted(const String& path) {
+    String lower = path;
+    lower.toLowerCase();
+    return lower.endsWith(".mp3") || lower.endsWith(".wav");
+}
+
+void CardScanner::loadIndex() {
+    _cache.clear();
+    File file = SD.open(SCAN_INDEX_FILE);
+    if (!file) return;
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        unsigned crc, size, mtime, code, offset;
+        int pathAt = 0;
+        if (sscanf(line.c_str(), "%8x %u %u %u %u %n", &crc, &size, &mtime, &code, &offset, &pathAt) != 5 ||
+            !pathAt || code > SCAN_CHANGED) {
+            continue;
+        }
+        _cache.push_back({ line.substring(pathAt), size, mtime, crc, offset, (ScanResult)code, false });
+    }
+    file.close();
+}
+
+void CardScanner::saveIndex() {
+    if (!SD.exists("/system")) SD.mkdir("/system");
+    File file = SD.open(SCAN_INDEX_TMP, FILE_WRITE);
+    if (!file) return;
+    for (const auto& e : _cache) {
+        file.printf("%08x %u %u %u %u %s\n", (unsigned)e.crc, (unsigned)e.size, (unsigned)e.mtime,
+                    (unsigned)e.result, (unsigned)e.offset, e.path.c_str());
+    }
+    file.close();
+    SD.remove(SCAN_INDEX_FILE);
+    SD.rename(SCAN_INDEX_TMP, SCAN_INDEX_FILE);
+}
+
+void CardScanner::rescan() {
+    _rescan = true;
+}
+
+bool CardScanner::takeNewBad() {
+    bool newBad = _newBad;
+    _newBad = false;
+    return newBad;
+}
+
+void CardScanner::loop(bool idle) {
+    if (!_block) return;
+    if (!idle) {
+        // Playback owns the card: let go of the file, keep the position.
+        if (_file) _file.close();
+        if (_dir) _dir.close();
+        _idleSince = 0;
+        return;
+    }
+    if (!_idleSince) _idleSince = millis();
+    if (millis() - _idleSince < SCAN_IDLE_DELAY_MS) return;
+
+    uint32_t deadline = micros() + SCAN_BUDGET_MS * 1000UL;
+    switch (_state) {
+        case SCAN_WAIT:
+            if (!_rescan && _passes && millis() - _lastPass < SCAN_INTERVAL_MS) return;
+            startPass();
+            break;
+        case SCAN_LIST:
+            if (listStep(deadline)) {
+                _current = 0;
+                _state = _pending.empty() ? SCAN_SAVE : SCAN_FILE;
+            }
+            break;
+        case SCAN_FILE:
+            if (fileStep(deadline)) _state = SCAN_SAVE;
+            break;
+        case SCAN_SAVE: {
+            _cache.erase(std::remove_if(_cache.begin(), _cache.end(), [](const Entry& e) { return !e.seen; }),
+                         _cache.end());
+            _pending.clear();
+            saveIndex();
+            publish();
+            _passes++;
+            _lastPass = millis();
+            _state = SCAN_WAIT;
+            if (_found) _newBad = true;
+            LOG_SCAN_F("Pass %u%s: %u files, %u read (%u KB) in %lu ms, %u damaged",
+                       (unsigned)_passes, _deep ? " (deep)" : "", (unsigned)_cache.size(), _passFiles,
+                       (unsigned)(_passBytes / 1024), millis() - _passStart, _badCount);
+            break;
+        }
+    }
+}
+
+void CardScanner::startPass() {
+    if (_rescan) {
+        _rescan = false;
+        _cache.clear();
+    }
+    _deep = (_passes + 1) % SCAN_DEEP_EVERY == 0;
+    for (auto& e : _cache) e.seen = false;
+    std::sort(_cache.begin(), _cache.end(), [](const Entry& a, const Entry& b) { return pathBefore(a.path, b.path); });
+    _known = _cache.size();
+    _pending.clear();
+    _dirs.clear();
+    _dirPath = "";
+    for (const char* root : SCAN_ROOTS) _dirs.push_back(root);
+    _passStart = millis();
+    _passBytes = 0;
+    _passFiles = 0;
+    _found = 0;
+    _fileCount = 0;
+    _checked = 0;
+    _state = SCAN_LIST;
+}
+
+// Lists entries until the deadline; subdirectories are pushed for later.
+bool CardScanner::listStep(uint32_t deadline) {
+    while ((int32_t)(deadline - micros()) > 0) {
+        if (!_dir) {
+            if (!_dirPath.length()) {
+                if (_dirs.empty()) return true;
+                _dirPath = _dirs.back();
+                _dirs.pop_back();
+                _dirListed = 0;
+                _dirDepth = 0;
+                for (const char* p = _dirPath.c_str(); *p; p++) _dirDepth += *p == '/';
+            }
+            _dir = SD.open(_dirPath);
+            if (!_dir) {
+                _dirPath = "";
+                continue;
+            }
+            for (uint32_t i = 0; i < _dirListed; i++) {
+                File skipped = _dir.openNextFile();
+                if (!skipped) break;
+                skipped.close();
+            }
+        }
+        File file = _dir.openNextFile();
+        if (!file) {
+            _dir.close();
+            _dirPath = "";
+            continue;
+        }
+        _dirListed++;
+        listEntry(file);
+        file.close();
+    }
+    return false;
+}
+
+void CardScanner::listEntry(File& file) {
+    String path = _dirPath + "/" + file.name();
+    if (file.isDirectory()) {
+        if (_dirDepth < SCAN_MAX_DEPTH) _dirs.push_back(path);
+        return;
+    }
+    if (!wanted(path) || path.length() >= SCAN_PATH_LEN) return;
+    uint32_t size = file.size();
+    uint32_t mtime = file.getLastWrite();
+    _fileCount++;
+    auto known = _cache.begin() + _known;
+    auto it = std::lower_bound(_cache.begin(), known, path,
+                               [](const Entry& e, const String& p) { return pathBefore(e.path, p); });
+    if (it == known || it->path != path) {
+        _pending.push_back(_cache.size());
+        _cache.push_back({ path, size, mtime, 0, 0, SCAN_OK, true });
+        return;
+    }
+    Entry& e = *it;
+    e.seen = true;
+    if (e.size != size || e.mtime != mtime || _deep) {
+        if (e.size != size || e.mtime != mtime) e.result = SCAN_OK;
+        e.size = size;
+        e.mtime = mtime;
+        _pending.push_back(it - _cache.begin());
+    }
+}
+
+bool CardScanner::openCurrent() {
+    Entry& e = _cache[_pending[_current]];
+    _file = SD.open(e.path);
+    if (!_file) return false;
+    if (_pos == 0) {
+        _crc = 0;
+        _result = SCAN_OK;
+        _resultAt = 0;
+        _mp3 = false;
+        _tail = false;
+        String lower = e.path;
+        lower.toLowerCase();
+        if (lower.endsWith(".wav")) {
+            _result = checkWav(_file.size(), &_resultAt);
+        } else {
+            _mp3 = startMp3(_file.size());
+        }
+        _file.seek(0);
+    } else if (_file.size() != e.size || !_file.seek(_pos)) {
+        // Rewritten while we were away; check it from the start.
+        e.size = _file.size();
+        e.mtime = _file.getLastWrite();
+        _file.close();
+        _pos = 0;
+        return openCurrent();
+    }
+    return true;
+}
+
+bool CardScanner::fileStep(uint32_t deadline) {
+    while ((int32_t)(deadline - micros()) > 0) {
+        if (_current >= _pending.size()) return true;
+        Entry& e = _cache[_pending[_current]];
+        if (!_file && !openCurrent()) {
+            _result = SCAN_UNREADABLE;
+            _resultAt = _pos;
+            finishFile();
+            continue;
+        }
+        if (_result != SCAN_OK) {
+            finishFile();
+            continue;
+        }
+        int n = _file.read(_block, SCAN_BLOCK);
+        if (n < 0 || (n == 0 && _pos < e.size)) {
+            _result = SCAN_UNREADABLE;
+            _resultAt = _pos;
+            finishFile();
+            continue;
+        }
+        if (n == 0) {
+            finishFile();
+            continue;
+        }
+        _crc = crc32_le(_crc, _block, n);
+        if (_mp3) walkFrames(_block, n);
+        _pos += n;
+        _passBytes += n;
+    }
+    return false;
+}
+
+void CardScanner::finishFile() {
+    Entry& e = _cache[_pending[_current]];
+    if (_file) _file.close();
+    if (_result == SCAN_OK && _mp3 && !_tail) {
+        if (_frames < 2) {
+            _result = SCAN_NO_FRAMES;
+            _resultAt = _audioStart;
+        } else if (_nextFrame > e.size) {
+            _result = SCAN_TRUNCATED;
+            _resultAt = e.size;
+        }
+    }
+    // Rot stays reported until the file is replaced (size or mtime change).
+    if (_result == SCAN_OK && e.result == SCAN_CHANGED) _result = SCAN_CHANGED;
+    bool wasBad = e.result != SCAN_OK;
+    if (_result == SCAN_OK && !wasBad && _deep && e.crc && e.crc != _crc) {
+        // Same size and mtime, different bytes: the card changed them.
+        _result = SCAN_CHANGED;
+    }
+    if (_result != SCAN_OK && !wasBad) {
+        _found++;
+        LOG_SCAN_F("%s: %s at %u", e.path.c_str(), resultName(_result), (unsigned)_resultAt);
+    }
+    e.result = _result;
+    e.offset = _result == SCAN_OK ? 0 : _resultAt;
+    e.crc = _result == SCAN_OK ? _crc : 0;
+    _pos = 0;
+    _current++;
+    _checked = _current;
+    _passFiles++;
+}
+
+// Reads the WAV chunk list with seeks; the data itself only needs to be
+// there (and is read for the CRC afterwards).
+ScanResult CardScanner::checkWav(uint32_t size, uint32_t* offset) {
+    uint8_t head[16];
+    *offset = 0;
+    if (size < 12 || _file.read(head, 12) != 12) return SCAN_TRUNCATED;
+    if (memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0) return SCAN_BAD_HEADER;
+
+    bool fmt = false;
+    uint32_t pos = 12;
+    for (uint8_t chunks = 0; chunks < 16 && pos + 8 <= size; chunks++) {
+        *offset = pos;
+        if (!_file.seek(pos) || _file.read(head, 8) != 8) return SCAN_UNREADABLE;
+        uint32_t len = readLe32(head + 4);
+        if (memcmp(head, "fmt ", 4) == 0) {
+            if (len < 16 || _file.read(head, 16) != 16) return SCAN_BAD_HEADER;
+            uint16_t format = head[0] | (head[1] << 8);
+            uint16_t channels = head[2] | (head[3] << 8);
+            uint32_t rate = readLe32(head + 4);
+            if ((format != 1 && format != 3 && format != 0x11 && format != 0xFFFE) || channels < 1 || channels > 2 ||
+                rate < 8000 || rate > 96000) {
+                return SCAN_BAD_FORMAT;
+            }
+            fmt = true;
+        } else if (memcmp(head, "data", 4) == 0) {
+            if (!fmt) return SCAN_BAD_HEADER;
+            // Streams written without knowing their length leave it open.
+            if (len != 0xFFFFFFFF && pos + 8 + len > size) {
+                *offset = size;
+                return SCAN_TRUNCATED;
+            }
+            return SCAN_OK;
+        }
+        pos += 8 + len + (len & 1);
+    }
+    return pos + 8 > size ? SCAN_TRUNCATED : SCAN_BAD_HEADER;
+}
+
+// Skips an ID3v2 tag; frames are expected right after it.
+bool CardScanner::startMp3(uint32_t size) {
+    uint8_t head[10];
+    uint32_t start = 0;
+    if (size >= 10 && _file.read(head, 10) == 10 && memcmp(head, "ID3", 3) == 0) {
+        start = 10 + (((uint32_t)(head[6] & 0x7F) << 21) | ((uint32_t)(head[7] & 0x7F) << 14) |
+                      ((uint32_t)(head[8] & 0x7F) << 7) | (head[9] & 0x7F));
+        if (head[5] & 0x10) start += 10;
+        if (start > size) {
+            _result = SCAN_TRUNCATED;
+            _resultAt = size;
+        }
+    }
+    _audioStart = start;
+    _nextFrame = start;
+    _chainStart = start;
+    _frames = 0;
+    _carryLen = 0;
+    return true;
+}
+
+// Follows the frame chain through one block. A chain only counts as
+// synced after two frames in a row; until then a failed header moves the
+// search on by a byte, as the decoder would. Once synced, a header that
+// does not match is either the start of a trailing tag or damage.
+void CardScanner::walkFrames(const uint8_t* data, size_t len) {
+    uint32_t blockStart = _pos;
+    uint32_t end = _pos + len;
+    uint32_t first = blockStart - _carryLen;
+    if (_nextFrame < first) _nextFrame = first;
+
+    while (!_tail && _result == SCAN_OK && _nextFrame + 4 <= end) {
+        uint8_t h[4];
+        for (uint8_t i = 0; i < 4; i++) {
+            uint32_t at = _nextFrame + i;
+            h[i] = at >= blockStart ? data[at - blockStart] : _carry[at - first];
+        }
+        int32_t frameLen = mp3FrameLength(h);
+        if (frameLen > 0 && _frames && (h[1] != _frameKey[0] || (h[2] & 0x0C) != _frameKey[1])) frameLen = -1;
+        if (frameLen == 0) {
+            // Free format: frame lengths are not in the headers.
+            _tail = true;
+            _frames++;
+            break;
+        }
+        if (frameLen > 0) {
+            if (!_frames) {
+                _chainStart = _nextFrame;
+                _frameKey[0] = h[1];
+                _frameKey[1] = h[2] & 0x0C;
+            }
+            _frames++;
+            _nextFrame += frameLen;
+            continue;
+        }
+        if (_frames >= 2) {
+            if (memcmp(h, "TAG", 3) == 0 || memcmp(h, "APE", 3) == 0 || memcmp(h, "LYR", 3) == 0) {
+                _tail = true;
+            } else {
+                _result = SCAN_LOST_SYNC;
+                _resultAt = _nextFrame;
+            }
+            break;
+        }
+        _nextFrame = _frames ? _chainStart + 1 : _nextFrame + 1;
+        if (_nextFrame < first) _nextFrame = first;
+        _frames = 0;
+        while (_nextFrame < end) {
+            uint32_t at = _nextFrame;
+            if ((at >= blockStart ? data[at - blockStart] : _carry[at - first]) == 0xFF) break;
+            _nextFrame++;
+        }
+        _chainStart = _nextFrame;
+        if (_nextFrame - _audioStart > SCAN_SYNC_SEARCH) {
+            _result = SCAN_NO_FRAMES;
+            _resultAt = _audioStart;
+        }
+    }
+    _carryLen = len < 3 ? len : 3;
+    memcpy(_carry, data + len - _carryLen, _carryLen);
+}
+
+void CardScanner::publish() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _badCount = 0;
+    for (const auto& e : _cache) {
+        if (e.result == SCAN_OK) continue;
+        if (_badCount < SCAN_MAX_BAD) {
+            Bad& b = _bad[_badCount];
+            snprintf(b.path, sizeof(b.path), "%s", e.path.c_str());
+            for (char* p = b.path; *p; p++) {
+                if (*p == '"' || *p == '\\' || *p < 0x20) *p = '_';
+            }
+            b.result = e.result;
+            b.offset = e.offset;
+        }
+        _badCount++;
+    }
+    xSemaphoreGive(_lock);
+}
+
+size_t CardScanner::writeJson(char* buffer, size_t size) {
+    if (!_lock) {
+        int n = snprintf(buffer, size, "{\"state\":\"off\"}");
+        return (n > 0 && (size_t)n < size) ? n : 0;
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    int n = snprintf(buffer, size, "{\"state\":\"%s\",\"pass\":%u,\"deep\":%s,\"files\":%u,\"checked\":%u,"
+                     "\"pending\":%u,\"damaged\":%u,\"bad\":[",
+                     STATE_NAMES[_state], (unsigned)_passes, _deep ? "true" : "false", _fileCount, _checked,
+                     (unsigned)_pending.size(), _badCount);
+    for (uint16_t i = 0; i < _badCount && i < SCAN_MAX_BAD && n > 0 && (size_t)n < size; i++) {
+        n += snprintf(buffer + n, size - n, "%s{\"path\":\"%s\",\"error\":\"%s\",\"offset\":%u}", i ? "," : "",
+                      _bad[i].path, resultName(_bad[i].result), (unsigned)_bad[i].offset);
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "]}");
+    xSemaphoreGive(_lock);
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
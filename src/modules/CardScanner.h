@@ -0,0 +1,137 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+
+#define SCAN_INDEX_FILE      "/system/scan.idx"
+#define SCAN_INDEX_TMP       "/system/scan.tmp"
+#define SCAN_BLOCK           4096
+#define SCAN_BUDGET_MS       6
+#define SCAN_IDLE_DELAY_MS   5000
+#define SCAN_INTERVAL_MS     (30UL * 60 * 1000)
+#define SCAN_DEEP_EVERY      8
+#define SCAN_MAX_BAD         16
+#define SCAN_PATH_LEN        96
+#define SCAN_MAX_DEPTH       4
+
+enum ScanResult : uint8_t {
+    SCAN_OK,
+    SCAN_UNREADABLE,
+    SCAN_BAD_HEADER,
+    SCAN_BAD_FORMAT,
+    SCAN_NO_FRAMES,
+    SCAN_LOST_SYNC,
+    SCAN_TRUNCATED,
+    SCAN_CHANGED
+};
+
+// Checks the card for damaged audio while the toy has nothing else to do,
+// instead of a child finding out by tapping a figurine. Every .mp3 and
+// .wav under DIR_TALES, DIR_RECORDS and /system is read once: MP3 files
+// frame by frame (each header must be valid and lead to the next),
+// WAV files by their RIFF chunks. A CRC-32 is taken on the way.
+//
+// Results are kept in SCAN_INDEX_FILE, one "<crc32> <size> <mtime> <code>
+// <offset> <path>" line each, and a file is only read again when its size
+// or mtime changes. Every SCAN_DEEP_EVERY passes all files are re-read and
+// a CRC that changed under the same size and mtime is reported as bit rot.
+//
+// loop() does at most SCAN_BUDGET_MS of work per call (checked after every
+// directory entry and every block) and only while the caller reports idle;
+// the open directory or file is closed as soon as playback starts and the
+// scan resumes from the same entry or offset later.
+class CardScanner {
+public:
+    bool begin();
+    void loop(bool idle);
+    // Forgets cached results so the next pass reads every file.
+    void rescan();
+    uint16_t badCount() const { return _badCount; }
+    // True once after a pass that found a file not reported before.
+    bool takeNewBad();
+    size_t writeJson(char* buffer, size_t size);
+    static const char* resultName(ScanResult result);
+
+private:
+    enum State : uint8_t { SCAN_WAIT, SCAN_LIST, SCAN_FILE, SCAN_SAVE };
+
+    struct Entry {
+        String path;
+        uint32_t size;
+        uint32_t mtime;
+        uint32_t crc;
+        uint32_t offset;
+        ScanResult result;
+        bool seen;
+    };
+    struct Bad {
+        char path[SCAN_PATH_LEN];
+        ScanResult result;
+        uint32_t offset;
+    };
+
+    uint8_t* _block = nullptr;
+    // The first _known entries are sorted by path for lookups; files new
+    // to this pass are appended behind them.
+    std::vector<Entry> _cache;
+    size_t _known = 0;
+    std::vector<size_t> _pending;
+    std::vector<String> _dirs;
+    // Directory being listed; kept across loop() calls, reopened after a
+    // yield past the _dirListed entries already seen.
+    File _dir;
+    String _dirPath;
+    uint8_t _dirDepth = 0;
+    uint32_t _dirListed = 0;
+    State _state = SCAN_WAIT;
+    unsigned long _idleSince = 0;
+    unsigned long _lastPass = 0;
+    bool _deep = false;
+    volatile bool _rescan = false;
+    bool _newBad = false;
+    uint16_t _found = 0;
+    uint32_t _passes = 0;
+    uint32_t _passStart = 0;
+    uint32_t _passBytes = 0;
+    uint16_t _passFiles = 0;
+
+    // File being checked; kept across loop() calls, reopened after a yield.
+    size_t _current = 0;
+    File _file;
+    uint32_t _pos = 0;
+    uint32_t _crc = 0;
+    bool _mp3 = false;
+    uint32_t _audioStart = 0;
+    uint32_t _nextFrame = 0;
+    uint32_t _frames = 0;
+    uint32_t _chainStart = 0;
+    uint8_t _frameKey[2];
+    uint8_t _carry[3];
+    uint8_t _carryLen = 0;
+    bool _tail = false;
+    ScanResult _result = SCAN_OK;
+    uint32_t _resultAt = 0;
+
+    SemaphoreHandle_t _lock = nullptr;
+    Bad _bad[SCAN_MAX_BAD];
+    uint16_t _badCount = 0;
+    volatile uint16_t _fileCount = 0;
+    volatile uint16_t _checked = 0;
+
+    void loadIndex();
+    void saveIndex();
+    void startPass();
+    bool listStep(uint32_t deadline);
+    void listEntry(File& file);
+    bool fileStep(uint32_t deadline);
+    bool openCurrent();
+    void finishFile();
+    void publish();
+    ScanResult checkWav(uint32_t size, uint32_t* offset);
+    bool startMp3(uint32_t size);
+    void walkFrames(const uint8_t* data, size_t len);
+    static bool wanted(const String& path);
+};
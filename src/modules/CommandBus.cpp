@@ -0,0 +1,111 @@
+#include "CommandBus.h"
+
+#define DEBUG_BUS 1
+
+#if DEBUG_BUS
+    #define LOG_BUS(msg) Serial.println("[BUS] " msg)
+    #define LOG_BUS_F(fmt, ...) Serial.printf("[BUS] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_BUS(msg)
+    #define LOG_BUS_F(fmt, ...)
+#endif
+
+#define BUS_SLOW_LATENCY_US 100000
+
+void CommandBus::begin() {
+    if (!_queue) _queue = xQueueCreate(BUS_QUEUE_DEPTH, sizeof(BusCommand));
+}
+
+void CommandBus::onCommand(BusHandler handler) {
+    _handler = handler;
+}
+
+bool CommandBus::post(BusCommandType type, int32_t arg, const char* path, TickType_t wait) {
+    if (!_queue) return false;
+
+    BusCommand cmd;
+    cmd.type = type;
+    cmd.arg = arg;
+    cmd.path[0] = '\0';
+    if (path) strlcpy(cmd.path, path, sizeof(cmd.path));
+    cmd.postedUs = micros();
+
+    if (xQueueSend(_queue, &cmd, wait) != pdTRUE) {
+        _rejected++;
+        LOG_BUS_F("Queue full, rejected command %d", type);
+        return false;
+    }
+    return true;
+}
+
+bool CommandBus::postCoalesced(BusCommandType type, int32_t arg) {
+    portENTER_CRITICAL(&_mux);
+    if (!_coalescedPending[type]) {
+        _coalescedPending[type] = true;
+        _coalescedSince[type] = millis();
+        _coalesced[type].postedUs = micros();
+    }
+    _coalesced[type].type = type;
+    _coalesced[type].arg = arg;
+    _coalesced[type].path[0] = '\0';
+    portEXIT_CRITICAL(&_mux);
+    return true;
+}
+
+bool CommandBus::postVolume(int volume) {
+    return postCoalesced(CMD_AUDIO_VOLUME, volume);
+}
+
+bool CommandBus::postLedColor(uint8_t r, uint8_t g, uint8_t b) {
+    return postCoalesced(CMD_LED_COLOR, (r << 16) | (g << 8) | b);
+}
+
+void CommandBus::dispatch() {
+    if (!_queue) return;
+
+    BusCommand cmd;
+    while (xQueueReceive(_queue, &cmd, 0) == pdTRUE) {
+        execute(cmd);
+    }
+
+    for (uint8_t type = 0; type < CMD_COUNT; type++) {
+        if (!_coalescedPending[type]) continue;
+        bool ready = false;
+        portENTER_CRITICAL(&_mux);
+        if (_coalescedPending[type] && millis() - _coalescedSince[type] >= BUS_COALESCE_HOLD_MS) {
+            cmd = _coalesced[type];
+            _coalescedPending[type] = false;
+            ready = true;
+        }
+        portEXIT_CRITICAL(&_mux);
+        if (ready) execute(cmd);
+    }
+}
+
+void CommandBus::execute(const BusCommand& cmd) {
+    if (_handler) _handler(cmd);
+
+    uint32_t latency = micros() - cmd.postedUs;
+    _executed++;
+    if (latency > _maxLatencyUs) _maxLatencyUs = latency;
+    _avgLatencyUs = _avgLatencyUs ? (_avgLatencyUs * 7 + latency) / 8 : latency;
+    if (latency > BUS_SLOW_LATENCY_US) {
+        LOG_BUS_F("Command %d took %u us from post to done", cmd.type, (unsigned)latency);
+    }
+}
+
+uint32_t CommandBus::getExecuted() {
+    return _executed;
+}
+
+uint32_t CommandBus::getRejected() {
+    return _rejected;
+}
+
+uint32_t CommandBus::getMaxLatencyUs() {
+    return _maxLatencyUs;
+}
+
+uint32_t CommandBus::getAvgLatencyUs() {
+    return _avgLatencyUs;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#define BUS_QUEUE_DEPTH      16
+#define BUS_PATH_LEN         48
+#define BUS_COALESCE_HOLD_MS 50
+
+enum BusCommandType : uint8_t {
+    CMD_AUDIO_PLAY_FILE,
+    CMD_AUDIO_PLAY_FOLDER,
+    CMD_AUDIO_PLAY_CUE,
+    CMD_AUDIO_PLAY_STREAM,
+    CMD_AUDIO_STOP,
+    CMD_AUDIO_TOGGLE_PAUSE,
+    CMD_AUDIO_PAUSE,
+    CMD_AUDIO_RESUME,
+    CMD_AUDIO_NEXT,
+    CMD_AUDIO_VOLUME,
+    CMD_AUDIO_VOLUME_STEP,
+    CMD_AUDIO_SPEED,
+    CMD_LED_COLOR,
+    CMD_LED_LOADING,
+    CMD_LED_BLINK_ERROR,
+    CMD_COUNT
+};
+
+struct BusCommand {
+    BusCommandType type;
+    int32_t arg;
+    char path[BUS_PATH_LEN];
+    uint32_t postedUs;
+};
+
+typedef std::function<void(const BusCommand&)> BusHandler;
+
+// Bounded multi-producer queue feeding the task that owns AudioManager and
+// LedController. post() is safe from any task; dispatch() runs only on the
+// owner. Volume and LED colour are coalesced: only the latest value runs.
+class CommandBus {
+public:
+    void begin();
+    void onCommand(BusHandler handler);
+
+    bool post(BusCommandType type, int32_t arg = 0, const char* path = nullptr, TickType_t wait = 0);
+    bool postVolume(int volume);
+    bool postLedColor(uint8_t r, uint8_t g, uint8_t b);
+
+    void dispatch();
+
+    uint32_t getExecuted();
+    uint32_t getRejected();
+    uint32_t getMaxLatencyUs();
+    uint32_t getAvgLatencyUs();
+
+private:
+    QueueHandle_t _queue = nullptr;
+    BusHandler _handler;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    BusCommand _coalesced[CMD_COUNT];
+    bool _coalescedPending[CMD_COUNT] = {};
+    unsigned long _coalescedSince[CMD_COUNT] = {};
+
+    uint32_t _executed = 0;
+    volatile uint32_t _rejected = 0;
+    uint32_t _maxLatencyUs = 0;
+    uint32_t _avgLatencyUs = 0;
+
+    bool postCoalesced(BusCommandType type, int32_t arg);
+    void execute(const BusCommand& cmd);
+};
@@ -0,0 +1,383 @@
+#include "ContentSync.h"
+#include <rom/crc.h>
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_SYNC 1
+#if DEBUG_SYNC
+    #define LOG_SYNC(msg) Serial.println("[SYNC] " msg)
+    #define LOG_SYNC_F(fmt, ...) Serial.printf("[SYNC] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_SYNC(msg)
+    #define LOG_SYNC_F(fmt, ...)
+#endif
+
+#define SYNC_SETTLE_MS  2000
+#define SYNC_SESSION_MS 10000
+
+static const char* const STATUS_NAMES[] = {
+    "ok", "done", "bad_path", "bad_offset", "bad_chunk", "bad_file", "io_error"
+};
+
+const char* ContentSync::statusName(SyncStatus status) {
+    return status <= SYNC_IO_ERROR ? STATUS_NAMES[status] : "?";
+}
+
+bool ContentSync::begin() {
+    if (!_block) _block = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, SYNC_HASH_BLOCK, MEM_WEB);
+    if (!_chunk) _chunk = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, SYNC_CHUNK_MAX, MEM_WEB);
+    // _block belongs to the hasher on the main task; part files are opened
+    // on the AsyncTCP task.
+    if (!_partBlock) _partBlock = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, SYNC_HASH_BLOCK, MEM_WEB);
+    if (!_lock) _lock = xSemaphoreCreateMutex();
+    return _block && _chunk && _partBlock && _lock;
+}
+
+bool ContentSync::validPath(const char* path) {
+    size_t len = strlen(path);
+    return strncmp(path, DIR_TALES "/", sizeof(DIR_TALES)) == 0 && len + 6 < SYNC_PATH_LEN &&
+           !strstr(path, "..") && !strstr(path, "//") && path[len - 1] != '/';
+}
+
+void ContentSync::makeParents(const char* path) {
+    char dir[SYNC_PATH_LEN];
+    for (const char* p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+        size_t len = p - path;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        if (!SD.exists(dir)) SD.mkdir(dir);
+    }
+}
+
+void ContentSync::loadCache() {
+    _cache.clear();
+    File file = SD.open(SYNC_MANIFEST_FILE);
+    if (!file) return;
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        unsigned crc, size, mtime;
+        int pathAt = 0;
+        if (sscanf(line.c_str(), "%8x %u %u %n", &crc, &size, &mtime, &pathAt) != 3 || !pathAt) continue;
+        _cache.push_back({ line.substring(pathAt), size, mtime, crc, true });
+    }
+    file.close();
+}
+
+void ContentSync::scan(const String& dir) {
+    File root = SD.open(dir);
+    if (!root) return;
+    File file = root.openNextFile();
+    while (file) {
+        String path = dir + "/" + file.name();
+        if (file.isDirectory()) {
+            file.close();
+            scan(path);
+        } else if (!path.endsWith(".part") && !path.endsWith(".pcrc") && !path.endsWith(".done")) {
+            _entries.push_back({ path, (uint32_t)file.size(), (uint32_t)file.getLastWrite(), 0, false });
+            file.close();
+        } else {
+            file.close();
+        }
+        file = root.openNextFile();
+    }
+    root.close();
+}
+
+void ContentSync::queue(const char* path, uint32_t size, uint32_t crc, bool remove) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _finished.push_back({ String(path), size, crc, remove });
+    xSemaphoreGive(_lock);
+    _ready = false;
+    _changed = true;
+}
+
+// Only the newest action per path counts: a file uploaded twice in one
+// sync has a single part file, installed once.
+void ContentSync::applyFinished(std::vector<Finished>& finished) {
+    char part[SYNC_PATH_LEN];
+    for (size_t i = 0; i < finished.size(); i++) {
+        const Finished& f = finished[i];
+        bool superseded = false;
+        for (size_t j = i + 1; j < finished.size() && !superseded; j++) superseded = finished[j].path == f.path;
+        if (superseded) continue;
+        SD.remove(f.path.c_str());
+        if (f.remove) continue;
+        snprintf(part, sizeof(part), "%s.done", f.path.c_str());
+        if (!SD.rename(part, f.path.c_str())) LOG_SYNC_F("Could not install %s", f.path.c_str());
+    }
+}
+
+// Lists the library and takes every CRC it can from the cache or from
+// uploads that just finished; loop() hashes the rest.
+void ContentSync::refresh() {
+    if (!_block) return;
+    if (_hashFile) _hashFile.close();
+    if (_cache.empty()) loadCache();
+
+    std::vector<Finished> finished;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    finished.swap(_finished);
+    xSemaphoreGive(_lock);
+    applyFinished(finished);
+
+    _entries.clear();
+    scan(DIR_TALES);
+    uint32_t reused = 0;
+    for (auto& e : _entries) {
+        for (auto f = finished.rbegin(); f != finished.rend(); ++f) {
+            if (f->path != e.path) continue;
+            if (!f->remove && f->size == e.size) {
+                e.crc = f->crc;
+                e.hashed = true;
+            }
+            break;
+        }
+        if (e.hashed) continue;
+        for (const auto& c : _cache) {
+            if (c.size == e.size && c.mtime == e.mtime && c.path == e.path) {
+                e.crc = c.crc;
+                e.hashed = true;
+                reused++;
+                break;
+            }
+        }
+    }
+    _next = 0;
+    _fileCount = _entries.size();
+    _hashedCount = 0;
+    for (const auto& e : _entries) _hashedCount += e.hashed;
+    _ready = false;
+    _scanning = true;
+    LOG_SYNC_F("Manifest: %u files, %u cached", (unsigned)_entries.size(), (unsigned)reused);
+}
+
+bool ContentSync::hashStep(unsigned long deadline) {
+    while ((long)(deadline - millis()) > 0) {
+        while (_next < _entries.size() && _entries[_next].hashed) _next++;
+        if (_next >= _entries.size()) return true;
+
+        Entry& e = _entries[_next];
+        if (!_hashFile) {
+            _hashFile = SD.open(e.path);
+            _hashCrc = 0;
+            if (!_hashFile) {
+                e.hashed = true;
+                _hashedCount++;
+                continue;
+            }
+        }
+        int n = _hashFile.read(_block, SYNC_HASH_BLOCK);
+        if (n > 0) {
+            _hashCrc = crc32_le(_hashCrc, _block, n);
+        } else {
+            _hashFile.close();
+            e.crc = _hashCrc;
+            e.hashed = true;
+            _hashedCount++;
+        }
+    }
+    return false;
+}
+
+void ContentSync::writeManifest() {
+    if (!SD.exists("/system")) SD.mkdir("/system");
+    File file = SD.open(SYNC_MANIFEST_TMP, FILE_WRITE);
+    if (!file) return;
+    for (const auto& e : _entries) {
+        file.printf("%08x %u %u %s\n", (unsigned)e.crc, (unsigned)e.size, (unsigned)e.mtime, e.path.c_str());
+    }
+    file.close();
+    SD.remove(SYNC_MANIFEST_FILE);
+    SD.rename(SYNC_MANIFEST_TMP, SYNC_MANIFEST_FILE);
+}
+
+void ContentSync::loop() {
+    if (!_block) return;
+    if (_changed && millis() - _lastTransfer > SYNC_SETTLE_MS) {
+        _changed = false;
+        LOG_SYNC_F("Sync: %u files, %u bytes in %lu ms", _syncFiles, (unsigned)_syncBytes, _lastTransfer - _syncStart);
+        refresh();
+    }
+    if (!_scanning) return;
+    if (!hashStep(millis() + SYNC_HASH_BUDGET_MS)) return;
+    writeManifest();
+    _cache = _entries;
+    _scanning = false;
+    _ready = !_changed;
+    LOG_SYNC_F("Manifest ready: %u files", (unsigned)_entries.size());
+}
+
+// Restores the running state of a part file left by an earlier connection
+// (or boot), so any transfer can pick up where it stopped.
+bool ContentSync::openPart(const char* path) {
+    if (strcmp(_partPath, path) == 0) return true;
+    char part[SYNC_PATH_LEN];
+    snprintf(part, sizeof(part), "%s.part", path);
+    _partSize = 0;
+    _partCrc = 0;
+    File file = SD.open(part);
+    if (file) {
+        uint32_t size = file.size();
+        uint32_t saved[2] = { 0, 0 };
+        snprintf(part, sizeof(part), "%s.pcrc", path);
+        File crcFile = SD.open(part);
+        if (crcFile) {
+            if (crcFile.read((uint8_t*)saved, sizeof(saved)) != sizeof(saved)) saved[0] = 0;
+            crcFile.close();
+        }
+        if (size && saved[0] == size) {
+            _partSize = size;
+            _partCrc = saved[1];
+        } else {
+            // No CRC for this size, e.g. power was lost between the two
+            // writes of a chunk: hash the part once.
+            int n;
+            while ((n = file.read(_partBlock, SYNC_HASH_BLOCK)) > 0) {
+                _partCrc = crc32_le(_partCrc, _partBlock, n);
+                _partSize += n;
+            }
+        }
+        file.close();
+    }
+    snprintf(_partPath, sizeof(_partPath), "%s", path);
+    return true;
+}
+
+void ContentSync::savePartCrc(const char* path) {
+    char name[SYNC_PATH_LEN];
+    snprintf(name, sizeof(name), "%s.pcrc", path);
+    File file = SD.open(name, FILE_WRITE);
+    if (!file) return;
+    uint32_t saved[2] = { _partSize, _partCrc };
+    file.write((const uint8_t*)saved, sizeof(saved));
+    file.close();
+}
+
+uint32_t ContentSync::partOffset(const char* path) {
+    if (!validPath(path)) return 0;
+    if (strcmp(_partPath, path) == 0) return _partSize;
+    char part[SYNC_PATH_LEN];
+    snprintf(part, sizeof(part), "%s.part", path);
+    File file = SD.open(part);
+    if (!file) return 0;
+    uint32_t size = file.size();
+    file.close();
+    return size;
+}
+
+// One chunk upload at a time: the body is buffered until the request
+// completes and commitChunk() has checked it.
+bool ContentSync::chunkData(const uint8_t* data, size_t len, size_t index, size_t total) {
+    if (index == 0) {
+        _chunkLen = 0;
+        _chunkOk = _chunk && total <= SYNC_CHUNK_MAX;
+    }
+    if (!_chunkOk || index + len > SYNC_CHUNK_MAX) {
+        _chunkOk = false;
+        return false;
+    }
+    memcpy(_chunk + index, data, len);
+    _chunkLen = index + len;
+    return true;
+}
+
+// Forgets a chunk whose request went away before commitChunk().
+void ContentSync::dropChunk() {
+    _chunkLen = 0;
+    _chunkOk = false;
+}
+
+SyncStatus ContentSync::commitChunk(const char* path, uint32_t size, uint32_t crc, uint32_t offset, uint32_t chunkCrc) {
+    if (!validPath(path)) return SYNC_BAD_PATH;
+    size_t len = _chunkOk ? _chunkLen : 0;
+    _chunkOk = false;
+    if (!_chunk || crc32_le(0, _chunk, len) != chunkCrc) return SYNC_BAD_CHUNK;
+
+    openPart(path);
+    if (offset != _partSize) return SYNC_BAD_OFFSET;
+    if (offset + len > size) return SYNC_BAD_CHUNK;
+
+    beginTransfer();
+
+    char part[SYNC_PATH_LEN];
+    char partCrc[SYNC_PATH_LEN];
+    snprintf(part, sizeof(part), "%s.part", path);
+    snprintf(partCrc, sizeof(partCrc), "%s.pcrc", path);
+    if (offset == 0) {
+        makeParents(path);
+        SD.remove(part);
+        SD.remove(partCrc);
+    }
+    File file = SD.open(part, FILE_APPEND);
+    if (!file) return SYNC_IO_ERROR;
+    size_t written = len ? file.write(_chunk, len) : 0;
+    file.close();
+    if (written != len) {
+        _partPath[0] = '\0';
+        return SYNC_IO_ERROR;
+    }
+    _partSize += len;
+    _partCrc = crc32_le(_partCrc, _chunk, len);
+    _syncBytes += len;
+    if (_partSize < size) {
+        savePartCrc(path);
+        return SYNC_OK;
+    }
+
+    uint32_t fileCrc = _partCrc;
+    _partPath[0] = '\0';
+    if (fileCrc != crc) {
+        SD.remove(part);
+        SD.remove(partCrc);
+        LOG_SYNC_F("%s: CRC %08x, expected %08x", path, (unsigned)fileCrc, (unsigned)crc);
+        return SYNC_BAD_FILE;
+    }
+    return finishPart(path, size, crc);
+}
+
+SyncStatus ContentSync::installPart(const char* path, uint32_t size, uint32_t crc) {
+    if (!validPath(path)) return SYNC_BAD_PATH;
+    beginTransfer();
+    _syncBytes += size;
+    return finishPart(path, size, crc);
+}
+
+void ContentSync::beginTransfer() {
+    if (millis() - _lastTransfer > SYNC_SESSION_MS) {
+        _syncStart = millis();
+        _syncBytes = 0;
+        _syncFiles = 0;
+    }
+    _lastTransfer = millis();
+}
+
+// Verified files wait as "<path>.done" for the main task to install, so
+// a new upload of the same path can start its own part file meanwhile.
+SyncStatus ContentSync::finishPart(const char* path, uint32_t size, uint32_t crc) {
+    char part[SYNC_PATH_LEN];
+    char done[SYNC_PATH_LEN];
+    snprintf(part, sizeof(part), "%s.part", path);
+    snprintf(done, sizeof(done), "%s.done", path);
+    SD.remove(done);
+    if (!SD.rename(part, done)) return SYNC_IO_ERROR;
+    snprintf(part, sizeof(part), "%s.pcrc", path);
+    SD.remove(part);
+    queue(path, size, crc, false);
+    _syncFiles++;
+    return SYNC_DONE;
+}
+
+SyncStatus ContentSync::remove(const char* path) {
+    if (!validPath(path)) return SYNC_BAD_PATH;
+    _lastTransfer = millis();
+    queue(path, 0, 0, true);
+    return SYNC_DONE;
+}
+
+size_t ContentSync::writeJson(char* buffer, size_t size) {
+    uint16_t files = _fileCount;
+    uint16_t hashed = _hashedCount;
+    int n = snprintf(buffer, size, "{\"ready\":%s,\"files\":%u,\"hashed\":%u,\"syncFiles\":%u,\"syncBytes\":%u}",
+                     _ready ? "true" : "false", files, hashed < files ? hashed : files, _syncFiles,
+                     (unsigned)_syncBytes);
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+
+#define SYNC_MANIFEST_FILE   "/system/manifest.idx"
+#define SYNC_MANIFEST_TMP    "/system/manifest.tmp"
+#define SYNC_CHUNK_MAX       32768
+#define SYNC_HASH_BUDGET_MS  15
+#define SYNC_HASH_BLOCK      4096
+#define SYNC_PATH_LEN        96
+
+enum SyncStatus : uint8_t {
+    SYNC_OK,
+    SYNC_DONE,
+    SYNC_BAD_PATH,
+    SYNC_BAD_OFFSET,
+    SYNC_BAD_CHUNK,
+    SYNC_BAD_FILE,
+    SYNC_IO_ERROR
+};
+
+// Delta sync of the tale library. The device keeps a manifest of every
+// file under DIR_TALES, one "<crc32> <size> <mtime> <path>" line each.
+// CRCs are cached on SD and only recomputed for files whose size or mtime
+// changed, a few milliseconds per loop() so the portal stays responsive.
+// The manifest CRC is the standard (zlib) CRC-32.
+//
+// A client compares the manifest with its copy and uploads only what is
+// missing or different, in chunks. Each chunk carries its own CRC and the
+// offset it starts at. A chunk is appended to "<path>.part" only when both
+// check out, so a dropped connection resumes from the part file's size.
+// The running CRC is saved next to it in "<path>.pcrc", so resuming does
+// not reread the part. The last chunk also checks the CRC of the whole file.
+//
+// Chunk bodies arrive on the AsyncTCP task, which only ever touches part
+// files. Finished files and deletions are queued, and the main task (the
+// one that plays tales and hashes the library) applies them once transfers
+// settle, then rebuilds the manifest using the uploaded CRCs rather than
+// reading the files again.
+class ContentSync {
+public:
+    bool begin();
+    void refresh();
+    void loop();
+    bool isReady() const { return _ready; }
+
+    // AsyncTCP side.
+    uint32_t partOffset(const char* path);
+    bool chunkData(const uint8_t* data, size_t len, size_t index, size_t total);
+    void dropChunk();
+    SyncStatus commitChunk(const char* path, uint32_t size, uint32_t crc, uint32_t offset, uint32_t chunkCrc);
+    SyncStatus remove(const char* path);
+    // Queues a complete, verified "<path>.part" written by another producer
+    // (archive extraction) the same way as the last chunk of an upload.
+    SyncStatus installPart(const char* path, uint32_t size, uint32_t crc);
+    size_t writeJson(char* buffer, size_t size);
+    static const char* statusName(SyncStatus status);
+    static bool validPath(const char* path);
+    static void makeParents(const char* path);
+
+private:
+    struct Entry {
+        String path;
+        uint32_t size;
+        uint32_t mtime;
+        uint32_t crc;
+        bool hashed;
+    };
+    struct Finished {
+        String path;
+        uint32_t size;
+        uint32_t crc;
+        bool remove;
+    };
+    std::vector<Entry> _entries;
+    std::vector<Entry> _cache;
+    size_t _next = 0;
+    volatile uint16_t _fileCount = 0;
+    volatile uint16_t _hashedCount = 0;
+    volatile bool _ready = false;
+    bool _scanning = false;
+    File _hashFile;
+    uint32_t _hashCrc = 0;
+    uint8_t* _block = nullptr;
+
+    uint8_t* _chunk = nullptr;
+    size_t _chunkLen = 0;
+    bool _chunkOk = false;
+
+    char _partPath[SYNC_PATH_LEN] = "";
+    uint32_t _partSize = 0;
+    uint32_t _partCrc = 0;
+    uint8_t* _partBlock = nullptr;
+
+    std::vector<Finished> _finished;
+    SemaphoreHandle_t _lock = nullptr;
+    volatile bool _changed = false;
+
+    unsigned long _syncStart = 0;
+    uint32_t _syncBytes = 0;
+    uint16_t _syncFiles = 0;
+    unsigned long _lastTransfer = 0;
+
+    void queue(const char* path, uint32_t size, uint32_t crc, bool remove);
+    void applyFinished(std::vector<Finished>& finished);
+    void loadCache();
+    void scan(const String& dir);
+    bool hashStep(unsigned long deadline);
+    void writeManifest();
+    bool openPart(const char* path);
+    void savePartCrc(const char* path);
+    void beginTransfer();
+    SyncStatus finishPart(const char* path, uint32_t size, uint32_t crc);
+};
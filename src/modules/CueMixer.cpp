@@ -0,0 +1,187 @@
+#include "CueMixer.h"
+#include "../utils/MemoryArena.h"
+#include "../utils/WavHeader.h"
+
+#define DEBUG_CUE 1
+
+#if DEBUG_CUE
+    #define LOG_CUE(msg) Serial.println("[CUE] " msg)
+    #define LOG_CUE_F(fmt, ...) Serial.printf("[CUE] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_CUE(msg)
+    #define LOG_CUE_F(fmt, ...)
+#endif
+
+static inline int16_t ulawDecode(uint8_t u) {
+    u = ~u;
+    int32_t sample = ((((int32_t)u & 0x0F) << 3) + 0x84) << ((u >> 4) & 0x07);
+    sample -= 0x84;
+    return (int16_t)((u & 0x80) ? -sample : sample);
+}
+
+int CueMixer::find(const char* path) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (strcmp(_cues[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+bool CueMixer::has(const char* path) {
+    return find(path) >= 0;
+}
+
+bool CueMixer::loadEmbedded(const EmbeddedAsset* asset) {
+    if (!asset || asset->type != EMBED_CUE_ULAW || has(asset->path)) return false;
+    if (_count >= CUE_MAX_SLOTS || strlen(asset->path) >= CUE_PATH_LEN) return false;
+
+    Cue& cue = _cues[_count++];
+    strcpy(cue.path, asset->path);
+    cue.pcm = nullptr;
+    cue.ulaw = asset->data;
+    cue.frames = asset->size;
+    cue.rate = asset->rate;
+    LOG_CUE_F("Embedded %s: %u frames @ %u Hz", asset->path, (unsigned)cue.frames, (unsigned)cue.rate);
+    return true;
+}
+
+bool CueMixer::load(const char* path) {
+    int existing = find(path);
+    if (existing >= 0 && _cues[existing].pcm) return true;
+    if (existing < 0 && (_count >= CUE_MAX_SLOTS || strlen(path) >= CUE_PATH_LEN)) return false;
+
+    File file = SD.open(path);
+    if (!file) return false;
+
+    WavInfo info;
+    if (!WavHeader::read(file, info)) {
+        LOG_CUE_F("Not a WAV file: %s", path);
+        file.close();
+        return false;
+    }
+
+    uint16_t channels = info.channels;
+    uint32_t rate = info.sampleRate;
+    uint32_t dataBytes = info.dataBytes;
+    if (info.format != WAV_FORMAT_PCM || info.bitsPerSample != 16 || (channels != 1 && channels != 2) || rate == 0 || dataBytes == 0) {
+        LOG_CUE_F("Unsupported WAV (fmt=%u ch=%u bits=%u): %s", info.format, channels, info.bitsPerSample, path);
+        file.close();
+        return false;
+    }
+
+    uint32_t frames = dataBytes / (2 * channels);
+    if (frames * 2 > CUE_MAX_BYTES) frames = CUE_MAX_BYTES / 2;
+
+    int16_t* pcm = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, frames * sizeof(int16_t), MEM_CUE);
+    if (!pcm) {
+        LOG_CUE_F("PSRAM allocation failed for %s", path);
+        file.close();
+        return false;
+    }
+
+    int16_t block[256];
+    uint32_t done = 0;
+    while (done < frames) {
+        uint32_t want = min((uint32_t)(256 / channels), frames - done);
+        int got = file.read((uint8_t*)block, want * channels * 2) / (channels * 2);
+        if (got <= 0) break;
+        for (int i = 0; i < got; i++) {
+            pcm[done + i] = (channels == 2) ? (int16_t)(((int32_t)block[2 * i] + block[2 * i + 1]) / 2) : block[i];
+        }
+        done += got;
+    }
+    file.close();
+
+    // An embedded cue is replaced in place; only stop it if it is playing.
+    if (existing >= 0 && _active == existing) _active = -1;
+    Cue& cue = existing >= 0 ? _cues[existing] : _cues[_count++];
+    strcpy(cue.path, path);
+    cue.frames = done;
+    cue.rate = rate;
+    cue.ulaw = nullptr;
+    cue.pcm = pcm;
+    LOG_CUE_F("Loaded %s: %u frames @ %u Hz", path, (unsigned)done, (unsigned)rate);
+    return true;
+}
+
+bool CueMixer::play(const char* path) {
+    int idx = find(path);
+    if (idx < 0) return false;
+    _active = -1;
+    _pos = 0;
+    _active = idx;
+    updateStep();
+    return true;
+}
+
+void CueMixer::stop() {
+    _active = -1;
+}
+
+bool CueMixer::isActive() {
+    return _active >= 0;
+}
+
+uint32_t CueMixer::activeRate() {
+    int8_t idx = _active;
+    return idx >= 0 ? _cues[idx].rate : _outRate;
+}
+
+void CueMixer::setOutputRate(uint32_t rate) {
+    if (rate == 0 || rate == _outRate) return;
+    _outRate = rate;
+    updateStep();
+}
+
+void CueMixer::setLevel(uint16_t levelQ8) {
+    _level = levelQ8;
+}
+
+void CueMixer::updateStep() {
+    int8_t idx = _active;
+    if (idx < 0) return;
+    _step = (uint32_t)(((uint64_t)_cues[idx].rate << 16) / _outRate);
+}
+
+// The decoder halves its samples for filter headroom, cues follow suit.
+int32_t CueMixer::nextSample() {
+    int8_t idx = _active;
+    if (idx < 0) return 0;
+    const Cue& cue = _cues[idx];
+    uint32_t frame = _pos >> 16;
+    if (frame >= cue.frames) {
+        _active = -1;
+        return 0;
+    }
+    _pos += _step;
+    int32_t s = cue.pcm ? cue.pcm[frame] : ulawDecode(cue.ulaw[frame]);
+    return (s * _level) >> 9;
+}
+
+void CueMixer::mix(int16_t* frame) {
+    int32_t target = (_active >= 0) ? CUE_DUCK_Q15 : 32768;
+    if (_duck > target) {
+        _duck -= CUE_DUCK_ATTACK;
+        if (_duck < target) _duck = target;
+    } else if (_duck < target) {
+        _duck += CUE_DUCK_RELEASE;
+        if (_duck > target) _duck = target;
+    }
+    if (_duck == 32768 && _active < 0) return;
+
+    int32_t cue = nextSample();
+    for (int ch = 0; ch < 2; ch++) {
+        int32_t v = (((int32_t)frame[ch] * _duck) >> 15) + cue;
+        frame[ch] = (int16_t)constrain(v, -32768, 32767);
+    }
+}
+
+size_t CueMixer::render(int16_t* frames, size_t count) {
+    size_t n = 0;
+    while (n < count && _active >= 0) {
+        int32_t s = nextSample();
+        frames[2 * n] = (int16_t)s;
+        frames[2 * n + 1] = (int16_t)s;
+        n++;
+    }
+    return n;
+}
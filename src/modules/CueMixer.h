@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "EmbeddedAssets.h"
+
+#define CUE_MAX_SLOTS     12
+#define CUE_MAX_BYTES     (256 * 1024)
+#define CUE_PATH_LEN      48
+
+// Ducking levels are Q15 gains applied to the story while a cue plays.
+#define CUE_DUCK_Q15      9830
+#define CUE_DUCK_ATTACK   52
+#define CUE_DUCK_RELEASE  4
+
+// Short system sounds held as mono PCM in PSRAM and mixed on top of the
+// decoder output, so a cue never stops or restarts the current story.
+// Embedded fallback cues are played as mu-law straight from flash until
+// the SD copy is loaded over them.
+class CueMixer {
+public:
+    bool load(const char* path);
+    bool loadEmbedded(const EmbeddedAsset* asset);
+    bool has(const char* path);
+    bool play(const char* path);
+    void stop();
+    bool isActive();
+
+    void setOutputRate(uint32_t rate);
+    void setLevel(uint16_t levelQ8);
+
+    // Mixes one stereo frame in place (story ducked, cue added).
+    void mix(int16_t* frame);
+    // Renders stereo frames when no story is running. Returns frames written.
+    size_t render(int16_t* frames, size_t count);
+    uint32_t activeRate();
+
+private:
+    struct Cue {
+        char path[CUE_PATH_LEN];
+        int16_t* pcm;
+        const uint8_t* ulaw;
+        uint32_t frames;
+        uint32_t rate;
+    };
+
+    Cue _cues[CUE_MAX_SLOTS];
+    uint8_t _count = 0;
+    volatile int8_t _active = -1;
+    uint32_t _pos = 0;
+    uint32_t _step = 1 << 16;
+    uint32_t _outRate = 44100;
+    uint16_t _level = 256;
+    int32_t _duck = 32768;
+
+    int find(const char* path);
+    int32_t nextSample();
+    void updateStep();
+};
@@ -0,0 +1,166 @@
+#include "DmaTuner.h"
+#include <driver/i2s.h>
+
+#define DEBUG_DMA 1
+#if DEBUG_DMA
+    #define LOG_DMA(msg) Serial.println("[DMA] " msg)
+    #define LOG_DMA_F(fmt, ...) Serial.printf("[DMA] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_DMA(msg)
+    #define LOG_DMA_F(fmt, ...)
+#endif
+
+// Starting points: decoder playback from SD needs little, WiFi interrupts
+// and the AsyncTCP task add jitter, A2DP packets arrive in bursts.
+static const DmaProfile DEFAULT_PROFILES[DMA_MODE_COUNT] = {
+    { 6, 512 },
+    { 10, 512 },
+    { 8, 256 },
+};
+static const char* const PROFILE_KEYS[DMA_MODE_COUNT] = { "dma_sd", "dma_wifi", "dma_bt" };
+
+const char* DmaTuner::modeName(DmaMode mode) {
+    static const char* const NAMES[DMA_MODE_COUNT] = { "sd", "wifi", "a2dp" };
+    return mode < DMA_MODE_COUNT ? NAMES[mode] : "?";
+}
+
+void DmaTuner::begin(Preferences* prefs) {
+    _prefs = prefs;
+    for (uint8_t m = 0; m < DMA_MODE_COUNT; m++) {
+        _profiles[m] = DEFAULT_PROFILES[m];
+        uint32_t stored = _prefs ? _prefs->getUInt(PROFILE_KEYS[m], 0) : 0;
+        uint8_t count = stored >> 16;
+        uint16_t len = stored & 0xFFFF;
+        if (count >= DMA_MIN_COUNT && count <= DMA_MAX_COUNT && len >= 64 && len <= 1024) {
+            _profiles[m] = { count, len };
+        }
+        LOG_DMA_F("Profile %s: %u x %u frames", modeName((DmaMode)m), _profiles[m].count, _profiles[m].len);
+    }
+}
+
+void DmaTuner::save(DmaMode mode) {
+    if (!_prefs) return;
+    _prefs->putUInt(PROFILE_KEYS[mode], ((uint32_t)_profiles[mode].count << 16) | _profiles[mode].len);
+}
+
+uint8_t DmaTuner::maxCount(uint16_t len) const {
+    uint32_t count = (uint32_t)DMA_MAX_LATENCY_MS * (_rate ? _rate : 44100) / (1000UL * len);
+    if (count > DMA_MAX_COUNT) count = DMA_MAX_COUNT;
+    return count < DMA_MIN_COUNT ? DMA_MIN_COUNT : count;
+}
+
+void DmaTuner::startTrack(DmaMode mode, const DmaProfile& installed) {
+    _mode = mode;
+    _installed = installed;
+    _capacity = (uint32_t)installed.count * installed.len;
+    _tracking = true;
+    _activeMs = 0;
+    _activeSince = millis();
+    _graceSince = _activeSince;
+    _lastUs = micros();
+    _occupancy = 0;
+    _lowWater = _capacity;
+    _underruns = 0;
+    _dryFrames = 0;
+}
+
+void DmaTuner::setActive(bool active, uint32_t rate) {
+    if (rate) _rate = rate;
+    if (active == _active) return;
+    _active = active;
+    if (active) {
+        // The ring is refilled from empty after a pause; give it the same
+        // grace as a track start.
+        _activeSince = millis();
+        _graceSince = _activeSince;
+    } else {
+        _activeMs += millis() - _activeSince;
+    }
+}
+
+void DmaTuner::restart(QueueHandle_t events) {
+    if (events) xQueueReset(events);
+    _written.store(0, std::memory_order_relaxed);
+    _occupancy = 0;
+    _lastUs = micros();
+    _graceSince = millis();
+}
+
+// Runs even while inactive so the ring stays in step; only underruns and
+// the low water of active playback past the grace period are counted.
+void DmaTuner::poll(QueueHandle_t events) {
+    uint32_t now = micros();
+    uint32_t elapsed = now - _lastUs;
+    _lastUs = now;
+    _estimated = events == nullptr;
+    uint32_t played = 0;
+    if (events) {
+        i2s_event_t event;
+        while (xQueueReceive(events, &event, 0) == pdTRUE) {
+            if (event.type == I2S_EVENT_TX_DONE) played += _installed.len;
+        }
+    } else {
+        played = (uint64_t)elapsed * _rate / 1000000;
+    }
+    // The loop writes after it has been away, so the level before this
+    // pass's writes is the lowest it got.
+    int32_t low = _occupancy - (int32_t)played;
+    uint32_t dry = 0;
+    if (low < 0) {
+        dry = -low;
+        low = 0;
+    }
+    int32_t occupancy = low + (int32_t)_written.exchange(0, std::memory_order_relaxed);
+    if (occupancy > (int32_t)_capacity) {
+        // I2S takes no more than the ring holds, so with events this is
+        // played buffers that went unseen. The model only has a blocked writer.
+        if (events) dry += occupancy - _capacity;
+        occupancy = _capacity;
+    }
+    _occupancy = occupancy;
+    if (!_active || millis() - _graceSince < DMA_GRACE_MS) return;
+    if (dry) {
+        _underruns++;
+        _dryFrames += dry;
+    }
+    if (low < _lowWater) _lowWater = low;
+}
+
+bool DmaTuner::endTrack() {
+    if (!_tracking) return false;
+    _tracking = false;
+    uint32_t ms = activeMs();
+    if (ms < DMA_MIN_EVAL_MS || !_capacity || !_rate) return false;
+
+    DmaProfile& profile = _profiles[_mode];
+    DmaProfile before = profile;
+    uint32_t lowPct = (uint32_t)_lowWater * 100 / _capacity;
+    uint8_t limit = maxCount(_installed.len);
+
+    if (_underruns) {
+        _cleanTracks[_mode] = 0;
+        uint8_t step = _installed.count / 4 > 2 ? _installed.count / 4 : 2;
+        if (_installed.count < limit) {
+            profile.count = _installed.count + step < limit ? _installed.count + step : limit;
+            profile.len = _installed.len;
+        }
+    } else if (lowPct < 50) {
+        _cleanTracks[_mode] = 0;
+    } else if (++_cleanTracks[_mode] >= DMA_SHRINK_AFTER && _installed.count > DMA_MIN_COUNT) {
+        _cleanTracks[_mode] = 0;
+        profile.count = _installed.count - 1;
+        profile.len = _installed.len;
+    }
+
+    bool changed = profile.count != before.count || profile.len != before.len;
+    LOG_DMA_F("%s: %u x %u frames (%u ms), %u s played, %u underruns%s (%u ms dry), low water %u%%%s",
+              modeName(_mode), _installed.count, _installed.len,
+              (unsigned)((uint32_t)_installed.count * _installed.len * 1000 / _rate), (unsigned)(ms / 1000),
+              _underruns, _estimated ? " (estimated)" : "", (unsigned)((uint64_t)_dryFrames * 1000 / _rate), (unsigned)lowPct,
+              changed ? "" : ", profile kept");
+    if (changed) {
+        LOG_DMA_F("%s profile now %u x %u frames", modeName(_mode), profile.count, profile.len);
+        save(_mode);
+    }
+    return changed;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include <atomic>
+
+#define DMA_MIN_COUNT        3
+#define DMA_MAX_COUNT        24
+#define DMA_MAX_LATENCY_MS   250
+#define DMA_GRACE_MS         500
+#define DMA_MIN_EVAL_MS      10000
+#define DMA_BT_EVAL_MS       60000
+#define DMA_SHRINK_AFTER     3
+// TX_DONE events the driver keeps between two polls. More than the largest
+// ring, so a loop that stalled long enough to lose some also ran it dry.
+#define DMA_EVENT_QUEUE_LEN  64
+
+enum DmaMode : uint8_t {
+    DMA_MODE_SD,
+    DMA_MODE_WIFI,
+    DMA_MODE_A2DP,
+    DMA_MODE_COUNT
+};
+
+struct DmaProfile {
+    uint8_t count;
+    uint16_t len;
+};
+
+// Sizes the I2S DMA ring per output mode from what playback actually did.
+// Every frame I2S accepted is counted and the driver's TX_DONE events count
+// the buffers the DMA finished; written minus played is what the ring
+// holds. When more was played than written, the DMA sent a buffer nobody
+// filled (zeros, with tx_desc_auto_clear): an underrun. The A2DP library
+// installs its driver without an event queue, so there the ring is drained
+// at the sample rate instead, which is only an estimate and logged as one.
+//
+// Profiles are only changed between tracks (the driver has to be
+// reinstalled). Each track that underran adds buffers, up to
+// DMA_MAX_LATENCY_MS of audio. DMA_SHRINK_AFTER clean tracks in a row whose
+// ring never fell below half full give one buffer back. Profiles live in
+// NVS, so each mode starts from its last good setting.
+class DmaTuner {
+public:
+    void begin(Preferences* prefs);
+    DmaProfile profile(DmaMode mode) const { return _profiles[mode]; }
+
+    // Starts a measurement window with the ring that is now installed.
+    void startTrack(DmaMode mode, const DmaProfile& installed);
+    // Closes the window; true if the profile of its mode changed.
+    bool endTrack();
+    // Playback running (not paused or stopped) at `rate`; frames are only
+    // accounted while active.
+    void setActive(bool active, uint32_t rate);
+    bool isActive() const { return _active; }
+    uint32_t activeMs() const { return _activeMs + (_active ? millis() - _activeSince : 0); }
+
+    // Frames I2S accepted; safe from any task (A2DP calls it on its own).
+    inline void noteFrames(uint32_t frames) { _written.fetch_add(frames, std::memory_order_relaxed); }
+    // From the main loop: settles the frames written and the buffers played
+    // since the last call. `events` is the driver's queue, or nullptr.
+    void poll(QueueHandle_t events);
+    // The ring was zeroed or restarted; what it held will not play.
+    void restart(QueueHandle_t events);
+
+private:
+    Preferences* _prefs = nullptr;
+    DmaProfile _profiles[DMA_MODE_COUNT];
+    uint8_t _cleanTracks[DMA_MODE_COUNT] = {};
+
+    DmaMode _mode = DMA_MODE_SD;
+    bool _tracking = false;
+    DmaProfile _installed = { 0, 0 };
+    uint32_t _capacity = 0;
+    uint32_t _rate = 0;
+    bool _active = false;
+    unsigned long _activeSince = 0;
+    uint32_t _activeMs = 0;
+    unsigned long _graceSince = 0;
+    uint32_t _lastUs = 0;
+    std::atomic<uint32_t> _written{0};
+    int32_t _occupancy = 0;
+    int32_t _lowWater = 0;
+    uint16_t _underruns = 0;
+    uint32_t _dryFrames = 0;
+    bool _estimated = false;
+
+    uint8_t maxCount(uint16_t len) const;
+    void save(DmaMode mode);
+    static const char* modeName(DmaMode mode);
+};
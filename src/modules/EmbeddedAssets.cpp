@@ -0,0 +1,10 @@
+#include "EmbeddedAssets.h"
+#include <string.h>
+
+const EmbeddedAsset* findEmbeddedAsset(const char* path, EmbeddedAssetType type) {
+    for (size_t i = 0; i < EMBEDDED_ASSET_COUNT; i++) {
+        const EmbeddedAsset& asset = EMBEDDED_ASSETS[i];
+        if (asset.type == type && strcmp(asset.path, path) == 0) return &asset;
+    }
+    return nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+enum EmbeddedAssetType : uint8_t {
+    EMBED_CUE_ULAW,
+    EMBED_WEB_GZIP
+};
+
+// Generated by scripts/embed_assets.py from assets/embedded/. The data lives
+// in flash rodata and is read in place.
+struct EmbeddedAsset {
+    const char* path;
+    const uint8_t* data;
+    uint32_t size;
+    uint32_t rate;
+    EmbeddedAssetType type;
+};
+
+extern const EmbeddedAsset EMBEDDED_ASSETS[];
+extern const size_t EMBEDDED_ASSET_COUNT;
+
+const EmbeddedAsset* findEmbeddedAsset(const char* path, EmbeddedAssetType type);
@@ -0,0 +1,120 @@
+#include "ImaAdpcm.h"
+
+static const int16_t STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static inline int32_t clampIndex(int32_t index) {
+    return index < 0 ? 0 : (index > 88 ? 88 : index);
+}
+
+static inline int32_t clampSample(int32_t s) {
+    return s < -32768 ? -32768 : (s > 32767 ? 32767 : s);
+}
+
+uint16_t ImaAdpcm::blockAlign(uint16_t channels) {
+    return channels == 2 ? ADPCM_BLOCK_ALIGN_STEREO : ADPCM_BLOCK_ALIGN_MONO;
+}
+
+uint16_t ImaAdpcm::framesPerBlock(uint16_t blockAlign, uint16_t channels) {
+    return (blockAlign - 4 * channels) * 2 / channels + 1;
+}
+
+int16_t ImaAdpcm::decodeSample(ImaAdpcmChannel& ch, uint8_t nibble) {
+    int32_t step = STEP_TABLE[ch.index];
+    int32_t diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    ch.predictor = clampSample((nibble & 8) ? ch.predictor - diff : ch.predictor + diff);
+    ch.index = clampIndex(ch.index + INDEX_TABLE[nibble & 0x0F]);
+    return (int16_t)ch.predictor;
+}
+
+uint8_t ImaAdpcm::encodeSample(ImaAdpcmChannel& ch, int16_t sample) {
+    int32_t step = STEP_TABLE[ch.index];
+    int32_t diff = sample - ch.predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { nibble |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { nibble |= 1; }
+    // Track the decoder exactly so rounding errors do not accumulate.
+    decodeSample(ch, nibble);
+    return nibble;
+}
+
+void ImaAdpcm::encodeBlock(const int16_t* pcm, size_t frames, uint16_t channels,
+                           ImaAdpcmChannel* state, uint8_t* block, uint16_t blockAlign) {
+    size_t blockFrames = framesPerBlock(blockAlign, channels);
+    if (frames == 0) {
+        for (uint16_t i = 0; i < blockAlign; i++) block[i] = 0;
+        return;
+    }
+
+    for (uint16_t c = 0; c < channels; c++) {
+        state[c].predictor = pcm[c];
+        uint8_t* h = block + 4 * c;
+        h[0] = (uint8_t)(state[c].predictor & 0xFF);
+        h[1] = (uint8_t)((state[c].predictor >> 8) & 0xFF);
+        h[2] = (uint8_t)state[c].index;
+        h[3] = 0;
+    }
+
+    uint8_t* out = block + 4 * channels;
+    for (size_t f = 1; f < blockFrames; f += 8) {
+        for (uint16_t c = 0; c < channels; c++) {
+            for (int k = 0; k < 8; k += 2) {
+                size_t f0 = f + k;
+                size_t f1 = f + k + 1;
+                int16_t s0 = pcm[(f0 < frames ? f0 : frames - 1) * channels + c];
+                int16_t s1 = pcm[(f1 < frames ? f1 : frames - 1) * channels + c];
+                uint8_t lo = encodeSample(state[c], s0);
+                uint8_t hi = encodeSample(state[c], s1);
+                *out++ = lo | (hi << 4);
+            }
+        }
+    }
+}
+
+size_t ImaAdpcm::decodeBlock(const uint8_t* block, size_t blockBytes, uint16_t channels, int16_t* pcm) {
+    if (channels == 0 || channels > 2 || blockBytes < 4u * channels) return 0;
+
+    ImaAdpcmChannel state[2];
+    for (uint16_t c = 0; c < channels; c++) {
+        const uint8_t* h = block + 4 * c;
+        state[c].predictor = (int16_t)(h[0] | (h[1] << 8));
+        state[c].index = clampIndex(h[2]);
+        pcm[c] = (int16_t)state[c].predictor;
+    }
+
+    const uint8_t* in = block + 4 * channels;
+    const uint8_t* end = block + blockBytes;
+    size_t frame = 1;
+    while (in + 4 * channels <= end) {
+        for (uint16_t c = 0; c < channels; c++) {
+            for (int k = 0; k < 4; k++) {
+                uint8_t b = *in++;
+                pcm[(frame + 2 * k) * channels + c] = decodeSample(state[c], b & 0x0F);
+                pcm[(frame + 2 * k + 1) * channels + c] = decodeSample(state[c], b >> 4);
+            }
+        }
+        frame += 8;
+    }
+    return frame;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADPCM_BLOCK_ALIGN_MONO   512
+#define ADPCM_BLOCK_ALIGN_STEREO 1024
+#define ADPCM_MAX_BLOCK_ALIGN    ADPCM_BLOCK_ALIGN_STEREO
+#define ADPCM_MAX_BLOCK_FRAMES   1017
+
+struct ImaAdpcmChannel {
+    int32_t predictor;
+    int32_t index;
+};
+
+// IMA ADPCM in the Microsoft WAV block layout (format tag 0x11): per block a
+// 4-byte header per channel, then 4-byte groups of 8 nibbles per channel.
+// Pure integer code with no Arduino dependencies.
+class ImaAdpcm {
+public:
+    static uint16_t blockAlign(uint16_t channels);
+    static uint16_t framesPerBlock(uint16_t blockAlign, uint16_t channels);
+
+    // Encodes `frames` interleaved PCM16 frames (at most framesPerBlock) into
+    // one block. Short blocks are padded with the last sample.
+    static void encodeBlock(const int16_t* pcm, size_t frames, uint16_t channels,
+                            ImaAdpcmChannel* state, uint8_t* block, uint16_t blockAlign);
+    // Decodes one block into interleaved PCM16. Returns frames produced.
+    static size_t decodeBlock(const uint8_t* block, size_t blockBytes, uint16_t channels, int16_t* pcm);
+
+    static uint8_t encodeSample(ImaAdpcmChannel& ch, int16_t sample);
+    static int16_t decodeSample(ImaAdpcmChannel& ch, uint8_t nibble);
+};
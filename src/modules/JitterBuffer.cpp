@@ -0,0 +1,197 @@
+#include "JitterBuffer.h"
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_STREAM 1
+
+#if DEBUG_STREAM
+    #define LOG_STREAM(msg) Serial.println("[STREAM] " msg)
+    #define LOG_STREAM_F(fmt, ...) Serial.printf("[STREAM] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_STREAM(msg)
+    #define LOG_STREAM_F(fmt, ...)
+#endif
+
+#define RING_MASK (JITTER_CAPACITY_FRAMES - 1)
+
+bool JitterBuffer::begin() {
+    if (!_ring) _ring = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, JITTER_CAPACITY_FRAMES * 2 * sizeof(int16_t), MEM_AUDIO);
+    return _ring != nullptr;
+}
+
+// Runs on the network task while the audio loop may still be reading the
+// previous stream, so the tail is left alone: the new stream starts at the
+// current head and open() moves the tail there.
+void JitterBuffer::start(uint32_t sampleRate, uint8_t channels) {
+    _accepting = false;
+    _inRate = sampleRate;
+    _channels = channels == 2 ? 2 : 1;
+    _carryLen = 0;
+    _finished = false;
+    _startMs = millis();
+    _lastArrivalUs = 0;
+    _lastChunkUs = 0;
+    _jitterUs = 0;
+    _overflowFrames = 0;
+    _startHead = _head;
+    _started = true;
+    _accepting = _ring != nullptr && sampleRate > 0;
+    LOG_STREAM_F("Start: %u Hz, %u ch", (unsigned)sampleRate, _channels);
+}
+
+bool JitterBuffer::open() {
+    if (!_started || !_accepting) return false;
+    _started = false;
+    portENTER_CRITICAL(&_mux);
+    _tail = _startHead;
+    portEXIT_CRITICAL(&_mux);
+    _sampleRate = _inRate;
+    _buffering = true;
+    _floorMs = JITTER_MIN_MS;
+    _startupMs = 0;
+    _underruns = 0;
+    _open = true;
+    return true;
+}
+
+void JitterBuffer::writeFrame(uint32_t index, const uint8_t* frame) {
+    int16_t* dst = _ring + (index & RING_MASK) * 2;
+    dst[0] = (int16_t)(frame[0] | (frame[1] << 8));
+    dst[1] = _channels == 2 ? (int16_t)(frame[2] | (frame[3] << 8)) : dst[0];
+}
+
+// Each chunk's arrival is compared with how much audio the previous one
+// carried; the smoothed deviation is the jitter estimate.
+size_t JitterBuffer::push(const uint8_t* pcm, size_t len) {
+    if (!_accepting || _finished) return 0;
+    const size_t frameBytes = _channels * sizeof(int16_t);
+
+    uint32_t now = micros();
+    if (_lastArrivalUs) {
+        int32_t d = (int32_t)(now - _lastArrivalUs) - (int32_t)_lastChunkUs;
+        if (d < 0) d = -d;
+        _jitterUs += (d - _jitterUs) / 16;
+    }
+    _lastArrivalUs = now;
+    _lastChunkUs = (uint32_t)((uint64_t)len * 1000000 / (frameBytes * _inRate));
+
+    uint32_t head = _head;
+    uint32_t tail;
+    portENTER_CRITICAL(&_mux);
+    tail = _tail;
+    portEXIT_CRITICAL(&_mux);
+
+    size_t used = 0;
+    if (_carryLen) {
+        while (_carryLen < frameBytes && used < len) _carry[_carryLen++] = pcm[used++];
+        if (_carryLen < frameBytes) return len;
+        if (head - tail < JITTER_CAPACITY_FRAMES) writeFrame(head++, _carry);
+        else _overflowFrames++;
+        _carryLen = 0;
+    }
+    while (used + frameBytes <= len) {
+        if (head - tail >= JITTER_CAPACITY_FRAMES) {
+            _overflowFrames += (len - used) / frameBytes;
+            used += (len - used) / frameBytes * frameBytes;
+            break;
+        }
+        writeFrame(head++, pcm + used);
+        used += frameBytes;
+    }
+    while (used < len) _carry[_carryLen++] = pcm[used++];
+
+    portENTER_CRITICAL(&_mux);
+    _head = head;
+    portEXIT_CRITICAL(&_mux);
+    return len;
+}
+
+void JitterBuffer::finish() {
+    _finished = true;
+}
+
+uint32_t JitterBuffer::fill() {
+    portENTER_CRITICAL(&_mux);
+    uint32_t n = _head - _tail;
+    portEXIT_CRITICAL(&_mux);
+    return n;
+}
+
+uint32_t JitterBuffer::targetMs() {
+    uint32_t ms = JITTER_MIN_MS + JITTER_VARIANCE_GAIN * _jitterUs / 1000;
+    if (ms < _floorMs) ms = _floorMs;
+    if (ms > JITTER_MAX_MS) ms = JITTER_MAX_MS;
+    return ms;
+}
+
+size_t JitterBuffer::pop(int16_t* stereo, size_t frames) {
+    if (!_open) return 0;
+    uint32_t available = fill();
+
+    if (_buffering) {
+        uint32_t target = (uint64_t)targetMs() * _sampleRate / 1000;
+        // A finished stream shorter than the target plays what it has.
+        if (available < target && !_finished) return 0;
+        _buffering = false;
+        if (_startupMs == 0) {
+            _startupMs = millis() - _startMs;
+            LOG_STREAM_F("Playback started after %u ms (target %u ms)", (unsigned)_startupMs, (unsigned)targetMs());
+        }
+    }
+    if (available == 0) {
+        if (!_finished) {
+            _underruns++;
+            if (_floorMs + JITTER_UNDERRUN_STEP_MS <= JITTER_MAX_MS) _floorMs += JITTER_UNDERRUN_STEP_MS;
+            LOG_STREAM_F("Underrun %u, rebuffering to %u ms", (unsigned)_underruns, (unsigned)targetMs());
+            _buffering = true;
+        }
+        return 0;
+    }
+
+    if (frames > available) frames = available;
+    uint32_t tail = _tail;
+    for (size_t i = 0; i < frames; i++) {
+        const int16_t* src = _ring + ((tail + i) & RING_MASK) * 2;
+        stereo[2 * i] = src[0];
+        stereo[2 * i + 1] = src[1];
+    }
+    portENTER_CRITICAL(&_mux);
+    _tail = tail + frames;
+    portEXIT_CRITICAL(&_mux);
+    return frames;
+}
+
+bool JitterBuffer::isOpen() {
+    return _open;
+}
+
+// Also stops taking data for the stream, so a network stream that is
+// interrupted by other playback is dropped rather than queued.
+void JitterBuffer::close() {
+    _open = false;
+    _accepting = false;
+}
+
+bool JitterBuffer::isDrained() {
+    return !_open || (_finished && fill() == 0);
+}
+
+uint32_t JitterBuffer::getSampleRate() {
+    return _sampleRate;
+}
+
+size_t JitterBuffer::writeJson(char* out, size_t size) {
+    int n = snprintf(out, size,
+                     "{\"open\":%s,\"rate\":%u,\"bufferedMs\":%u,\"targetMs\":%u,\"jitterMs\":%u,"
+                     "\"startupMs\":%u,\"underruns\":%u,\"overflowFrames\":%u}",
+                     _open ? "true" : "false", (unsigned)_sampleRate,
+                     _sampleRate ? (unsigned)((uint64_t)fill() * 1000 / _sampleRate) : 0,
+                     (unsigned)targetMs(), (unsigned)(_jitterUs / 1000), (unsigned)_startupMs,
+                     (unsigned)_underruns, (unsigned)_overflowFrames);
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+void JitterBuffer::report() {
+    LOG_STREAM_F("Ended: startup %u ms, %u underruns, target %u ms, jitter %u ms, %u frames dropped",
+                 (unsigned)_startupMs, (unsigned)_underruns, (unsigned)targetMs(),
+                 (unsigned)(_jitterUs / 1000), (unsigned)_overflowFrames);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+
+// Ring capacity in stereo frames (power of two): about 1.4 s at 48 kHz.
+#define JITTER_CAPACITY_FRAMES  65536
+#define JITTER_MIN_MS           120
+#define JITTER_MAX_MS           1000
+#define JITTER_UNDERRUN_STEP_MS 100
+#define JITTER_VARIANCE_GAIN    3
+#define JITTER_MIN_RATE         8000
+#define JITTER_MAX_RATE         48000
+
+// Single-producer/single-consumer PCM buffer between the network task that
+// receives a live stream and the audio loop that plays it. Playback starts
+// (and restarts after an underrun) only once the fill reaches a target
+// depth, which follows the measured arrival jitter of the incoming chunks
+// (RFC 3550 interarrival estimate) and is raised after every underrun.
+//
+// The producer owns the head and the consumer the tail. A new stream is
+// announced with start() and taken up by open() on the consumer side,
+// which skips whatever the previous stream left behind.
+class JitterBuffer {
+public:
+    bool begin();
+
+    // Producer side (network task).
+    void start(uint32_t sampleRate, uint8_t channels);
+    size_t push(const uint8_t* pcm, size_t len);
+    void finish();
+
+    // Consumer side (audio loop). open() is false if no stream was started
+    // since the last one; pop() returns 0 while buffering.
+    bool open();
+    size_t pop(int16_t* stereo, size_t frames);
+    bool isOpen();
+    bool isDrained();
+    void close();
+    uint32_t getSampleRate();
+
+    size_t writeJson(char* out, size_t size);
+    void report();
+
+private:
+    int16_t* _ring = nullptr;
+    volatile uint32_t _head = 0;
+    volatile uint32_t _tail = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    // Producer state.
+    volatile bool _accepting = false;
+    volatile bool _finished = false;
+    volatile bool _started = false;
+    volatile uint32_t _startHead = 0;
+    volatile uint32_t _inRate = 0;
+    uint8_t _channels = 0;
+    uint8_t _carry[4];
+    uint8_t _carryLen = 0;
+    uint32_t _startMs = 0;
+    uint32_t _lastArrivalUs = 0;
+    uint32_t _lastChunkUs = 0;
+    int32_t _jitterUs = 0;
+    uint32_t _overflowFrames = 0;
+
+    // Consumer state.
+    volatile bool _open = false;
+    bool _buffering = true;
+    uint32_t _sampleRate = 0;
+    uint32_t _floorMs = JITTER_MIN_MS;
+    uint32_t _startupMs = 0;
+    uint32_t _underruns = 0;
+
+    uint32_t fill();
+    uint32_t targetMs();
+    void writeFrame(uint32_t index, const uint8_t* frame);
+};
@@ -2,7 +2,7 @@
 
 void LedController::begin() {
     _strip.begin();
-    _strip.setBrightness(50);
+    _strip.setBrightness(Board::ledBrightness);
     setColor(255, 0, 0);
 }
 
@@ -10,7 +10,7 @@ void LedController::setColor(uint8_t r, uint8_t g, uint8_t b) {
     _isLoading = false;
     _blinkCount = 0;
     _savedR = r; _savedG = g; _savedB = b;
-    _strip.setPixelColor(0, _strip.Color(r, g, b));
+    _strip.fill(_strip.Color(r, g, b));
     _strip.show();
 }
 
@@ -25,14 +25,27 @@ void LedController::blinkError(int count) {
     _blinkLastUpdate = millis();
 }
 
+void LedController::setVisualizer(bool enabled) {
+    if (enabled == _visualizer) return;
+    _visualizer = enabled;
+    if (!enabled) {
+        _strip.fill(_strip.Color(_savedR, _savedG, _savedB));
+        _strip.show();
+    }
+}
+
+void LedController::setVisualLevel(uint8_t level) {
+    _visualLevel = level;
+}
+
 void LedController::loop() {
     if (_blinkCount > 0) {
         if (millis() - _blinkLastUpdate > 200) {
             _blinkLastUpdate = millis();
             if (_blinkPhase % 2 == 0) {
-                _strip.setPixelColor(0, _strip.Color(255, 0, 0));
+                _strip.fill(_strip.Color(255, 0, 0));
             } else {
-                _strip.setPixelColor(0, _strip.Color(_savedR, _savedG, _savedB)); 
+                _strip.fill(_strip.Color(_savedR, _savedG, _savedB)); 
             }
             _strip.show();
             _blinkPhase++;
@@ -45,8 +58,16 @@ void LedController::loop() {
             _lastUpdate = millis();
             _breathVal += _breathDir;
             if (_breathVal >= 255 || _breathVal <= 0) _breathDir *= -1;
-            _strip.setPixelColor(0, _strip.Color(0, 0, _breathVal));
+            _strip.fill(_strip.Color(0, 0, _breathVal));
             _strip.show();
         }
+        return;
+    }
+    // Never fully dark, and only re-sent when the level moved noticeably.
+    if (_visualizer && abs((int)_visualLevel - (int)_shownLevel) >= LED_VIS_MIN_STEP) {
+        _shownLevel = _visualLevel;
+        uint16_t scale = LED_VIS_FLOOR + ((255 - LED_VIS_FLOOR) * _shownLevel) / 255;
+        _strip.fill(_strip.Color((_savedR * scale) >> 8, (_savedG * scale) >> 8, (_savedB * scale) >> 8));
+        _strip.show();
     }
 }
\ No newline at end of file
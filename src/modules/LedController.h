@@ -2,16 +2,22 @@
 #include <Adafruit_NeoPixel.h>
 #include "Config.h"
 
+#define LED_VIS_FLOOR      64
+#define LED_VIS_MIN_STEP   4
+
 class LedController {
 public:
     void begin();
     void setColor(uint8_t r, uint8_t g, uint8_t b);
     void setLoading(bool active);
     void blinkError(int count = 3); 
+    // Modulates the current colour's brightness with an audio level.
+    void setVisualizer(bool enabled);
+    void setVisualLevel(uint8_t level);
     void loop();
 
 private:
-    Adafruit_NeoPixel _strip = Adafruit_NeoPixel(1, PIN_LED, NEO_GRB + NEO_KHZ800);
+    Adafruit_NeoPixel _strip = Adafruit_NeoPixel(Board::ledCount, Board::pinLed, NEO_GRB + NEO_KHZ800);
     bool _isLoading = false;
     unsigned long _lastUpdate = 0;
     int _breathVal = 0;
@@ -20,4 +26,7 @@ private:
     int _blinkPhase = 0;
     unsigned long _blinkLastUpdate = 0;
     uint8_t _savedR = 0, _savedG = 0, _savedB = 0;
+    bool _visualizer = false;
+    uint8_t _visualLevel = 0;
+    uint8_t _shownLevel = 0;
 };
\ No newline at end of file
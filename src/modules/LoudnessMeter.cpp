@@ -0,0 +1,141 @@
+#include "LoudnessMeter.h"
+#include <math.h>
+#include <string.h>
+
+static float blockLoudness(float energy) {
+    return -0.691f + 10.0f * log10f(energy);
+}
+
+void LoudnessMeter::begin(uint32_t sampleRate, uint8_t channels) {
+    _sampleRate = sampleRate;
+    _channels = channels < 1 ? 1 : (channels > 2 ? 2 : channels);
+    _subBlockFrames = sampleRate / 10;
+
+    // BS.1770 pre-filter (high shelf) and RLB high-pass, re-derived for
+    // the actual sample rate.
+    double f0 = 1681.974450955533, g = 3.999843853973347, q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / sampleRate);
+    double vh = pow(10.0, g / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    _shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    _shelf.b1 = 2.0 * (k * k - vh) / a0;
+    _shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    _shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    _shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    _highpass.b0 = 1.0f;
+    _highpass.b1 = -2.0f;
+    _highpass.b2 = 1.0f;
+    _highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    _highpass.a2 = (1.0 - k / q + k * k) / a0;
+
+    reset();
+}
+
+void LoudnessMeter::reset() {
+    memset(_shelf.z1, 0, sizeof(_shelf.z1));
+    memset(_shelf.z2, 0, sizeof(_shelf.z2));
+    memset(_highpass.z1, 0, sizeof(_highpass.z1));
+    memset(_highpass.z2, 0, sizeof(_highpass.z2));
+    memset(_hist, 0, sizeof(_hist));
+    memset(_histEnergy, 0, sizeof(_histEnergy));
+    _subFrames = 0;
+    _subEnergy = 0.0f;
+    _prevCount = 0;
+    _blocks = 0;
+    _frames = 0;
+    _peak = 0.0f;
+}
+
+void LoudnessMeter::setInputScale(float scale) {
+    _scale = scale;
+}
+
+float LoudnessMeter::filter(Biquad& bq, uint8_t ch, float x) {
+    float y = bq.b0 * x + bq.z1[ch];
+    bq.z1[ch] = bq.b1 * x - bq.a1 * y + bq.z2[ch];
+    bq.z2[ch] = bq.b2 * x - bq.a2 * y;
+    return y;
+}
+
+void LoudnessMeter::add(const int16_t* interleaved, size_t frames) {
+    if (_sampleRate == 0) return;
+    const float norm = _scale / 32768.0f;
+    for (size_t i = 0; i < frames; i++) {
+        for (uint8_t ch = 0; ch < _channels; ch++) {
+            float x = interleaved[i * _channels + ch] * norm;
+            float ax = fabsf(x);
+            if (ax > _peak) _peak = ax;
+            float y = filter(_highpass, ch, filter(_shelf, ch, x));
+            _subEnergy += y * y;
+        }
+        if (++_subFrames >= _subBlockFrames) closeSubBlock();
+    }
+    _frames += frames;
+}
+
+// Each 100 ms sub-block completes one 400 ms gating block together with the
+// three before it.
+void LoudnessMeter::closeSubBlock() {
+    float sub = _subEnergy / _subFrames;
+    _subEnergy = 0.0f;
+    _subFrames = 0;
+
+    if (_prevCount == 3) {
+        float energy = (_prevSub[0] + _prevSub[1] + _prevSub[2] + sub) / 4.0f;
+        if (energy > 0.0f) {
+            int bin = (int)((blockLoudness(energy) - LOUDNESS_MIN_LUFS) / LOUDNESS_BIN_LU);
+            if (bin >= 0) {
+                if (bin >= LOUDNESS_BINS) bin = LOUDNESS_BINS - 1;
+                _hist[bin]++;
+                _histEnergy[bin] += energy;
+                _blocks++;
+            }
+        }
+        _prevSub[0] = _prevSub[1];
+        _prevSub[1] = _prevSub[2];
+        _prevSub[2] = sub;
+    } else {
+        _prevSub[_prevCount++] = sub;
+    }
+}
+
+bool LoudnessMeter::hasResult() {
+    return _blocks > 0;
+}
+
+float LoudnessMeter::integratedLufs() {
+    if (_blocks == 0) return LOUDNESS_MIN_LUFS;
+
+    double sum = 0.0;
+    for (int i = 0; i < LOUDNESS_BINS; i++) sum += _histEnergy[i];
+    float relativeGate = blockLoudness(sum / _blocks) - 10.0f;
+
+    int first = (int)((relativeGate - LOUDNESS_MIN_LUFS) / LOUDNESS_BIN_LU);
+    if (first < 0) first = 0;
+    sum = 0.0;
+    uint32_t count = 0;
+    for (int i = first; i < LOUDNESS_BINS; i++) {
+        sum += _histEnergy[i];
+        count += _hist[i];
+    }
+    if (count == 0) return LOUDNESS_MIN_LUFS;
+    return blockLoudness(sum / count);
+}
+
+float LoudnessMeter::peak() {
+    return _peak;
+}
+
+float LoudnessMeter::measuredSeconds() {
+    return _sampleRate ? (float)_frames / _sampleRate : 0.0f;
+}
+
+uint32_t LoudnessMeter::getSampleRate() {
+    return _sampleRate;
+}
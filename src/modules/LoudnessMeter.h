@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Gated loudness histogram: 0.25 LU bins from -70 to +5 LUFS. Each bin
+// keeps the summed energy of its blocks, so only the relative gate is
+// quantized, not the result.
+#define LOUDNESS_BIN_LU      0.25f
+#define LOUDNESS_MIN_LUFS    -70.0f
+#define LOUDNESS_BINS        300
+
+// Streaming integrated loudness (EBU R128 / ITU BS.1770): K-weighting,
+// 400 ms blocks with 75% overlap, absolute and relative gating. Block
+// loudness goes into a fixed histogram so memory does not grow with track
+// length. No Arduino dependencies.
+class LoudnessMeter {
+public:
+    void begin(uint32_t sampleRate, uint8_t channels);
+    void reset();
+    // Linear factor applied to samples before measuring, used to undo a
+    // gain that was already applied upstream.
+    void setInputScale(float scale);
+    void add(const int16_t* interleaved, size_t frames);
+
+    bool hasResult();
+    float integratedLufs();
+    float peak();
+    float measuredSeconds();
+    uint32_t getSampleRate();
+
+private:
+    struct Biquad {
+        float b0, b1, b2, a1, a2;
+        float z1[2], z2[2];
+    };
+
+    uint32_t _sampleRate = 0;
+    uint8_t _channels = 0;
+    float _scale = 1.0f;
+    Biquad _shelf;
+    Biquad _highpass;
+
+    uint32_t _subBlockFrames = 0;
+    uint32_t _subFrames = 0;
+    float _subEnergy = 0.0f;
+    float _prevSub[3];
+    uint8_t _prevCount = 0;
+
+    uint32_t _hist[LOUDNESS_BINS];
+    float _histEnergy[LOUDNESS_BINS];
+    uint32_t _blocks = 0;
+    uint32_t _frames = 0;
+    float _peak = 0.0f;
+
+    static float filter(Biquad& bq, uint8_t ch, float x);
+    void closeSubBlock();
+};
@@ -0,0 +1,161 @@
+#include "NdefParser.h"
+#include <string.h>
+
+#define NDEF_FLAG_MB   0x80
+#define NDEF_FLAG_ME   0x40
+#define NDEF_FLAG_SR   0x10
+#define NDEF_FLAG_IL   0x08
+#define NDEF_TNF_MASK  0x07
+#define NDEF_TNF_WELL_KNOWN 0x01
+
+static const char* const URI_PREFIXES[] = {
+    "", "http://www.", "https://www.", "http://", "https://", "tel:", "mailto:"
+};
+
+NdefTlvStatus NdefParser::findMessage(const uint8_t* data, size_t len, size_t* offset, size_t* length) {
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t type = data[pos];
+        if (type == NDEF_TLV_NULL) {
+            pos++;
+            continue;
+        }
+        if (type == NDEF_TLV_TERMINATOR) return NDEF_TLV_ABSENT;
+
+        if (pos + 1 >= len) {
+            *length = pos + 2;
+            return NDEF_TLV_NEED_MORE;
+        }
+        size_t valueLen = data[pos + 1];
+        size_t headerLen = 2;
+        if (valueLen == 0xFF) {
+            if (pos + 3 >= len) {
+                *length = pos + 4;
+                return NDEF_TLV_NEED_MORE;
+            }
+            valueLen = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+            headerLen = 4;
+        }
+
+        if (type == NDEF_TLV_MESSAGE) {
+            *offset = pos + headerLen;
+            *length = valueLen;
+            return NDEF_TLV_FOUND;
+        }
+        pos += headerLen + valueLen;
+    }
+    *length = pos + 2;
+    return NDEF_TLV_NEED_MORE;
+}
+
+static size_t appendPrintable(char* out, size_t outSize, size_t written, const uint8_t* src, size_t srcLen) {
+    for (size_t i = 0; i < srcLen && written + 1 < outSize; i++) {
+        char c = (char)src[i];
+        if (c >= 0x20 && c <= 0x7E) out[written++] = c;
+    }
+    return written;
+}
+
+size_t NdefParser::decodeFirstRecord(const uint8_t* msg, size_t len, char* out, size_t outSize) {
+    if (outSize == 0) return 0;
+    out[0] = '\0';
+    if (len < 3) return 0;
+
+    uint8_t header = msg[0];
+    size_t pos = 1;
+    size_t typeLen = msg[pos++];
+    size_t payloadLen;
+    if (header & NDEF_FLAG_SR) {
+        payloadLen = msg[pos++];
+    } else {
+        if (pos + 4 > len) return 0;
+        payloadLen = ((size_t)msg[pos] << 24) | ((size_t)msg[pos + 1] << 16) |
+                     ((size_t)msg[pos + 2] << 8) | msg[pos + 3];
+        pos += 4;
+    }
+    size_t idLen = 0;
+    if (header & NDEF_FLAG_IL) {
+        if (pos >= len) return 0;
+        idLen = msg[pos++];
+    }
+    if (pos + typeLen + idLen > len || payloadLen > len - pos - typeLen - idLen) return 0;
+
+    const uint8_t* type = msg + pos;
+    const uint8_t* payload = msg + pos + typeLen + idLen;
+    bool wellKnown = (header & NDEF_TNF_MASK) == NDEF_TNF_WELL_KNOWN && typeLen == 1;
+
+    size_t written = 0;
+    if (wellKnown && type[0] == 'U') {
+        if (payloadLen < 1) return 0;
+        uint8_t code = payload[0];
+        if (code < sizeof(URI_PREFIXES) / sizeof(URI_PREFIXES[0])) {
+            const char* prefix = URI_PREFIXES[code];
+            while (*prefix && written + 1 < outSize) out[written++] = *prefix++;
+        }
+        written = appendPrintable(out, outSize, written, payload + 1, payloadLen - 1);
+    } else if (wellKnown && type[0] == 'T') {
+        if (payloadLen < 1) return 0;
+        size_t langLen = payload[0] & 0x3F;
+        if (1 + langLen > payloadLen) return 0;
+        written = appendPrintable(out, outSize, written, payload + 1 + langLen, payloadLen - 1 - langLen);
+    } else {
+        written = appendPrintable(out, outSize, written, payload, payloadLen);
+    }
+    out[written] = '\0';
+    return written;
+}
+
+size_t NdefParser::encodeMessage(const char* text, uint8_t* out, size_t outSize) {
+    size_t textLen = strlen(text);
+    uint8_t type = 'T';
+    uint8_t code = 0;
+    for (uint8_t i = 1; i < sizeof(URI_PREFIXES) / sizeof(URI_PREFIXES[0]); i++) {
+        size_t prefixLen = strlen(URI_PREFIXES[i]);
+        if (strncmp(text, URI_PREFIXES[i], prefixLen) == 0 && strncmp(URI_PREFIXES[i], "http", 4) == 0) {
+            type = 'U';
+            code = i;
+            text += prefixLen;
+            textLen -= prefixLen;
+            break;
+        }
+    }
+
+    static const char LANG[] = "en";
+    size_t payloadLen = type == 'T' ? 1 + sizeof(LANG) - 1 + textLen : 1 + textLen;
+    bool shortRecord = payloadLen <= 0xFF;
+    size_t msgLen = 4 + (shortRecord ? 0 : 3) + payloadLen;
+    size_t tlvHeader = msgLen < 0xFF ? 2 : 4;
+    if (tlvHeader + msgLen + 1 > outSize || msgLen > 0xFFFE) return 0;
+
+    size_t pos = 0;
+    out[pos++] = NDEF_TLV_MESSAGE;
+    if (tlvHeader == 2) {
+        out[pos++] = (uint8_t)msgLen;
+    } else {
+        out[pos++] = 0xFF;
+        out[pos++] = (uint8_t)(msgLen >> 8);
+        out[pos++] = (uint8_t)msgLen;
+    }
+    out[pos++] = NDEF_FLAG_MB | NDEF_FLAG_ME | (shortRecord ? NDEF_FLAG_SR : 0) | NDEF_TNF_WELL_KNOWN;
+    out[pos++] = 1;
+    if (shortRecord) {
+        out[pos++] = (uint8_t)payloadLen;
+    } else {
+        out[pos++] = (uint8_t)(payloadLen >> 24);
+        out[pos++] = (uint8_t)(payloadLen >> 16);
+        out[pos++] = (uint8_t)(payloadLen >> 8);
+        out[pos++] = (uint8_t)payloadLen;
+    }
+    out[pos++] = type;
+    if (type == 'T') {
+        out[pos++] = sizeof(LANG) - 1;
+        memcpy(out + pos, LANG, sizeof(LANG) - 1);
+        pos += sizeof(LANG) - 1;
+    } else {
+        out[pos++] = code;
+    }
+    memcpy(out + pos, text, textLen);
+    pos += textLen;
+    out[pos++] = NDEF_TLV_TERMINATOR;
+    return pos;
+}
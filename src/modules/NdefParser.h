@@ -0,0 +1,34 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define NDEF_TLV_NULL        0x00
+#define NDEF_TLV_MESSAGE     0x03
+#define NDEF_TLV_TERMINATOR  0xFE
+
+enum NdefTlvStatus {
+    NDEF_TLV_FOUND,
+    NDEF_TLV_NEED_MORE,
+    NDEF_TLV_ABSENT
+};
+
+// Pure byte-level parser for the NTAG2xx user area (starting at page 4).
+// No Arduino dependencies so it can be fed captured tag dumps.
+class NdefParser {
+public:
+    // Locates the NDEF Message TLV. On NDEF_TLV_FOUND, offset/length describe
+    // the message value. NDEF_TLV_NEED_MORE means `len` bytes are not enough
+    // to reach the message header; `*length` then holds the minimum to read.
+    static NdefTlvStatus findMessage(const uint8_t* data, size_t len, size_t* offset, size_t* length);
+
+    // Decodes the first record of an NDEF message into `out` as text.
+    // URI records get their abbreviation prefix expanded, Text records have
+    // the language code stripped. Returns the number of chars written, 0 on error.
+    static size_t decodeFirstRecord(const uint8_t* msg, size_t len, char* out, size_t outSize);
+
+    // Encodes `text` as a single-record NDEF message wrapped in a Message TLV
+    // and a Terminator TLV, ready to be written from page 4. http(s) links
+    // become URI records, anything else an "en" Text record. Returns the
+    // number of bytes, 0 if it does not fit in `outSize`.
+    static size_t encodeMessage(const char* text, uint8_t* out, size_t outSize);
+};
@@ -1,4 +1,5 @@
 #include "NfcManager.h"
+#include "NdefParser.h"
 
 #define DEBUG_NFC 1
 
@@ -10,6 +11,15 @@
     #define LOG_NFC_F(fmt, ...)
 #endif
 
+// Fastest first; the PN532 tops out at 400 kHz but long figurine-base
+// wiring often needs the slower settings.
+static const uint32_t NFC_I2C_CLOCKS[] = { 400000, 100000, 50000 };
+static const uint8_t NFC_I2C_CLOCK_COUNT = sizeof(NFC_I2C_CLOCKS) / sizeof(NFC_I2C_CLOCKS[0]);
+
+#define NFC_CLOCK_WINDOW        16
+#define NFC_CLOCK_MAX_ERR_PCT   10
+#define NFC_CLOCK_UPGRADE_AFTER 8
+
 NfcManager* _nfcInstance = nullptr;
 
 NfcManager::NfcManager(uint8_t pinSda, uint8_t pinScl) 
@@ -23,22 +33,29 @@ void NfcManager::begin() {
     LOG_NFC_F("  I2C Pins: SDA=%d, SCL=%d", _pinSda, _pinScl);
     
     Wire.begin(_pinSda, _pinScl);
-    Wire.setClock(50000); 
     Wire.setTimeOut(10000); 
 
     _nfc.begin();
     
-    uint32_t versiondata = _nfc.getFirmwareVersion();
+    uint32_t versiondata = 0;
+    for (_clockIndex = 0; _clockIndex < NFC_I2C_CLOCK_COUNT; _clockIndex++) {
+        applyClock();
+        versiondata = _nfc.getFirmwareVersion();
+        if (versiondata) break;
+    }
     if (!versiondata) {
+        _clockIndex = NFC_I2C_CLOCK_COUNT - 1;
+        applyClock();
         LOG_NFC("ERROR: NFC Module not found!");
         Serial.println("NFC Module not found!");
         return;
     }
     
-    LOG_NFC_F("Found chip PN5%02X", (versiondata>>24) & 0xFF);
+    LOG_NFC_F("Found chip PN5%02X at %lu Hz", (versiondata>>24) & 0xFF, (unsigned long)getI2cClock());
     Serial.print("Found chip PN5"); Serial.println((versiondata>>24) & 0xFF, HEX); 
     
     _nfc.SAMConfig();
+    _nfc.setPassiveActivationRetries(NFC_SCAN_RETRIES);
     LOG_NFC("SAMConfig complete");
     
     LOG_NFC("Starting NFC task on Core 0 with priority 3...");
@@ -53,10 +70,306 @@ void NfcManager::onTagDetected(std::function<void(String, String)> callback) {
     LOG_NFC("Callback registered");
 }
 
+void NfcManager::onPresenceChange(std::function<void(NfcPresenceEvent)> callback) {
+    _presenceCallback = callback;
+}
+
+uint32_t NfcManager::getLastSeenMs() {
+    return _presence.lastSeenMs();
+}
+
+// The next read of the same tag is reported as a new tap, not a return.
+// The tracker belongs to the NFC task, so this only leaves it a request.
+void NfcManager::forgetTag() {
+    _forgetRequested = true;
+}
+
+void NfcManager::applyForget() {
+    if (!_forgetRequested) return;
+    _forgetRequested = false;
+    _presence.forget();
+}
+
 Adafruit_PN532* NfcManager::getDriver() {
     return &_nfc;
 }
 
+uint32_t NfcManager::getI2cClock() {
+    return NFC_I2C_CLOCKS[_clockIndex];
+}
+
+void NfcManager::applyClock() {
+    Wire.setClock(NFC_I2C_CLOCKS[_clockIndex]);
+    _windowTx = 0;
+    _windowErrors = 0;
+    _cleanWindows = 0;
+}
+
+void NfcManager::recordTransaction(bool ok) {
+    _tapTx++;
+    _windowTx++;
+    if (!ok) _windowErrors++;
+    if (_windowTx < NFC_CLOCK_WINDOW) return;
+
+    if (_windowErrors * 100 > _windowTx * NFC_CLOCK_MAX_ERR_PCT) {
+        if (_clockIndex < NFC_I2C_CLOCK_COUNT - 1) {
+            _clockIndex++;
+            LOG_NFC_F("I2C error rate %u/%u, falling back to %lu Hz", _windowErrors, _windowTx, (unsigned long)getI2cClock());
+            applyClock();
+            return;
+        }
+        _cleanWindows = 0;
+    } else if (_windowErrors == 0 && ++_cleanWindows >= NFC_CLOCK_UPGRADE_AFTER && _clockIndex > 0) {
+        _clockIndex--;
+        LOG_NFC_F("I2C stable, trying %lu Hz", (unsigned long)getI2cClock());
+        applyClock();
+        return;
+    }
+    _windowTx = 0;
+    _windowErrors = 0;
+}
+
+// NTAG READ (0x30) always returns 4 pages; the classic block read exposes all
+// 16 bytes, unlike ntag2xx_ReadPage() which throws 12 of them away.
+bool NfcManager::readBlock(uint8_t page, uint8_t* buffer) {
+    for (int r = 0; r < NFC_READ_RETRIES; r++) {
+        bool ok = _nfc.mifareclassic_ReadDataBlock(page, buffer);
+        recordTransaction(ok);
+        if (ok) return true;
+        vTaskDelay(30 / portTICK_PERIOD_MS);
+    }
+    return false;
+}
+
+size_t NfcManager::readNdef(char* out, size_t outSize) {
+    uint8_t data[NFC_MAX_NDEF_BYTES];
+    size_t have = 0;
+    size_t need = 16;
+
+    while (true) {
+        if (need > sizeof(data)) {
+            LOG_NFC_F("NDEF too large: %u bytes", (unsigned)need);
+            return 0;
+        }
+        while (have < need) {
+            if (!readBlock(4 + have / 4, data + have)) {
+                LOG_NFC_F("Page %u read failed after %d retries", (unsigned)(4 + have / 4), NFC_READ_RETRIES);
+                return 0;
+            }
+            have += 16;
+        }
+
+        size_t offset = 0;
+        size_t length = 0;
+        NdefTlvStatus status = NdefParser::findMessage(data, have, &offset, &length);
+        if (status == NDEF_TLV_ABSENT) return 0;
+        if (status == NDEF_TLV_NEED_MORE) {
+            need = length;
+            continue;
+        }
+        if (offset + length > have) {
+            need = offset + length;
+            continue;
+        }
+        return NdefParser::decodeFirstRecord(data + offset, length, out, outSize);
+    }
+}
+
+// InListPassiveTarget with the UID as initiator data only selects that tag;
+// cascaded 7-byte UIDs need the CT byte in front.
+bool NfcManager::selectTracked() {
+    uint8_t cmd[3 + 8] = { PN532_COMMAND_INLISTPASSIVETARGET, 1, PN532_MIFARE_ISO14443A };
+    uint8_t cmdLen = 3;
+    uint8_t trackedLen = _presence.uidLength();
+    if (trackedLen == 7) cmd[cmdLen++] = 0x88;
+    memcpy(cmd + cmdLen, _presence.uid(), trackedLen);
+    cmdLen += trackedLen;
+
+    uint32_t start = micros();
+    uint8_t uid[7];
+    uint8_t uidLength = 0;
+    bool ok = _nfc.sendCommandCheckAck(cmd, cmdLen, NFC_PRESENCE_TIMEOUT_MS) &&
+              _nfc.readDetectedPassiveTargetID(uid, &uidLength) &&
+              _presence.matches(uid, uidLength);
+    _presenceBusyUs += micros() - start;
+    return ok;
+}
+
+void NfcManager::startTracking(const uint8_t* uid, uint8_t uidLength, bool silent) {
+    _presence.start(uid, uidLength, millis(), silent);
+    _presenceBusyUs = 0;
+}
+
+void NfcManager::trackPresence() {
+    bool seen = selectTracked();
+    uint32_t now = millis();
+    if (!_presence.update(seen, now)) return;
+
+    uint32_t elapsed = now - _presence.startMs();
+    LOG_NFC_F("Tag removed, last seen %lu ms ago (presence I2C duty %.1f%%)",
+              (unsigned long)(now - _presence.lastSeenMs()), elapsed ? _presenceBusyUs / (elapsed * 10.0f) : 0.0f);
+    if (_presenceCallback && !_presence.isSilent()) _presenceCallback(NFC_TAG_REMOVED);
+}
+
+// A presence check should answer "gone" after one attempt so an absent tag
+// costs one short transaction, but scanning with a single attempt misses
+// tags that are still being lowered onto the reader.
+void NfcManager::setPassiveRetries(uint8_t retries) {
+    if (retries == _passiveRetries) return;
+    if (_nfc.setPassiveActivationRetries(retries)) _passiveRetries = retries;
+}
+
+bool NfcManager::queueWrite(const char* text, uint16_t count) {
+    size_t len = strlen(text);
+    uint8_t probe[NFC_MAX_NDEF_BYTES];
+    if (!count || count > NFC_WRITE_MAX_COUNT) return false;
+    if (!len || len > NFC_WRITE_MAX_TEXT || !NdefParser::encodeMessage(text, probe, sizeof(probe))) return false;
+    // readNdef() only keeps printable ASCII, so anything else would not read back.
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] < 0x20 || text[i] > 0x7E || text[i] == '"' || text[i] == '\\') return false;
+    }
+    portENTER_CRITICAL(&_writeMux);
+    memcpy(_writeText, text, len + 1);
+    _writeRemaining = count;
+    _writeDone = 0;
+    _writeActiveMs = millis();
+    _writeTimedOut = false;
+    portEXIT_CRITICAL(&_writeMux);
+    LOG_NFC_F("Write job: next %u tag(s) get \"%s\"", count, text);
+    return true;
+}
+
+void NfcManager::cancelWrite() {
+    portENTER_CRITICAL(&_writeMux);
+    uint16_t remaining = _writeRemaining;
+    _writeRemaining = 0;
+    portEXIT_CRITICAL(&_writeMux);
+    if (remaining) LOG_NFC_F("Write job cancelled, %u tag(s) left", remaining);
+}
+
+// Runs on the NFC task before each scan.
+void NfcManager::expireWrite() {
+    portENTER_CRITICAL(&_writeMux);
+    uint16_t remaining = _writeRemaining;
+    bool expired = remaining && millis() - _writeActiveMs > NFC_WRITE_TIMEOUT_MS;
+    if (expired) {
+        _writeRemaining = 0;
+        _writeTimedOut = true;
+    }
+    portEXIT_CRITICAL(&_writeMux);
+    if (expired) LOG_NFC_F("Write job timed out, %u tag(s) left", remaining);
+}
+
+size_t NfcManager::writeJobJson(char* buffer, size_t size) {
+    char text[NFC_WRITE_MAX_TEXT + 1];
+    NfcWriteResult results[NFC_WRITE_HISTORY];
+    portENTER_CRITICAL(&_writeMux);
+    memcpy(text, _writeText, sizeof(text));
+    uint16_t remaining = _writeRemaining;
+    uint16_t done = _writeDone;
+    bool timedOut = _writeTimedOut;
+    uint8_t count = _resultCount;
+    for (uint8_t i = 0; i < count; i++) {
+        results[i] = _results[(_resultHead + NFC_WRITE_HISTORY - 1 - i) % NFC_WRITE_HISTORY];
+    }
+    portEXIT_CRITICAL(&_writeMux);
+
+    int n = snprintf(buffer, size, "{\"remaining\":%u,\"done\":%u,\"timedOut\":%s,\"text\":\"%s\",\"results\":[",
+                     remaining, done, timedOut ? "true" : "false", text);
+    for (uint8_t i = 0; i < count && n > 0 && (size_t)n < size; i++) {
+        const NfcWriteResult& r = results[i];
+        n += snprintf(buffer + n, size - n, "%s{\"uid\":\"%s\",\"ok\":%s,\"ms\":%u,\"pages\":%u,\"written\":%u,\"tx\":%u%s%s%s}",
+                      i ? "," : "", r.uid, r.ok ? "true" : "false", (unsigned)r.ms, r.pages, r.pagesWritten, r.transactions,
+                      r.error ? ",\"error\":\"" : "", r.error ? r.error : "", r.error ? "\"" : "");
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "]}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+bool NfcManager::writePage(uint8_t page, const uint8_t* data) {
+    for (int r = 0; r < NFC_READ_RETRIES; r++) {
+        bool ok = _nfc.ntag2xx_WritePage(page, (uint8_t*)data);
+        recordTransaction(ok);
+        if (ok) return true;
+        vTaskDelay(30 / portTICK_PERIOD_MS);
+    }
+    return false;
+}
+
+// NTAG2xx has no multi-page WRITE, so every written page costs a PN532
+// transaction while a READ returns four. The user area is read first and
+// only pages that differ are written; blocks that were written are read
+// back to verify. Re-programming a figurine with its current content
+// costs a handful of reads and no writes.
+bool NfcManager::programTag(const uint8_t* uid, uint8_t uidLength) {
+    uint32_t start = millis();
+    NfcWriteResult result = {};
+    for (uint8_t i = 0; i < uidLength; i++) snprintf(result.uid + 2 * i, 3, "%02X", uid[i]);
+
+    char text[NFC_WRITE_MAX_TEXT + 1];
+    portENTER_CRITICAL(&_writeMux);
+    memcpy(text, _writeText, sizeof(text));
+    portEXIT_CRITICAL(&_writeMux);
+
+    uint8_t message[NFC_MAX_NDEF_BYTES];
+    uint8_t current[NFC_MAX_NDEF_BYTES];
+    size_t len = NdefParser::encodeMessage(text, message, sizeof(message));
+    size_t blocks = (len + 15) / 16;
+    memset(message + len, 0, blocks * 16 - len);
+    result.pages = (len + 3) / 4;
+    _tapTx = 0;
+
+    const char* error = nullptr;
+    uint8_t header[16];
+    if (!len || blocks * 16 > sizeof(message)) error = "encode failed";
+    else if (!readBlock(0, header)) error = "read failed";
+    else if (header[12] != 0xE1 || (header[15] & 0xF0)) error = "not NDEF writable";
+    else if (len > header[14] * 8u) error = "tag too small";
+
+    for (size_t b = 0; !error && b < blocks; b++) {
+        if (!readBlock(4 + b * 4, current + b * 16)) error = "read failed";
+    }
+    uint16_t dirty = 0;
+    for (uint8_t p = 0; !error && p < result.pages; p++) {
+        if (memcmp(current + p * 4, message + p * 4, 4) == 0) continue;
+        if (!writePage(4 + p, message + p * 4)) {
+            error = "write failed";
+            break;
+        }
+        result.pagesWritten++;
+        dirty |= 1 << (p / 4);
+    }
+    for (size_t b = 0; !error && b < blocks; b++) {
+        if (!(dirty & (1 << b))) continue;
+        size_t checked = min((size_t)16, result.pages * 4 - b * 16);
+        if (!readBlock(4 + b * 4, current + b * 16)) error = "verify read failed";
+        else if (memcmp(current + b * 16, message + b * 16, checked) != 0) error = "verify mismatch";
+    }
+
+    result.ok = !error;
+    result.error = error;
+    result.ms = millis() - start;
+    result.transactions = _tapTx;
+    portENTER_CRITICAL(&_writeMux);
+    _results[_resultHead] = result;
+    _resultHead = (_resultHead + 1) % NFC_WRITE_HISTORY;
+    if (_resultCount < NFC_WRITE_HISTORY) _resultCount++;
+    if (result.ok) {
+        _writeDone++;
+        if (_writeRemaining) _writeRemaining--;
+    }
+    _writeActiveMs = millis();
+    portEXIT_CRITICAL(&_writeMux);
+
+    if (result.ok) {
+        LOG_NFC_F("Programmed %s in %u ms: %u of %u pages written, %u transactions at %lu Hz", result.uid,
+                  (unsigned)result.ms, result.pagesWritten, result.pages, result.transactions, (unsigned long)getI2cClock());
+    } else {
+        LOG_NFC_F("Programming %s failed: %s after %u ms", result.uid, error, (unsigned)result.ms);
+    }
+    return result.ok;
+}
+
 void NfcManager::taskEntry(void* parameter) {
     NfcManager* instance = (NfcManager*)parameter;
     instance->loopTask();
@@ -66,9 +379,38 @@ void NfcManager::loopTask() {
     LOG_NFC("Task started - entering main loop");
     
     while(true) {
+        applyForget();
+        setPassiveRetries(_presence.isPresent() ? NFC_PRESENCE_RETRIES : NFC_SCAN_RETRIES);
+        if (_presence.isPresent()) {
+            trackPresence();
+            vTaskDelay(NFC_PRESENCE_INTERVAL_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        expireWrite();
         uint8_t uid[7]; 
         uint8_t uidLength;
         if (_nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, 100)) {
+            applyForget();
+            bool sameTag = _presence.matches(uid, uidLength);
+            if (sameTag && !_presence.isSilent()) {
+                LOG_NFC("Tracked tag returned");
+                startTracking(uid, uidLength);
+                if (_presenceCallback) _presenceCallback(NFC_TAG_RETURNED);
+                continue;
+            }
+
+            // Tags being programmed are tracked silently: lifting one off
+            // is not a removal for playback, and putting it back does not
+            // program it twice unless the last attempt failed.
+            if (_writeRemaining) {
+                if (!sameTag || !_lastWriteOk) _lastWriteOk = programTag(uid, uidLength);
+                startTracking(uid, uidLength, true);
+                continue;
+            }
+
+            _tapTx = 0;
+            recordTransaction(true);
             vTaskDelay(30 / portTICK_PERIOD_MS);
             
             String uidStr = "";
@@ -77,52 +419,16 @@ void NfcManager::loopTask() {
                 uidStr += String(uid[i], HEX);
             }
             uidStr.toUpperCase();
-            uint8_t dataBuffer[16]; 
-            memset(dataBuffer, 0, sizeof(dataBuffer));
-            
-            String content = "";
-            bool error = false;
-            int errorCount = 0;
-            
-            for (uint8_t page = 4; page < 10; page++) {
-                bool pageRead = false;
-                for(int r = 0; r < 5; r++) {
-                    memset(dataBuffer, 0, sizeof(dataBuffer));
-                    
-                    if (_nfc.ntag2xx_ReadPage(page, dataBuffer)) {
-                        pageRead = true;
-                        break;
-                    }
-                    vTaskDelay(30 / portTICK_PERIOD_MS);
-                }
-                
-                if (pageRead) {
-                    for (int i = 0; i < 4; i++) {
-                        char c = (char)dataBuffer[i];
-                        if (c >= 0x20 && c <= 0x7E) { 
-                            if (isalnum(c) || c == ':' || c == '/' || c == '.' || c == '-' || c == '_') {
-                                content += c;
-                            }
-                        }
-                    }
-                } else {
-                    errorCount++;
-                    if (errorCount >= 2) {
-                        error = true;
-                        LOG_NFC_F("Page %d read failed after 5 retries", page);
-                        break;
-                    }
-                }
-                vTaskDelay(20 / portTICK_PERIOD_MS);
-            }
-            if (!error && content.length() > 3 && _callback) {
-                if (content.indexOf("cmd:") != -1 || content.indexOf("192.168") != -1) {
-                    LOG_NFC_F("Valid tag content: %s", content.c_str());
-                    _callback(uidStr, content);
-                    vTaskDelay(2000 / portTICK_PERIOD_MS); 
-                } else {
-                    LOG_NFC_F("Invalid content (no cmd: or IP): %s", content.c_str());
-                }
+
+            char text[NFC_MAX_NDEF_BYTES];
+            size_t textLen = readNdef(text, sizeof(text));
+            LOG_NFC_F("Tap used %u PN532 transactions at %lu Hz", _tapTx, (unsigned long)getI2cClock());
+
+            if (textLen > 0 && _callback) {
+                LOG_NFC_F("Tag content: %s", text);
+                _callback(uidStr, String(text));
+                startTracking(uid, uidLength);
+                continue;
             }
         }
         vTaskDelay(300 / portTICK_PERIOD_MS);
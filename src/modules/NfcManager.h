@@ -3,13 +3,56 @@
 #include <Wire.h>
 #include <Adafruit_PN532.h>
 #include <functional>
+#include "PresenceTracker.h"
+
+#define NFC_MAX_NDEF_BYTES 256
+#define NFC_READ_RETRIES   3
+
+// Passive activation retries: one attempt while checking a tracked tag,
+// the PN532 default (retry until the command times out) while scanning.
+#define NFC_PRESENCE_RETRIES 0x01
+#define NFC_SCAN_RETRIES     0xFF
+
+// Tag programming: text is kept well under NFC_MAX_NDEF_BYTES so the
+// encoded message can always be read back by readNdef().
+#define NFC_WRITE_MAX_TEXT  200
+#define NFC_WRITE_HISTORY   8
+#define NFC_WRITE_MAX_COUNT 100
+// A job nobody feeds tags to for this long is dropped, so a forgotten one
+// does not overwrite the next figurine put on the reader.
+#define NFC_WRITE_TIMEOUT_MS 120000
+
+enum NfcPresenceEvent {
+    NFC_TAG_REMOVED,
+    NFC_TAG_RETURNED
+};
+
+struct NfcWriteResult {
+    char uid[15];
+    bool ok;
+    const char* error;
+    uint32_t ms;
+    uint8_t pagesWritten;
+    uint8_t pages;
+    uint8_t transactions;
+};
 
 class NfcManager {
 public:
     NfcManager(uint8_t pinSda, uint8_t pinScl);
     void begin();
     void onTagDetected(std::function<void(String, String)> callback); 
+    void onPresenceChange(std::function<void(NfcPresenceEvent)> callback);
+    uint32_t getLastSeenMs();
+    void forgetTag();
     Adafruit_PN532* getDriver();
+    uint32_t getI2cClock();
+    // Programs the next `count` new tags placed on the reader with `text`
+    // instead of reading them. Called from the portal; false if the text
+    // cannot be encoded or count is not 1..NFC_WRITE_MAX_COUNT.
+    bool queueWrite(const char* text, uint16_t count);
+    void cancelWrite();
+    size_t writeJobJson(char* buffer, size_t size);
 
 private:
     uint8_t _pinSda;
@@ -17,6 +60,39 @@ private:
     Adafruit_PN532 _nfc;
     TaskHandle_t _taskHandle;
     std::function<void(String, String)> _callback;
+    std::function<void(NfcPresenceEvent)> _presenceCallback;
+    uint8_t _clockIndex = 0;
+    uint16_t _windowTx = 0;
+    uint16_t _windowErrors = 0;
+    uint8_t _cleanWindows = 0;
+    uint16_t _tapTx = 0;
+    PresenceTracker _presence;
+    volatile bool _forgetRequested = false;
+    uint32_t _presenceBusyUs = 0;
+    uint8_t _passiveRetries = NFC_SCAN_RETRIES;
+
+    portMUX_TYPE _writeMux = portMUX_INITIALIZER_UNLOCKED;
+    char _writeText[NFC_WRITE_MAX_TEXT + 1] = "";
+    volatile uint16_t _writeRemaining = 0;
+    uint16_t _writeDone = 0;
+    uint32_t _writeActiveMs = 0;
+    bool _writeTimedOut = false;
+    bool _lastWriteOk = true;
+    NfcWriteResult _results[NFC_WRITE_HISTORY];
+    uint8_t _resultHead = 0;
+    uint8_t _resultCount = 0;
     static void taskEntry(void* parameter);
     void loopTask();
-};
\ No newline at end of file
+    bool readBlock(uint8_t page, uint8_t* buffer);
+    size_t readNdef(char* out, size_t outSize);
+    void applyClock();
+    void recordTransaction(bool ok);
+    bool selectTracked();
+    void trackPresence();
+    void applyForget();
+    void startTracking(const uint8_t* uid, uint8_t uidLength, bool silent = false);
+    void setPassiveRetries(uint8_t retries);
+    bool writePage(uint8_t page, const uint8_t* data);
+    bool programTag(const uint8_t* uid, uint8_t uidLength);
+    void expireWrite();
+};
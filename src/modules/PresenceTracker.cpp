@@ -0,0 +1,59 @@
+#include "PresenceTracker.h"
+#include <string.h>
+
+void PresenceTracker::start(const uint8_t* uid, uint8_t uidLength, uint32_t nowMs, bool silent) {
+    if (uidLength > sizeof(_uid)) uidLength = sizeof(_uid);
+    memcpy(_uid, uid, uidLength);
+    _uidLength = uidLength;
+    _present = true;
+    _silent = silent;
+    _misses = 0;
+    _lastSeenMs = nowMs;
+    _startMs = nowMs;
+}
+
+bool PresenceTracker::update(bool seen, uint32_t nowMs) {
+    if (!_present) return false;
+    if (seen) {
+        _misses = 0;
+        _lastSeenMs = nowMs;
+        return false;
+    }
+    if (++_misses < NFC_PRESENCE_MISSES) return false;
+    _present = false;
+    return true;
+}
+
+// The next read of the same tag is reported as a new tap, not a return.
+void PresenceTracker::forget() {
+    _present = false;
+    _uidLength = 0;
+}
+
+bool PresenceTracker::isPresent() const {
+    return _present;
+}
+
+bool PresenceTracker::isSilent() const {
+    return _silent;
+}
+
+bool PresenceTracker::matches(const uint8_t* uid, uint8_t uidLength) const {
+    return uidLength == _uidLength && uidLength > 0 && memcmp(uid, _uid, uidLength) == 0;
+}
+
+const uint8_t* PresenceTracker::uid() const {
+    return _uid;
+}
+
+uint8_t PresenceTracker::uidLength() const {
+    return _uidLength;
+}
+
+uint32_t PresenceTracker::lastSeenMs() const {
+    return _lastSeenMs;
+}
+
+uint32_t PresenceTracker::startMs() const {
+    return _startMs;
+}
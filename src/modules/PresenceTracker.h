@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Presence checks re-select the last read UID instead of re-reading it.
+#define NFC_PRESENCE_INTERVAL_MS 150
+#define NFC_PRESENCE_TIMEOUT_MS  30
+#define NFC_PRESENCE_MISSES      2
+
+// Whether the last read tag is still on the reader, fed with the outcome
+// of each presence check. NFC_PRESENCE_MISSES failed checks in a row make
+// it removed, so a single dropped transaction does not pause the story.
+// The tracked UID is kept after removal to recognise the tag coming back.
+// No Arduino dependencies so the timing can be simulated on the host.
+class PresenceTracker {
+public:
+    void start(const uint8_t* uid, uint8_t uidLength, uint32_t nowMs, bool silent);
+    // True on the check that declares the tag removed.
+    bool update(bool seen, uint32_t nowMs);
+    void forget();
+
+    bool isPresent() const;
+    bool isSilent() const;
+    bool matches(const uint8_t* uid, uint8_t uidLength) const;
+    const uint8_t* uid() const;
+    uint8_t uidLength() const;
+    uint32_t lastSeenMs() const;
+    uint32_t startMs() const;
+
+private:
+    uint8_t _uid[7];
+    volatile uint8_t _uidLength = 0;
+    volatile bool _present = false;
+    bool _silent = false;
+    uint8_t _misses = 0;
+    volatile uint32_t _lastSeenMs = 0;
+    uint32_t _startMs = 0;
+};
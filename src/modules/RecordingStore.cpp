@@ -0,0 +1,241 @@
+#include "RecordingStore.h"
+
+#define DEBUG_REC 1
+#if DEBUG_REC
+    #define LOG_REC(msg) Serial.println("[REC] " msg)
+    #define LOG_REC_F(fmt, ...) Serial.printf("[REC] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_REC(msg)
+    #define LOG_REC_F(fmt, ...)
+#endif
+
+#define RECORD_INDEX_MAGIC 0x31584952UL  // "RIX1"
+#define RECORD_INDEX_TMP   "/records/index.tmp"
+
+void RecordingStore::slotPath(uint8_t slot, uint16_t gen, char* path, size_t size) {
+    snprintf(path, size, DIR_RECORDS "/s%02u_%u.wav", slot, gen);
+}
+
+bool RecordingStore::begin() {
+    memset(_entries, 0, sizeof(_entries));
+    memset(_pending, 0, sizeof(_pending));
+    _seq = 0;
+    _staleCount = 0;
+    if (!SD.exists(DIR_RECORDS)) SD.mkdir(DIR_RECORDS);
+
+    File file = SD.open(FILE_RECORD_INDEX);
+    if (file) {
+        uint32_t magic = 0;
+        bool ok = file.read((uint8_t*)&magic, 4) == 4 && magic == RECORD_INDEX_MAGIC &&
+                  file.read((uint8_t*)&_seq, 4) == 4 &&
+                  file.read((uint8_t*)_entries, sizeof(_entries)) == sizeof(_entries);
+        file.close();
+        if (!ok) {
+            LOG_REC("Index unreadable, starting empty");
+            memset(_entries, 0, sizeof(_entries));
+            _seq = 0;
+        }
+    }
+
+    // Generations the index does not point at are interrupted uploads or
+    // replaced files that were never collected.
+    File dir = SD.open(DIR_RECORDS);
+    if (dir) {
+        char path[RECORD_PATH_LEN];
+        File entry = dir.openNextFile();
+        while (entry) {
+            unsigned slot, gen;
+            bool orphan = !entry.isDirectory() && sscanf(entry.name(), "s%u_%u.wav", &slot, &gen) == 2 &&
+                          (slot >= RECORD_SLOTS || _entries[slot].gen != gen);
+            if (orphan) snprintf(path, sizeof(path), DIR_RECORDS "/%s", entry.name());
+            entry.close();
+            if (orphan) SD.remove(path);
+            entry = dir.openNextFile();
+        }
+        dir.close();
+    }
+
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < RECORD_SLOTS; i++) {
+        if (_entries[i].gen) used++;
+    }
+    _legacy = SD.exists(FILE_CUSTOM_STORY);
+    _ready = true;
+    LOG_REC_F("%u/%u slots used%s", used, RECORD_SLOTS, _legacy ? ", legacy recording present" : "");
+    return true;
+}
+
+int8_t RecordingStore::find(const char* uid) {
+    for (uint8_t i = 0; i < RECORD_SLOTS; i++) {
+        if (_entries[i].uid[0] && strncmp(_entries[i].uid, uid, RECORD_UID_LEN) == 0) return i;
+    }
+    return -1;
+}
+
+// Existing slot for the UID, else a free one, else the least recently
+// written slot that is not being uploaded into.
+int8_t RecordingStore::claim(const char* uid) {
+    int8_t slot = find(uid);
+    if (slot >= 0) return slot;
+    for (uint8_t i = 0; i < RECORD_SLOTS; i++) {
+        if (!_entries[i].uid[0]) return i;
+    }
+    for (uint8_t i = 0; i < RECORD_SLOTS; i++) {
+        if (_pending[i]) continue;
+        if (slot < 0 || _entries[i].seq < _entries[slot].seq) slot = i;
+    }
+    return slot;
+}
+
+bool RecordingStore::resolve(const char* uid, char* path, size_t size) {
+    if (!_ready || !uid[0]) return false;
+    portENTER_CRITICAL(&_mux);
+    int8_t slot = find(uid);
+    uint16_t gen = slot >= 0 ? _entries[slot].gen : 0;
+    portEXIT_CRITICAL(&_mux);
+    if (gen) {
+        slotPath(slot, gen, path, size);
+        return true;
+    }
+    if (!_legacy) return false;
+
+    char target[RECORD_PATH_LEN];
+    slot = beginWrite(uid, target, sizeof(target));
+    if (slot < 0) return false;
+    File file = SD.open(FILE_CUSTOM_STORY);
+    uint32_t bytes = file ? file.size() : 0;
+    if (file) file.close();
+    if (!bytes || !SD.rename(FILE_CUSTOM_STORY, target)) {
+        abort(slot);
+        return false;
+    }
+    _legacy = false;
+    commit(slot, bytes);
+    LOG_REC_F("Legacy recording adopted by %s", uid);
+    snprintf(path, size, "%s", target);
+    return true;
+}
+
+int8_t RecordingStore::beginWrite(const char* uid, char* path, size_t size) {
+    if (!_ready || !uid[0]) return -1;
+    portENTER_CRITICAL(&_mux);
+    int8_t slot = claim(uid);
+    if (slot >= 0) {
+        Entry& e = _entries[slot];
+        if (strncmp(e.uid, uid, RECORD_UID_LEN) != 0) {
+            // Evicted or fresh: the previous owner loses its recording now.
+            if (e.gen && _staleCount < RECORD_SLOTS) {
+                _staleSlot[_staleCount] = slot;
+                _stale[_staleCount++] = e.gen;
+            }
+            strncpy(e.uid, uid, RECORD_UID_LEN - 1);
+            e.uid[RECORD_UID_LEN - 1] = '\0';
+            e.gen = 0;
+            e.bytes = 0;
+        }
+        // Generations only ever grow within a slot, so a new file can never
+        // share a name with one that is still playing or waiting in collect().
+        if (++e.lastGen == 0) e.lastGen = 1;
+        _pending[slot] = e.lastGen;
+        slotPath(slot, e.lastGen, path, size);
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (slot < 0) LOG_REC_F("No slot free for %s", uid);
+    return slot;
+}
+
+bool RecordingStore::commit(int8_t slot, uint32_t bytes) {
+    if (slot < 0 || slot >= RECORD_SLOTS) return false;
+    portENTER_CRITICAL(&_mux);
+    Entry& e = _entries[slot];
+    if (e.gen && _staleCount < RECORD_SLOTS) {
+        _staleSlot[_staleCount] = slot;
+        _stale[_staleCount++] = e.gen;
+    }
+    e.gen = _pending[slot];
+    _pending[slot] = 0;
+    e.bytes = bytes;
+    e.seq = ++_seq;
+    portEXIT_CRITICAL(&_mux);
+    LOG_REC_F("Slot %d now holds %u bytes for %s", slot, (unsigned)bytes, e.uid);
+    return save();
+}
+
+void RecordingStore::abort(int8_t slot) {
+    if (slot < 0 || slot >= RECORD_SLOTS) return;
+    char path[RECORD_PATH_LEN];
+    portENTER_CRITICAL(&_mux);
+    uint16_t gen = _pending[slot];
+    _pending[slot] = 0;
+    if (!_entries[slot].gen) _entries[slot].uid[0] = '\0';
+    portEXIT_CRITICAL(&_mux);
+    if (!gen) return;
+    slotPath(slot, gen, path, sizeof(path));
+    SD.remove(path);
+}
+
+bool RecordingStore::save() {
+    Entry snapshot[RECORD_SLOTS];
+    portENTER_CRITICAL(&_mux);
+    memcpy(snapshot, _entries, sizeof(snapshot));
+    uint32_t seq = _seq;
+    portEXIT_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < RECORD_SLOTS; i++) {
+        if (!snapshot[i].gen) memset(snapshot[i].uid, 0, RECORD_UID_LEN);
+    }
+
+    File file = SD.open(RECORD_INDEX_TMP, FILE_WRITE);
+    if (!file) return false;
+    uint32_t magic = RECORD_INDEX_MAGIC;
+    bool ok = file.write((const uint8_t*)&magic, 4) == 4 &&
+              file.write((const uint8_t*)&seq, 4) == 4 &&
+              file.write((const uint8_t*)snapshot, sizeof(snapshot)) == sizeof(snapshot);
+    file.close();
+    if (!ok) return false;
+    SD.remove(FILE_RECORD_INDEX);
+    return SD.rename(RECORD_INDEX_TMP, FILE_RECORD_INDEX);
+}
+
+// Called from the main loop with the file the player has open, which is
+// never deleted from under it.
+void RecordingStore::collect(const char* activePath) {
+    char path[RECORD_PATH_LEN];
+    for (uint8_t i = 0;;) {
+        // Uploads append under the lock from the AsyncTCP task; only this
+        // loop removes, so entry i stays put while the file is deleted.
+        portENTER_CRITICAL(&_mux);
+        bool more = i < _staleCount;
+        uint8_t slot = more ? _staleSlot[i] : 0;
+        uint16_t gen = more ? _stale[i] : 0;
+        portEXIT_CRITICAL(&_mux);
+        if (!more) break;
+        slotPath(slot, gen, path, sizeof(path));
+        if (activePath && strcmp(path, activePath) == 0) {
+            i++;
+            continue;
+        }
+        SD.remove(path);
+        portENTER_CRITICAL(&_mux);
+        _staleCount--;
+        _staleSlot[i] = _staleSlot[_staleCount];
+        _stale[i] = _stale[_staleCount];
+        portEXIT_CRITICAL(&_mux);
+    }
+}
+
+size_t RecordingStore::writeJson(char* buffer, size_t size) {
+    int n = snprintf(buffer, size, "{\"slots\":%u,\"recordings\":[", RECORD_SLOTS);
+    bool first = true;
+    for (uint8_t i = 0; i < RECORD_SLOTS && n > 0 && (size_t)n < size; i++) {
+        portENTER_CRITICAL(&_mux);
+        Entry e = _entries[i];
+        bool uploading = _pending[i] != 0;
+        portEXIT_CRITICAL(&_mux);
+        if (!e.gen && !uploading) continue;
+        n += snprintf(buffer + n, size - n, "%s{\"slot\":%u,\"uid\":\"%s\",\"bytes\":%u,\"uploading\":%s}",
+                      first ? "" : ",", i, e.uid, (unsigned)e.bytes, uploading ? "true" : "false");
+        first = false;
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "]}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
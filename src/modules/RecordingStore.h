@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "Config.h"
+
+#define RECORD_UID_LEN  16
+#define RECORD_PATH_LEN 32
+
+// Custom recordings keyed by figurine UID. Each of RECORD_SLOTS slots maps a
+// UID to a file; the slot table is a small fixed-size index on SD that is
+// read once in begin() and rewritten (via a temp file) on every change, so
+// lookups never touch the card.
+//
+// An upload writes a new generation of its slot's file and only switches
+// the index over in commit(), so a slot can keep playing while another one,
+// or a new version of itself, is being uploaded. Replaced generations are
+// deleted by collect() once they are no longer playing. When every slot is
+// taken, the least recently written one is reused.
+//
+// The index is shared between the AsyncTCP task (uploads) and the main
+// task (lookups); entries are copied under a spinlock.
+class RecordingStore {
+public:
+    bool begin();
+
+    // Resolves a UID to its recording. A pre-slot FILE_CUSTOM_STORY is
+    // adopted by the first UID that asks and has no slot of its own.
+    bool resolve(const char* uid, char* path, size_t size);
+    void setLegacyPresent(bool present) { _legacy = present; }
+
+    int8_t beginWrite(const char* uid, char* path, size_t size);
+    bool commit(int8_t slot, uint32_t bytes);
+    void abort(int8_t slot);
+
+    void collect(const char* activePath);
+    size_t writeJson(char* buffer, size_t size);
+
+private:
+    struct Entry {
+        char uid[RECORD_UID_LEN];
+        uint32_t bytes;
+        uint32_t seq;
+        uint16_t gen;
+        uint16_t lastGen;
+    };
+    Entry _entries[RECORD_SLOTS];
+    uint16_t _pending[RECORD_SLOTS];
+    uint32_t _seq = 0;
+    bool _legacy = false;
+    bool _ready = false;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    uint16_t _stale[RECORD_SLOTS];
+    uint8_t _staleSlot[RECORD_SLOTS];
+    uint8_t _staleCount = 0;
+
+    int8_t find(const char* uid);
+    int8_t claim(const char* uid);
+    bool save();
+    static void slotPath(uint8_t slot, uint16_t gen, char* path, size_t size);
+};
@@ -0,0 +1,194 @@
+#include "Resampler.h"
+#include <math.h>
+#include <string.h>
+#include "../utils/MemoryArena.h"
+
+struct QualityParams {
+    uint8_t taps;
+    float cutoff;   // Fraction of the lower Nyquist frequency at -6 dB.
+    float beta;     // Kaiser window shape.
+};
+
+static const QualityParams QUALITY[RESAMPLE_QUALITY_COUNT] = {
+    { 8, 0.80f, 4.0f },
+    { 16, 0.88f, 6.0f },
+    { 32, 0.94f, 8.0f },
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, by its power series.
+static float besselI0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    float q = x * x / 4.0f;
+    for (int k = 1; k < 32 && term > sum * 1e-7f; k++) {
+        term *= q / (float)(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+static inline int16_t saturate(int32_t v) {
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return (int16_t)v;
+}
+
+const char* Resampler::qualityName(ResampleQuality quality) {
+    static const char* const NAMES[RESAMPLE_QUALITY_COUNT] = { "low", "medium", "high" };
+    return quality < RESAMPLE_QUALITY_COUNT ? NAMES[quality] : "?";
+}
+
+bool Resampler::begin() {
+    if (!_coeffs) {
+        _coeffs = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, RESAMPLE_MAX_PHASES * RESAMPLE_MAX_TAPS * sizeof(int16_t), MEM_AUDIO);
+    }
+    return _coeffs != nullptr;
+}
+
+void Resampler::configure(uint32_t inRate, uint32_t outRate, ResampleQuality quality) {
+    if (quality >= RESAMPLE_QUALITY_COUNT) quality = RESAMPLE_MEDIUM;
+    if (inRate == _inRate && outRate == _outRate && quality == _quality && _taps) {
+        reset();
+        return;
+    }
+    _inRate = inRate;
+    _outRate = outRate;
+    _quality = quality;
+    _taps = QUALITY[quality].taps;
+    uint32_t g = gcd(inRate, outRate);
+    _up = g ? outRate / g : 1;
+    _down = g ? inRate / g : 1;
+    _stepInt = _down / _up;
+    _stepFrac = _down % _up;
+    _phases = _up < RESAMPLE_MAX_PHASES ? _up : RESAMPLE_MAX_PHASES;
+    if (!isBypass()) build();
+    reset();
+}
+
+// Branch p holds the taps for an output that lies p/phases of an input
+// frame past the newest-but-half frame of the window.
+void Resampler::build() {
+    const QualityParams& q = QUALITY[_quality];
+    float fc = 0.5f * q.cutoff * (_up < _down ? (float)_up / _down : 1.0f);
+    float half = _taps / 2.0f;
+    float norm = besselI0(q.beta);
+    float taps[RESAMPLE_MAX_TAPS];
+    for (uint16_t p = 0; p < _phases; p++) {
+        float frac = (float)p / _phases;
+        float sum = 0.0f;
+        for (uint8_t j = 0; j < _taps; j++) {
+            float x = (float)j - (half - 1.0f) - frac;
+            float r = x / half;
+            float window = r * r < 1.0f ? besselI0(q.beta * sqrtf(1.0f - r * r)) / norm : 0.0f;
+            float arg = 2.0f * (float)M_PI * fc * x;
+            float sinc = fabsf(arg) < 1e-6f ? 1.0f : sinf(arg) / arg;
+            taps[j] = 2.0f * fc * sinc * window;
+            sum += taps[j];
+        }
+        // Unity gain per branch, so no branch adds a DC step.
+        int16_t* c = _coeffs + p * _taps;
+        for (uint8_t j = 0; j < _taps; j++) c[j] = saturate(lroundf(taps[j] / sum * 32768.0f));
+    }
+}
+
+void Resampler::reset() {
+    // Half a window of silence ahead of the first frame, so the first
+    // output is centred on it.
+    _fill = _taps ? _taps / 2 - 1 : 0;
+    memset(_buf, 0, _fill * 2 * sizeof(int16_t));
+    _pos = 0;
+    _phase = 0;
+}
+
+bool Resampler::isBypass() {
+    return _up == _down || !_coeffs;
+}
+
+uint32_t Resampler::getInputRate() {
+    return _inRate;
+}
+
+ResampleQuality Resampler::getQuality() {
+    return _quality;
+}
+
+uint8_t Resampler::getTaps() {
+    return _taps;
+}
+
+uint16_t Resampler::getPhases() {
+    return isBypass() ? 0 : _phases;
+}
+
+size_t Resampler::maxInput(size_t outFrames) {
+    if (isBypass()) return outFrames;
+    if (outFrames < 2) return 0;
+    return (size_t)((uint64_t)(outFrames - 1) * _down / _up);
+}
+
+size_t Resampler::process(const int16_t* in, size_t frames, int16_t* out, size_t outFrames, size_t* consumed) {
+    if (isBypass()) {
+        if (frames > outFrames) frames = outFrames;
+        memcpy(out, in, frames * 2 * sizeof(int16_t));
+        if (consumed) *consumed = frames;
+        return frames;
+    }
+    size_t produced = 0;
+    size_t taken = 0;
+    while (true) {
+        // Input an earlier call left in the buffer comes out first.
+        produced += run(out + produced * 2, outFrames - produced);
+        // Keep the frames the next outputs still need at the front. A large
+        // downsampling step can point past the buffer into input not seen yet.
+        size_t keep = _pos < _fill ? _fill - _pos : 0;
+        memmove(_buf, _buf + (_fill - keep) * 2, keep * 2 * sizeof(int16_t));
+        _pos -= _fill - keep;
+        _fill = keep;
+        if (taken == frames) break;
+
+        size_t room = RESAMPLE_MAX_TAPS + RESAMPLE_BLOCK - _fill;
+        size_t take = frames - taken < room ? frames - taken : room;
+        // Full of input whose output has no room yet; the rest is left.
+        if (take == 0) break;
+        memcpy(_buf + _fill * 2, in + taken * 2, take * 2 * sizeof(int16_t));
+        _fill += take;
+        taken += take;
+    }
+    if (consumed) *consumed = taken;
+    return produced;
+}
+
+size_t Resampler::run(int16_t* out, size_t outFrames) {
+    size_t produced = 0;
+    while (produced < outFrames && _pos + _taps <= _fill) {
+        uint32_t branch = _phases == _up ? _phase : _phase * _phases / _up;
+        const int16_t* c = _coeffs + branch * _taps;
+        const int16_t* x = _buf + _pos * 2;
+        int32_t left = 0;
+        int32_t right = 0;
+        for (uint8_t j = 0; j < _taps; j++) {
+            left += x[2 * j] * c[j];
+            right += x[2 * j + 1] * c[j];
+        }
+        out[2 * produced] = saturate((left + (1 << 14)) >> 15);
+        out[2 * produced + 1] = saturate((right + (1 << 14)) >> 15);
+        produced++;
+
+        _pos += _stepInt;
+        _phase += _stepFrac;
+        if (_phase >= _up) {
+            _phase -= _up;
+            _pos++;
+        }
+    }
+    return produced;
+}
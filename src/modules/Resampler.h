@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESAMPLE_MAX_TAPS    32
+#define RESAMPLE_MAX_PHASES  256
+#define RESAMPLE_BLOCK       256
+
+enum ResampleQuality : uint8_t {
+    RESAMPLE_LOW,
+    RESAMPLE_MEDIUM,
+    RESAMPLE_HIGH,
+    RESAMPLE_QUALITY_COUNT
+};
+
+// Sample-rate conversion for interleaved stereo PCM16 with a Kaiser-windowed
+// sinc split into polyphase branches. The ratio is reduced to L/M, so the
+// usual pairs (22.05, 44.1 and 48 kHz) step exactly through L branches;
+// ratios needing more than RESAMPLE_MAX_PHASES use that many and take the
+// branch at or just before the exact phase (up to 1/RESAMPLE_MAX_PHASES of
+// a frame early).
+// Coefficients are Q15, built once per ratio and quality; the filter itself
+// is integer only. Input is buffered in blocks of up to RESAMPLE_BLOCK
+// frames, output lags input by half the filter length.
+class Resampler {
+public:
+    bool begin();
+    void configure(uint32_t inRate, uint32_t outRate, ResampleQuality quality);
+    // Clears the filter history, e.g. between tracks.
+    void reset();
+    bool isBypass();
+    uint32_t getInputRate();
+    ResampleQuality getQuality();
+    uint8_t getTaps();
+    uint16_t getPhases();
+
+    // Most input frames one process() call may take with `outFrames` of room.
+    size_t maxInput(size_t outFrames);
+    // Returns the output frames written. Input is taken as long as there is
+    // room for what it produces; `consumed` gets how many frames that was,
+    // which is all of them when `frames` <= maxInput(outFrames).
+    size_t process(const int16_t* in, size_t frames, int16_t* out, size_t outFrames, size_t* consumed = nullptr);
+
+    static const char* qualityName(ResampleQuality quality);
+
+private:
+    int16_t* _coeffs = nullptr;
+    int16_t _buf[(RESAMPLE_MAX_TAPS + RESAMPLE_BLOCK) * 2];
+    size_t _fill = 0;
+    size_t _pos = 0;
+
+    uint32_t _inRate = 0;
+    uint32_t _outRate = 0;
+    ResampleQuality _quality = RESAMPLE_MEDIUM;
+    uint8_t _taps = 0;
+    uint32_t _up = 1;
+    uint32_t _down = 1;
+    uint16_t _phases = 0;
+    uint32_t _phase = 0;
+    uint32_t _stepInt = 0;
+    uint32_t _stepFrac = 0;
+
+    void build();
+    size_t run(int16_t* out, size_t outFrames);
+};
@@ -0,0 +1,296 @@
+#include "SessionLog.h"
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_SESSION 1
+#if DEBUG_SESSION
+    #define LOG_SESSION(msg) Serial.println("[SES] " msg)
+    #define LOG_SESSION_F(fmt, ...) Serial.printf("[SES] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_SESSION(msg)
+    #define LOG_SESSION_F(fmt, ...)
+#endif
+
+#define SESSION_HEADER_BYTES 11
+
+static const char* const TYPE_NAMES[SES_TYPE_COUNT] = {
+    "boot", "tag", "presence", "button", "audio", "web", "state", "command", "replay"
+};
+
+static bool isInput(uint8_t type) {
+    return type >= SES_TAG && type <= SES_WEB;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool SessionLog::begin() {
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!_buffers[i]) _buffers[i] = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, SESSION_BUFFER_BYTES, MEM_MAIN);
+        if (!_buffers[i]) return false;
+    }
+    if (!SD.exists("/system")) SD.mkdir("/system");
+    File file = SD.open(SESSION_LOG_FILE);
+    _fileBytes = 0;
+    if (file) {
+        _fileBytes = file.size();
+        file.close();
+        if (_fileBytes > SESSION_MAX_FILE_BYTES) rotate();
+    }
+    _ready = true;
+    record(SES_BOOT);
+    return true;
+}
+
+void SessionLog::record(SessionEventType type, uint8_t arg, uint32_t value) {
+    append(type, arg, value, nullptr, 0);
+}
+
+void SessionLog::recordTag(const char* uid, const char* content) {
+    char text[SESSION_MAX_TEXT];
+    size_t uidLen = strnlen(uid, SESSION_MAX_TEXT - 1);
+    memcpy(text, uid, uidLen);
+    text[uidLen] = '\0';
+    size_t contentLen = strnlen(content, SESSION_MAX_TEXT - 1 - uidLen);
+    memcpy(text + uidLen + 1, content, contentLen);
+    append(SES_TAG, 0, 0, text, uidLen + 1 + contentLen);
+}
+
+void SessionLog::recordEffect(SessionEventType type, uint8_t arg) {
+    uint32_t latencyUs = 0;
+    portENTER_CRITICAL(&_mux);
+    if (_pendingInputUs) {
+        latencyUs = micros() - _pendingInputUs;
+        if (latencyUs > SESSION_LATENCY_WINDOW_US) latencyUs = 0;
+        _pendingInputUs = 0;
+    }
+    portEXIT_CRITICAL(&_mux);
+    append(type, arg, latencyUs, nullptr, 0);
+}
+
+void SessionLog::append(SessionEventType type, uint8_t arg, uint32_t value, const char* text, uint8_t len) {
+    if (!_ready) return;
+    uint32_t ms = millis();
+    uint8_t header[SESSION_HEADER_BYTES];
+    put32(header, ms);
+    put32(header + 4, value);
+    header[8] = type;
+    header[9] = arg;
+    header[10] = len;
+
+    portENTER_CRITICAL(&_mux);
+    if (isInput(type)) _pendingInputUs = micros() | 1;
+    uint8_t* buffer = _buffers[_active];
+    uint16_t& fill = _fill[_active];
+    if (fill + SESSION_HEADER_BYTES + len <= SESSION_BUFFER_BYTES) {
+        memcpy(buffer + fill, header, SESSION_HEADER_BYTES);
+        if (len) memcpy(buffer + fill + SESSION_HEADER_BYTES, text, len);
+        fill += SESSION_HEADER_BYTES + len;
+    } else {
+        _dropped++;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (_replaying) echo(ms, type, arg, value, text, len);
+}
+
+void SessionLog::echo(uint32_t ms, SessionEventType type, uint8_t arg, uint32_t value, const char* text, uint8_t len) {
+    if (type == SES_TAG) {
+        const char* content = text + strnlen(text, len) + 1;
+        int contentLen = len - (content - text);
+        Serial.printf("[SES] %u %s %u %u %s %.*s\n", (unsigned)ms, TYPE_NAMES[type], arg, (unsigned)value,
+                      text, contentLen > 0 ? contentLen : 0, content);
+    } else {
+        Serial.printf("[SES] %u %s %u %u\n", (unsigned)ms, TYPE_NAMES[type], arg, (unsigned)value);
+    }
+}
+
+void SessionLog::flush() {
+    portENTER_CRITICAL(&_mux);
+    uint8_t full = _active;
+    _active ^= 1;
+    uint32_t dropped = _dropped;
+    _dropped = 0;
+    portEXIT_CRITICAL(&_mux);
+
+    if (_fill[full]) {
+        if (_fileBytes + _fill[full] > SESSION_MAX_FILE_BYTES) rotate();
+        File file = SD.open(SESSION_LOG_FILE, FILE_APPEND);
+        if (file) {
+            _fileBytes += file.write(_buffers[full], _fill[full]);
+            file.close();
+        }
+        _fill[full] = 0;
+    }
+    if (dropped) LOG_SESSION_F("%u records dropped, buffer full", (unsigned)dropped);
+}
+
+void SessionLog::rotate() {
+    SD.remove(SESSION_HISTORY_FILE);
+    SD.rename(SESSION_LOG_FILE, SESSION_HISTORY_FILE);
+    LOG_SESSION_F("Log reached %u bytes, kept as %s", (unsigned)_fileBytes, SESSION_HISTORY_FILE);
+    _fileBytes = 0;
+}
+
+uint32_t SessionLog::now() {
+    if (!_replaying) return millis() + _clockOffset;
+    return _replayNow;
+}
+
+// The history ends where the log starts, so a boot cut by the rotation is
+// whole again in the copy.
+bool SessionLog::copyLogs() {
+    SD.remove(SESSION_REPLAY_FILE);
+    File dst = SD.open(SESSION_REPLAY_FILE, FILE_WRITE);
+    if (!dst) return false;
+    static const char* const SOURCES[] = { SESSION_HISTORY_FILE, SESSION_LOG_FILE };
+    uint8_t chunk[512];
+    bool copied = false;
+    for (const char* path : SOURCES) {
+        File src = SD.open(path);
+        if (!src) continue;
+        size_t n;
+        while ((n = src.read(chunk, sizeof(chunk))) > 0) dst.write(chunk, n);
+        src.close();
+        copied = true;
+    }
+    dst.close();
+    return copied;
+}
+
+void SessionLog::onReplay(SessionReplayCallback callback) {
+    _replayCallback = callback;
+}
+
+// The replay reads a copy of the logs so its own records can keep going to
+// the original. bootsBack 0 is the current boot, 1 the one before it, and
+// so on. Record times are taken relative to the first record of the boot,
+// which is not SES_BOOT when the history starts in the middle of one.
+bool SessionLog::startReplay(uint8_t speed, uint8_t bootsBack) {
+    if (!_ready || _replaying || speed == 0) return false;
+    flush();
+    if (!copyLogs()) return false;
+    _replayFile = SD.open(SESSION_REPLAY_FILE);
+    if (!_replayFile) return false;
+
+    uint32_t boots[SESSION_MAX_BOOTS];
+    uint8_t count = 0;
+    uint8_t header[SESSION_HEADER_BYTES];
+    while (_replayFile.read(header, SESSION_HEADER_BYTES) == SESSION_HEADER_BYTES) {
+        uint32_t offset = _replayFile.position() - SESSION_HEADER_BYTES;
+        // After a rotation the file starts in the middle of a boot.
+        if (header[8] == SES_BOOT || offset == 0) {
+            if (count == SESSION_MAX_BOOTS) {
+                memmove(boots, boots + 1, sizeof(boots) - sizeof(boots[0]));
+                count--;
+            }
+            boots[count++] = offset;
+        }
+        _replayFile.seek(_replayFile.position() + header[10]);
+    }
+    if (bootsBack >= count) {
+        LOG_SESSION_F("Replay: only %u boot(s) in the log", count);
+        _replayFile.close();
+        return false;
+    }
+    uint8_t segment = count - 1 - bootsBack;
+    _replayEnd = segment + 1 < count ? boots[segment + 1] : _replayFile.size();
+    _replayFile.seek(boots[segment]);
+    _replayFile.read(header, SESSION_HEADER_BYTES);
+    _replayBaseMs = get32(header);
+    _replayFile.seek(boots[segment]);
+
+    _speed = speed;
+    _replayed = 0;
+    _havePending = false;
+    // The replay clock carries on from the current time.
+    _replayClockMs = now();
+    _replayNow = _replayClockMs;
+    _replayStart = millis();
+    _replaying = true;
+    record(SES_REPLAY, 1, speed);
+    LOG_SESSION_F("Replaying %u bytes at %ux", (unsigned)(_replayEnd - boots[segment]), speed);
+    return true;
+}
+
+void SessionLog::stopReplay() {
+    if (!_replaying) return;
+    _replayFile.close();
+    record(SES_REPLAY, 0, _replayed);
+    _clockOffset = now() - millis();
+    _replaying = false;
+    LOG_SESSION_F("Replay done: %u inputs in %lu ms", (unsigned)_replayed, millis() - _replayStart);
+}
+
+bool SessionLog::readNext() {
+    uint8_t header[SESSION_HEADER_BYTES];
+    while (_replayFile.position() + SESSION_HEADER_BYTES <= _replayEnd) {
+        if (_replayFile.read(header, SESSION_HEADER_BYTES) != SESSION_HEADER_BYTES) return false;
+        uint8_t len = header[10];
+        if (!isInput(header[8])) {
+            _replayFile.seek(_replayFile.position() + len);
+            continue;
+        }
+        uint8_t keep = len < SESSION_MAX_TEXT ? len : SESSION_MAX_TEXT;
+        _replayFile.read((uint8_t*)_text, keep);
+        if (keep < len) _replayFile.seek(_replayFile.position() + len - keep);
+        _text[keep] = '\0';
+
+        _next.ms = get32(header);
+        _next.value = get32(header + 4);
+        _next.type = header[8];
+        _next.arg = header[9];
+        _next.uid = _text;
+        _next.content = _text + strnlen(_text, keep);
+        if (_next.content < _text + keep) _next.content++;
+        return true;
+    }
+    return false;
+}
+
+// The clock stops at the next input for one loop before the input is fed
+// back, so the timers that fired before it live (a track gap, a prompt
+// timeout) fire before it here too, however long a loop takes.
+void SessionLog::stepReplay() {
+    if (_havePending && _replayNow == _replayClockMs + (_next.ms - _replayBaseMs)) {
+        _havePending = false;
+        _replayed++;
+        if (_next.type == SES_TAG) recordTag(_next.uid, _next.content);
+        else record((SessionEventType)_next.type, _next.arg, _next.value);
+        if (_replayCallback) _replayCallback(_next);
+    }
+    if (!_havePending) {
+        if (!readNext()) {
+            stopReplay();
+            return;
+        }
+        _havePending = true;
+    }
+    uint32_t due = _replayClockMs + (_next.ms - _replayBaseMs);
+    uint32_t clock = _replayClockMs + (millis() - _replayStart) * _speed;
+    _replayNow = (int32_t)(clock - due) < 0 ? clock : due;
+}
+
+bool SessionLog::handleCommand(const char* line) {
+    if (strncmp(line, "replay", 6) != 0 || (line[6] != ' ' && line[6] != '\0')) return false;
+    if (strcmp(line + 6, " stop") == 0) {
+        stopReplay();
+        return true;
+    }
+    unsigned speed = 10, back = 1;
+    sscanf(line + 6, "%u %u", &speed, &back);
+    if (!startReplay(speed > 255 ? 255 : speed, back)) LOG_SESSION("Replay not started");
+    return true;
+}
+
+void SessionLog::loop() {
+    if (!_ready) return;
+    if (_replaying) stepReplay();
+    if (millis() - _lastFlush < SESSION_FLUSH_MS && _fill[_active] < SESSION_BUFFER_BYTES / 2) return;
+    _lastFlush = millis();
+    flush();
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <functional>
+
+#define SESSION_LOG_FILE       "/system/session.bin"
+#define SESSION_HISTORY_FILE   "/system/session.old"
+#define SESSION_REPLAY_FILE    "/system/replay.bin"
+#define SESSION_BUFFER_BYTES   2048
+#define SESSION_FLUSH_MS       5000
+#define SESSION_MAX_FILE_BYTES (64 * 1024)
+#define SESSION_MAX_TEXT       64
+#define SESSION_MAX_BOOTS      16
+#define SESSION_LATENCY_WINDOW_US 2000000UL
+
+enum SessionEventType : uint8_t {
+    SES_BOOT,
+    SES_TAG,        // text = "<uid>\0<content>"
+    SES_PRESENCE,   // arg = NfcPresenceEvent
+    SES_BUTTON,     // arg = SessionButton
+    SES_AUDIO,      // arg = isPlaying, or SES_AUDIO_TRACK_END
+    SES_WEB,        // arg = SessionWebAction, value = its parameter
+    SES_STATE,      // arg = from << 4 | to, value = latency in us
+    SES_COMMAND,    // arg = BusCommandType, value = latency in us
+    SES_REPLAY,     // arg = 1 on start, 0 on end, value = speed
+    SES_TYPE_COUNT
+};
+
+// The loop saw the track finish; playback moves on SESSION_TRACK_GAP_MS later.
+#define SES_AUDIO_TRACK_END 2
+#define SESSION_TRACK_GAP_MS 500
+
+enum SessionButton : uint8_t {
+    SES_BTN_VOL_CLICK,
+    SES_BTN_VOL_LONG,
+    SES_BTN_CTRL_CLICK,
+    SES_BTN_CTRL_LONG,
+    SES_BTN_COMBO
+};
+
+enum SessionWebAction : uint8_t {
+    SES_WEB_VOLUME,
+    SES_WEB_SPEED,
+    SES_WEB_LED,
+    SES_WEB_STREAM,
+    SES_WEB_UPLOAD
+};
+
+struct SessionEvent {
+    uint32_t ms;
+    uint32_t value;
+    uint8_t type;
+    uint8_t arg;
+    const char* uid;
+    const char* content;
+};
+
+typedef std::function<void(const SessionEvent&)> SessionReplayCallback;
+
+// Compact log of everything that drives the main state machine: tag reads,
+// presence changes, button gestures, audio state callbacks and portal
+// actions, plus the state transitions and commands they caused. The first
+// effect after an input carries its latency from that input; effects more
+// than two seconds later are logged as unattributed (latency 0).
+//
+// On SD each record is an 11-byte little-endian header (ms, value, type,
+// arg, text length) followed by the text. Recording is safe from any task;
+// the file is only touched from loop(). A replay feeds a previous boot's
+// inputs back through the same handlers at N times real speed, with live
+// inputs ignored, and echoes every record to serial as "[SES] ..." lines
+// for scripts/session_replay.py. Timers in the state machine read now(),
+// which runs at the replay's speed and is only moved by loop(), so their
+// timeouts replay faithfully.
+//
+// The log is moved to SESSION_HISTORY_FILE whenever a flush would take it
+// past SESSION_MAX_FILE_BYTES. A replay reads SESSION_REPLAY_FILE, a copy
+// of the history followed by the log, so boots from before the move can
+// still be replayed.
+class SessionLog {
+public:
+    bool begin();
+    void record(SessionEventType type, uint8_t arg = 0, uint32_t value = 0);
+    void recordTag(const char* uid, const char* content);
+    void recordEffect(SessionEventType type, uint8_t arg);
+
+    void onReplay(SessionReplayCallback callback);
+    bool startReplay(uint8_t speed, uint8_t bootsBack);
+    void stopReplay();
+    bool isReplaying() const { return _replaying; }
+    // Milliseconds like millis(), but N times faster during a replay.
+    uint32_t now();
+
+    // Serial console: "replay <speed> [boots back]", "replay stop".
+    bool handleCommand(const char* line);
+    void loop();
+
+private:
+    uint8_t* _buffers[2] = { nullptr, nullptr };
+    uint16_t _fill[2] = { 0, 0 };
+    uint8_t _active = 0;
+    uint32_t _dropped = 0;
+    uint32_t _pendingInputUs = 0;
+    unsigned long _lastFlush = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    bool _ready = false;
+
+    SessionReplayCallback _replayCallback;
+    File _replayFile;
+    volatile bool _replaying = false;
+    uint8_t _speed = 1;
+    uint32_t _replayEnd = 0;
+    uint32_t _replayBaseMs = 0;
+    unsigned long _replayStart = 0;
+    uint32_t _replayClockMs = 0;
+    uint32_t _replayNow = 0;
+    uint32_t _clockOffset = 0;
+    uint32_t _fileBytes = 0;
+    uint32_t _replayed = 0;
+    bool _havePending = false;
+    SessionEvent _next;
+    char _text[SESSION_MAX_TEXT + 1];
+
+    void append(SessionEventType type, uint8_t arg, uint32_t value, const char* text, uint8_t len);
+    void flush();
+    void rotate();
+    bool copyLogs();
+    bool readNext();
+    void stepReplay();
+    void echo(uint32_t ms, SessionEventType type, uint8_t arg, uint32_t value, const char* text, uint8_t len);
+};
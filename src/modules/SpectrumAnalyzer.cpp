@@ -0,0 +1,120 @@
+#include "SpectrumAnalyzer.h"
+#include <math.h>
+
+#define HALF (SPECTRUM_FFT_SIZE / 2)
+
+static inline int16_t mulQ15(int16_t a, int16_t b) {
+    return (int16_t)(((int32_t)a * b) >> 15);
+}
+
+// Q4 log2 of a 32-bit power value: integer part from the leading bit, the
+// fraction from the next four bits.
+static uint16_t log2Q4(uint32_t v) {
+    if (v == 0) return 0;
+    int msb = 31 - __builtin_clz(v);
+    uint32_t frac = msb >= 4 ? (v >> (msb - 4)) & 0x0F : (v << (4 - msb)) & 0x0F;
+    return (uint16_t)((msb << 4) | frac);
+}
+
+void SpectrumAnalyzer::begin() {
+    if (_ready) return;
+    for (int k = 0; k < HALF; k++) {
+        double a = 2.0 * M_PI * k / SPECTRUM_FFT_SIZE;
+        _cos[k] = (int16_t)lround(cos(a) * 32767.0);
+        _sin[k] = (int16_t)lround(sin(a) * 32767.0);
+    }
+    for (int n = 0; n < SPECTRUM_FFT_SIZE; n++) {
+        _hann[n] = (int16_t)lround(0.5 * (1.0 - cos(2.0 * M_PI * n / (SPECTRUM_FFT_SIZE - 1))) * 32767.0);
+    }
+    _ready = true;
+}
+
+void SpectrumAnalyzer::arm() {
+    _fill = 0;
+    _armed = true;
+}
+
+bool SpectrumAnalyzer::captured() {
+    return _armed && _fill >= SPECTRUM_FFT_SIZE;
+}
+
+void SpectrumAnalyzer::tap(const int16_t* stereo, size_t frames) {
+    for (size_t i = 0; i < frames && _fill < SPECTRUM_FFT_SIZE && _armed; i++) {
+        tap(stereo[2 * i], stereo[2 * i + 1]);
+    }
+}
+
+// In-place radix-2 DIT over the HALF-point complex sequence. W_HALF^k is
+// W_SIZE^(2k), so the SIZE-point tables serve both the FFT and the split.
+void SpectrumAnalyzer::fft() {
+    for (int i = 1, j = 0; i < HALF; i++) {
+        int bit = HALF >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            int16_t t = _re[i]; _re[i] = _re[j]; _re[j] = t;
+            t = _im[i]; _im[i] = _im[j]; _im[j] = t;
+        }
+    }
+
+    for (int len = 2; len <= HALF; len <<= 1) {
+        int half = len >> 1;
+        int step = SPECTRUM_FFT_SIZE / len;
+        for (int start = 0; start < HALF; start += len) {
+            for (int k = 0; k < half; k++) {
+                int16_t wr = _cos[k * step];
+                int16_t wi = -_sin[k * step];
+                int a = start + k;
+                int b = a + half;
+                int16_t tr = (int16_t)(((int32_t)_re[b] * wr - (int32_t)_im[b] * wi) >> 15);
+                int16_t ti = (int16_t)(((int32_t)_re[b] * wi + (int32_t)_im[b] * wr) >> 15);
+                int16_t ar = _re[a] >> 1;
+                int16_t ai = _im[a] >> 1;
+                tr >>= 1;
+                ti >>= 1;
+                _re[a] = ar + tr;
+                _im[a] = ai + ti;
+                _re[b] = ar - tr;
+                _im[b] = ai - ti;
+            }
+        }
+    }
+}
+
+void SpectrumAnalyzer::analyze(uint32_t sampleRate, uint16_t* bands) {
+    uint32_t power[SPECTRUM_BANDS] = { 0 };
+    _armed = false;
+
+    for (int n = 0; n < HALF; n++) {
+        _re[n] = mulQ15(_window[2 * n], _hann[2 * n]);
+        _im[n] = mulQ15(_window[2 * n + 1], _hann[2 * n + 1]);
+    }
+    fft();
+
+    // Split the packed transform: X[k] = (Z[k] + Z*[H-k]) / 2
+    //                                   - j W^k (Z[k] - Z*[H-k]) / 2
+    const uint32_t edges[SPECTRUM_BANDS - 1] = {
+        (uint32_t)SPECTRUM_EDGE_1 * SPECTRUM_FFT_SIZE / sampleRate,
+        (uint32_t)SPECTRUM_EDGE_2 * SPECTRUM_FFT_SIZE / sampleRate,
+        (uint32_t)SPECTRUM_EDGE_3 * SPECTRUM_FFT_SIZE / sampleRate,
+    };
+    int band = 0;
+    for (int k = 1; k < HALF; k++) {
+        int32_t zr = _re[k], zi = _im[k];
+        int32_t cr = _re[HALF - k], ci = -_im[HALF - k];
+        int32_t er = (zr + cr) >> 1, ei = (zi + ci) >> 1;
+        int32_t dr = (zr - cr) >> 1, di = (zi - ci) >> 1;
+        // -j * W^k * d, with W^k = cos - j sin
+        int32_t wr = _cos[k], wi = -_sin[k];
+        int32_t pr = (dr * wr - di * wi) >> 15;
+        int32_t pi = (dr * wi + di * wr) >> 15;
+        int32_t xr = er + pi;
+        int32_t xi = ei - pr;
+
+        while (band < SPECTRUM_BANDS - 1 && (uint32_t)k > edges[band]) band++;
+        uint32_t p = (uint32_t)(xr * xr) + (uint32_t)(xi * xi);
+        power[band] = (power[band] > UINT32_MAX - p) ? UINT32_MAX : power[band] + p;
+    }
+
+    for (int b = 0; b < SPECTRUM_BANDS; b++) bands[b] = log2Q4(power[b]);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPECTRUM_FFT_SIZE  256
+#define SPECTRUM_FFT_LOG2  8
+#define SPECTRUM_BANDS     4
+
+// Band edges in Hz: bass, low mids, high mids, treble.
+#define SPECTRUM_EDGE_1    250
+#define SPECTRUM_EDGE_2    1000
+#define SPECTRUM_EDGE_3    4000
+
+// Captures one window of the output on request and turns it into band
+// energies. The capture side is a couple of compares per frame when idle,
+// so it can sit in the I2S hook; analyze() runs outside it.
+//
+// The FFT is Q15 fixed point: the 256 real samples are packed as 128
+// complex points, transformed with a radix-2 FFT that halves every stage
+// to stay in range, then split into the 128 real-input bins. Twiddles and
+// the Hann window are tables built once in begin(). No Arduino dependencies.
+class SpectrumAnalyzer {
+public:
+    void begin();
+    void arm();
+    bool captured();
+
+    inline void tap(int16_t left, int16_t right) {
+        if (_fill < SPECTRUM_FFT_SIZE && _armed) {
+            _window[_fill++] = (int16_t)((left + right) >> 1);
+        }
+    }
+    void tap(const int16_t* stereo, size_t frames);
+
+    // Band energies as log2 of the power (0-31 per band, Q4 fixed point).
+    void analyze(uint32_t sampleRate, uint16_t* bands);
+
+private:
+    int16_t _window[SPECTRUM_FFT_SIZE];
+    volatile uint16_t _fill = SPECTRUM_FFT_SIZE;
+    volatile bool _armed = false;
+
+    int16_t _re[SPECTRUM_FFT_SIZE / 2];
+    int16_t _im[SPECTRUM_FFT_SIZE / 2];
+    int16_t _cos[SPECTRUM_FFT_SIZE / 2];
+    int16_t _sin[SPECTRUM_FFT_SIZE / 2];
+    int16_t _hann[SPECTRUM_FFT_SIZE];
+    bool _ready = false;
+
+    void fft();
+};
@@ -0,0 +1,63 @@
+#include "TagRouter.h"
+
+#define TAG_NODE_NONE 0xFF
+
+bool TagRouter::add(const char* prefix, TagHandler handler) {
+    if (_compiled || _routeCount >= TAG_ROUTER_MAX_ROUTES || !prefix || !*prefix) return false;
+    _routes[_routeCount].prefix = prefix;
+    _routes[_routeCount].handler = handler;
+    _routeCount++;
+    return true;
+}
+
+uint8_t TagRouter::findChild(uint8_t parent, char c) const {
+    uint8_t n = _nodes[parent].child;
+    while (n != TAG_NODE_NONE) {
+        if (_nodes[n].c == c) return n;
+        n = _nodes[n].sibling;
+    }
+    return TAG_NODE_NONE;
+}
+
+bool TagRouter::compile() {
+    _nodes[0] = { '\0', TAG_NODE_NONE, TAG_NODE_NONE, -1 };
+    _nodeCount = 1;
+
+    for (uint8_t r = 0; r < _routeCount; r++) {
+        uint8_t node = 0;
+        for (const char* p = _routes[r].prefix; *p; p++) {
+            uint8_t next = findChild(node, *p);
+            if (next == TAG_NODE_NONE) {
+                if (_nodeCount >= TAG_ROUTER_MAX_NODES) return false;
+                next = _nodeCount++;
+                _nodes[next] = { *p, TAG_NODE_NONE, _nodes[node].child, -1 };
+                _nodes[node].child = next;
+            }
+            node = next;
+        }
+        _nodes[node].route = r;
+    }
+    _compiled = true;
+    return true;
+}
+
+bool TagRouter::dispatch(const TagView& uid, const TagView& content) const {
+    if (!_compiled) return false;
+
+    uint8_t node = 0;
+    int8_t matched = -1;
+    size_t matchedLen = 0;
+    for (size_t i = 0; i < content.len; i++) {
+        node = findChild(node, content.data[i]);
+        if (node == TAG_NODE_NONE) break;
+        if (_nodes[node].route >= 0) {
+            matched = _nodes[node].route;
+            matchedLen = i + 1;
+        }
+    }
+    if (matched < 0 || !_routes[matched].handler) return false;
+
+    TagView arg = { content.data + matchedLen, content.len - matchedLen };
+    _routes[matched].handler(uid, arg);
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+#define TAG_ROUTER_MAX_ROUTES 16
+#define TAG_ROUTER_MAX_NODES  128
+
+struct TagView {
+    const char* data;
+    size_t len;
+};
+
+typedef std::function<void(const TagView& uid, const TagView& arg)> TagHandler;
+
+// Prefix router for tag content. Routes are registered at startup, then
+// compile() packs the prefixes into a fixed-size trie; dispatch() walks it
+// once per tap and picks the longest matching prefix without allocating.
+class TagRouter {
+public:
+    bool add(const char* prefix, TagHandler handler);
+    bool compile();
+    bool dispatch(const TagView& uid, const TagView& content) const;
+
+private:
+    struct Route {
+        const char* prefix;
+        TagHandler handler;
+    };
+    struct Node {
+        char c;
+        uint8_t child;
+        uint8_t sibling;
+        int8_t route;
+    };
+
+    Route _routes[TAG_ROUTER_MAX_ROUTES];
+    uint8_t _routeCount = 0;
+    Node _nodes[TAG_ROUTER_MAX_NODES];
+    uint8_t _nodeCount = 0;
+    bool _compiled = false;
+
+    uint8_t findChild(uint8_t parent, char c) const;
+};
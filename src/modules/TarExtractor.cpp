@@ -0,0 +1,379 @@
+#include "TarExtractor.h"
+#include <rom/crc.h>
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_PACK 1
+#if DEBUG_PACK
+    #define LOG_PACK(msg) Serial.println("[PACK] " msg)
+    #define LOG_PACK_F(fmt, ...) Serial.printf("[PACK] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_PACK(msg)
+    #define LOG_PACK_F(fmt, ...)
+#endif
+
+#define GZIP_FHCRC    0x02
+#define GZIP_FEXTRA   0x04
+#define GZIP_FNAME    0x08
+#define GZIP_FCOMMENT 0x10
+
+#define TAR_NAME_MAX  (155 + 1 + 100 + 1)
+
+static uint32_t parseOctal(const uint8_t* field, size_t len) {
+    uint32_t value = 0;
+    size_t i = 0;
+    while (i < len && field[i] == ' ') i++;
+    for (; i < len && field[i] >= '0' && field[i] <= '7'; i++) value = (value << 3) | (field[i] - '0');
+    return value;
+}
+
+static bool endsWith(const char* s, const char* suffix) {
+    size_t len = strlen(s), n = strlen(suffix);
+    return len >= n && strcmp(s + len - n, suffix) == 0;
+}
+
+bool TarExtractor::begin(ContentSync* sync) {
+    _sync = sync;
+    if (!_block) _block = (uint8_t*)MemoryArena::alloc(ARENA_INTERNAL, TAR_BLOCK, MEM_WEB);
+    // SD writes go through the SPI DMA, so the write buffer stays internal.
+    if (!_out) _out = (uint8_t*)MemoryArena::alloc(ARENA_INTERNAL, TAR_WRITE_BUFFER, MEM_WEB);
+    if (!_window) _window = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, TAR_WINDOW, MEM_WEB);
+    if (!_inflator) _inflator = (tinfl_decompressor*)MemoryArena::alloc(ARENA_PSRAM, sizeof(tinfl_decompressor), MEM_WEB);
+    return _sync && _block && _out && _window && _inflator;
+}
+
+void TarExtractor::start() {
+    abortEntry();
+    _active = true;
+    _error = nullptr;
+    _sniffed = false;
+    _gz = GZ_NONE;
+    _tar = TAR_HEADER;
+    _blockPos = 0;
+    _zeroBlocks = 0;
+    _hasLongName = false;
+    _startMs = millis();
+    _elapsedMs = 0;
+    _bytesIn = 0;
+    _bytesOut = 0;
+    _files = 0;
+    _skipped = 0;
+}
+
+bool TarExtractor::fail(const char* error) {
+    if (!_error) {
+        _error = error;
+        LOG_PACK_F("%s after %u bytes", error, (unsigned)_bytesIn);
+    }
+    abortEntry();
+    return false;
+}
+
+bool TarExtractor::write(const uint8_t* data, size_t len) {
+    if (!_active || _error) return false;
+    if (!_block || !_out) return fail("not initialised");
+    _bytesIn += len;
+    if (!_sniffed && len) {
+        _sniffed = true;
+        if (data[0] == 0x1F) {
+            if (!_window || !_inflator) return fail("no inflate buffers");
+            _gz = GZ_HEADER;
+            _gzPos = 0;
+        }
+    }
+    return _gz == GZ_NONE ? feedTar(data, len) : feedGzip(data, len);
+}
+
+bool TarExtractor::feedGzip(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        switch (_gz) {
+        case GZ_HEADER:
+            _gzHeader[_gzPos++] = data[pos++];
+            if (_gzPos < sizeof(_gzHeader)) break;
+            if (_gzHeader[1] != 0x8B || _gzHeader[2] != 8) return fail("not a gzip stream");
+            _gzFlags = _gzHeader[3];
+            _gzPos = 0;
+            _gzExtra = 0;
+            _gz = GZ_EXTRA;
+            break;
+        case GZ_EXTRA:
+            if (!(_gzFlags & GZIP_FEXTRA)) {
+                _gz = GZ_NAME;
+            } else if (_gzPos < 2) {
+                _gzExtra |= data[pos++] << (8 * _gzPos++);
+            } else if (_gzExtra) {
+                size_t n = min(len - pos, (size_t)_gzExtra);
+                pos += n;
+                _gzExtra -= n;
+            } else {
+                _gz = GZ_NAME;
+            }
+            break;
+        case GZ_NAME:
+            if (!(_gzFlags & GZIP_FNAME) || data[pos++] == 0) _gz = GZ_COMMENT;
+            break;
+        case GZ_COMMENT:
+            if (!(_gzFlags & GZIP_FCOMMENT) || data[pos++] == 0) {
+                _gzExtra = (_gzFlags & GZIP_FHCRC) ? 2 : 0;
+                _gz = GZ_HCRC;
+            }
+            break;
+        case GZ_HCRC:
+            if (_gzExtra) {
+                pos++;
+                _gzExtra--;
+                break;
+            }
+            tinfl_init(_inflator);
+            _windowPos = 0;
+            _gzCrc = 0;
+            _gzSize = 0;
+            _gz = GZ_BODY;
+            break;
+        case GZ_BODY: {
+            tinfl_status status;
+            do {
+                size_t inBytes = len - pos;
+                size_t outBytes = TAR_WINDOW - _windowPos;
+                status = tinfl_decompress(_inflator, data + pos, &inBytes, _window, _window + _windowPos, &outBytes,
+                                          TINFL_FLAG_HAS_MORE_INPUT);
+                pos += inBytes;
+                if (outBytes) {
+                    const uint8_t* out = _window + _windowPos;
+                    _gzCrc = crc32_le(_gzCrc, out, outBytes);
+                    _gzSize += outBytes;
+                    _windowPos = (_windowPos + outBytes) & (TAR_WINDOW - 1);
+                    if (!feedTar(out, outBytes)) return false;
+                }
+            } while (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+            if (status < 0) return fail("corrupt deflate data");
+            if (status == TINFL_STATUS_DONE) {
+                // tinfl reads ahead up to four bytes at a time and counts
+                // them as consumed. Whole bytes still in its bit buffer are
+                // the start of the trailer, possibly from an earlier write().
+                _gzPos = 0;
+                for (uint32_t bits = _inflator->m_num_bits & ~7u; bits && _gzPos < 8; bits -= 8, _gzPos++) {
+                    _gzHeader[_gzPos] = (uint8_t)(_inflator->m_bit_buf >> (8 * _gzPos));
+                }
+                _gz = GZ_TRAILER;
+            }
+            break;
+        }
+        case GZ_TRAILER:
+            _gzHeader[_gzPos++] = data[pos++];
+            if (_gzPos < 8) break;
+            {
+                uint32_t crc, size;
+                memcpy(&crc, _gzHeader, 4);
+                memcpy(&size, _gzHeader + 4, 4);
+                if (crc != _gzCrc || size != _gzSize) return fail("gzip CRC mismatch");
+            }
+            _gz = GZ_DONE;
+            break;
+        default:
+            pos = len;
+            break;
+        }
+    }
+    return true;
+}
+
+bool TarExtractor::feedTar(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        switch (_tar) {
+        case TAR_HEADER:
+        case TAR_LONGNAME: {
+            size_t n = min(len - pos, (size_t)(TAR_BLOCK - _blockPos));
+            memcpy(_block + _blockPos, data + pos, n);
+            pos += n;
+            _blockPos += n;
+            if (_blockPos < TAR_BLOCK) break;
+            _blockPos = 0;
+            if (_tar == TAR_HEADER) {
+                if (!parseHeader()) return false;
+                break;
+            }
+            // GNU long name: the first block holds the NUL-terminated name
+            // of the next member; anything too long for SD paths is dropped.
+            if (!_hasLongName) {
+                size_t nameLen = strnlen((const char*)_block, TAR_BLOCK);
+                if (nameLen >= sizeof(_longName)) nameLen = 0;
+                memcpy(_longName, _block, nameLen);
+                _longName[nameLen] = '\0';
+                _hasLongName = true;
+            }
+            _remaining = _remaining > TAR_BLOCK ? _remaining - TAR_BLOCK : 0;
+            if (!_remaining) _tar = TAR_HEADER;
+            break;
+        }
+        case TAR_DATA: {
+            size_t n = min(len - pos, (size_t)_remaining);
+            _fileCrc = crc32_le(_fileCrc, data + pos, n);
+            _remaining -= n;
+            while (n) {
+                size_t take = min(n, (size_t)(TAR_WRITE_BUFFER - _outLen));
+                memcpy(_out + _outLen, data + pos, take);
+                _outLen += take;
+                pos += take;
+                n -= take;
+                if (_outLen == TAR_WRITE_BUFFER && !flushOut()) return false;
+            }
+            if (_remaining) break;
+            if (!closeEntry()) return false;
+            _remaining = _padding;
+            _tar = _padding ? TAR_SKIP : TAR_HEADER;
+            break;
+        }
+        case TAR_SKIP: {
+            size_t n = min(len - pos, (size_t)_remaining);
+            pos += n;
+            _remaining -= n;
+            if (!_remaining) _tar = TAR_HEADER;
+            break;
+        }
+        case TAR_END:
+            pos = len;
+            break;
+        }
+    }
+    return true;
+}
+
+bool TarExtractor::parseHeader() {
+    bool zero = true;
+    for (size_t i = 0; i < TAR_BLOCK && zero; i++) zero = _block[i] == 0;
+    if (zero) {
+        if (++_zeroBlocks >= 2) _tar = TAR_END;
+        return true;
+    }
+    _zeroBlocks = 0;
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++) sum += (i >= 148 && i < 156) ? ' ' : _block[i];
+    if (sum != parseOctal(_block + 148, 8)) return fail("bad tar header");
+
+    uint32_t size = parseOctal(_block + 124, 12);
+    uint32_t padded = (size + TAR_BLOCK - 1) & ~(uint32_t)(TAR_BLOCK - 1);
+    char type = (char)_block[156];
+
+    if (type == 'L') {
+        _hasLongName = false;
+        _remaining = padded;
+        _tar = padded ? TAR_LONGNAME : TAR_HEADER;
+        return true;
+    }
+
+    char name[TAR_NAME_MAX];
+    if (_hasLongName) {
+        snprintf(name, sizeof(name), "%s", _longName);
+        _hasLongName = false;
+    } else if (memcmp(_block + 257, "ustar", 5) == 0 && _block[345]) {
+        snprintf(name, sizeof(name), "%.155s/%.100s", (const char*)_block + 345, (const char*)_block);
+    } else {
+        snprintf(name, sizeof(name), "%.100s", (const char*)_block);
+    }
+
+    bool regular = type == '0' || type == '\0' || type == '7';
+    if (regular && mapPath(name, _path, sizeof(_path))) {
+        if (!openEntry(_path, size)) return false;
+        _padding = padded - size;
+        if (size) {
+            _remaining = size;
+            _tar = TAR_DATA;
+            return true;
+        }
+        if (!closeEntry()) return false;
+    } else {
+        if (type == '5' && mapPath(name, _path, sizeof(_path))) {
+            ContentSync::makeParents(_path);
+            if (!SD.exists(_path)) SD.mkdir(_path);
+        } else if (type != '5' && type != 'x' && type != 'g') {
+            LOG_PACK_F("Skipping %s", name);
+            _skipped++;
+        }
+        _padding = padded;
+    }
+    _remaining = _padding;
+    _tar = _padding ? TAR_SKIP : TAR_HEADER;
+    return true;
+}
+
+bool TarExtractor::mapPath(const char* name, char* path, size_t size) {
+    const char* rel = name;
+    while (strncmp(rel, "./", 2) == 0) rel += 2;
+    if (strncmp(rel, DIR_TALES + 1, sizeof(DIR_TALES) - 2) == 0 && rel[sizeof(DIR_TALES) - 2] == '/') {
+        rel += sizeof(DIR_TALES) - 1;
+    }
+    while (*rel == '/') rel++;
+    int n = snprintf(path, size, DIR_TALES "/%s", rel);
+    if (n <= 0 || (size_t)n >= size) return false;
+    if (path[n - 1] == '/') path[n - 1] = '\0';
+    return ContentSync::validPath(path) && !endsWith(path, ".part") && !endsWith(path, ".done");
+}
+
+bool TarExtractor::openEntry(const char* path, uint32_t size) {
+    char part[SYNC_PATH_LEN + 5];
+    snprintf(part, sizeof(part), "%s.part", path);
+    ContentSync::makeParents(path);
+    SD.remove(part);
+    _file = SD.open(part, FILE_WRITE);
+    if (!_file) return fail("cannot create file");
+    _fileSize = size;
+    _fileCrc = 0;
+    _outLen = 0;
+    return true;
+}
+
+bool TarExtractor::flushOut() {
+    if (!_outLen) return true;
+    size_t written = _file.write(_out, _outLen);
+    bool ok = written == _outLen;
+    _outLen = 0;
+    return ok || fail("SD write failed");
+}
+
+bool TarExtractor::closeEntry() {
+    if (!flushOut()) return false;
+    _file.close();
+    _bytesOut += _fileSize;
+    if (_sync->installPart(_path, _fileSize, _fileCrc) != SYNC_DONE) return fail("cannot install file");
+    _files++;
+    return true;
+}
+
+void TarExtractor::abortEntry() {
+    if (!_file) return;
+    _file.close();
+    char part[SYNC_PATH_LEN + 5];
+    snprintf(part, sizeof(part), "%s.part", _path);
+    SD.remove(part);
+}
+
+bool TarExtractor::finish() {
+    if (!_active) return false;
+    _active = false;
+    _elapsedMs = millis() - _startMs;
+    if (!_error) {
+        if (_gz != GZ_NONE && _gz != GZ_DONE) fail("gzip stream truncated");
+        else if (_tar != TAR_END && (_tar != TAR_HEADER || _blockPos)) fail("archive truncated");
+    }
+    uint32_t ms = _elapsedMs ? _elapsedMs : 1;
+    uint32_t rate = (uint32_t)((uint64_t)_bytesOut * 100 / ((uint64_t)ms * 1000));
+    // From the first body byte to finish(), so network waits are included.
+    LOG_PACK_F("%u files (%u skipped), %u KB in, %u KB out, %u ms, %u.%02u MB/s end to end%s", _files, _skipped,
+               (unsigned)(_bytesIn / 1024), (unsigned)(_bytesOut / 1024), (unsigned)ms, (unsigned)(rate / 100),
+               (unsigned)(rate % 100), _error ? " - FAILED" : "");
+    return !_error;
+}
+
+size_t TarExtractor::writeJson(char* buffer, size_t size) {
+    int n = snprintf(buffer, size,
+                     "{\"active\":%s,\"files\":%u,\"skipped\":%u,\"bytesIn\":%u,\"bytesOut\":%u,\"ms\":%u,\"error\":",
+                     _active ? "true" : "false", _files, _skipped, (unsigned)_bytesIn, (unsigned)_bytesOut,
+                     (unsigned)(_active ? millis() - _startMs : _elapsedMs));
+    if (n > 0 && (size_t)n < size) {
+        n += _error ? snprintf(buffer + n, size - n, "\"%s\"}", _error) : snprintf(buffer + n, size - n, "null}");
+    }
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <rom/miniz.h>
+#include "ContentSync.h"
+
+#define TAR_BLOCK        512
+#define TAR_WRITE_BUFFER 4096
+#define TAR_WINDOW       TINFL_LZ_DICT_SIZE
+
+// Unpacks a content pack (a ustar archive, optionally gzip-compressed) into
+// DIR_TALES while it is still arriving, so a whole library goes over one
+// request without ever existing on the device as an archive. Memory stays
+// fixed: one header block, a write buffer and, for gzip, the 32 KB inflate
+// window and the ROM inflater state.
+//
+// Member names are taken relative to DIR_TALES ("tales/" and "./" prefixes
+// are dropped). Each regular file is written to "<path>.part" with its
+// CRC computed on the way and then handed to ContentSync::installPart(), so
+// the main task installs it and the sync manifest picks it up without a
+// rehash. Members with unsafe names or of other types are skipped.
+class TarExtractor {
+public:
+    bool begin(ContentSync* sync);
+    void start();
+    // Feeds the next bytes of the request body; false once the stream is
+    // broken (the rest of the body is then ignored).
+    bool write(const uint8_t* data, size_t len);
+    // Call after the last byte; true if the archive ended cleanly.
+    bool finish();
+    bool isActive() const { return _active; }
+    const char* error() const { return _error; }
+    size_t writeJson(char* buffer, size_t size);
+
+private:
+    enum GzipState : uint8_t { GZ_NONE, GZ_HEADER, GZ_EXTRA, GZ_NAME, GZ_COMMENT, GZ_HCRC, GZ_BODY, GZ_TRAILER, GZ_DONE };
+    enum TarState : uint8_t { TAR_HEADER, TAR_LONGNAME, TAR_DATA, TAR_SKIP, TAR_END };
+
+    ContentSync* _sync = nullptr;
+    uint8_t* _block = nullptr;
+    uint8_t* _out = nullptr;
+    uint8_t* _window = nullptr;
+    tinfl_decompressor* _inflator = nullptr;
+
+    bool _active = false;
+    const char* _error = nullptr;
+    bool _sniffed = false;
+
+    GzipState _gz = GZ_NONE;
+    uint8_t _gzHeader[10];
+    uint8_t _gzFlags = 0;
+    size_t _gzPos = 0;
+    uint16_t _gzExtra = 0;
+    size_t _windowPos = 0;
+    uint32_t _gzCrc = 0;
+    uint32_t _gzSize = 0;
+
+    TarState _tar = TAR_HEADER;
+    size_t _blockPos = 0;
+    uint8_t _zeroBlocks = 0;
+    char _longName[SYNC_PATH_LEN];
+    bool _hasLongName = false;
+    uint32_t _remaining = 0;
+    uint32_t _padding = 0;
+
+    File _file;
+    char _path[SYNC_PATH_LEN];
+    uint32_t _fileSize = 0;
+    uint32_t _fileCrc = 0;
+    size_t _outLen = 0;
+
+    unsigned long _startMs = 0;
+    uint32_t _elapsedMs = 0;
+    uint32_t _bytesIn = 0;
+    uint32_t _bytesOut = 0;
+    uint16_t _files = 0;
+    uint16_t _skipped = 0;
+
+    bool fail(const char* error);
+    bool feedGzip(const uint8_t* data, size_t len);
+    bool feedTar(const uint8_t* data, size_t len);
+    bool parseHeader();
+    bool mapPath(const char* name, char* path, size_t size);
+    bool openEntry(const char* path, uint32_t size);
+    bool flushOut();
+    bool closeEntry();
+    void abortEntry();
+};
@@ -29,7 +29,7 @@ void ThemeManager::apply(String eventName, AudioManager &audio, LedController &l
         }
         if (event.containsKey("sound")) {
             const char* path = event["sound"];
-            audio.playFile(String(path));
+            audio.playCue(path);
         }
     } else {
         Serial.print("Event not found: "); Serial.println(eventName);
@@ -50,6 +50,14 @@ void ThemeManager::playSound(String eventName, AudioManager &audio) {
     JsonObject event = _doc[eventName];
     if (event.containsKey("sound")) {
         const char* path = event["sound"];
-        audio.playFile(String(path));
+        audio.playCue(path);
+    }
+}
+
+void ThemeManager::preloadSounds(AudioManager &audio) {
+    if (!_loaded) return;
+    for (JsonPair event : _doc.as<JsonObject>()) {
+        const char* path = event.value()["sound"];
+        if (path) audio.preloadCue(path);
     }
 }
\ No newline at end of file
@@ -18,8 +18,13 @@ public:
     void apply(String eventName, AudioManager &audio, LedController &led);
     void setLed(String eventName, LedController &led);
     void playSound(String eventName, AudioManager &audio);
+    void preloadSounds(AudioManager &audio);
 
 private:
-    DynamicJsonDocument _doc{4096};
+#if SUNTOY_STATIC_ALLOC
+    StaticJsonDocument<Board::themeJsonBytes> _doc;
+#else
+    DynamicJsonDocument _doc{Board::themeJsonBytes};
+#endif
     bool _loaded = false;
 };
\ No newline at end of file
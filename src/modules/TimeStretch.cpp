@@ -0,0 +1,168 @@
+#include "TimeStretch.h"
+#include <math.h>
+#include <string.h>
+#include "../utils/MemoryArena.h"
+
+static inline int16_t mono(const int16_t* stereo, size_t frame) {
+    return (int16_t)((stereo[2 * frame] + stereo[2 * frame + 1]) >> 1);
+}
+
+bool TimeStretch::begin() {
+    if (_in) return true;
+    _in = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, STRETCH_IN_FRAMES * 2 * sizeof(int16_t), MEM_AUDIO);
+    _out = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, STRETCH_MAX_SEQ * 2 * sizeof(int16_t), MEM_AUDIO);
+    _mid = (int16_t*)MemoryArena::alloc(ARENA_PSRAM, STRETCH_MAX_OVERLAP * 2 * sizeof(int16_t), MEM_AUDIO);
+    return _in && _out && _mid;
+}
+
+// Rates above 48 kHz keep the 48 kHz window sizes (slightly shorter windows).
+void TimeStretch::configure(uint32_t sampleRate) {
+    _sampleRate = sampleRate;
+    uint32_t rate = sampleRate > STRETCH_MAX_RATE ? STRETCH_MAX_RATE : sampleRate;
+    _seq = rate * STRETCH_SEQ_MS / 1000;
+    _overlap = (rate * STRETCH_OVERLAP_MS / 1000) & ~(STRETCH_DECIMATE - 1);
+    _seek = rate * STRETCH_SEEK_MS / 1000;
+    clear();
+}
+
+void TimeStretch::setSpeed(uint8_t percent) {
+    if (percent < STRETCH_MIN_PERCENT) percent = STRETCH_MIN_PERCENT;
+    if (percent > STRETCH_MAX_PERCENT) percent = STRETCH_MAX_PERCENT;
+    if (percent == _percent) return;
+    _percent = percent;
+    clear();
+}
+
+uint8_t TimeStretch::getSpeed() {
+    return _percent;
+}
+
+bool TimeStretch::isActive() {
+    return _percent != 100 && _in;
+}
+
+uint32_t TimeStretch::getSampleRate() {
+    return _sampleRate;
+}
+
+// The overlap tail starts silent, so the first sequence fades in.
+void TimeStretch::clear() {
+    _inFrames = 0;
+    _outFrames = _outPos = 0;
+    _skipFract = 0;
+    if (_mid) memset(_mid, 0, STRETCH_MAX_OVERLAP * 2 * sizeof(int16_t));
+}
+
+size_t TimeStretch::put(const int16_t* stereo, size_t frames) {
+    if (!_in || _sampleRate == 0) return 0;
+    size_t take = space();
+    if (frames < take) take = frames;
+    memcpy(_in + _inFrames * 2, stereo, take * 2 * sizeof(int16_t));
+    _inFrames += take;
+    return take;
+}
+
+size_t TimeStretch::space() {
+    return STRETCH_IN_FRAMES - _inFrames;
+}
+
+size_t TimeStretch::nextSkip() {
+    return (_skipFract + (uint32_t)_percent * (_seq - _overlap)) / 100;
+}
+
+bool TimeStretch::ready() {
+    if (!_in || _sampleRate == 0 || _outPos < _outFrames) return false;
+    size_t need = nextSkip() + _overlap;
+    if (need < _seq) need = _seq;
+    return _inFrames >= need + _seek;
+}
+
+size_t TimeStretch::available() {
+    return _outFrames - _outPos;
+}
+
+size_t TimeStretch::get(int16_t* stereo, size_t frames) {
+    size_t n = available();
+    if (frames < n) n = frames;
+    memcpy(stereo, _out + _outPos * 2, n * 2 * sizeof(int16_t));
+    _outPos += n;
+    return n;
+}
+
+// Normalised cross-correlation of the overlap tail against every candidate
+// start in the seek window: a coarse pass over every STRETCH_DECIMATE-th
+// sample and position, then a full-resolution pass around the winner.
+size_t TimeStretch::seekBestOffset() {
+    const size_t midLen = _overlap / STRETCH_DECIMATE;
+    const size_t inLen = (_seek + _overlap) / STRETCH_DECIMATE;
+    for (size_t j = 0; j < midLen; j++) _midDec[j] = mono(_mid, j * STRETCH_DECIMATE);
+    for (size_t j = 0; j < inLen; j++) _inDec[j] = mono(_in, j * STRETCH_DECIMATE);
+
+    int32_t energy = 0;
+    for (size_t j = 0; j < midLen; j++) energy += (_inDec[j] * _inDec[j]) >> STRETCH_CORR_SHIFT;
+
+    float bestScore = -1e30f;
+    size_t best = 0;
+    for (size_t p = 0; p + midLen <= inLen; p++) {
+        int32_t corr = 0;
+        for (size_t j = 0; j < midLen; j++) corr += (_midDec[j] * _inDec[p + j]) >> STRETCH_CORR_SHIFT;
+        float score = corr / sqrtf((float)energy + 1.0f);
+        if (score > bestScore) {
+            bestScore = score;
+            best = p * STRETCH_DECIMATE;
+        }
+        if (p + midLen < inLen) {
+            energy += (_inDec[p + midLen] * _inDec[p + midLen]) >> STRETCH_CORR_SHIFT;
+            energy -= (_inDec[p] * _inDec[p]) >> STRETCH_CORR_SHIFT;
+        }
+    }
+
+    size_t from = best >= STRETCH_DECIMATE - 1 ? best - (STRETCH_DECIMATE - 1) : 0;
+    size_t to = best + STRETCH_DECIMATE - 1;
+    if (to >= _seek) to = _seek - 1;
+    bestScore = -1e30f;
+    size_t refined = best;
+    for (size_t p = from; p <= to; p++) {
+        int32_t corr = 0;
+        int32_t e = 0;
+        for (size_t j = 0; j < _overlap; j++) {
+            int32_t s = mono(_in, p + j);
+            corr += (mono(_mid, j) * s) >> STRETCH_CORR_SHIFT;
+            e += (s * s) >> STRETCH_CORR_SHIFT;
+        }
+        float score = corr / sqrtf((float)e + 1.0f);
+        if (score > bestScore) {
+            bestScore = score;
+            refined = p;
+        }
+    }
+    return refined;
+}
+
+// Linear Q15 cross-fade from the saved tail into the new segment.
+void TimeStretch::overlapAdd(int16_t* out, const int16_t* in) {
+    const int32_t step = 32768 / _overlap;
+    int32_t w = 0;
+    for (size_t i = 0; i < _overlap; i++, w += step) {
+        out[2 * i] = (int16_t)((_mid[2 * i] * (32768 - w) + in[2 * i] * w) >> 15);
+        out[2 * i + 1] = (int16_t)((_mid[2 * i + 1] * (32768 - w) + in[2 * i + 1] * w) >> 15);
+    }
+}
+
+void TimeStretch::process() {
+    if (!ready()) return;
+
+    size_t offset = seekBestOffset();
+    const int16_t* src = _in + offset * 2;
+    overlapAdd(_out, src);
+    size_t body = _seq - 2 * _overlap;
+    memcpy(_out + _overlap * 2, src + _overlap * 2, body * 2 * sizeof(int16_t));
+    memcpy(_mid, src + (_seq - _overlap) * 2, _overlap * 2 * sizeof(int16_t));
+    _outFrames = _seq - _overlap;
+    _outPos = 0;
+
+    size_t skip = nextSkip();
+    _skipFract = _skipFract + (uint32_t)_percent * (_seq - _overlap) - skip * 100;
+    memmove(_in, _in + skip * 2, (_inFrames - skip) * 2 * sizeof(int16_t));
+    _inFrames -= skip;
+}
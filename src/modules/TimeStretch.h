@@ -0,0 +1,65 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define STRETCH_SEQ_MS       40
+#define STRETCH_OVERLAP_MS   8
+#define STRETCH_SEEK_MS      15
+#define STRETCH_MAX_RATE     48000
+#define STRETCH_DECIMATE     4
+#define STRETCH_CORR_SHIFT   9
+#define STRETCH_MIN_PERCENT  75
+#define STRETCH_MAX_PERCENT  150
+
+#define STRETCH_MAX_SEQ      (STRETCH_MAX_RATE * STRETCH_SEQ_MS / 1000)
+#define STRETCH_MAX_OVERLAP  (STRETCH_MAX_RATE * STRETCH_OVERLAP_MS / 1000)
+#define STRETCH_MAX_SEEK     (STRETCH_MAX_RATE * STRETCH_SEEK_MS / 1000)
+#define STRETCH_IN_FRAMES    (STRETCH_MAX_SEQ * STRETCH_MAX_PERCENT / 100 + STRETCH_MAX_OVERLAP + STRETCH_MAX_SEEK)
+#define STRETCH_DEC_FRAMES   ((STRETCH_MAX_SEEK + STRETCH_MAX_OVERLAP) / STRETCH_DECIMATE + 1)
+
+// Pitch-preserving tempo change for interleaved stereo PCM16 (WSOLA).
+// Each pass emits one sequence: the saved overlap tail is cross-faded into
+// the input segment that correlates best with it within the seek window,
+// then the input advances by speed * (sequence - overlap). The search runs
+// on a decimated mono copy first and is refined at full resolution, all in
+// integer arithmetic. Buffers are sized for 48 kHz and allocated once.
+class TimeStretch {
+public:
+    bool begin();
+    void configure(uint32_t sampleRate);
+    void setSpeed(uint8_t percent);
+    uint8_t getSpeed();
+    bool isActive();
+    uint32_t getSampleRate();
+    void clear();
+
+    size_t put(const int16_t* stereo, size_t frames);
+    size_t space();
+    // True when a pass can run: the last output was drained and there is
+    // enough input buffered.
+    bool ready();
+    void process();
+    size_t available();
+    size_t get(int16_t* stereo, size_t frames);
+
+private:
+    int16_t* _in = nullptr;
+    int16_t* _out = nullptr;
+    int16_t* _mid = nullptr;
+    size_t _inFrames = 0;
+    size_t _outFrames = 0;
+    size_t _outPos = 0;
+    int16_t _midDec[STRETCH_MAX_OVERLAP / STRETCH_DECIMATE];
+    int16_t _inDec[STRETCH_DEC_FRAMES];
+
+    uint32_t _sampleRate = 0;
+    uint16_t _seq = 0;
+    uint16_t _overlap = 0;
+    uint16_t _seek = 0;
+    uint8_t _percent = 100;
+    uint32_t _skipFract = 0;
+
+    size_t nextSkip();
+    size_t seekBestOffset();
+    void overlapAdd(int16_t* out, const int16_t* in);
+};
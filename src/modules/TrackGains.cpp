@@ -0,0 +1,95 @@
+#include "TrackGains.h"
+
+void TrackGains::load() {
+    _loaded = true;
+    if (!SD.exists(TRACK_GAINS_FILE) && SD.exists(TRACK_GAINS_TEMP)) SD.rename(TRACK_GAINS_TEMP, TRACK_GAINS_FILE);
+    File file = SD.open(TRACK_GAINS_FILE);
+    if (!file) return;
+
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        int a = line.indexOf(' ');
+        int b = line.indexOf(' ', a + 1);
+        if (a <= 0 || b <= a) continue;
+
+        String path = line.substring(b + 1);
+        path.trim();
+        uint32_t size = strtoul(line.c_str(), nullptr, 10);
+        int16_t gain = (int16_t)line.substring(a + 1, b).toInt();
+        _lines++;
+        Entry* e = find(path.c_str());
+        if (e) {
+            _sumMb += gain - e->gainMb;
+            e->size = size;
+            e->gainMb = gain;
+        } else {
+            _entries.push_back({ path, size, gain });
+            _sumMb += gain;
+        }
+    }
+    file.close();
+}
+
+TrackGains::Entry* TrackGains::find(const char* path) {
+    for (auto& e : _entries) {
+        if (e.path == path) return &e;
+    }
+    return nullptr;
+}
+
+bool TrackGains::lookup(const char* path, uint32_t size, int16_t* gainMb) {
+    if (!_loaded) load();
+    Entry* e = find(path);
+    if (!e || e->size != size) return false;
+    *gainMb = e->gainMb;
+    return true;
+}
+
+void TrackGains::store(const char* path, uint32_t size, int16_t gainMb) {
+    if (!_loaded) load();
+    Entry* e = find(path);
+    if (e) {
+        _sumMb += gainMb - e->gainMb;
+        e->size = size;
+        e->gainMb = gainMb;
+    } else {
+        _entries.push_back({ String(path), size, gainMb });
+        _sumMb += gainMb;
+    }
+
+    if (!SD.exists("/system")) SD.mkdir("/system");
+    File file = SD.open(TRACK_GAINS_FILE, FILE_APPEND);
+    if (!file) return;
+    file.printf("%u %d %s\n", size, gainMb, path);
+    file.close();
+    if (++_lines > _entries.size() + TRACK_GAINS_SLACK) compact();
+}
+
+bool TrackGains::average(int16_t* gainMb) {
+    if (!_loaded) load();
+    if (_entries.empty()) return false;
+    *gainMb = (int16_t)(_sumMb / (int32_t)_entries.size());
+    return true;
+}
+
+// Writes the live entries to a new index and swaps it in; if power is lost
+// between the remove and the rename, load() picks up the new file.
+void TrackGains::compact() {
+    for (size_t i = 0; i < _entries.size();) {
+        if (SD.exists(_entries[i].path)) {
+            i++;
+            continue;
+        }
+        _sumMb -= _entries[i].gainMb;
+        _entries.erase(_entries.begin() + i);
+    }
+
+    File file = SD.open(TRACK_GAINS_TEMP, FILE_WRITE);
+    if (!file) return;
+    for (const Entry& e : _entries) file.printf("%u %d %s\n", e.size, e.gainMb, e.path.c_str());
+    file.close();
+    SD.remove(TRACK_GAINS_FILE);
+    if (!SD.rename(TRACK_GAINS_TEMP, TRACK_GAINS_FILE)) return;
+    Serial.printf("[GAIN] Index compacted from %u to %u lines\n", (unsigned)_lines, (unsigned)_entries.size());
+    _lines = _entries.size();
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+
+#define TRACK_GAINS_FILE "/system/gain.idx"
+#define TRACK_GAINS_TEMP "/system/gain.tmp"
+// Rewritten once it holds this many lines more than live entries.
+#define TRACK_GAINS_SLACK 64
+
+// Per-track playback gain in millibels, keyed by path and file size so a
+// replaced file (e.g. a new custom story upload) is measured again.
+// Stored on SD as an append-only text index, "<size> <gain_mB> <path>"
+// per line; the last line for a path wins. Superseded lines and tracks
+// that are gone from the card are dropped when the index is compacted.
+class TrackGains {
+public:
+    bool lookup(const char* path, uint32_t size, int16_t* gainMb);
+    void store(const char* path, uint32_t size, int16_t gainMb);
+    // Mean of the stored gains, a starting point for unmeasured tracks.
+    bool average(int16_t* gainMb);
+
+private:
+    struct Entry {
+        String path;
+        uint32_t size;
+        int16_t gainMb;
+    };
+    std::vector<Entry> _entries;
+    bool _loaded = false;
+    uint32_t _lines = 0;
+    int32_t _sumMb = 0;
+
+    void load();
+    void compact();
+    Entry* find(const char* path);
+};
@@ -0,0 +1,362 @@
+#include "WarmCache.h"
+#include "../utils/MemoryArena.h"
+
+#define DEBUG_WARM 1
+#if DEBUG_WARM
+    #define LOG_WARM(msg) Serial.println("[WARM] " msg)
+    #define LOG_WARM_F(fmt, ...) Serial.printf("[WARM] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_WARM(msg)
+    #define LOG_WARM_F(fmt, ...)
+#endif
+
+#define WARM_MAGIC 0x314D5257  // "WRM1"
+
+// Takes only as many slots as the PSRAM arena has room for once
+// WARM_ARENA_RESERVE is kept back; without static arenas it takes what the
+// heap gives.
+bool WarmCache::begin() {
+    const size_t slotBytes = WARM_SLOT_FRAMES * sizeof(uint32_t);
+    uint8_t wanted = WARM_SLOTS;
+    size_t capacity = MemoryArena::capacity(ARENA_PSRAM);
+    if (capacity) {
+        size_t free = capacity - MemoryArena::used(ARENA_PSRAM);
+        size_t fit = free > WARM_ARENA_RESERVE ? (free - WARM_ARENA_RESERVE) / slotBytes : 0;
+        if (fit < wanted) wanted = fit;
+        LOG_WARM_F("PSRAM arena: %u of %u KB free, %u KB kept back, %u of %u slots of %u KB fit",
+                   (unsigned)(free / 1024), (unsigned)(capacity / 1024), WARM_ARENA_RESERVE / 1024, wanted,
+                   WARM_SLOTS, (unsigned)(slotBytes / 1024));
+    }
+    while (_slotCount < wanted) {
+        _slots[_slotCount].pcm = (uint32_t*)MemoryArena::alloc(ARENA_PSRAM, slotBytes, MEM_AUDIO);
+        if (!_slots[_slotCount].pcm) break;
+        _slotCount++;
+    }
+    if (!_slotCount) {
+        _enabled = false;
+        LOG_WARM("No PSRAM for a single slot - warm start off");
+        return false;
+    }
+    if (_slotCount < WARM_SLOTS) LOG_WARM_F("Only %u of %u slots", _slotCount, WARM_SLOTS);
+    loadTaps();
+    readHeaders();
+    return true;
+}
+
+void WarmCache::slotFile(uint8_t slot, char* path, size_t size, bool tmp) {
+    snprintf(path, size, WARM_DIR "/%u.%s", slot, tmp ? "tmp" : "pcm");
+}
+
+// Slot files are only trusted when header and length agree; their PCM is
+// read into PSRAM later, by loop().
+void WarmCache::readHeaders() {
+    char name[32];
+    for (uint8_t i = 0; i < _slotCount; i++) {
+        WarmSlot& slot = _slots[i];
+        slotFile(i, name, sizeof(name), false);
+        File file = SD.open(name);
+        if (!file) continue;
+        FileHeader header;
+        bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == WARM_MAGIC &&
+                  header.frames <= WARM_SLOT_FRAMES && header.rate && header.rate <= WARM_MAX_RATE &&
+                  memchr(header.path, '\0', sizeof(header.path)) &&
+                  file.size() == sizeof(header) + header.frames * sizeof(uint32_t);
+        file.close();
+        if (!ok) continue;
+        memcpy(slot.path, header.path, sizeof(slot.path));
+        slot.fileSize = header.fileSize;
+        slot.rate = header.rate;
+        slot.frames = header.frames;
+        slot.volume = header.volume;
+        slot.state = WARM_LOADING;
+    }
+}
+
+void WarmCache::loadTaps() {
+    _taps.clear();
+    File file = SD.open(WARM_TAPS_FILE);
+    if (!file) return;
+    while (file.available() && _taps.size() < WARM_MAX_TRACKS) {
+        String line = file.readStringUntil('\n');
+        unsigned score;
+        int pathAt = 0;
+        if (sscanf(line.c_str(), "%u %n", &score, &pathAt) != 1 || !pathAt || !score) continue;
+        _taps.push_back({ line.substring(pathAt), (uint16_t)score });
+    }
+    file.close();
+}
+
+void WarmCache::saveTaps() {
+    _tapsDirty = false;
+    if (!SD.exists("/system")) SD.mkdir("/system");
+    if (!SD.exists(WARM_DIR)) SD.mkdir(WARM_DIR);
+    File file = SD.open(WARM_TAPS_FILE, FILE_WRITE);
+    if (!file) return;
+    for (const auto& t : _taps) file.printf("%u %s\n", t.score, t.path.c_str());
+    file.close();
+}
+
+void WarmCache::noteTap(const char* path) {
+    if (strlen(path) >= WARM_PATH_LEN) return;
+    size_t i = 0;
+    while (i < _taps.size() && _taps[i].path != path) i++;
+    if (i < _taps.size()) {
+        _taps[i].score = _taps[i].score + WARM_TAP_SCORE < 0xFFFF ? _taps[i].score + WARM_TAP_SCORE : 0xFFFF;
+    } else {
+        if (_taps.size() >= WARM_MAX_TRACKS) {
+            size_t lowest = 0;
+            for (size_t j = 1; j < _taps.size(); j++) {
+                if (_taps[j].score < _taps[lowest].score) lowest = j;
+            }
+            _taps.erase(_taps.begin() + lowest);
+        }
+        _taps.push_back({ String(path), WARM_TAP_SCORE });
+    }
+    if (++_tapsSinceDecay >= WARM_DECAY_TAPS) {
+        _tapsSinceDecay = 0;
+        for (size_t j = 0; j < _taps.size();) {
+            _taps[j].score /= 2;
+            if (_taps[j].score) j++;
+            else _taps.erase(_taps.begin() + j);
+        }
+    }
+    _tapsDirty = true;
+}
+
+uint16_t WarmCache::scoreOf(const char* path) const {
+    for (const auto& t : _taps) {
+        if (t.path == path) return t.score;
+    }
+    return 0;
+}
+
+bool WarmCache::ranked(const char* path) const {
+    uint16_t score = scoreOf(path);
+    if (!score) return false;
+    uint8_t above = 0;
+    for (const auto& t : _taps) above += t.score > score;
+    return above < _slotCount;
+}
+
+const WarmSlot* WarmCache::lookup(const char* path, uint32_t fileSize) const {
+    if (!_enabled) return nullptr;
+    for (const auto& slot : _slots) {
+        if (slot.state == WARM_READY && slot.frames && slot.fileSize == fileSize && strcmp(slot.path, path) == 0) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+WarmSlot* WarmCache::beginCapture(const char* path, uint32_t fileSize, uint8_t volume) {
+    if (!_slotCount || !volume || !ranked(path)) return nullptr;
+    int8_t target = -1;
+    for (uint8_t i = 0; i < _slotCount && target < 0; i++) {
+        if (strcmp(_slots[i].path, path) == 0) target = i;
+    }
+    if (target >= 0) {
+        const WarmSlot& slot = _slots[target];
+        if (slot.state == WARM_READY && slot.fileSize == fileSize && slot.volume == volume) return nullptr;
+        if (slot.state == WARM_CAPTURE) return nullptr;
+    }
+    for (uint8_t i = 0; i < _slotCount && target < 0; i++) {
+        if (_slots[i].state == WARM_EMPTY) target = i;
+    }
+    // Otherwise the slot of the least tapped track that fell out of the top.
+    if (target < 0) {
+        uint16_t lowest = 0xFFFF;
+        for (uint8_t i = 0; i < _slotCount; i++) {
+            if (_slots[i].state == WARM_CAPTURE || ranked(_slots[i].path)) continue;
+            uint16_t score = scoreOf(_slots[i].path);
+            if (target < 0 || score < lowest) {
+                target = i;
+                lowest = score;
+            }
+        }
+    }
+    if (target < 0) return nullptr;
+
+    WarmSlot& slot = _slots[target];
+    abortIo(target);
+    // A recapture of the same track overwrites frames only after they were
+    // played from it, so the old content stays usable until then.
+    snprintf(slot.path, sizeof(slot.path), "%s", path);
+    slot.fileSize = fileSize;
+    slot.volume = volume;
+    slot.state = WARM_CAPTURE;
+    return &slot;
+}
+
+void WarmCache::endCapture(WarmSlot* slot, bool complete, uint32_t rate, uint32_t frames) {
+    slot->dirty = true;
+    if (!complete || !rate || !frames) {
+        slot->state = WARM_EMPTY;
+        slot->path[0] = '\0';
+        slot->frames = 0;
+        return;
+    }
+    slot->rate = rate;
+    slot->frames = frames;
+    slot->state = WARM_READY;
+    LOG_WARM_F("Cached %u ms of %s", (unsigned)((uint64_t)frames * 1000 / rate), slot->path);
+}
+
+void WarmCache::abortIo(uint8_t slot) {
+    if (_ioSlot != slot) return;
+    if (_ioFile) _ioFile.close();
+    _ioSlot = -1;
+    _ioOffset = 0;
+}
+
+void WarmCache::loop(bool idle) {
+    if (!idle) {
+        // Keep the position; the file is reopened when the toy is idle again.
+        if (_ioFile) _ioFile.close();
+        return;
+    }
+    if (_tapsDirty) saveTaps();
+    ioStep(millis() + WARM_IO_BUDGET_MS);
+}
+
+// One slot at a time: dirty slots are written (or their file removed when
+// the slot was dropped), slots read from SD at boot are loaded.
+bool WarmCache::ioStep(unsigned long deadline) {
+    char name[32];
+    char tmp[32];
+    while ((long)(deadline - millis()) > 0) {
+        if (_ioSlot < 0) {
+            for (uint8_t i = 0; i < _slotCount && _ioSlot < 0; i++) {
+                const WarmSlot& slot = _slots[i];
+                if ((slot.dirty && slot.state != WARM_CAPTURE) || slot.state == WARM_LOADING) _ioSlot = i;
+            }
+            if (_ioSlot < 0) return true;
+            _ioOffset = 0;
+        }
+
+        WarmSlot& slot = _slots[_ioSlot];
+        slotFile(_ioSlot, name, sizeof(name), false);
+        slotFile(_ioSlot, tmp, sizeof(tmp), true);
+        uint32_t total = slot.frames * sizeof(uint32_t);
+
+        if (slot.state == WARM_LOADING) {
+            if (!_ioFile) {
+                _ioFile = SD.open(name);
+                if (!_ioFile || !_ioFile.seek(sizeof(FileHeader) + _ioOffset)) {
+                    if (_ioFile) _ioFile.close();
+                    slot.state = WARM_EMPTY;
+                    slot.path[0] = '\0';
+                    _ioSlot = -1;
+                    continue;
+                }
+            }
+            uint32_t chunk = total - _ioOffset < WARM_IO_BLOCK ? total - _ioOffset : WARM_IO_BLOCK;
+            if (chunk && _ioFile.read((uint8_t*)slot.pcm + _ioOffset, chunk) != chunk) {
+                _ioFile.close();
+                slot.state = WARM_EMPTY;
+                slot.path[0] = '\0';
+                _ioSlot = -1;
+                continue;
+            }
+            _ioOffset += chunk;
+            if (_ioOffset >= total) {
+                _ioFile.close();
+                slot.state = WARM_READY;
+                _ioSlot = -1;
+                LOG_WARM_F("Loaded %s", slot.path);
+            }
+            continue;
+        }
+
+        if (slot.state != WARM_READY) {
+            SD.remove(name);
+            slot.dirty = false;
+            _ioSlot = -1;
+            continue;
+        }
+        if (!_ioFile) {
+            if (!SD.exists(WARM_DIR)) {
+                if (!SD.exists("/system")) SD.mkdir("/system");
+                SD.mkdir(WARM_DIR);
+            }
+            _ioFile = SD.open(tmp, _ioOffset ? FILE_APPEND : FILE_WRITE);
+            bool ok = _ioFile;
+            if (ok && _ioOffset == 0) {
+                FileHeader header = {};
+                header.magic = WARM_MAGIC;
+                header.fileSize = slot.fileSize;
+                header.rate = slot.rate;
+                header.frames = slot.frames;
+                header.volume = slot.volume;
+                memcpy(header.path, slot.path, sizeof(header.path));
+                ok = _ioFile.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+            }
+            if (!ok) {
+                if (_ioFile) _ioFile.close();
+                LOG_WARM_F("Could not save %s", slot.path);
+                slot.dirty = false;
+                _ioSlot = -1;
+                return true;
+            }
+        }
+        uint32_t chunk = total - _ioOffset < WARM_IO_BLOCK ? total - _ioOffset : WARM_IO_BLOCK;
+        if (chunk && _ioFile.write((const uint8_t*)slot.pcm + _ioOffset, chunk) != chunk) {
+            _ioFile.close();
+            SD.remove(tmp);
+            LOG_WARM_F("Could not save %s", slot.path);
+            slot.dirty = false;
+            _ioSlot = -1;
+            return true;
+        }
+        _ioOffset += chunk;
+        if (_ioOffset >= total) {
+            _ioFile.close();
+            SD.remove(name);
+            SD.rename(tmp, name);
+            slot.dirty = false;
+            _ioSlot = -1;
+        }
+    }
+    return false;
+}
+
+void WarmCache::noteLatency(bool warm, uint32_t us) {
+    Latency& l = _latency[warm ? 1 : 0];
+    l.count++;
+    l.totalUs += us;
+    if (us > l.maxUs) l.maxUs = us;
+}
+
+void WarmCache::report(Print& out) {
+    out.printf("Warm start %s, %u of %u slots of %u ms\n", _enabled ? "on" : "off", _slotCount, WARM_SLOTS, WARM_MS);
+    static const char* const STATES[] = { "empty", "ready", "capturing", "loading" };
+    for (uint8_t i = 0; i < _slotCount; i++) {
+        const WarmSlot& slot = _slots[i];
+        if (slot.state == WARM_EMPTY) {
+            out.printf("  slot %u: empty\n", i);
+            continue;
+        }
+        out.printf("  slot %u: %s, %s, %u Hz, volume %u, score %u\n", i, slot.path, STATES[slot.state],
+                   (unsigned)slot.rate, slot.volume, scoreOf(slot.path));
+    }
+    static const char* const MODES[] = { "cold starts", "warm starts" };
+    for (uint8_t m = 0; m < 2; m++) {
+        const Latency& l = _latency[m];
+        if (!l.count) {
+            out.printf("  %s: none yet\n", MODES[m]);
+            continue;
+        }
+        out.printf("  %s: %u taps, first sample to I2S after avg %.1f ms, max %.1f ms\n", MODES[m], (unsigned)l.count,
+                   l.totalUs / 1000.0f / l.count, l.maxUs / 1000.0f);
+    }
+}
+
+// "warm" prints the report, "warm on|off" switches warm starts (captures
+// continue) to compare latency, "warm clear" resets the latency figures.
+bool WarmCache::handleCommand(const char* line) {
+    if (strcmp(line, "warm") == 0) report(Serial);
+    else if (strcmp(line, "warm on") == 0) _enabled = _slotCount > 0;
+    else if (strcmp(line, "warm off") == 0) _enabled = false;
+    else if (strcmp(line, "warm clear") == 0) memset(_latency, 0, sizeof(_latency));
+    else return false;
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <vector>
+#include "Config.h"
+
+#define WARM_SLOTS          3
+// PSRAM arena left for what is allocated after the cache: theme cues
+// (CueMixer's CUE_MAX_BYTES), the resampler's table, the portal's
+// transcoder. Fewer slots are taken when the rest does not fit.
+#define WARM_ARENA_RESERVE  (320 * 1024)
+#define WARM_MS             1000
+#define WARM_MAX_RATE       48000
+#define WARM_SLOT_FRAMES    (WARM_MAX_RATE * WARM_MS / 1000)
+#define WARM_PATH_LEN       96
+#define WARM_DIR            "/system/warm"
+#define WARM_TAPS_FILE      "/system/warm/taps.idx"
+#define WARM_MAX_TRACKS     32
+#define WARM_TAP_SCORE      16
+#define WARM_DECAY_TAPS     32
+#define WARM_IO_BUDGET_MS   8
+#define WARM_IO_BLOCK       4096
+
+enum WarmSlotState : uint8_t {
+    WARM_EMPTY,
+    WARM_READY,
+    WARM_CAPTURE,
+    WARM_LOADING
+};
+
+// The first WARM_MS of a track exactly as the decoder handed it to I2S
+// (volume applied, before track gain), captured at `volume`.
+struct WarmSlot {
+    char path[WARM_PATH_LEN];
+    uint32_t fileSize;
+    uint32_t rate;
+    uint32_t frames;
+    uint8_t volume;
+    WarmSlotState state;
+    bool dirty;
+    uint32_t* pcm;
+};
+
+// PSRAM cache of the opening second of the figurines tapped most. Every
+// tap of a figurine scores its first track; scores halve every
+// WARM_DECAY_TAPS taps, so the WARM_SLOTS best are the ones tapped often
+// lately. Their PCM is recorded during a normal playback and saved under
+// WARM_DIR when the toy is idle, so the cache is warm again after a reboot.
+//
+// AudioManager plays a cached start straight to I2S while the decoder
+// opens the file, then drops decoded frames until it has caught up.
+class WarmCache {
+public:
+    bool begin();
+    // Saves and loads slots a few ms at a time while nothing plays.
+    void loop(bool idle);
+    void noteTap(const char* path);
+    const WarmSlot* lookup(const char* path, uint32_t fileSize) const;
+    // Slot to record the start of `path` into, or nullptr when the track
+    // is not among the most tapped or is already cached at this volume.
+    WarmSlot* beginCapture(const char* path, uint32_t fileSize, uint8_t volume);
+    void endCapture(WarmSlot* slot, bool complete, uint32_t rate, uint32_t frames);
+    bool isEnabled() const { return _enabled; }
+    // Play command to the first sample written to the DMA ring; the ring
+    // adds its own length before it is heard, which is not measured.
+    void noteLatency(bool warm, uint32_t us);
+    void report(Print& out);
+    bool handleCommand(const char* line);
+
+private:
+    struct TapScore {
+        String path;
+        uint16_t score;
+    };
+    struct Latency {
+        uint32_t count;
+        uint64_t totalUs;
+        uint32_t maxUs;
+    };
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t fileSize;
+        uint32_t rate;
+        uint32_t frames;
+        uint8_t volume;
+        uint8_t reserved[3];
+        char path[WARM_PATH_LEN];
+    };
+
+    WarmSlot _slots[WARM_SLOTS] = {};
+    uint8_t _slotCount = 0;
+    std::vector<TapScore> _taps;
+    uint16_t _tapsSinceDecay = 0;
+    bool _tapsDirty = false;
+    bool _enabled = true;
+    Latency _latency[2] = {};
+
+    int8_t _ioSlot = -1;
+    uint32_t _ioOffset = 0;
+    File _ioFile;
+
+    bool ranked(const char* path) const;
+    uint16_t scoreOf(const char* path) const;
+    void loadTaps();
+    void saveTaps();
+    void readHeaders();
+    void abortIo(uint8_t slot);
+    bool ioStep(unsigned long deadline);
+    static void slotFile(uint8_t slot, char* path, size_t size, bool tmp);
+};
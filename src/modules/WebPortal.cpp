@@ -1,53 +1,294 @@
 #include "WebPortal.h"
 #include <FS.h>
 #include <SD.h>
+#include <ArduinoJson.h>
+#include <new>
+#include "../utils/MemoryArena.h"
+#include "../utils/HeapMonitor.h"
+#include "../utils/LoopWatchdog.h"
+#include "../utils/SampleProfiler.h"
+#include "EmbeddedAssets.h"
+#include "AdpcmTranscoder.h"
+#include "TimeStretch.h"
+#include "JitterBuffer.h"
+#include "SessionLog.h"
+#include "RecordingStore.h"
+#include "ContentSync.h"
+#include "TarExtractor.h"
+#include "NfcManager.h"
+#include "CardScanner.h"
+
+#if FEATURE_WIFI_PORTAL
 
 static WebPortal* instance = nullptr;
 
 void WebPortal::begin() {
     instance = this;
-    if (server) {
-        delete server;
-        server = nullptr;
-    }
-
     WiFi.mode(WIFI_AP);
     WiFi.softAP(WIFI_SSID, WIFI_PASS);
     Serial.print("AP IP: "); Serial.println(WiFi.softAPIP());
 
+#if SUNTOY_STATIC_ALLOC
+    // Built once into the internal arena and only started/stopped afterwards.
+    if (server) {
+        server->begin();
+        return;
+    }
+    void* serverMem = MemoryArena::alloc(ARENA_INTERNAL, sizeof(AsyncWebServer), MEM_WEB);
+    void* wsMem = MemoryArena::alloc(ARENA_INTERNAL, sizeof(AsyncWebSocket), MEM_WEB);
+    if (!serverMem || !wsMem) {
+        Serial.println("[WEB] No memory for the web server, portal disabled");
+        return;
+    }
+    server = new (serverMem) AsyncWebServer(80);
+    _ws = new (wsMem) AsyncWebSocket("/ws");
+#else
+    if (server) {
+        delete server;
+        server = nullptr;
+    }
     server = new AsyncWebServer(80);
+    _ws = new AsyncWebSocket("/ws");
+#endif
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
     
+    _ws->onEvent([this](AsyncWebSocket* ws, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+        if (type == WS_EVT_CONNECT) {
+            _statusDirty = true;
+        } else if (type == WS_EVT_DISCONNECT) {
+            if (client->id() == _streamClient) endStream();
+        } else if (type == WS_EVT_DATA) {
+            AwsFrameInfo* info = (AwsFrameInfo*)arg;
+            if (info->message_opcode == WS_BINARY) {
+                if (_streamSink && client->id() == _streamClient) _streamSink->push(data, len);
+            } else if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+                handleWsMessage(client->id(), (const char*)data, len);
+            }
+        }
+    });
+    server->addHandler(_ws);
+
     setupRoutes();
     server->begin();
 }
 
 void WebPortal::stop() {
+    endStream();
+    // Tags put on the reader after this are figurines to play again.
+    if (_tagWriter) _tagWriter->cancelWrite();
+#if SUNTOY_STATIC_ALLOC
+    if (_ws) _ws->closeAll();
+    if (server) server->end();
+#else
     if (server) {
         server->end();
         delete server;
         server = nullptr;
     }
+    _ws = nullptr; // owned and freed by the server's handler list
     instance = nullptr;
+#endif
 }
 
-void WebPortal::loop() {}
+void WebPortal::loop() {
+    HEAP_SCOPE(MEM_WEB);
+    if (_ws) _ws->cleanupClients();
+}
+
+void WebPortal::endStream() {
+    if (!_streamClient) return;
+    _streamClient = 0;
+    if (_streamSink) _streamSink->finish();
+}
+
+// {"stream":"start","rate":22050,"channels":1} is followed by binary
+// PCM16LE frames from the same client until {"stream":"stop"}.
+void WebPortal::handleWsMessage(uint32_t clientId, const char* data, size_t len) {
+    StaticJsonDocument<128> msg;
+    if (deserializeJson(msg, data, len)) return;
+
+    if (msg.containsKey("stream") && _streamSink) {
+        const char* action = msg["stream"] | "";
+        if (strcmp(action, "start") == 0) {
+            uint32_t rate = msg["rate"] | 22050;
+            int channels = msg["channels"] | 1;
+            if (rate < JITTER_MIN_RATE || rate > JITTER_MAX_RATE || (channels != 1 && channels != 2)) {
+                Serial.printf("[WEB] Stream rejected: %u Hz, %d channels\n", (unsigned)rate, channels);
+                return;
+            }
+            endStream();
+            _streamSink->start(rate, channels);
+            _streamClient = clientId;
+            if (_streamCallback) _streamCallback();
+        } else if (strcmp(action, "stop") == 0 && clientId == _streamClient) {
+            endStream();
+        }
+    }
+
+    if (msg.containsKey("volume")) {
+        if (_volumeCallback) _volumeCallback(constrain(msg["volume"].as<int>(), 0, 21));
+    }
+    if (msg.containsKey("speed")) {
+        if (_speedCallback) _speedCallback(constrain(msg["speed"].as<int>(), STRETCH_MIN_PERCENT, STRETCH_MAX_PERCENT));
+    }
+    if (msg.containsKey("led")) {
+        JsonArray color = msg["led"];
+        if (_ledCallback) _ledCallback(color[0].as<int>(), color[1].as<int>(), color[2].as<int>());
+    }
+}
+
+void WebPortal::publishStatus(const char* state, int volume, int speed, const char* track, uint32_t position) {
+    if (!_ws) return;
+    if (!track) track = "";
+    bool changed = _statusDirty || state != _lastState || volume != _lastVolume || speed != _lastSpeed ||
+                   position != _lastPosition || strncmp(track, _lastTrack, WS_TRACK_LEN - 1) != 0;
+    if (!changed) return;
+
+    _statusDirty = false;
+    _lastState = state;
+    _lastVolume = volume;
+    _lastSpeed = speed;
+    _lastPosition = position;
+    strlcpy(_lastTrack, track, sizeof(_lastTrack));
+    if (_ws->count() == 0) return;
+
+    // Track names come from the SD card, so they go through the serializer
+    // for escaping; the buffer fits a name made entirely of \uXXXX escapes.
+    StaticJsonDocument<128> doc;
+    doc["state"] = state;
+    doc["volume"] = volume;
+    doc["speed"] = speed;
+    doc["track"] = (const char*)_lastTrack;
+    doc["position"] = position;
+    char json[WS_TRACK_LEN * 6 + 96];
+    if (serializeJson(doc, json, sizeof(json)) == 0) return;
+    _ws->textAll(json);
+}
 
 bool WebPortal::isClientConnected() {
     return WiFi.softAPgetStationNum() > 0;
 }
 
 void WebPortal::onVolumeChange(std::function<void(int)> callback) { _volumeCallback = callback; }
+void WebPortal::onSpeedChange(std::function<void(int)> callback) { _speedCallback = callback; }
 void WebPortal::onLedChange(std::function<void(int, int, int)> callback) { _ledCallback = callback; }
-void WebPortal::onUploadComplete(std::function<void()> callback) { _uploadCallback = callback; }
+void WebPortal::onUploadComplete(std::function<void(const char*)> callback) { _uploadCallback = callback; }
+void WebPortal::setStreamSink(JitterBuffer* sink) { _streamSink = sink; }
+void WebPortal::onStreamStart(std::function<void()> callback) { _streamCallback = callback; }
+void WebPortal::setRecordingStore(RecordingStore* store) { _recordings = store; }
+
+void WebPortal::setUploadTarget(const char* uid) {
+    snprintf(_uploadTarget, sizeof(_uploadTarget), "%s", uid);
+}
+
+void WebPortal::setContentSync(ContentSync* sync) { _contentSync = sync; }
+void WebPortal::setPackExtractor(TarExtractor* extractor) { _pack = extractor; }
+void WebPortal::setTagWriter(NfcManager* nfc) { _tagWriter = nfc; }
+void WebPortal::setCardScanner(CardScanner* scanner) { _scanner = scanner; }
+
+static uint32_t paramU32(AsyncWebServerRequest *request, const char* name, int base) {
+    return request->hasParam(name) ? strtoul(request->getParam(name)->value().c_str(), nullptr, base) : 0;
+}
+
+void WebPortal::setupSyncRoutes() {
+    server->on("/sync/manifest", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!_contentSync) { request->send(404); return; }
+        if (!_contentSync->isReady() || !SD.exists(SYNC_MANIFEST_FILE)) {
+            char json[160];
+            _contentSync->writeJson(json, sizeof(json));
+            request->send(503, "application/json", json);
+            return;
+        }
+        request->send(SD, SYNC_MANIFEST_FILE, "text/plain");
+    });
+
+    server->on("/sync/status", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!_contentSync || !request->hasParam("path")) { request->send(400); return; }
+        char json[48];
+        snprintf(json, sizeof(json), "{\"offset\":%u}", (unsigned)_contentSync->partOffset(request->getParam("path")->value().c_str()));
+        request->send(200, "application/json", json);
+    });
+
+    // POST /sync/file?path=&size=&crc=&offset=&chunk= with the chunk as an
+    // application/octet-stream body; CRCs are hex. A 409 carries the offset
+    // to resume from. The chunk buffer is shared, so one chunk at a time;
+    // a second one gets 409 with status "busy".
+    server->on("/sync/file", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (_syncRequest && request != _syncRequest) {
+            request->send(409, "application/json", "{\"status\":\"busy\"}");
+            return;
+        }
+        _syncRequest = nullptr;
+        if (!_contentSync || !request->hasParam("path")) { request->send(400); return; }
+        String path = request->getParam("path")->value();
+        SyncStatus status = _contentSync->commitChunk(path.c_str(), paramU32(request, "size", 10),
+                                                      paramU32(request, "crc", 16), paramU32(request, "offset", 10),
+                                                      paramU32(request, "chunk", 16));
+        int code = 200;
+        if (status == SYNC_BAD_PATH) code = 400;
+        else if (status == SYNC_BAD_OFFSET) code = 409;
+        else if (status == SYNC_BAD_CHUNK || status == SYNC_BAD_FILE) code = 422;
+        else if (status == SYNC_IO_ERROR) code = 500;
+        char json[64];
+        snprintf(json, sizeof(json), "{\"status\":\"%s\",\"offset\":%u}", ContentSync::statusName(status),
+                 (unsigned)_contentSync->partOffset(path.c_str()));
+        request->send(code, "application/json", json);
+    }, nullptr, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+        if (!_contentSync) return;
+        if (index == 0 && !_syncRequest) {
+            _syncRequest = request;
+            request->onDisconnect([this, request]{
+                if (_syncRequest != request) return;
+                _syncRequest = nullptr;
+                _contentSync->dropChunk();
+            });
+        }
+        if (request == _syncRequest) _contentSync->chunkData(data, len, index, total);
+    });
+
+    server->on("/sync/delete", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (!_contentSync || !request->hasParam("path")) { request->send(400); return; }
+        SyncStatus status = _contentSync->remove(request->getParam("path")->value().c_str());
+        request->send(status == SYNC_DONE ? 200 : 400, "text/plain", ContentSync::statusName(status));
+    });
+
+    // POST /sync/pack with a tar (or tar.gz) body, unpacked while it
+    // uploads. Only one pack at a time; a second one gets 409.
+    server->on("/sync/pack", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (!_pack) { request->send(404); return; }
+        if (request != _packRequest) { request->send(_packRequest ? 409 : 400); return; }
+        _packRequest = nullptr;
+        bool ok = _pack->finish();
+        char json[192];
+        _pack->writeJson(json, sizeof(json));
+        request->send(ok ? 200 : 422, "application/json", json);
+    }, nullptr, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+        if (!_pack) return;
+        if (index == 0 && !_packRequest) {
+            _packRequest = request;
+            request->onDisconnect([this, request]{
+                if (_packRequest != request) return;
+                _packRequest = nullptr;
+                _pack->finish();
+            });
+            _pack->start();
+        }
+        if (request == _packRequest) _pack->write(data, len);
+    });
+}
 
 void WebPortal::setupRoutes() {
     server->on("/ping", HTTP_GET, [](AsyncWebServerRequest *request){
         request->send(200, "text/plain", "pong");
     });
     server->on("/", HTTP_GET, [](AsyncWebServerRequest *request){
+        const EmbeddedAsset* page = nullptr;
         if (SD.exists("/web/index.html")) {
             request->send(SD, "/web/index.html", "text/html");
+        } else if ((page = findEmbeddedAsset("/web/index.html", EMBED_WEB_GZIP))) {
+            AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", page->data, page->size);
+            response->addHeader("Content-Encoding", "gzip");
+            request->send(response);
         } else {
             request->send(200, "text/plain", "Error: index.html not found (Check SD/web folder)");
         }
@@ -57,6 +298,95 @@ void WebPortal::setupRoutes() {
     server->serveStatic("/script.js", SD, "/web/script.js").setCacheControl("max-age=3600");
     server->serveStatic("/assets", SD, "/background").setCacheControl("max-age=3600"); 
 
+    server->on("/heap", HTTP_GET, [](AsyncWebServerRequest *request){
+        char json[512];
+        if (HeapMonitor::writeJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(500);
+    });
+
+    server->on("/stalls", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (request->hasParam("clear")) LoopWatchdog::clear();
+        char json[1536];
+        if (LoopWatchdog::writeJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(500);
+    });
+
+#if SUNTOY_PROFILER
+    // The dump stops a running profile; scripts/sample_profile.py reads it.
+    server->on("/profile", HTTP_GET, [](AsyncWebServerRequest *request){
+        SampleProfiler::stop();
+        request->send(request->beginResponse("application/octet-stream", SampleProfiler::dumpSize(),
+            [](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                return SampleProfiler::readDump(index, buffer, maxLen);
+            }));
+    });
+
+    // POST /profile?hz=997 starts sampling, ?stop ends it, ?clear empties the log.
+    server->on("/profile", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (request->hasParam("clear")) SampleProfiler::clear();
+        else if (request->hasParam("stop")) SampleProfiler::stop();
+        else if (!SampleProfiler::start(request->hasParam("hz") ? request->getParam("hz")->value().toInt() : 0)) {
+            request->send(500, "text/plain", "Profiler unavailable");
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    });
+
+#endif
+    server->on("/recordings", HTTP_GET, [this](AsyncWebServerRequest *request){
+        char json[1536];
+        if (_recordings && _recordings->writeJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(404);
+    });
+
+    server->on("/nfc/write", HTTP_GET, [this](AsyncWebServerRequest *request){
+        char json[1536];
+        if (_tagWriter && _tagWriter->writeJobJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(404);
+    });
+
+    // POST /nfc/write?text=cmd:07&count=20 programs the next 20 tags placed
+    // on the reader (1 to NFC_WRITE_MAX_COUNT); ?cancel stops the job. The
+    // job also ends when the portal stops.
+    server->on("/nfc/write", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (!_tagWriter) { request->send(404); return; }
+        if (request->hasParam("cancel")) {
+            _tagWriter->cancelWrite();
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        if (!request->hasParam("text")) { request->send(400); return; }
+        long count = request->hasParam("count") ? request->getParam("count")->value().toInt() : 1;
+        if (count < 1 || count > NFC_WRITE_MAX_COUNT) { request->send(400, "text/plain", "Invalid count"); return; }
+        if (_tagWriter->queueWrite(request->getParam("text")->value().c_str(), count)) request->send(200, "text/plain", "OK");
+        else request->send(400, "text/plain", "Invalid text");
+    });
+
+    server->on("/scan", HTTP_GET, [this](AsyncWebServerRequest *request){
+        char json[2560];
+        if (_scanner && _scanner->writeJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(404);
+    });
+
+    // The next idle pass reads every file again instead of trusting the cache.
+    server->on("/scan", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (!_scanner) { request->send(404); return; }
+        _scanner->rescan();
+        request->send(200, "text/plain", "OK");
+    });
+
+    server->on("/session", HTTP_GET, [](AsyncWebServerRequest *request){
+        const char* path = request->hasParam("old") ? SESSION_HISTORY_FILE : SESSION_LOG_FILE;
+        if (SD.exists(path)) request->send(SD, path, "application/octet-stream", true);
+        else request->send(404);
+    });
+
+    server->on("/stream", HTTP_GET, [this](AsyncWebServerRequest *request){
+        char json[256];
+        if (_streamSink && _streamSink->writeJson(json, sizeof(json))) request->send(200, "application/json", json);
+        else request->send(404);
+    });
+
     server->on("/volume", HTTP_GET, [this](AsyncWebServerRequest *request){
         if (request->hasParam("val")) {
             int val = request->getParam("val")->value().toInt();
@@ -65,6 +395,14 @@ void WebPortal::setupRoutes() {
         } else request->send(400);
     });
 
+    server->on("/speed", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (request->hasParam("val")) {
+            int val = request->getParam("val")->value().toInt();
+            if (_speedCallback) _speedCallback(constrain(val, STRETCH_MIN_PERCENT, STRETCH_MAX_PERCENT));
+            request->send(200, "text/plain", "OK");
+        } else request->send(400);
+    });
+
     server->on("/led", HTTP_GET, [this](AsyncWebServerRequest *request){
         int r = request->hasParam("r") ? request->getParam("r")->value().toInt() : 0;
         int g = request->hasParam("g") ? request->getParam("g")->value().toInt() : 0;
@@ -73,17 +411,27 @@ void WebPortal::setupRoutes() {
         request->send(200, "text/plain", "OK");
     });
 
-    server->on("/upload", HTTP_POST, [](AsyncWebServerRequest *request){
+    // One recording upload at a time; a second one gets 409.
+    server->on("/upload", HTTP_POST, [this](AsyncWebServerRequest *request){
+        if (request != _uploadRequest) { request->send(_uploadRequest ? 409 : 400); return; }
+        _uploadRequest = nullptr;
         request->send(200, "text/plain", "OK");
-    }, handleUpload);
+    }, [this](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final){
+        handleUpload(request, filename, index, data, len, final);
+    });
+
+    setupSyncRoutes();
 
+#if FEATURE_OTA
     server->on("/update", HTTP_POST, [](AsyncWebServerRequest *request){
         bool success = !Update.hasError();
         AsyncWebServerResponse *response = request->beginResponse(200, "text/plain", success ? "OK" : "FAIL");
         response->addHeader("Connection", "close");
         request->send(response);
         if (success) { delay(1000); ESP.restart(); }
-    }, handleUpload);
+    }, [this](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final){
+        handleUpload(request, filename, index, data, len, final);
+    });
     
     server->on("/rollback", HTTP_GET, [](AsyncWebServerRequest *request){
         if (Update.canRollBack()) { 
@@ -95,29 +443,112 @@ void WebPortal::setupRoutes() {
             request->send(400, "text/plain", "Fail");
         }
     });
+#endif
 }
 
 void WebPortal::handleUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+#if FEATURE_OTA
     if (request->url() == "/update") {
         if (!index) Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH);
         Update.write(data, len);
         if (final) Update.end(true);
         return;
     }
-    
-    static File file;
-    if (!index) {
-        if(!SD.exists("/records")) SD.mkdir("/records");
+#endif
+
+    if (!index && !_uploadRequest) {
+        _uploadRequest = request;
+        request->onDisconnect([this, request]{
+            if (_uploadRequest != request) return;
+            _uploadRequest = nullptr;
+            abortUpload();
+        });
+        startUpload(request);
+    }
+    if (request != _uploadRequest) return;
+    if (_uploadFile) {
+        if (_transcode) _transcoder->write(data, len);
+        else _uploadFile.write(data, len);
+    }
+    if (final) finishUpload();
+}
+
+void WebPortal::startUpload(AsyncWebServerRequest *request) {
+    if(!SD.exists(DIR_RECORDS)) SD.mkdir(DIR_RECORDS);
+    _uploadSlot = -1;
+    _uploadUid[0] = '\0';
+
+    char path[RECORD_PATH_LEN];
+    String uid = request->hasParam("uid") ? request->getParam("uid")->value() : String(_uploadTarget);
+    if (_recordings && uid.length()) _uploadSlot = _recordings->beginWrite(uid.c_str(), path, sizeof(path));
+    if (_uploadSlot >= 0) {
+        snprintf(_uploadUid, sizeof(_uploadUid), "%s", uid.c_str());
+    } else {
+        snprintf(path, sizeof(path), "%s", FILE_CUSTOM_STORY);
         if(SD.exists(FILE_CUSTOM_STORY)) SD.remove(FILE_CUSTOM_STORY);
-        
-        file = SD.open(FILE_CUSTOM_STORY, FILE_WRITE);
     }
-    if (file) file.write(data, len);
-    
-    if (final) {
-        if(file) file.close();
-        if (instance && instance->_uploadCallback) {
-            instance->_uploadCallback();
-        }
+    _uploadFile = SD.open(path, FILE_WRITE);
+    _transcode = request->hasParam("codec") && request->getParam("codec")->value() == "adpcm";
+    // About 5 KB of block buffers, so it lives in PSRAM and only once.
+    if (_transcode && !_transcoder) {
+        void* mem = MemoryArena::alloc(ARENA_PSRAM, sizeof(AdpcmTranscoder), MEM_WEB);
+        if (mem) _transcoder = new (mem) AdpcmTranscoder();
+    }
+    if (!_transcoder) _transcode = false;
+    if (_transcode) _transcoder->begin(&_uploadFile);
+}
+
+void WebPortal::finishUpload() {
+    if (_uploadFile && _transcode) {
+        _transcoder->finish();
+        uint32_t in = _transcoder->getBytesIn();
+        uint32_t out = _transcoder->getBytesOut();
+        uint32_t us = _transcoder->getEncodeMicros();
+        Serial.printf("Upload %s: %u -> %u bytes (%.1fx), encode %u KB/s\n",
+                      _transcoder->isTranscoding() ? "ADPCM" : "passthrough", in, out,
+                      out ? (float)in / out : 0.0f, us ? (unsigned)((uint64_t)in * 1000000 / 1024 / us) : 0);
+    }
+    uint32_t bytes = _uploadFile ? _uploadFile.size() : 0;
+    if (_uploadFile) _uploadFile.close();
+    // The index only points at the file once it is closed.
+    if (_uploadSlot >= 0) {
+        if (bytes) _recordings->commit(_uploadSlot, bytes);
+        else _recordings->abort(_uploadSlot);
+        _uploadSlot = -1;
+    } else if (bytes && _recordings) {
+        _recordings->setLegacyPresent(true);
+    }
+    if (_uploadCallback) _uploadCallback(_uploadUid);
+}
+
+// The client went away mid-upload: nothing of it is kept.
+void WebPortal::abortUpload() {
+    if (_uploadFile) {
+        _uploadFile.close();
+        if (_uploadSlot < 0) SD.remove(FILE_CUSTOM_STORY);
     }
-}
\ No newline at end of file
+    if (_uploadSlot >= 0) _recordings->abort(_uploadSlot);
+    _uploadSlot = -1;
+}
+
+#else
+
+void WebPortal::begin() {}
+void WebPortal::stop() {}
+void WebPortal::loop() {}
+bool WebPortal::isClientConnected() { return false; }
+void WebPortal::onVolumeChange(std::function<void(int)> callback) {}
+void WebPortal::onSpeedChange(std::function<void(int)> callback) {}
+void WebPortal::onLedChange(std::function<void(int, int, int)> callback) {}
+void WebPortal::onUploadComplete(std::function<void(const char*)> callback) {}
+void WebPortal::setStreamSink(JitterBuffer* sink) {}
+void WebPortal::onStreamStart(std::function<void()> callback) {}
+void WebPortal::setRecordingStore(RecordingStore* store) {}
+void WebPortal::setUploadTarget(const char* uid) {}
+void WebPortal::setContentSync(ContentSync* sync) {}
+void WebPortal::setPackExtractor(TarExtractor* extractor) {}
+void WebPortal::setTagWriter(NfcManager* nfc) {}
+void WebPortal::setCardScanner(CardScanner* scanner) {}
+void WebPortal::publishStatus(const char* state, int volume, int speed, const char* track, uint32_t position) {}
+
+#endif
\ No newline at end of file
@@ -1,10 +1,25 @@
 #pragma once
 #include <Arduino.h>
+#include <functional>
+#include "Config.h"
+#if FEATURE_WIFI_PORTAL
+#include <FS.h>
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
+#endif
+#if FEATURE_OTA
 #include <Update.h>
-#include <functional>
-#include "Config.h"
+#endif
+
+#define WS_TRACK_LEN           64
+
+class JitterBuffer;
+class RecordingStore;
+class AdpcmTranscoder;
+class ContentSync;
+class TarExtractor;
+class NfcManager;
+class CardScanner;
 
 class WebPortal {
 public:
@@ -12,16 +27,71 @@ public:
     void stop();
     void loop();
     bool isClientConnected();
+    // Control callbacks run on the AsyncTCP task.
     void onVolumeChange(std::function<void(int)> callback);
+    void onSpeedChange(std::function<void(int)> callback);
     void onLedChange(std::function<void(int, int, int)> callback);
-    void onUploadComplete(std::function<void()> callback);
+    // Called with the UID whose recording slot took the upload, or "" when
+    // it went to the shared pre-slot file.
+    void onUploadComplete(std::function<void(const char*)> callback);
+    // Live PCM pushed over the WebSocket goes straight into the sink; the
+    // callback fires when a client starts a stream.
+    void setStreamSink(JitterBuffer* sink);
+    void onStreamStart(std::function<void()> callback);
+    // Uploads go to the recording slot of ?uid=, or of the upload target
+    // (the figurine that asked for a recording) when the request has none.
+    void setRecordingStore(RecordingStore* store);
+    void setUploadTarget(const char* uid);
+    // Manifest and chunked upload routes under /sync for the tale library.
+    void setContentSync(ContentSync* sync);
+    // POST /sync/pack streams a tar or tar.gz content pack into the library.
+    void setPackExtractor(TarExtractor* extractor);
+    // /nfc/write queues tag programming jobs on the reader.
+    void setTagWriter(NfcManager* nfc);
+    // /scan reports damaged files found by the card scanner.
+    void setCardScanner(CardScanner* scanner);
+    void publishStatus(const char* state, int volume, int speed, const char* track, uint32_t position);
 
 private:
+#if FEATURE_WIFI_PORTAL
     AsyncWebServer* server = nullptr;
+    AsyncWebSocket* _ws = nullptr;
     std::function<void(int)> _volumeCallback;
+    std::function<void(int)> _speedCallback;
     std::function<void(int, int, int)> _ledCallback;
-    std::function<void()> _uploadCallback;
+    std::function<void(const char*)> _uploadCallback;
+    std::function<void()> _streamCallback;
+    JitterBuffer* _streamSink = nullptr;
+    RecordingStore* _recordings = nullptr;
+    ContentSync* _contentSync = nullptr;
+    TarExtractor* _pack = nullptr;
+    AsyncWebServerRequest* _packRequest = nullptr;
+    AsyncWebServerRequest* _syncRequest = nullptr;
+    AsyncWebServerRequest* _uploadRequest = nullptr;
+    File _uploadFile;
+    AdpcmTranscoder* _transcoder = nullptr;
+    bool _transcode = false;
+    int8_t _uploadSlot = -1;
+    char _uploadUid[16] = "";
+    NfcManager* _tagWriter = nullptr;
+    CardScanner* _scanner = nullptr;
+    char _uploadTarget[16] = "";
+    volatile uint32_t _streamClient = 0;
+
+    volatile bool _statusDirty = true;
+    const char* _lastState = nullptr;
+    int _lastVolume = -1;
+    int _lastSpeed = -1;
+    uint32_t _lastPosition = 0;
+    char _lastTrack[WS_TRACK_LEN] = "";
 
     void setupRoutes();
-    static void handleUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+    void setupSyncRoutes();
+    void handleWsMessage(uint32_t clientId, const char* data, size_t len);
+    void endStream();
+    void handleUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+    void startUpload(AsyncWebServerRequest *request);
+    void finishUpload();
+    void abortUpload();
+#endif
 };
\ No newline at end of file
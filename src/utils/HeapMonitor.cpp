@@ -0,0 +1,69 @@
+#include "HeapMonitor.h"
+#include <esp_heap_caps.h>
+
+static const char* const SUBSYSTEM_NAMES[MEM_COUNT] = {
+    "main", "audio", "cue", "nfc", "web", "theme"
+};
+
+HeapMonitor::Stats HeapMonitor::_stats[MEM_COUNT] = {};
+unsigned long HeapMonitor::_lastReport = 0;
+
+const char* HeapMonitor::name(MemSubsystem subsystem) {
+    return subsystem < MEM_COUNT ? SUBSYSTEM_NAMES[subsystem] : "?";
+}
+
+void HeapMonitor::record(MemSubsystem subsystem, size_t freeBefore, size_t freeAfter) {
+    Stats& s = _stats[subsystem];
+    int32_t retained = (int32_t)freeBefore - (int32_t)freeAfter;
+    if (retained > s.maxRetained) s.maxRetained = retained;
+    s.netRetained += retained;
+    if (s.scopes == 0 || freeAfter < s.lowWater) s.lowWater = freeAfter;
+    s.scopes++;
+}
+
+void HeapMonitor::report(Print& out) {
+    out.printf("[MEM] internal free=%u min=%u largest=%u | psram free=%u largest=%u\n",
+               (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+               (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+               (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+               (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+               (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+    out.printf("[MEM] arena internal %u/%u psram %u/%u\n",
+               (unsigned)MemoryArena::used(ARENA_INTERNAL), (unsigned)MemoryArena::capacity(ARENA_INTERNAL),
+               (unsigned)MemoryArena::used(ARENA_PSRAM), (unsigned)MemoryArena::capacity(ARENA_PSRAM));
+    for (uint8_t i = 0; i < MEM_COUNT; i++) {
+        const Stats& s = _stats[i];
+        out.printf("[MEM]  %-6s long-lived=%u peak=%d net=%d low=%u scopes=%u\n",
+                   SUBSYSTEM_NAMES[i], (unsigned)MemoryArena::ownedBy((MemSubsystem)i),
+                   (int)s.maxRetained, (int)s.netRetained, (unsigned)s.lowWater, (unsigned)s.scopes);
+    }
+}
+
+size_t HeapMonitor::writeJson(char* buffer, size_t size) {
+    int n = snprintf(buffer, size, "{\"free\":%u,\"min\":%u,\"largest\":%u,\"psramFree\":%u,\"subsystems\":{",
+                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                     (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+                     (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+                     (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    for (uint8_t i = 0; i < MEM_COUNT && n > 0 && (size_t)n < size; i++) {
+        const Stats& s = _stats[i];
+        n += snprintf(buffer + n, size - n, "%s\"%s\":{\"arena\":%u,\"peak\":%d,\"net\":%d,\"low\":%u}",
+                      i ? "," : "", SUBSYSTEM_NAMES[i], (unsigned)MemoryArena::ownedBy((MemSubsystem)i),
+                      (int)s.maxRetained, (int)s.netRetained, (unsigned)s.lowWater);
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "}}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+void HeapMonitor::loop() {
+    if (millis() - _lastReport < HEAP_REPORT_INTERVAL_MS) return;
+    _lastReport = millis();
+    report(Serial);
+}
+
+HeapScope::HeapScope(MemSubsystem subsystem)
+    : _subsystem(subsystem), _freeBefore(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)) {}
+
+HeapScope::~HeapScope() {
+    HeapMonitor::record(_subsystem, _freeBefore, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
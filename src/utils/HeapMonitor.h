@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+#include "MemoryArena.h"
+
+#define HEAP_REPORT_INTERVAL_MS 60000
+
+// Per-subsystem heap accounting. A HeapScope around a subsystem's work
+// records how much internal heap it kept and the lowest free level seen
+// on exit; report() adds the largest free block, which is the number that
+// actually shows fragmentation.
+class HeapMonitor {
+public:
+    static void record(MemSubsystem subsystem, size_t freeBefore, size_t freeAfter);
+    static void report(Print& out);
+    static size_t writeJson(char* buffer, size_t size);
+    static void loop();
+    static const char* name(MemSubsystem subsystem);
+
+private:
+    struct Stats {
+        int32_t maxRetained;
+        int32_t netRetained;
+        size_t lowWater;
+        uint32_t scopes;
+    };
+    static Stats _stats[MEM_COUNT];
+    static unsigned long _lastReport;
+};
+
+class HeapScope {
+public:
+    explicit HeapScope(MemSubsystem subsystem);
+    ~HeapScope();
+
+private:
+    MemSubsystem _subsystem;
+    size_t _freeBefore;
+};
+
+#define HEAP_SCOPE(subsystem) HeapScope _heapScope(subsystem)
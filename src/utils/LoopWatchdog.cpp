@@ -0,0 +1,223 @@
+#include "LoopWatchdog.h"
+#include <esp_attr.h>
+#include <string.h>
+
+#define DEBUG_WDOG 1
+#if DEBUG_WDOG
+    #define LOG_WDOG(msg) Serial.println("[WDOG] " msg)
+    #define LOG_WDOG_F(fmt, ...) Serial.printf("[WDOG] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_WDOG(msg)
+    #define LOG_WDOG_F(fmt, ...)
+#endif
+
+#define STALL_MAGIC 0x53544C32UL
+#define STALL_NONE  0xFF
+
+// Per-module budgets in ms. Commands run playFile() and friends, which open
+// files on SD, so they get the most headroom.
+static const char* const MODULE_NAMES[LOOP_MODULE_COUNT] = {
+    "commands", "audio", "nfc", "buttons", "led", "web", "main"
+};
+static const uint16_t MODULE_BUDGET_MS[LOOP_MODULE_COUNT] = {
+    150, 40, 60, 5, 5, 40, 50
+};
+
+struct Stall {
+    uint32_t durationMs;
+    uint32_t uptimeS;
+    uint16_t line;
+    uint8_t module;
+    uint8_t boot;
+    char site[STALL_SITE_LEN];
+};
+
+struct StallLog {
+    uint32_t magic;
+    uint8_t head;
+    uint8_t count;
+    uint8_t boot;
+    uint8_t openModule;
+    // Slot the hang check already recorded the open scope in, or STALL_NONE.
+    uint8_t openSlot;
+    uint16_t openLine;
+    uint32_t openUptimeS;
+    char openSite[STALL_SITE_LEN];
+    Stall stalls[STALL_HISTORY];
+};
+
+static RTC_NOINIT_ATTR StallLog rtcLog;
+
+uint32_t LoopWatchdog::_worstUs[LOOP_MODULE_COUNT] = {};
+uint32_t LoopWatchdog::_overruns[LOOP_MODULE_COUNT] = {};
+volatile uint32_t LoopWatchdog::_openStartUs = 0;
+portMUX_TYPE LoopWatchdog::_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void copySite(char* out, const char* file) {
+    const char* base = strrchr(file, '/');
+    base = base ? base + 1 : file;
+    strncpy(out, base, STALL_SITE_LEN - 1);
+    out[STALL_SITE_LEN - 1] = '\0';
+}
+
+const char* LoopWatchdog::name(LoopModule module) {
+    return module < LOOP_MODULE_COUNT ? MODULE_NAMES[module] : "?";
+}
+
+void LoopWatchdog::begin() {
+    if (rtcLog.magic != STALL_MAGIC || rtcLog.head >= STALL_HISTORY || rtcLog.count > STALL_HISTORY) {
+        memset(&rtcLog, 0, sizeof(rtcLog));
+        rtcLog.magic = STALL_MAGIC;
+        rtcLog.openModule = STALL_NONE;
+    }
+    if (rtcLog.openModule < LOOP_MODULE_COUNT) {
+        LOG_WDOG_F("Reset while inside %s at %s:%u", MODULE_NAMES[rtcLog.openModule], rtcLog.openSite, rtcLog.openLine);
+        // A hang the check already recorded keeps its entry.
+        if (rtcLog.openSlot >= STALL_HISTORY) {
+            record(rtcLog.openModule, rtcLog.openSite, rtcLog.openLine, 0, rtcLog.openUptimeS);
+        }
+    }
+    rtcLog.openModule = STALL_NONE;
+    rtcLog.openSlot = STALL_NONE;
+    rtcLog.boot++;
+    if (rtcLog.count) report(Serial);
+    xTaskCreatePinnedToCore(hangTask, "LoopHang", 3072, nullptr, 1, nullptr, 0);
+}
+
+void LoopWatchdog::enter(LoopModule module, const char* file, uint16_t line) {
+    portENTER_CRITICAL(&_mux);
+    _openStartUs = micros();
+    rtcLog.openModule = module;
+    rtcLog.openSlot = STALL_NONE;
+    rtcLog.openLine = line;
+    rtcLog.openUptimeS = millis() / 1000;
+    copySite(rtcLog.openSite, file);
+    portEXIT_CRITICAL(&_mux);
+}
+
+void LoopWatchdog::exit(LoopModule module, uint32_t startUs) {
+    uint32_t elapsedUs = micros() - startUs;
+    if (elapsedUs > _worstUs[module]) _worstUs[module] = elapsedUs;
+    uint32_t elapsedMs = elapsedUs / 1000;
+    bool over = elapsedMs > MODULE_BUDGET_MS[module];
+    portENTER_CRITICAL(&_mux);
+    if (rtcLog.openSlot < STALL_HISTORY) {
+        rtcLog.stalls[rtcLog.openSlot].durationMs = elapsedMs;
+    } else if (over) {
+        record(module, rtcLog.openSite, rtcLog.openLine, elapsedMs, rtcLog.openUptimeS);
+    }
+    rtcLog.openModule = STALL_NONE;
+    rtcLog.openSlot = STALL_NONE;
+    portEXIT_CRITICAL(&_mux);
+    if (over) {
+        _overruns[module]++;
+        LOG_WDOG_F("%s took %u ms (budget %u) at %s:%u", MODULE_NAMES[module], (unsigned)elapsedMs,
+                   MODULE_BUDGET_MS[module], rtcLog.openSite, rtcLog.openLine);
+    }
+}
+
+// Records a scope that has been open for LOOP_HANG_MS, once; exit() then
+// updates that entry with the full duration if the scope ever returns.
+void LoopWatchdog::checkHang() {
+    char site[STALL_SITE_LEN];
+    uint8_t module;
+    uint16_t line;
+    uint32_t ageMs;
+    portENTER_CRITICAL(&_mux);
+    module = rtcLog.openModule;
+    ageMs = (micros() - _openStartUs) / 1000;
+    bool hung = module < LOOP_MODULE_COUNT && rtcLog.openSlot >= STALL_HISTORY && ageMs >= LOOP_HANG_MS;
+    if (hung) {
+        rtcLog.openSlot = record(module, rtcLog.openSite, rtcLog.openLine, ageMs, rtcLog.openUptimeS);
+        memcpy(site, rtcLog.openSite, sizeof(site));
+        line = rtcLog.openLine;
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (hung) LOG_WDOG_F("%s still running after %u ms at %s:%u", MODULE_NAMES[module], (unsigned)ageMs, site, line);
+}
+
+void LoopWatchdog::hangTask(void* arg) {
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(LOOP_HANG_CHECK_MS));
+        checkHang();
+    }
+}
+
+uint8_t LoopWatchdog::record(uint8_t module, const char* site, uint16_t line, uint32_t durationMs, uint32_t uptimeS) {
+    uint8_t slot = rtcLog.head;
+    Stall& s = rtcLog.stalls[slot];
+    s.durationMs = durationMs;
+    s.uptimeS = uptimeS;
+    s.line = line;
+    s.module = module;
+    s.boot = rtcLog.boot;
+    strncpy(s.site, site, STALL_SITE_LEN - 1);
+    s.site[STALL_SITE_LEN - 1] = '\0';
+    rtcLog.head = (rtcLog.head + 1) % STALL_HISTORY;
+    if (rtcLog.count < STALL_HISTORY) rtcLog.count++;
+    return slot;
+}
+
+void LoopWatchdog::report(Print& out) {
+    out.printf("[WDOG] boot %u, %u stall(s) kept\n", rtcLog.boot, rtcLog.count);
+    for (uint8_t i = 0; i < rtcLog.count; i++) {
+        const Stall& s = rtcLog.stalls[(rtcLog.head + STALL_HISTORY - 1 - i) % STALL_HISTORY];
+        if (s.durationMs) {
+            out.printf("[WDOG]  boot %u +%us %-8s %u ms at %s:%u\n", s.boot, (unsigned)s.uptimeS,
+                       name((LoopModule)s.module), (unsigned)s.durationMs, s.site, s.line);
+        } else {
+            out.printf("[WDOG]  boot %u +%us %-8s never returned at %s:%u\n", s.boot, (unsigned)s.uptimeS,
+                       name((LoopModule)s.module), s.site, s.line);
+        }
+    }
+    for (uint8_t i = 0; i < LOOP_MODULE_COUNT; i++) {
+        if (!_worstUs[i]) continue;
+        out.printf("[WDOG]  %-8s worst=%u us budget=%u ms overruns=%u\n", MODULE_NAMES[i],
+                   (unsigned)_worstUs[i], MODULE_BUDGET_MS[i], (unsigned)_overruns[i]);
+    }
+}
+
+size_t LoopWatchdog::writeJson(char* buffer, size_t size) {
+    int n = snprintf(buffer, size, "{\"boot\":%u,\"stalls\":[", rtcLog.boot);
+    for (uint8_t i = 0; i < rtcLog.count && n > 0 && (size_t)n < size; i++) {
+        const Stall& s = rtcLog.stalls[(rtcLog.head + STALL_HISTORY - 1 - i) % STALL_HISTORY];
+        n += snprintf(buffer + n, size - n, "%s{\"module\":\"%s\",\"ms\":%u,\"site\":\"%s:%u\",\"boot\":%u,\"uptime\":%u}",
+                      i ? "," : "", name((LoopModule)s.module), (unsigned)s.durationMs, s.site, s.line,
+                      s.boot, (unsigned)s.uptimeS);
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "],\"modules\":{");
+    for (uint8_t i = 0; i < LOOP_MODULE_COUNT && n > 0 && (size_t)n < size; i++) {
+        n += snprintf(buffer + n, size - n, "%s\"%s\":{\"worstUs\":%u,\"budgetMs\":%u,\"overruns\":%u}",
+                      i ? "," : "", MODULE_NAMES[i], (unsigned)_worstUs[i], MODULE_BUDGET_MS[i],
+                      (unsigned)_overruns[i]);
+    }
+    if (n > 0 && (size_t)n < size) n += snprintf(buffer + n, size - n, "}}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+void LoopWatchdog::clear() {
+    portENTER_CRITICAL(&_mux);
+    rtcLog.head = 0;
+    rtcLog.count = 0;
+    rtcLog.openSlot = STALL_NONE;
+    portEXIT_CRITICAL(&_mux);
+    memset(_worstUs, 0, sizeof(_worstUs));
+    memset(_overruns, 0, sizeof(_overruns));
+}
+
+// Serial console: "stalls" prints the log, "stalls clear" empties it.
+bool LoopWatchdog::handleCommand(const char* line) {
+    if (strcmp(line, "stalls") == 0) report(Serial);
+    else if (strcmp(line, "stalls clear") == 0) clear();
+    else return false;
+    return true;
+}
+
+LoopScope::LoopScope(LoopModule module, const char* file, uint16_t line)
+    : _module(module), _startUs(micros()) {
+    LoopWatchdog::enter(module, file, line);
+}
+
+LoopScope::~LoopScope() {
+    LoopWatchdog::exit(_module, _startUs);
+}
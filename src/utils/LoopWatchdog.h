@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+
+#define STALL_HISTORY 8
+#define STALL_SITE_LEN 20
+// A scope open this long is reported while it is still running; checked
+// from a low-priority task on the other core.
+#define LOOP_HANG_MS       5000
+#define LOOP_HANG_CHECK_MS 1000
+
+enum LoopModule : uint8_t {
+    LOOP_COMMANDS,
+    LOOP_AUDIO,
+    LOOP_NFC,
+    LOOP_BUTTONS,
+    LOOP_LED,
+    LOOP_WEB,
+    LOOP_MAIN,
+    LOOP_MODULE_COUNT
+};
+
+// Main-loop supervisor. A LoopScope around a module's work in loop()
+// timestamps entry and exit; anything over the module's budget is logged
+// with the call site and kept in RTC memory, which survives ESP.restart()
+// and watchdog resets. A scope open for LOOP_HANG_MS is logged and recorded
+// while it still runs, and one still open at reset is recovered on boot, so
+// a hang that never returns is attributed too.
+class LoopWatchdog {
+public:
+    static void begin();
+    static void enter(LoopModule module, const char* file, uint16_t line);
+    static void exit(LoopModule module, uint32_t startUs);
+    static void report(Print& out);
+    static size_t writeJson(char* buffer, size_t size);
+    static void clear();
+    static bool handleCommand(const char* line);
+    static const char* name(LoopModule module);
+
+private:
+    static uint8_t record(uint8_t module, const char* site, uint16_t line, uint32_t durationMs, uint32_t uptimeS);
+    static void checkHang();
+    static void hangTask(void* arg);
+    static uint32_t _worstUs[LOOP_MODULE_COUNT];
+    static uint32_t _overruns[LOOP_MODULE_COUNT];
+    static volatile uint32_t _openStartUs;
+    static portMUX_TYPE _mux;
+};
+
+class LoopScope {
+public:
+    LoopScope(LoopModule module, const char* file, uint16_t line);
+    ~LoopScope();
+
+private:
+    LoopModule _module;
+    uint32_t _startUs;
+};
+
+// The site kept is the line of the LOOP_SCOPE itself, i.e. which block of
+// loop() overran, not where inside it the time went; the sampling profiler
+// answers that.
+#define LOOP_SCOPE(module) LoopScope _loopScope(module, __FILE__, __LINE__)
@@ -0,0 +1,65 @@
+#include "MemoryArena.h"
+#include <esp_heap_caps.h>
+#include "Config.h"
+
+#define ARENA_ALIGN 16
+
+MemoryArena::Region MemoryArena::_regions[ARENA_REGION_COUNT] = {};
+size_t MemoryArena::_owned[MEM_COUNT] = {};
+
+static uint32_t capsFor(ArenaRegion region) {
+    return region == ARENA_PSRAM ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                                 : (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+}
+
+bool MemoryArena::begin() {
+#if SUNTOY_STATIC_ALLOC
+    const size_t sizes[ARENA_REGION_COUNT] = { Board::arenaInternalBytes, Board::arenaPsramBytes };
+    bool ok = true;
+    for (uint8_t r = 0; r < ARENA_REGION_COUNT; r++) {
+        if (_regions[r].base) continue;
+        _regions[r].base = (uint8_t*)heap_caps_malloc(sizes[r], capsFor((ArenaRegion)r));
+        _regions[r].size = _regions[r].base ? sizes[r] : 0;
+        _regions[r].used = 0;
+        if (!_regions[r].base) {
+            Serial.printf("[MEM] Arena %u (%u bytes) allocation failed\n", r, (unsigned)sizes[r]);
+            ok = false;
+        }
+    }
+    return ok;
+#else
+    return true;
+#endif
+}
+
+void* MemoryArena::alloc(ArenaRegion region, size_t bytes, MemSubsystem owner) {
+    Region& r = _regions[region];
+    size_t aligned = (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    void* ptr = nullptr;
+
+    if (r.base && r.used + aligned <= r.size) {
+        ptr = r.base + r.used;
+        r.used += aligned;
+    } else {
+#if SUNTOY_STATIC_ALLOC
+        Serial.printf("[MEM] Arena %u exhausted, %u bytes for subsystem %u from heap\n", region, (unsigned)bytes, owner);
+#endif
+        ptr = heap_caps_malloc(bytes, capsFor(region));
+        if (!ptr && region == ARENA_PSRAM) ptr = heap_caps_malloc(bytes, capsFor(ARENA_INTERNAL));
+    }
+
+    if (ptr) _owned[owner] += bytes;
+    return ptr;
+}
+
+size_t MemoryArena::used(ArenaRegion region) {
+    return _regions[region].used;
+}
+
+size_t MemoryArena::capacity(ArenaRegion region) {
+    return _regions[region].size;
+}
+
+size_t MemoryArena::ownedBy(MemSubsystem owner) {
+    return _owned[owner];
+}
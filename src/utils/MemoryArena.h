@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+enum ArenaRegion : uint8_t {
+    ARENA_INTERNAL,
+    ARENA_PSRAM,
+    ARENA_REGION_COUNT
+};
+
+enum MemSubsystem : uint8_t {
+    MEM_MAIN,
+    MEM_AUDIO,
+    MEM_CUE,
+    MEM_NFC,
+    MEM_WEB,
+    MEM_THEME,
+    MEM_COUNT
+};
+
+// Boot-time bump arenas for long-lived buffers. With SUNTOY_STATIC_ALLOC the
+// internal (DMA-capable) and PSRAM regions are carved out once in begin() and
+// never freed; otherwise alloc() is a thin wrapper over heap_caps_malloc so
+// callers stay the same in both builds.
+//
+// Only the fixed buffers routed through alloc() are static. Arduino Strings,
+// the playlist's vector<String>, std::function callbacks and the libraries'
+// own buffers still come from the heap in both builds; HeapMonitor is what
+// shows whether those settle after boot.
+class MemoryArena {
+public:
+    static bool begin();
+    static void* alloc(ArenaRegion region, size_t bytes, MemSubsystem owner);
+    static size_t used(ArenaRegion region);
+    static size_t capacity(ArenaRegion region);
+    static size_t ownedBy(MemSubsystem owner);
+
+private:
+    struct Region {
+        uint8_t* base;
+        size_t size;
+        size_t used;
+    };
+    static Region _regions[ARENA_REGION_COUNT];
+    static size_t _owned[MEM_COUNT];
+};
@@ -0,0 +1,99 @@
+#include "ProfileLog.h"
+#include <stdio.h>
+#include <string.h>
+
+void ProfileLog::attach(uint8_t* buffer, size_t capacity) {
+    _log = buffer;
+    _capacity = capacity;
+    clear();
+}
+
+void ProfileLog::clear() {
+    uint32_t hz = _header.hz;
+    memset(&_header, 0, sizeof(_header));
+    _header.hz = hz;
+    memset(_tasks, 0, sizeof(_tasks));
+    memset(_handles, 0, sizeof(_handles));
+    _full = false;
+}
+
+uint8_t IRAM_ATTR ProfileLog::taskSlot(const void* task, const char* name) {
+    uint8_t slot = 0;
+    while (slot < _header.tasks && _handles[slot] != task) slot++;
+    if (slot < _header.tasks) return slot;
+    if (slot == PROFILE_TASKS) return 0xFF;
+    _handles[slot] = task;
+    strncpy(_tasks[slot], name, PROFILE_TASK_LEN - 1);
+    _header.tasks++;
+    return slot;
+}
+
+const char* ProfileLog::taskName(uint8_t slot) const {
+    return slot < _header.tasks ? _tasks[slot] : "(other)";
+}
+
+bool IRAM_ATTR ProfileLog::add(uint8_t core, uint8_t slot, const uint32_t* pcs, uint8_t depth) {
+    if (depth > PROFILE_DEPTH) depth = PROFILE_DEPTH;
+    size_t bytes = 4 + depth * sizeof(uint32_t);
+    if (_full || _header.bytes + bytes > _capacity) {
+        _header.dropped++;
+        _full = true;
+        return false;
+    }
+    uint8_t* record = _log + _header.bytes;
+    record[0] = core;
+    record[1] = slot;
+    record[2] = depth;
+    record[3] = 0;
+    memcpy(record + 4, pcs, depth * sizeof(uint32_t));
+    _header.bytes += bytes;
+    _header.samples++;
+    return true;
+}
+
+bool ProfileLog::next(size_t* pos, Sample* sample) const {
+    if (*pos + 4 > _header.bytes) return false;
+    const uint8_t* record = _log + *pos;
+    sample->core = record[0];
+    sample->task = record[1];
+    sample->depth = record[2];
+    sample->pcs = record + 4;
+    *pos += 4 + record[2] * sizeof(uint32_t);
+    return true;
+}
+
+size_t ProfileLog::dumpSize() const {
+    return sizeof(Header) + _header.tasks * PROFILE_TASK_LEN + _header.bytes;
+}
+
+size_t ProfileLog::read(size_t offset, uint8_t* buffer, size_t size) const {
+    Header header = _header;
+    header.magic = PROFILE_MAGIC;
+    header.version = PROFILE_VERSION;
+    header.depth = PROFILE_DEPTH;
+    const uint8_t* parts[] = { (const uint8_t*)&header, (const uint8_t*)_tasks, _log };
+    const size_t sizes[] = { sizeof(Header), (size_t)header.tasks * PROFILE_TASK_LEN, header.bytes };
+    size_t copied = 0;
+    for (uint8_t i = 0; i < 3 && copied < size; i++) {
+        if (offset >= sizes[i]) {
+            offset -= sizes[i];
+            continue;
+        }
+        size_t n = min(sizes[i] - offset, size - copied);
+        memcpy(buffer + copied, parts[i] + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+// The offset lets a reader put lines back in place and notice gaps when
+// other output got in between.
+size_t ProfileLog::hexLine(size_t offset, char* line) const {
+    uint8_t chunk[PROFILE_DUMP_LINE];
+    size_t n = read(offset, chunk, sizeof(chunk));
+    int at = snprintf(line, PROFILE_HEX_LEN, "%08x ", (unsigned)offset);
+    for (size_t i = 0; i < n; i++) at += snprintf(line + at, PROFILE_HEX_LEN - at, "%02x", chunk[i]);
+    line[at] = '\0';
+    return n;
+}
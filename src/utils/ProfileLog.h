@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+
+#define PROFILE_DEPTH        8
+#define PROFILE_TASKS        24
+#define PROFILE_TASK_LEN     16
+#define PROFILE_MAGIC        0x31465250UL  // "PRF1"
+#define PROFILE_VERSION      1
+#define PROFILE_DUMP_LINE    32
+// "<offset> <hex>" for one PROFILE_DUMP_LINE of the dump.
+#define PROFILE_HEX_LEN      (9 + PROFILE_DUMP_LINE * 2 + 1)
+
+// The sample log behind SampleProfiler, free of timer and task code so it
+// builds on the host. Each record is core, task slot, depth and a pad byte,
+// then `depth` program counters. Tasks are named once in a table of
+// PROFILE_TASKS, found by their handle; later ones are slot 0xFF. A dump
+// is the header, the task names and the records, the layout
+// scripts/sample_profile.py reads.
+//
+// Not locked: the profiler's interrupt adds under its own spinlock.
+class ProfileLog {
+public:
+    struct Header {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t depth;
+        uint8_t tasks;
+        uint8_t reserved;
+        uint32_t hz;
+        uint32_t samples;
+        uint32_t dropped;
+        uint32_t durationMs;
+        uint32_t bytes;
+    };
+    struct Sample {
+        uint8_t core;
+        uint8_t task;
+        uint8_t depth;
+        const uint8_t* pcs;
+    };
+
+    void attach(uint8_t* buffer, size_t capacity);
+    bool isAttached() const { return _log != nullptr; }
+    // Empties the log; the rate stays.
+    void clear();
+    void setRate(uint32_t hz) { _header.hz = hz; }
+    void addDuration(uint32_t ms) { _header.durationMs += ms; }
+    const Header& header() const { return _header; }
+    bool isFull() const { return _full; }
+
+    // Slot of `task`, named `name` the first time it is seen.
+    uint8_t taskSlot(const void* task, const char* name);
+    const char* taskName(uint8_t slot) const;
+    // Appends a sample; once one does not fit, the log is full and the
+    // rest are only counted as dropped.
+    bool add(uint8_t core, uint8_t slot, const uint32_t* pcs, uint8_t depth);
+    // The record at `*pos`, moving `*pos` past it; false at the end.
+    bool next(size_t* pos, Sample* sample) const;
+
+    size_t dumpSize() const;
+    // Copies up to `size` bytes of the dump starting at `offset`.
+    size_t read(size_t offset, uint8_t* buffer, size_t size) const;
+    // Formats the dump line at `offset` into `line` (PROFILE_HEX_LEN) and
+    // returns the bytes it covers.
+    size_t hexLine(size_t offset, char* line) const;
+
+private:
+    Header _header = {};
+    char _tasks[PROFILE_TASKS][PROFILE_TASK_LEN] = {};
+    const void* _handles[PROFILE_TASKS] = {};
+    uint8_t* _log = nullptr;
+    size_t _capacity = 0;
+    bool _full = false;
+};
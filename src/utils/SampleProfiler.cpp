@@ -0,0 +1,244 @@
+#include "SampleProfiler.h"
+#include "Config.h"
+
+#if SUNTOY_PROFILER
+
+#include <string.h>
+#include <freertos/xtensa_context.h>
+#include <esp_debug_helpers.h>
+#include <soc/soc_memory_layout.h>
+#include "MemoryArena.h"
+
+#define DEBUG_PROF 1
+#if DEBUG_PROF
+    #define LOG_PROF(msg) Serial.println("[PROF] " msg)
+    #define LOG_PROF_F(fmt, ...) Serial.printf("[PROF] " fmt "\n", ##__VA_ARGS__)
+#else
+    #define LOG_PROF(msg)
+    #define LOG_PROF_F(fmt, ...)
+#endif
+
+// Timer group 1, so group 0 stays free for libraries.
+#define PROFILE_TIMER_BASE 2
+
+ProfileLog SampleProfiler::_log;
+uint32_t SampleProfiler::_startMs = 0;
+size_t SampleProfiler::_dumpOffset = 0;
+size_t SampleProfiler::_dumpEnd = 0;
+
+static hw_timer_t* timers[portNUM_PROCESSORS] = {};
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool running = false;
+
+struct AttachJob {
+    uint8_t core;
+    TaskHandle_t caller;
+};
+
+// Static, so a task that outlives attachTimers()'s wait never reads a
+// dead stack frame.
+static AttachJob attachJobs[portNUM_PROCESSORS];
+
+// Return addresses keep the caller's window increment in the top two bits;
+// the call instruction itself is 3 bytes before the return address.
+static inline uint32_t IRAM_ATTR callSite(uint32_t ret) {
+    return ((ret & 0x3FFFFFFF) | 0x40000000) - 3;
+}
+
+// Interrupts are bound to the core that allocates them, so each core's
+// timer is attached from a short task pinned to it.
+void SampleProfiler::attachTask(void* arg) {
+    AttachJob* job = (AttachJob*)arg;
+    hw_timer_t* timer = timerBegin(PROFILE_TIMER_BASE + job->core, 80, true);
+    if (timer) timerAttachInterrupt(timer, SampleProfiler::sampleIsr, true);
+    timers[job->core] = timer;
+    xTaskNotifyGive(job->caller);
+    vTaskDelete(nullptr);
+}
+
+bool SampleProfiler::attachTimers() {
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        if (timers[core]) continue;
+        AttachJob* job = &attachJobs[core];
+        job->core = core;
+        job->caller = xTaskGetCurrentTaskHandle();
+        if (xTaskCreatePinnedToCore(attachTask, "profAttach", 2048, job, configMAX_PRIORITIES - 1, nullptr, core) != pdPASS ||
+            !ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500)) || !timers[core]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The interrupted task's registers sit in the exception frame its
+// pxTopOfStack points at (the first TCB field) while a level-1 interrupt
+// runs, and its register windows have been spilled to its stack, so the
+// chain can be walked the way the panic handler does.
+void IRAM_ATTR SampleProfiler::sampleIsr() {
+    if (!running || _log.isFull()) return;
+    uint8_t core = xPortGetCoreID();
+    TaskHandle_t task = xTaskGetCurrentTaskHandleForCPU(core);
+    if (!task) return;
+    const XtExcFrame* frame = *(const XtExcFrame**)task;
+
+    uint32_t pcs[PROFILE_DEPTH];
+    uint8_t depth = 0;
+    pcs[depth++] = frame->pc;
+    esp_backtrace_frame_t bt = {};
+    bt.pc = frame->pc;
+    bt.sp = frame->a1;
+    bt.next_pc = frame->a0;
+    while (depth < PROFILE_DEPTH && bt.next_pc && esp_stack_ptr_is_sane(bt.sp)) {
+        if (!esp_backtrace_get_next_frame(&bt)) break;
+        uint32_t site = callSite(bt.pc);
+        if (!esp_ptr_executable((void*)site)) break;
+        pcs[depth++] = site;
+    }
+
+    portENTER_CRITICAL_ISR(&logMux);
+    _log.add(core, _log.taskSlot(task, pcTaskGetTaskName(task)), pcs, depth);
+    portEXIT_CRITICAL_ISR(&logMux);
+}
+
+bool SampleProfiler::start(uint32_t hz) {
+    if (running) return true;
+    if (_dumpOffset < _dumpEnd) {
+        LOG_PROF("Dump in progress");
+        return false;
+    }
+    if (hz == 0 || hz > PROFILE_MAX_HZ) hz = PROFILE_DEFAULT_HZ;
+    if (!_log.isAttached()) {
+        uint8_t* buffer = (uint8_t*)MemoryArena::alloc(ARENA_PSRAM, PROFILE_BUFFER_BYTES, MEM_MAIN);
+        if (!buffer) {
+            LOG_PROF("No memory for the sample log");
+            return false;
+        }
+        _log.attach(buffer, PROFILE_BUFFER_BYTES);
+    }
+    if (!attachTimers()) {
+        LOG_PROF("Could not attach the sampling timers");
+        return false;
+    }
+    if (_log.isFull() || (_log.header().samples && hz != _log.header().hz)) clear();
+    _log.setRate(hz);
+    running = true;
+    _startMs = millis();
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        timerAlarmWrite(timers[core], 1000000 / hz, true);
+        timerWrite(timers[core], 0);
+        timerAlarmEnable(timers[core]);
+    }
+    LOG_PROF_F("Sampling both cores at %u Hz, %u KB log", (unsigned)hz, PROFILE_BUFFER_BYTES / 1024);
+    return true;
+}
+
+void SampleProfiler::stop() {
+    if (!running) return;
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) timerAlarmDisable(timers[core]);
+    running = false;
+    _log.addDuration(millis() - _startMs);
+    const ProfileLog::Header& header = _log.header();
+    LOG_PROF_F("Stopped: %u samples in %u ms, %u dropped", (unsigned)header.samples,
+               (unsigned)header.durationMs, (unsigned)header.dropped);
+}
+
+void SampleProfiler::clear() {
+    if (_dumpOffset < _dumpEnd) {
+        LOG_PROF("Dump in progress");
+        return;
+    }
+    stop();
+    portENTER_CRITICAL(&logMux);
+    _log.clear();
+    portEXIT_CRITICAL(&logMux);
+}
+
+bool SampleProfiler::isRunning() {
+    return running;
+}
+
+void SampleProfiler::loop() {
+    if (running && _log.isFull()) {
+        LOG_PROF("Sample log full");
+        stop();
+    }
+    if (_dumpOffset < _dumpEnd) dumpLines();
+}
+
+void SampleProfiler::report(Print& out) {
+    uint32_t perCore[portNUM_PROCESSORS] = {};
+    uint32_t perTask[portNUM_PROCESSORS][PROFILE_TASKS + 1] = {};
+    portENTER_CRITICAL(&logMux);
+    ProfileLog::Header header = _log.header();
+    portEXIT_CRITICAL(&logMux);
+    ProfileLog::Sample sample;
+    for (size_t pos = 0; pos < header.bytes && _log.next(&pos, &sample);) {
+        uint8_t core = sample.core < portNUM_PROCESSORS ? sample.core : 0;
+        uint8_t task = sample.task < PROFILE_TASKS ? sample.task : PROFILE_TASKS;
+        perCore[core]++;
+        perTask[core][task]++;
+    }
+    out.printf("[PROF] %s at %u Hz, %u samples, %u dropped, %u of %u KB used\n", running ? "running" : "stopped",
+               (unsigned)header.hz, (unsigned)header.samples, (unsigned)header.dropped,
+               (unsigned)(header.bytes / 1024), PROFILE_BUFFER_BYTES / 1024);
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        if (!perCore[core]) continue;
+        out.printf("[PROF]  core %u: %u samples\n", core, (unsigned)perCore[core]);
+        for (uint8_t t = 0; t <= PROFILE_TASKS; t++) {
+            if (!perTask[core][t]) continue;
+            out.printf("[PROF]   %-16s %5.1f%%\n", _log.taskName(t),
+                       perTask[core][t] * 100.0f / perCore[core]);
+        }
+    }
+}
+
+size_t SampleProfiler::dumpSize() {
+    return _log.dumpSize();
+}
+
+size_t SampleProfiler::readDump(size_t offset, uint8_t* buffer, size_t size) {
+    return _log.read(offset, buffer, size);
+}
+
+// "dump N bytes", then "<offset> <hex>" lines from loop(), then "dump end".
+// A 512 KB log is over a minute of output at 115200 baud.
+void SampleProfiler::dump() {
+    if (_dumpOffset < _dumpEnd) return;
+    stop();
+    _dumpOffset = 0;
+    _dumpEnd = _log.dumpSize();
+    LOG_PROF_F("dump %u bytes", (unsigned)_dumpEnd);
+}
+
+// Writes only what fits in the serial TX buffer, so loop() never waits on
+// the UART.
+void SampleProfiler::dumpLines() {
+    char line[PROFILE_HEX_LEN];
+    for (uint8_t i = 0; i < PROFILE_DUMP_LINES && _dumpOffset < _dumpEnd; i++) {
+        if (Serial.availableForWrite() < PROFILE_HEX_LEN + 8) return;
+        size_t n = _log.hexLine(_dumpOffset, line);
+        if (n == 0) {
+            _dumpOffset = _dumpEnd;
+            break;
+        }
+        _dumpOffset += n;
+        Serial.printf("[PROF] %s\n", line);
+    }
+    if (_dumpOffset >= _dumpEnd) LOG_PROF("dump end");
+}
+
+// Serial console: "prof" prints the summary, "prof start [hz]", "prof stop",
+// "prof dump" and "prof clear".
+bool SampleProfiler::handleCommand(const char* line) {
+    if (strncmp(line, "prof", 4) != 0) return false;
+    const char* args = line + 4;
+    if (*args == '\0') report(Serial);
+    else if (strncmp(args, " start", 6) == 0) start(strtoul(args + 6, nullptr, 10));
+    else if (strcmp(args, " stop") == 0) stop();
+    else if (strcmp(args, " dump") == 0) dump();
+    else if (strcmp(args, " clear") == 0) clear();
+    else return false;
+    return true;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#include <Arduino.h>
+#include "ProfileLog.h"
+
+#define PROFILE_DEFAULT_HZ   997
+#define PROFILE_MAX_HZ       10000
+#define PROFILE_BUFFER_BYTES (512 * 1024)
+// Dump lines written per loop(), as long as the serial buffer has room.
+#define PROFILE_DUMP_LINES   8
+
+// Statistical profiler, built only with SUNTOY_PROFILER. While running, a
+// hardware timer on each core interrupts it at the given rate and records
+// the task it interrupted: program counter, call chain and task name go
+// into a fixed PSRAM log until it is full. Time spent in other interrupts
+// and with interrupts masked is never sampled.
+//
+// The dump (see ProfileLog) goes out over serial as offset-tagged hex lines,
+// a few per loop() so audio and the console keep running, or from the
+// portal at /profile. scripts/sample_profile.py symbolizes it against the
+// firmware ELF.
+class SampleProfiler {
+public:
+    static bool start(uint32_t hz);
+    static void stop();
+    static void clear();
+    static bool isRunning();
+    // Stops a run whose log filled up and writes pending dump lines.
+    static void loop();
+    // Per core and per task share of the samples.
+    static void report(Print& out);
+    static size_t dumpSize();
+    // Copies up to `size` bytes of the dump starting at `offset`.
+    static size_t readDump(size_t offset, uint8_t* buffer, size_t size);
+    // Starts the serial dump that loop() writes out.
+    static void dump();
+    static bool handleCommand(const char* line);
+
+private:
+    static bool attachTimers();
+    static void attachTask(void* arg);
+    static void sampleIsr();
+    static void dumpLines();
+    static ProfileLog _log;
+    static uint32_t _startMs;
+    static size_t _dumpOffset;
+    static size_t _dumpEnd;
+};
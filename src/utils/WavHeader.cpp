@@ -0,0 +1,32 @@
+#include "WavHeader.h"
+
+bool WavHeader::read(File& file, WavInfo& info) {
+    memset(&info, 0, sizeof(info));
+
+    uint8_t header[12];
+    if (file.read(header, 12) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    uint8_t chunk[16];
+    while (file.read(chunk, 8) == 8) {
+        uint32_t chunkLen = le32(chunk + 4);
+        size_t next = file.position() + chunkLen + (chunkLen & 1);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkLen >= 16) {
+            if (file.read(chunk, 16) != 16) return false;
+            info.format = le16(chunk);
+            info.channels = le16(chunk + 2);
+            info.sampleRate = le32(chunk + 4);
+            info.blockAlign = le16(chunk + 12);
+            info.bitsPerSample = le16(chunk + 14);
+        } else if (memcmp(chunk, "fact", 4) == 0 && chunkLen >= 4) {
+            if (file.read(chunk, 4) != 4) return false;
+            info.factFrames = le32(chunk);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            info.dataBytes = chunkLen;
+            return info.format != 0;
+        }
+        file.seek(next);
+    }
+    return false;
+}
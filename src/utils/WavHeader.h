@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+#define WAV_FORMAT_PCM       0x0001
+#define WAV_FORMAT_IMA_ADPCM 0x0011
+
+struct WavInfo {
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint16_t bitsPerSample;
+    uint16_t blockAlign;
+    uint32_t dataBytes;
+    uint32_t factFrames;
+};
+
+// Walks the RIFF chunks up to "data" and leaves the file positioned at the
+// first sample byte.
+class WavHeader {
+public:
+    static bool read(File& file, WavInfo& info);
+
+    static uint32_t le32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+    static uint16_t le16(const uint8_t* p) {
+        return p[0] | (p[1] << 8);
+    }
+    static void put32(uint8_t* p, uint32_t v) {
+        p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+    }
+    static void put16(uint8_t* p, uint16_t v) {
+        p[0] = v; p[1] = v >> 8;
+    }
+};
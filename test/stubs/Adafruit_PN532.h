@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_PN532 {
+public:
+    Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire* theWire = &Wire) {}
+    Adafruit_PN532(uint8_t ss) {}
+};
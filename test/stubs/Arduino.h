@@ -0,0 +1,129 @@
+#pragma once
+// Host stand-ins for the few Arduino and FreeRTOS calls the modules under
+// test make. Time only moves when a test advances stubMicros.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+using std::min;
+using std::max;
+
+// newlib has it; glibc only from 2.38.
+#if !defined(__GLIBC__) || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+#define IRAM_ATTR
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+inline uint32_t stubMicros = 0;
+inline uint32_t micros() { return stubMicros; }
+inline unsigned long millis() { return stubMicros / 1000; }
+inline void delay(uint32_t ms) { stubMicros += ms * 1000; }
+
+#define LOW  0
+#define HIGH 1
+#define INPUT 0x01
+#define INPUT_PULLDOWN 0x09
+#define OUTPUT 0x03
+inline uint8_t stubPins[40];
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline int digitalRead(uint8_t pin) { return stubPins[pin]; }
+inline void digitalWrite(uint8_t pin, uint8_t val) { stubPins[pin] = val; }
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+    virtual size_t write(const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) write(data[i]);
+        return len;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t println(const char* s = "") { return print(s) + print("\n"); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return n > 0 ? print(buf) : 0;
+    }
+};
+
+// Output goes to stdout; input is whatever a test passes to stubInput().
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) {}
+    int available() { return _in.size() - _pos; }
+    int read() { return _pos < _in.size() ? (uint8_t)_in[_pos++] : -1; }
+    void stubInput(const char* s) { _in += s; }
+
+private:
+    std::string _in;
+    size_t _pos = 0;
+};
+
+inline HardwareSerial Serial;
+
+// Just enough of WString for paths and manifest lines.
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    const char* c_str() const { return _s.c_str(); }
+    unsigned length() const { return _s.size(); }
+    String substring(unsigned from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned from, unsigned to) const {
+        return from < to && from < _s.size() ? String(_s.substr(from, to - from)) : String();
+    }
+    bool endsWith(const char* suffix) const {
+        size_t n = strlen(suffix);
+        return _s.size() >= n && _s.compare(_s.size() - n, n, suffix) == 0;
+    }
+    bool startsWith(const char* prefix) const { return _s.compare(0, strlen(prefix), prefix) == 0; }
+    int toInt() const { return atoi(_s.c_str()); }
+    void toLowerCase() {
+        for (char& c : _s) c = tolower((unsigned char)c);
+    }
+    String& operator+=(const String& other) {
+        _s += other._s;
+        return *this;
+    }
+    String& operator+=(char c) {
+        _s += c;
+        return *this;
+    }
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator==(const char* other) const { return _s == other; }
+
+private:
+    std::string _s;
+};
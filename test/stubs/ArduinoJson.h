@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+
+class JsonDocument {};
+
+template <size_t N> class StaticJsonDocument : public JsonDocument {};
+
+class DynamicJsonDocument : public JsonDocument {
+public:
+    explicit DynamicJsonDocument(size_t capacity) {}
+};
@@ -0,0 +1,12 @@
+#pragma once
+// Decoder stand-in for linking code that holds an Audio member. It never
+// produces sound; host tests fake AudioManager itself.
+#include <Arduino.h>
+#include <FS.h>
+
+class Audio {
+public:
+    bool isRunning() { return false; }
+    uint32_t stopSong() { return 0; }
+    void loop() {}
+};
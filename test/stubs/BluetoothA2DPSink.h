@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+
+class BluetoothA2DPSink {
+public:
+    void end(bool releaseMemory = false) {}
+    bool is_connected() { return false; }
+};
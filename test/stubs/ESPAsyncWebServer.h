@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+
+class AsyncWebServer;
+class AsyncWebSocket;
+class AsyncWebServerRequest;
@@ -0,0 +1,86 @@
+#pragma once
+// In-memory File with the subset of the fs::File API the modules use.
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs {
+
+class File : public Print {
+public:
+    typedef std::function<File(const char*)> Opener;
+
+    File() {}
+    explicit File(std::shared_ptr<std::vector<uint8_t>> data, const char* path = "", uint32_t lastWrite = 0)
+        : _data(data), _name(baseName(path)), _lastWrite(lastWrite) {}
+    // A directory listing the full paths in `entries`, opened with `open`.
+    File(const char* path, std::vector<std::string> entries, Opener open)
+        : _name(baseName(path)), _dir(true), _entries(entries), _open(open) {}
+
+    operator bool() const { return _data != nullptr || _dir; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override {
+        if (!_data) return 0;
+        if (_pos + len > _data->size()) _data->resize(_pos + len);
+        memcpy(_data->data() + _pos, buf, len);
+        _pos += len;
+        return len;
+    }
+    size_t read(uint8_t* buf, size_t len) {
+        if (!_data) return 0;
+        size_t n = min(len, _data->size() - _pos);
+        memcpy(buf, _data->data() + _pos, n);
+        _pos += n;
+        return n;
+    }
+    int read() {
+        uint8_t c;
+        return read(&c, 1) ? c : -1;
+    }
+    String readStringUntil(char end) {
+        std::string s;
+        int c;
+        while ((c = read()) >= 0 && c != end) s += (char)c;
+        return String(s);
+    }
+    bool seek(size_t pos) {
+        if (!_data || pos > _data->size()) return false;
+        _pos = pos;
+        return true;
+    }
+    size_t position() const { return _pos; }
+    size_t size() const { return _data ? _data->size() : 0; }
+    int available() const { return (int)(size() - _pos); }
+    const char* name() const { return _name.c_str(); }
+    bool isDirectory() const { return _dir; }
+    uint32_t getLastWrite() const { return _lastWrite; }
+    File openNextFile() {
+        if (!_dir || _next >= _entries.size()) return File();
+        return _open(_entries[_next++].c_str());
+    }
+    void close() {
+        _data.reset();
+        _dir = false;
+    }
+
+private:
+    std::shared_ptr<std::vector<uint8_t>> _data;
+    size_t _pos = 0;
+    std::string _name;
+    uint32_t _lastWrite = 0;
+    bool _dir = false;
+    std::vector<std::string> _entries;
+    size_t _next = 0;
+    Opener _open;
+
+    static std::string baseName(const char* path) {
+        const char* slash = strrchr(path, '/');
+        return slash ? slash + 1 : path;
+    }
+};
+
+}
+
+using fs::File;
@@ -0,0 +1,37 @@
+#pragma once
+// NVS stand-in: one in-memory store shared by every Preferences object and
+// kept until a test calls stubPreferencesReset().
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+inline std::map<std::string, uint32_t> stubPreferences;
+
+inline void stubPreferencesReset() { stubPreferences.clear(); }
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        _name = name;
+        return true;
+    }
+    void end() {}
+    size_t putUChar(const char* key, uint8_t v) { return put(key, v); }
+    size_t putBool(const char* key, bool v) { return put(key, v); }
+    size_t putUInt(const char* key, uint32_t v) { return put(key, v); }
+    uint8_t getUChar(const char* key, uint8_t def = 0) { return (uint8_t)get(key, def); }
+    bool getBool(const char* key, bool def = false) { return get(key, def) != 0; }
+    uint32_t getUInt(const char* key, uint32_t def = 0) { return get(key, def); }
+
+private:
+    std::string _name;
+
+    size_t put(const char* key, uint32_t v) {
+        stubPreferences[_name + "/" + key] = v;
+        return sizeof(v);
+    }
+    uint32_t get(const char* key, uint32_t def) {
+        auto it = stubPreferences.find(_name + "/" + key);
+        return it == stubPreferences.end() ? def : it->second;
+    }
+};
@@ -0,0 +1,73 @@
+#pragma once
+// In-memory card: files by full path, directories implied by mkdir. Like
+// FAT, rename refuses to replace an existing file. Every open for writing
+// bumps the file's modification time; every open costs openMicros.
+#include <FS.h>
+#include <SPI.h>
+#include <map>
+#include <set>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+class SDFS {
+public:
+    bool begin(uint8_t ssPin) { return true; }
+    File open(const char* path, const char* mode = FILE_READ) {
+        stubMicros += openMicros;
+        std::string p(path);
+        if (_dirs.count(p)) return File(path, list(p), [this](const char* child) { return open(child); });
+        auto it = _files.find(p);
+        if (mode[0] == 'r') return it == _files.end() ? File() : File(it->second, path, _mtime[p]);
+        if (it == _files.end()) it = _files.emplace(p, std::make_shared<std::vector<uint8_t>>()).first;
+        if (mode[0] == 'w') it->second->clear();
+        _mtime[p] = ++_clock;
+        File file(it->second, path, _mtime[p]);
+        file.seek(it->second->size());
+        return file;
+    }
+    File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char* path) const { return _files.count(path) || _dirs.count(path); }
+    bool mkdir(const char* path) { return _dirs.insert(path).second; }
+    bool remove(const char* path) { return _files.erase(path) > 0; }
+    bool rename(const char* from, const char* to) {
+        auto it = _files.find(from);
+        if (it == _files.end() || exists(to)) return false;
+        _files[to] = it->second;
+        _mtime[to] = _mtime[from];
+        _files.erase(it);
+        return true;
+    }
+    // Test helpers.
+    uint32_t openMicros = 0;
+    std::shared_ptr<std::vector<uint8_t>> data(const char* path) {
+        auto it = _files.find(path);
+        return it == _files.end() ? nullptr : it->second;
+    }
+    void reset() {
+        _files.clear();
+        _dirs.clear();
+        _mtime.clear();
+        openMicros = 0;
+    }
+
+private:
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> _files;
+    std::map<std::string, uint32_t> _mtime;
+    std::set<std::string> _dirs;
+    uint32_t _clock = 0;
+
+    std::vector<std::string> list(const std::string& dir) const {
+        std::vector<std::string> entries;
+        std::string prefix = dir + "/";
+        auto direct = [&](const std::string& p) {
+            return p.compare(0, prefix.size(), prefix) == 0 && p.find('/', prefix.size()) == std::string::npos;
+        };
+        for (const auto& d : _dirs) if (direct(d)) entries.push_back(d);
+        for (const auto& f : _files) if (direct(f.first)) entries.push_back(f.first);
+        return entries;
+    }
+};
+
+inline SDFS SD;
@@ -0,0 +1,21 @@
+#pragma once
+// The radio is never up in host tests; mode changes are only counted.
+#include <Arduino.h>
+
+typedef enum { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m) {
+        _mode = m;
+        return true;
+    }
+    wifi_mode_t getMode() const { return _mode; }
+    bool disconnect(bool wifioff = false) { return true; }
+    uint8_t softAPgetStationNum() { return 0; }
+
+private:
+    wifi_mode_t _mode = WIFI_OFF;
+};
+
+inline WiFiClass WiFi;
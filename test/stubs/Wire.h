@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_INTERNAL (1 << 0)
+#define MALLOC_CAP_DMA      (1 << 1)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 3)
+
+// Optional model of the internal heap for soak tests: a fixed pool with
+// first-fit allocation, 8-byte block headers and coalescing on free. Until
+// stubHeapBegin() is called every request goes to malloc and the
+// statistics read zero. PSRAM is never modelled.
+struct StubHeapBlock {
+    uint32_t size;
+    uint32_t used;
+};
+
+struct StubHeap {
+    uint8_t* pool = nullptr;
+    size_t size = 0;
+    size_t freeBytes = 0;
+    size_t minFree = 0;
+};
+
+inline StubHeap stubHeap;
+
+inline void stubHeapBegin(size_t size) {
+    free(stubHeap.pool);
+    size &= ~(size_t)7;
+    stubHeap.pool = (uint8_t*)malloc(size);
+    stubHeap.size = size;
+    StubHeapBlock* first = (StubHeapBlock*)stubHeap.pool;
+    first->size = size - sizeof(StubHeapBlock);
+    first->used = 0;
+    stubHeap.freeBytes = first->size;
+    stubHeap.minFree = first->size;
+}
+
+inline StubHeapBlock* stubHeapNext(StubHeapBlock* block) {
+    uint8_t* next = (uint8_t*)(block + 1) + block->size;
+    return next < stubHeap.pool + stubHeap.size ? (StubHeapBlock*)next : nullptr;
+}
+
+inline bool stubHeapOwns(void* ptr) {
+    return stubHeap.pool && ptr >= stubHeap.pool && ptr < stubHeap.pool + stubHeap.size;
+}
+
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    if (!stubHeap.pool || !(caps & MALLOC_CAP_INTERNAL)) return malloc(size);
+    size = (size + 7) & ~(size_t)7;
+    for (StubHeapBlock* b = (StubHeapBlock*)stubHeap.pool; b; b = stubHeapNext(b)) {
+        if (b->used || b->size < size) continue;
+        if (b->size >= size + sizeof(StubHeapBlock) + 8) {
+            StubHeapBlock* rest = (StubHeapBlock*)((uint8_t*)(b + 1) + size);
+            rest->size = b->size - size - sizeof(StubHeapBlock);
+            rest->used = 0;
+            b->size = size;
+            stubHeap.freeBytes -= sizeof(StubHeapBlock);
+        }
+        b->used = 1;
+        stubHeap.freeBytes -= b->size;
+        if (stubHeap.freeBytes < stubHeap.minFree) stubHeap.minFree = stubHeap.freeBytes;
+        return b + 1;
+    }
+    return nullptr;
+}
+
+inline void heap_caps_free(void* ptr) {
+    if (!stubHeapOwns(ptr)) {
+        free(ptr);
+        return;
+    }
+    StubHeapBlock* block = (StubHeapBlock*)ptr - 1;
+    block->used = 0;
+    stubHeap.freeBytes += block->size;
+    for (StubHeapBlock* b = (StubHeapBlock*)stubHeap.pool; b; b = stubHeapNext(b)) {
+        StubHeapBlock* next;
+        while (!b->used && (next = stubHeapNext(b)) && !next->used) {
+            b->size += sizeof(StubHeapBlock) + next->size;
+            stubHeap.freeBytes += sizeof(StubHeapBlock);
+        }
+    }
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_INTERNAL) ? stubHeap.freeBytes : 0;
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_INTERNAL) ? stubHeap.minFree : 0;
+}
+
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    size_t largest = 0;
+    if (!(caps & MALLOC_CAP_INTERNAL) || !stubHeap.pool) return 0;
+    for (StubHeapBlock* b = (StubHeapBlock*)stubHeap.pool; b; b = stubHeapNext(b)) {
+        if (!b->used && b->size > largest) largest = b->size;
+    }
+    return largest;
+}
@@ -0,0 +1,11 @@
+#pragma once
+// Tests run on one thread; locks only have to exist.
+#include <stdint.h>
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
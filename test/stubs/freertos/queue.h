@@ -0,0 +1,31 @@
+#pragma once
+// Fixed-depth FIFO of copied items. Nothing blocks: a full queue rejects
+// the send and an empty one fails the receive whatever the wait.
+#include "FreeRTOS.h"
+#include <string.h>
+#include <deque>
+#include <vector>
+
+struct QueueDefinition {
+    UBaseType_t depth;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+typedef QueueDefinition* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t depth, UBaseType_t itemSize) {
+    return new QueueDefinition{depth, itemSize, {}};
+}
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t) {
+    if (q->items.size() >= q->depth) return pdFALSE;
+    const uint8_t* bytes = (const uint8_t*)item;
+    q->items.emplace_back(bytes, bytes + q->itemSize);
+    return pdTRUE;
+}
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t) {
+    if (q->items.empty()) return pdFALSE;
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    return pdTRUE;
+}
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q->items.size(); }
@@ -0,0 +1,4 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
@@ -0,0 +1,13 @@
+#pragma once
+// The ROM's crc32_le is zlib's CRC-32 (reflected 0xEDB88320, inverted).
+#include <stdint.h>
+#include <stddef.h>
+
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
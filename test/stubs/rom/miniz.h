@@ -0,0 +1,59 @@
+#pragma once
+// The ROM's tinfl on top of zlib's raw inflate (link with -lz). tinfl's
+// fast path reads input four bytes at a time, so when a stream ends, up to
+// four bytes past it sit in m_bit_buf and count as consumed. This stand-in
+// always reads that far ahead, so callers are tested against the worst case.
+#include <zlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TINFL_LZ_DICT_SIZE        32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+struct tinfl_decompressor {
+    uint32_t m_num_bits;
+    uint32_t m_bit_buf;
+    uint32_t magic;
+    z_stream z;
+};
+
+// The decompressor comes from MemoryArena uninitialised, like on the board.
+inline void tinfl_init(tinfl_decompressor* r) {
+    if (r->magic == 0x54494E46) {
+        inflateReset(&r->z);
+    } else {
+        memset(&r->z, 0, sizeof(r->z));
+        inflateInit2(&r->z, -15);
+        r->magic = 0x54494E46;
+    }
+    r->m_num_bits = 0;
+    r->m_bit_buf = 0;
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inSize, uint8_t* outStart,
+                                     uint8_t* outNext, size_t* outSize, uint32_t flags) {
+    r->z.next_in = (Bytef*)in;
+    r->z.avail_in = *inSize;
+    r->z.next_out = outNext;
+    r->z.avail_out = *outSize;
+    int rc = inflate(&r->z, Z_NO_FLUSH);
+    if (rc == Z_STREAM_END) {
+        while (r->m_num_bits < 32 && r->z.avail_in) {
+            r->m_bit_buf |= (uint32_t)*r->z.next_in++ << r->m_num_bits;
+            r->m_num_bits += 8;
+            r->z.avail_in--;
+        }
+    }
+    *inSize -= r->z.avail_in;
+    *outSize -= r->z.avail_out;
+    if (rc == Z_STREAM_END) return TINFL_STATUS_DONE;
+    if (rc != Z_OK && rc != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+    return r->z.avail_out ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_HAS_MORE_OUTPUT;
+}
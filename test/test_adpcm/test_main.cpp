@@ -0,0 +1,182 @@
+#include <unity.h>
+#include <math.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "modules/AdpcmTranscoder.h"
+#include "utils/WavHeader.h"
+
+void setUp() {}
+void tearDown() {}
+
+typedef std::vector<uint8_t> Bytes;
+
+static void put(Bytes& b, const char* tag) {
+    b.insert(b.end(), tag, tag + 4);
+}
+
+static void put32(Bytes& b, uint32_t v) {
+    uint8_t p[4];
+    WavHeader::put32(p, v);
+    b.insert(b.end(), p, p + 4);
+}
+
+static void put16(Bytes& b, uint16_t v) {
+    uint8_t p[2];
+    WavHeader::put16(p, v);
+    b.insert(b.end(), p, p + 2);
+}
+
+// PCM WAV with `extra` bytes of LIST chunk between "fmt " and "data".
+static Bytes makeWav(uint16_t channels, uint16_t bits, uint32_t frames, uint32_t extra) {
+    Bytes b;
+    put(b, "RIFF");
+    put32(b, 0);
+    put(b, "WAVE");
+    put(b, "fmt ");
+    put32(b, 16);
+    put16(b, WAV_FORMAT_PCM);
+    put16(b, channels);
+    put32(b, 16000);
+    put32(b, 16000 * channels * bits / 8);
+    put16(b, channels * bits / 8);
+    put16(b, bits);
+    if (extra) {
+        put(b, "LIST");
+        put32(b, extra);
+        for (uint32_t i = 0; i < extra + (extra & 1); i++) b.push_back('a' + i % 26);
+    }
+    put(b, "data");
+    put32(b, frames * channels * bits / 8);
+    for (uint32_t i = 0; i < frames * channels; i++) {
+        int16_t s = (int16_t)(8000 * sin(i * 0.05));
+        if (bits == 16) put16(b, (uint16_t)s);
+        else b.push_back((uint8_t)(s >> 8));
+    }
+    WavHeader::put32(b.data() + 4, b.size() - 8);
+    return b;
+}
+
+// Feeds `in` in pieces of `step` bytes and returns what was written.
+static Bytes transcode(const Bytes& in, size_t step, bool* ok = nullptr) {
+    auto data = std::make_shared<Bytes>();
+    File file(data);
+    AdpcmTranscoder transcoder;
+    transcoder.begin(&file);
+    bool good = true;
+    for (size_t pos = 0; pos < in.size(); pos += step) {
+        good &= transcoder.write(in.data() + pos, min(step, in.size() - pos));
+    }
+    good &= transcoder.finish();
+    if (ok) *ok = good;
+    return *data;
+}
+
+static void checkAdpcm(const Bytes& out, uint16_t channels, uint32_t frames) {
+    TEST_ASSERT_GREATER_THAN(ADPCM_WAV_HEADER_BYTES, out.size());
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", out.data(), 4);
+    TEST_ASSERT_EQUAL(WAV_FORMAT_IMA_ADPCM, WavHeader::le16(out.data() + 20));
+    TEST_ASSERT_EQUAL(channels, WavHeader::le16(out.data() + 22));
+    TEST_ASSERT_EQUAL(frames, WavHeader::le32(out.data() + 48));
+    TEST_ASSERT_EQUAL(out.size() - ADPCM_WAV_HEADER_BYTES, WavHeader::le32(out.data() + 56));
+}
+
+void test_plain_header() {
+    Bytes out = transcode(makeWav(1, 16, 4000, 0), 4096);
+    checkAdpcm(out, 1, 4000);
+}
+
+void test_list_chunk_larger_than_scan_buffer() {
+    Bytes out = transcode(makeWav(2, 16, 3000, 700), 4096);
+    checkAdpcm(out, 2, 3000);
+}
+
+void test_chunking_does_not_change_output() {
+    Bytes in = makeWav(1, 16, 2500, 301);
+    Bytes whole = transcode(in, in.size());
+    checkAdpcm(whole, 1, 2500);
+    const size_t steps[] = { 1, 7, 64, 255, 256, 1000 };
+    for (size_t step : steps) {
+        Bytes out = transcode(in, step);
+        TEST_ASSERT_EQUAL(whole.size(), out.size());
+        TEST_ASSERT_EQUAL_MEMORY(whole.data(), out.data(), whole.size());
+    }
+}
+
+void test_decoded_audio_tracks_input() {
+    Bytes in = makeWav(1, 16, 2034, 40);
+    Bytes out = transcode(in, 333);
+    int16_t pcm[ADPCM_MAX_BLOCK_FRAMES];
+    size_t frames = ImaAdpcm::decodeBlock(out.data() + ADPCM_WAV_HEADER_BYTES, ADPCM_BLOCK_ALIGN_MONO, 1, pcm);
+    TEST_ASSERT_EQUAL(ImaAdpcm::framesPerBlock(ADPCM_BLOCK_ALIGN_MONO, 1), frames);
+    const uint8_t* src = in.data() + in.size() - 2034 * 2;
+    for (size_t i = 100; i < frames; i++) {
+        TEST_ASSERT_INT_WITHIN(600, (int16_t)WavHeader::le16(src + 2 * i), pcm[i]);
+    }
+}
+
+void test_eight_bit_passes_through() {
+    Bytes in = makeWav(1, 8, 1000, 0);
+    Bytes out = transcode(in, 100);
+    TEST_ASSERT_EQUAL(in.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(in.data(), out.data(), in.size());
+}
+
+void test_not_riff_passes_through() {
+    Bytes in(1000, 0x5A);
+    Bytes out = transcode(in, 300);
+    TEST_ASSERT_EQUAL(in.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(in.data(), out.data(), in.size());
+}
+
+void test_missing_data_chunk_fails() {
+    Bytes in = makeWav(1, 16, 0, 500);
+    in.resize(in.size() - 8);
+    bool ok = true;
+    transcode(in, 64, &ok);
+    TEST_ASSERT_FALSE(ok);
+}
+
+// Times a ten-second mono 16 kHz transcode and the decode of every block,
+// and prints the SD read rate during playback of each format. The rates come
+// from the data sizes, so they also cover the block headers.
+void test_cost_and_sd_rate() {
+    const uint32_t rate = 16000;
+    const uint32_t frames = rate * 10;
+    Bytes in = makeWav(1, 16, frames, 0);
+    auto start = std::chrono::steady_clock::now();
+    Bytes out = transcode(in, 4096);
+    auto encodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    checkAdpcm(out, 1, frames);
+
+    int16_t pcm[ADPCM_MAX_BLOCK_FRAMES];
+    size_t decoded = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t pos = ADPCM_WAV_HEADER_BYTES; pos + ADPCM_BLOCK_ALIGN_MONO <= out.size(); pos += ADPCM_BLOCK_ALIGN_MONO) {
+        decoded += ImaAdpcm::decodeBlock(out.data() + pos, ADPCM_BLOCK_ALIGN_MONO, 1, pcm);
+    }
+    auto decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_GREATER_OR_EQUAL(frames, decoded);
+
+    double seconds = (double)frames / rate;
+    double pcmRate = frames * 2 / seconds;
+    double adpcmRate = (out.size() - ADPCM_WAV_HEADER_BYTES) / seconds;
+    TEST_ASSERT_INT_WITHIN(ADPCM_BLOCK_ALIGN_MONO, (int)WavHeader::le32(out.data() + 28), (int)adpcmRate);
+    TEST_ASSERT_LESS_THAN(pcmRate / 3.5, adpcmRate);
+    printf("  encode %.0f ns, decode %.0f ns per frame on this host\n", (double)encodeNs / frames, (double)decodeNs / decoded);
+    printf("  SD read at %u Hz mono: PCM %.0f B/s, ADPCM %.0f B/s (%.2fx less)\n",
+           (unsigned)rate, pcmRate, adpcmRate, pcmRate / adpcmRate);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_header);
+    RUN_TEST(test_list_chunk_larger_than_scan_buffer);
+    RUN_TEST(test_chunking_does_not_change_output);
+    RUN_TEST(test_decoded_audio_tracks_input);
+    RUN_TEST(test_eight_bit_passes_through);
+    RUN_TEST(test_not_riff_passes_through);
+    RUN_TEST(test_missing_data_chunk_fails);
+    RUN_TEST(test_cost_and_sd_rate);
+    return UNITY_END();
+}
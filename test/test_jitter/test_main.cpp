@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <vector>
+#include "modules/JitterBuffer.h"
+
+void setUp() {}
+void tearDown() {}
+
+// The ring is allocated once for the firmware's lifetime, so every test
+// reuses the same buffer.
+static JitterBuffer jitter;
+
+// A value from the /stream status JSON; UINT32_MAX if it is missing.
+static uint32_t field(const char* name) {
+    char json[256];
+    if (!jitter.writeJson(json, sizeof(json))) return UINT32_MAX;
+    char key[32];
+    snprintf(key, sizeof(key), "\"%s\":", name);
+    const char* at = strstr(json, key);
+    return at ? (uint32_t)strtoul(at + strlen(key), nullptr, 10) : UINT32_MAX;
+}
+
+// Mono PCM16LE counting up from `first`.
+static std::vector<uint8_t> ramp(size_t frames, int16_t first) {
+    std::vector<uint8_t> pcm;
+    for (size_t i = 0; i < frames; i++) {
+        int16_t s = (int16_t)(first + i);
+        pcm.push_back((uint8_t)s);
+        pcm.push_back((uint8_t)(s >> 8));
+    }
+    return pcm;
+}
+
+// Sends `frames` in one chunk and then waits for its duration, like a
+// sender pacing itself in real time.
+static void send(uint32_t rate, size_t frames, int16_t first) {
+    std::vector<uint8_t> pcm = ramp(frames, first);
+    jitter.push(pcm.data(), pcm.size());
+    stubMicros += (uint32_t)((uint64_t)frames * 1000000 / rate);
+}
+
+static void startStream(uint32_t rate) {
+    TEST_ASSERT_TRUE(jitter.begin());
+    jitter.start(rate, 1);
+    TEST_ASSERT_TRUE(jitter.open());
+}
+
+void test_open_needs_start() {
+    startStream(16000);
+    TEST_ASSERT_FALSE(jitter.open());
+    jitter.start(0, 1);
+    TEST_ASSERT_FALSE(jitter.open());
+}
+
+void test_buffers_to_target_then_plays() {
+    startStream(16000);
+    int16_t out[512 * 2];
+    int16_t next = 0;
+    // 20 ms chunks: nothing comes out before JITTER_MIN_MS is buffered.
+    for (int i = 0; i * 20 < JITTER_MIN_MS; i++) {
+        TEST_ASSERT_EQUAL(0, jitter.pop(out, 64));
+        send(16000, 320, next);
+        next += 320;
+    }
+    TEST_ASSERT_EQUAL(64, jitter.pop(out, 64));
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_INT16(i, out[2 * i]);
+        TEST_ASSERT_EQUAL_INT16(i, out[2 * i + 1]);
+    }
+}
+
+void test_frames_split_across_chunks() {
+    startStream(8000);
+    std::vector<uint8_t> pcm = ramp(2000, 100);
+    // Odd chunk sizes leave half a frame over each time.
+    for (size_t pos = 0; pos < pcm.size(); pos += 7) {
+        jitter.push(pcm.data() + pos, min((size_t)7, pcm.size() - pos));
+    }
+    jitter.finish();
+    int16_t out[2000 * 2];
+    TEST_ASSERT_EQUAL(2000, jitter.pop(out, 2000));
+    for (int i = 0; i < 2000; i++) TEST_ASSERT_EQUAL_INT16(100 + i, out[2 * i]);
+    TEST_ASSERT_TRUE(jitter.isDrained());
+}
+
+// A new stream is announced on the network side while the audio side still
+// holds the last one; only open() moves the read position.
+void test_restart_skips_old_stream() {
+    startStream(16000);
+    send(16000, 3000, 0);
+    jitter.finish();
+    int16_t out[256 * 2];
+    TEST_ASSERT_EQUAL(256, jitter.pop(out, 256));
+
+    jitter.start(22050, 1);
+    send(22050, 4000, 5000);
+    TEST_ASSERT_EQUAL(16000, jitter.getSampleRate());
+    TEST_ASSERT_EQUAL(256, jitter.pop(out, 256));
+    TEST_ASSERT_EQUAL_INT16(256, out[0]);
+
+    TEST_ASSERT_TRUE(jitter.open());
+    TEST_ASSERT_EQUAL(22050, jitter.getSampleRate());
+    TEST_ASSERT_FALSE(jitter.isDrained());
+    TEST_ASSERT_EQUAL(256, jitter.pop(out, 256));
+    TEST_ASSERT_EQUAL_INT16(5000, out[0]);
+}
+
+// Arrivals paced by each chunk's own length are not jitter, whatever the
+// chunk sizes.
+void test_steady_arrivals_with_mixed_sizes() {
+    startStream(16000);
+    const size_t sizes[] = { 160, 640, 320, 1280, 160 };
+    for (int i = 0; i < 200; i++) send(16000, sizes[i % 5], 0);
+    TEST_ASSERT_EQUAL(0, field("jitterMs"));
+    TEST_ASSERT_EQUAL(JITTER_MIN_MS, field("targetMs"));
+}
+
+void test_late_chunks_raise_target() {
+    startStream(16000);
+    for (int i = 0; i < 200; i++) {
+        send(16000, 320, 0);
+        if (i % 2) stubMicros += 40000;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(15, field("jitterMs"));
+    TEST_ASSERT_GREATER_THAN(JITTER_MIN_MS, field("targetMs"));
+}
+
+void test_underrun_raises_floor() {
+    startStream(16000);
+    send(16000, 16000 * JITTER_MIN_MS / 1000, 0);
+    int16_t out[512 * 2];
+    while (jitter.pop(out, 512)) {}
+    TEST_ASSERT_EQUAL(1, field("underruns"));
+    TEST_ASSERT_EQUAL(JITTER_MIN_MS + JITTER_UNDERRUN_STEP_MS, field("targetMs"));
+}
+
+void test_overflow_is_counted() {
+    startStream(48000);
+    send(48000, JITTER_CAPACITY_FRAMES + 100, 0);
+    TEST_ASSERT_EQUAL(100, field("overflowFrames"));
+}
+
+void test_close_stops_accepting() {
+    startStream(16000);
+    jitter.close();
+    uint8_t pcm[4] = { 0 };
+    TEST_ASSERT_EQUAL(0, jitter.push(pcm, sizeof(pcm)));
+    TEST_ASSERT_TRUE(jitter.isDrained());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_open_needs_start);
+    RUN_TEST(test_buffers_to_target_then_plays);
+    RUN_TEST(test_frames_split_across_chunks);
+    RUN_TEST(test_restart_skips_old_stream);
+    RUN_TEST(test_steady_arrivals_with_mixed_sizes);
+    RUN_TEST(test_late_chunks_raise_target);
+    RUN_TEST(test_underrun_raises_floor);
+    RUN_TEST(test_overflow_is_counted);
+    RUN_TEST(test_close_stops_accepting);
+    return UNITY_END();
+}
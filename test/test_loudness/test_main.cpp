@@ -0,0 +1,89 @@
+#include <unity.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "modules/LoudnessMeter.h"
+
+void setUp() {}
+void tearDown() {}
+
+typedef std::vector<int16_t> Pcm;
+
+static LoudnessMeter meter;
+
+// Stereo sine with the same `dbfs` peak level in both channels.
+static Pcm sine(uint32_t rate, float hz, float dbfs, size_t frames) {
+    Pcm pcm(frames * 2);
+    float amplitude = 32767.0f * powf(10.0f, dbfs / 20.0f);
+    for (size_t i = 0; i < frames; i++) {
+        int16_t s = (int16_t)lrintf(amplitude * sinf(2.0f * (float)M_PI * hz * i / rate));
+        pcm[2 * i] = s;
+        pcm[2 * i + 1] = s;
+    }
+    return pcm;
+}
+
+static void measure(const Pcm& pcm, uint32_t rate, size_t step) {
+    meter.begin(rate, 2);
+    size_t frames = pcm.size() / 2;
+    for (size_t pos = 0; pos < frames; pos += step) {
+        meter.add(pcm.data() + 2 * pos, step < frames - pos ? step : frames - pos);
+    }
+}
+
+// BS.1770: a 997 Hz sine at -20 dBFS in both channels reads -20 LUFS.
+void test_reference_tone_per_rate() {
+    const uint32_t rates[] = { 22050, 44100, 48000 };
+    for (uint32_t rate : rates) {
+        measure(sine(rate, 997.0f, -20.0f, rate * 5), rate, 1024);
+        TEST_ASSERT_TRUE(meter.hasResult());
+        printf("  %5u Hz: %.2f LUFS\n", (unsigned)rate, meter.integratedLufs());
+        TEST_ASSERT_FLOAT_WITHIN(0.1f, -20.0f, meter.integratedLufs());
+    }
+}
+
+// Silence is below the absolute gate, so padding a tone with six seconds of
+// it barely moves the result; ungated it would read about -24.8 LUFS. Only
+// the blocks straddling the end of the tone still pass the relative gate.
+void test_silence_is_gated() {
+    const uint32_t rate = 48000;
+    Pcm pcm = sine(rate, 997.0f, -20.0f, rate * 3);
+    pcm.resize(pcm.size() * 3, 0);
+    measure(pcm, rate, 1024);
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, -20.0f, meter.integratedLufs());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 9.0f, meter.measuredSeconds());
+}
+
+void test_chunking_does_not_change_result() {
+    const uint32_t rate = 44100;
+    Pcm pcm = sine(rate, 440.0f, -12.0f, rate * 2);
+    measure(pcm, rate, pcm.size() / 2);
+    float whole = meter.integratedLufs();
+    const size_t steps[] = { 1, 37, 4410 };
+    for (size_t step : steps) {
+        measure(pcm, rate, step);
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, whole, meter.integratedLufs());
+    }
+}
+
+// The host figure is printed for comparison with the per-track analysis
+// cost AudioManager logs on the board.
+void test_throughput() {
+    const uint32_t rate = 44100;
+    Pcm pcm = sine(rate, 997.0f, -20.0f, rate * 30);
+    auto start = std::chrono::steady_clock::now();
+    measure(pcm, rate, 1152);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_TRUE(meter.hasResult());
+    printf("  44.1 kHz stereo: %.0f ns per frame, %.0fx realtime on this host\n",
+           (double)ns / (pcm.size() / 2), 30e9 / ns);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_reference_tone_per_rate);
+    RUN_TEST(test_silence_is_gated);
+    RUN_TEST(test_chunking_does_not_change_result);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
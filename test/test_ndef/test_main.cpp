@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <string.h>
+#include "modules/NdefParser.h"
+
+void setUp() {}
+void tearDown() {}
+
+// User area of an NTAG213 holding "https://example.com/t" behind a Lock
+// Control TLV, as read from page 4.
+static const uint8_t URI_TAG[] = {
+    0x01, 0x03, 0xA0, 0x0C, 0x34,
+    0x03, 0x12, 0xD1, 0x01, 0x0E, 0x55, 0x04,
+    'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm', '/', 't',
+    0xFE, 0x00, 0x00
+};
+
+void test_find_skips_other_tlvs() {
+    size_t offset = 0, length = 0;
+    TEST_ASSERT_EQUAL(NDEF_TLV_FOUND, NdefParser::findMessage(URI_TAG, sizeof(URI_TAG), &offset, &length));
+    TEST_ASSERT_EQUAL(7, offset);
+    TEST_ASSERT_EQUAL(0x12, length);
+}
+
+void test_find_needs_more_for_truncated_header() {
+    size_t offset = 0, length = 0;
+    TEST_ASSERT_EQUAL(NDEF_TLV_NEED_MORE, NdefParser::findMessage(URI_TAG, 6, &offset, &length));
+    TEST_ASSERT_EQUAL(7, length);
+
+    const uint8_t longTlv[] = { 0x00, 0x03, 0xFF, 0x01 };
+    TEST_ASSERT_EQUAL(NDEF_TLV_NEED_MORE, NdefParser::findMessage(longTlv, sizeof(longTlv), &offset, &length));
+    TEST_ASSERT_EQUAL(5, length);
+}
+
+void test_find_reads_three_byte_length() {
+    const uint8_t longTlv[] = { 0x03, 0xFF, 0x01, 0x20, 0xD1 };
+    size_t offset = 0, length = 0;
+    TEST_ASSERT_EQUAL(NDEF_TLV_FOUND, NdefParser::findMessage(longTlv, sizeof(longTlv), &offset, &length));
+    TEST_ASSERT_EQUAL(4, offset);
+    TEST_ASSERT_EQUAL(0x120, length);
+}
+
+void test_find_stops_at_terminator() {
+    const uint8_t empty[] = { 0x00, 0x00, 0xFE, 0x03, 0x05 };
+    size_t offset = 0, length = 0;
+    TEST_ASSERT_EQUAL(NDEF_TLV_ABSENT, NdefParser::findMessage(empty, sizeof(empty), &offset, &length));
+}
+
+void test_decode_uri_expands_prefix() {
+    char text[64];
+    size_t n = NdefParser::decodeFirstRecord(URI_TAG + 7, 0x12, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("https://example.com/t", text);
+    TEST_ASSERT_EQUAL(strlen(text), n);
+}
+
+void test_decode_text_strips_language() {
+    const uint8_t msg[] = { 0xD1, 0x01, 0x07, 'T', 0x02, 'e', 'n', 'v', 'o', 'l', '5' };
+    char text[16];
+    NdefParser::decodeFirstRecord(msg, sizeof(msg), text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("vol5", text);
+}
+
+void test_decode_rejects_payload_past_end() {
+    const uint8_t msg[] = { 0xD1, 0x01, 0x20, 'T', 0x02, 'e', 'n' };
+    char text[16];
+    TEST_ASSERT_EQUAL(0, NdefParser::decodeFirstRecord(msg, sizeof(msg), text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("", text);
+}
+
+void test_decode_truncates_to_output() {
+    char text[8];
+    size_t n = NdefParser::decodeFirstRecord(URI_TAG + 7, 0x12, text, sizeof(text));
+    TEST_ASSERT_EQUAL(7, n);
+    TEST_ASSERT_EQUAL_STRING("https:/", text);
+}
+
+void test_encode_uri_matches_tag_layout() {
+    uint8_t buf[64];
+    size_t len = NdefParser::encodeMessage("https://example.com/t", buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(sizeof(URI_TAG) - 5 - 2, len);
+    TEST_ASSERT_EQUAL_MEMORY(URI_TAG + 5, buf, len);
+}
+
+void test_encode_text_record() {
+    uint8_t buf[64];
+    size_t len = NdefParser::encodeMessage("tale/bunny", buf, sizeof(buf));
+    const uint8_t expected[] = { 0x03, 0x11, 0xD1, 0x01, 0x0D, 'T', 0x02, 'e', 'n',
+                                 't', 'a', 'l', 'e', '/', 'b', 'u', 'n', 'n', 'y', 0xFE };
+    TEST_ASSERT_EQUAL(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, len);
+}
+
+// A message of 0xFF bytes or more needs the three-byte TLV length.
+void test_encode_tlv_length_boundary() {
+    char input[260];
+    uint8_t buf[300];
+    memset(input, 'a', sizeof(input));
+    input[247] = '\0';
+    size_t len = NdefParser::encodeMessage(input, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0xFE, buf[1]);
+    TEST_ASSERT_EQUAL(2 + 0xFE + 1, len);
+    input[247] = 'a';
+    input[248] = '\0';
+    len = NdefParser::encodeMessage(input, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0xFF, buf[1]);
+    TEST_ASSERT_EQUAL(0x00, buf[2]);
+    TEST_ASSERT_EQUAL(0xFF, buf[3]);
+    TEST_ASSERT_EQUAL(4 + 0xFF + 1, len);
+}
+
+void test_encode_round_trip() {
+    const char* const inputs[] = { "tale/bunny", "https://example.com/a", "http://192.168.4.1/" };
+    for (const char* input : inputs) {
+        uint8_t buf[128];
+        size_t len = NdefParser::encodeMessage(input, buf, sizeof(buf));
+        TEST_ASSERT_GREATER_THAN(0, len);
+        TEST_ASSERT_EQUAL_HEX8(NDEF_TLV_TERMINATOR, buf[len - 1]);
+
+        size_t offset = 0, length = 0;
+        TEST_ASSERT_EQUAL(NDEF_TLV_FOUND, NdefParser::findMessage(buf, len, &offset, &length));
+        char text[128];
+        NdefParser::decodeFirstRecord(buf + offset, length, text, sizeof(text));
+        TEST_ASSERT_EQUAL_STRING(input, text);
+    }
+}
+
+void test_encode_long_record() {
+    char input[300];
+    memset(input, 'a', sizeof(input) - 1);
+    input[sizeof(input) - 1] = '\0';
+    uint8_t buf[400];
+    size_t len = NdefParser::encodeMessage(input, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(0xFF, buf[1]);
+
+    size_t offset = 0, length = 0;
+    TEST_ASSERT_EQUAL(NDEF_TLV_FOUND, NdefParser::findMessage(buf, len, &offset, &length));
+    static char text[400];
+    TEST_ASSERT_EQUAL(sizeof(input) - 1, NdefParser::decodeFirstRecord(buf + offset, length, text, sizeof(text)));
+}
+
+void test_encode_rejects_overflow() {
+    uint8_t buf[8];
+    TEST_ASSERT_EQUAL(0, NdefParser::encodeMessage("too long for this", buf, sizeof(buf)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_find_skips_other_tlvs);
+    RUN_TEST(test_find_needs_more_for_truncated_header);
+    RUN_TEST(test_find_reads_three_byte_length);
+    RUN_TEST(test_find_stops_at_terminator);
+    RUN_TEST(test_decode_uri_expands_prefix);
+    RUN_TEST(test_decode_text_strips_language);
+    RUN_TEST(test_decode_rejects_payload_past_end);
+    RUN_TEST(test_decode_truncates_to_output);
+    RUN_TEST(test_encode_uri_matches_tag_layout);
+    RUN_TEST(test_encode_text_record);
+    RUN_TEST(test_encode_tlv_length_boundary);
+    RUN_TEST(test_encode_round_trip);
+    RUN_TEST(test_encode_long_record);
+    RUN_TEST(test_encode_rejects_overflow);
+    return UNITY_END();
+}
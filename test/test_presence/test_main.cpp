@@ -0,0 +1,96 @@
+#include <unity.h>
+#include "modules/PresenceTracker.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint8_t UID[] = { 0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6 };
+static const uint8_t OTHER[] = { 0x04, 0xA1, 0xB2, 0xC3 };
+
+// Runs presence checks every NFC_PRESENCE_INTERVAL_MS from `startMs` while
+// the tag is on the reader until `liftMs`, and returns the time of the check
+// that reported the removal, or 0 if none did before `endMs`.
+static uint32_t simulate(PresenceTracker& tracker, uint32_t startMs, uint32_t liftMs, uint32_t endMs) {
+    for (uint32_t now = startMs; now < endMs; now += NFC_PRESENCE_INTERVAL_MS) {
+        if (tracker.update(now < liftMs, now)) return now;
+    }
+    return 0;
+}
+
+void test_removal_within_misses_intervals() {
+    // Lifting the tag anywhere inside an interval must be reported within
+    // NFC_PRESENCE_MISSES checks of the last check that saw it.
+    for (uint32_t lift = 1000; lift < 1000 + NFC_PRESENCE_INTERVAL_MS; lift += 10) {
+        PresenceTracker tracker;
+        tracker.start(UID, sizeof(UID), 0, false);
+        uint32_t removed = simulate(tracker, NFC_PRESENCE_INTERVAL_MS, lift, 10000);
+        TEST_ASSERT_NOT_EQUAL(0, removed);
+        TEST_ASSERT_FALSE(tracker.isPresent());
+        TEST_ASSERT_LESS_OR_EQUAL(NFC_PRESENCE_MISSES * NFC_PRESENCE_INTERVAL_MS, removed - tracker.lastSeenMs());
+        TEST_ASSERT_LESS_THAN(lift, tracker.lastSeenMs() + 1);
+    }
+}
+
+void test_single_glitch_keeps_tag() {
+    PresenceTracker tracker;
+    tracker.start(UID, sizeof(UID), 0, false);
+    uint32_t now = 0;
+    for (int i = 0; i < 40; i++) {
+        now += NFC_PRESENCE_INTERVAL_MS;
+        // Every fifth check fails on its own, as a dropped I2C transaction.
+        TEST_ASSERT_FALSE(tracker.update(i % 5 != 4, now));
+    }
+    TEST_ASSERT_TRUE(tracker.isPresent());
+}
+
+void test_removal_reported_once() {
+    PresenceTracker tracker;
+    tracker.start(UID, sizeof(UID), 0, false);
+    int reports = 0;
+    for (uint32_t now = 150; now < 3000; now += NFC_PRESENCE_INTERVAL_MS) {
+        reports += tracker.update(false, now);
+    }
+    TEST_ASSERT_EQUAL(1, reports);
+}
+
+void test_returned_tag_matches() {
+    PresenceTracker tracker;
+    tracker.start(UID, sizeof(UID), 0, false);
+    simulate(tracker, 150, 600, 2000);
+    TEST_ASSERT_FALSE(tracker.isPresent());
+    TEST_ASSERT_TRUE(tracker.matches(UID, sizeof(UID)));
+    TEST_ASSERT_FALSE(tracker.matches(OTHER, sizeof(OTHER)));
+
+    tracker.start(UID, sizeof(UID), 2000, false);
+    TEST_ASSERT_TRUE(tracker.isPresent());
+    TEST_ASSERT_EQUAL(2000, tracker.lastSeenMs());
+}
+
+void test_forget_drops_uid() {
+    PresenceTracker tracker;
+    tracker.start(UID, sizeof(UID), 0, false);
+    tracker.forget();
+    TEST_ASSERT_FALSE(tracker.isPresent());
+    TEST_ASSERT_FALSE(tracker.matches(UID, sizeof(UID)));
+    TEST_ASSERT_FALSE(tracker.update(false, 150));
+}
+
+void test_silent_tracking() {
+    PresenceTracker tracker;
+    tracker.start(OTHER, sizeof(OTHER), 0, true);
+    TEST_ASSERT_TRUE(tracker.isSilent());
+    TEST_ASSERT_NOT_EQUAL(0, simulate(tracker, 150, 300, 2000));
+    tracker.start(OTHER, sizeof(OTHER), 2000, false);
+    TEST_ASSERT_FALSE(tracker.isSilent());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_removal_within_misses_intervals);
+    RUN_TEST(test_single_glitch_keeps_tag);
+    RUN_TEST(test_removal_reported_once);
+    RUN_TEST(test_returned_tag_matches);
+    RUN_TEST(test_forget_drops_uid);
+    RUN_TEST(test_silent_tracking);
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "utils/ProfileLog.h"
+
+void setUp() {}
+void tearDown() {}
+
+static ProfileLog profile;
+static uint8_t buffer[256];
+
+static void reset(size_t capacity = sizeof(buffer)) {
+    profile.attach(buffer, capacity);
+    profile.setRate(997);
+}
+
+static std::vector<uint8_t> dump() {
+    std::vector<uint8_t> data(profile.dumpSize());
+    data.resize(profile.read(0, data.data(), data.size()));
+    return data;
+}
+
+static uint32_t le32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void test_dump_layout() {
+    reset();
+    const uint32_t pcs[] = { 0x400d1234, 0x400d5678 };
+    TEST_ASSERT_TRUE(profile.add(1, profile.taskSlot(&profile, "loopTask"), pcs, 2));
+    profile.addDuration(250);
+    std::vector<uint8_t> data = dump();
+    TEST_ASSERT_EQUAL(28 + PROFILE_TASK_LEN + 12, data.size());
+    TEST_ASSERT_EQUAL_HEX32(PROFILE_MAGIC, le32(&data[0]));
+    TEST_ASSERT_EQUAL(PROFILE_VERSION, data[4]);
+    TEST_ASSERT_EQUAL(PROFILE_DEPTH, data[5]);
+    TEST_ASSERT_EQUAL(1, data[6]);
+    TEST_ASSERT_EQUAL(997, le32(&data[8]));
+    TEST_ASSERT_EQUAL(1, le32(&data[12]));
+    TEST_ASSERT_EQUAL(0, le32(&data[16]));
+    TEST_ASSERT_EQUAL(250, le32(&data[20]));
+    TEST_ASSERT_EQUAL(12, le32(&data[24]));
+    TEST_ASSERT_EQUAL_STRING("loopTask", (const char*)&data[28]);
+    const uint8_t* record = &data[28 + PROFILE_TASK_LEN];
+    TEST_ASSERT_EQUAL(1, record[0]);
+    TEST_ASSERT_EQUAL(0, record[1]);
+    TEST_ASSERT_EQUAL(2, record[2]);
+    TEST_ASSERT_EQUAL_HEX32(0x400d1234, le32(record + 4));
+    TEST_ASSERT_EQUAL_HEX32(0x400d5678, le32(record + 8));
+}
+
+void test_task_table_overflow() {
+    static int tasks[PROFILE_TASKS + 2];
+    reset();
+    for (uint8_t i = 0; i < PROFILE_TASKS; i++) {
+        TEST_ASSERT_EQUAL(i, profile.taskSlot(&tasks[i], "task"));
+    }
+    TEST_ASSERT_EQUAL(3, profile.taskSlot(&tasks[3], "again"));
+    TEST_ASSERT_EQUAL(0xFF, profile.taskSlot(&tasks[PROFILE_TASKS], "late"));
+    TEST_ASSERT_EQUAL(PROFILE_TASKS, profile.header().tasks);
+    TEST_ASSERT_EQUAL_STRING("(other)", profile.taskName(0xFF));
+}
+
+void test_long_names_are_cut() {
+    reset();
+    uint8_t slot = profile.taskSlot(&profile, "a_very_long_task_name");
+    TEST_ASSERT_EQUAL(PROFILE_TASK_LEN - 1, strlen(profile.taskName(slot)));
+}
+
+void test_full_log_drops() {
+    reset(4 + 4 * PROFILE_DEPTH + 8);
+    uint32_t pcs[PROFILE_DEPTH + 2] = {};
+    TEST_ASSERT_TRUE(profile.add(0, 0, pcs, PROFILE_DEPTH + 2));
+    TEST_ASSERT_TRUE(profile.add(0, 0, pcs, 1));
+    TEST_ASSERT_FALSE(profile.isFull());
+    TEST_ASSERT_FALSE(profile.add(0, 0, pcs, 1));
+    TEST_ASSERT_TRUE(profile.isFull());
+    // Once full, even a sample that would fit is dropped.
+    TEST_ASSERT_FALSE(profile.add(0, 0, pcs, 0));
+    TEST_ASSERT_EQUAL(2, profile.header().samples);
+    TEST_ASSERT_EQUAL(2, profile.header().dropped);
+    TEST_ASSERT_EQUAL(4 + 4 * PROFILE_DEPTH + 8, profile.header().bytes);
+}
+
+void test_next_walks_records() {
+    reset();
+    const uint32_t pcs[] = { 1, 2, 3 };
+    for (uint8_t i = 0; i < 4; i++) profile.add(i & 1, i, pcs, i);
+    ProfileLog::Sample sample;
+    size_t pos = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(profile.next(&pos, &sample));
+        TEST_ASSERT_EQUAL(i & 1, sample.core);
+        TEST_ASSERT_EQUAL(i, sample.task);
+        TEST_ASSERT_EQUAL(i, sample.depth);
+        if (i) TEST_ASSERT_EQUAL(i, le32(sample.pcs + 4 * (i - 1)));
+    }
+    TEST_ASSERT_FALSE(profile.next(&pos, &sample));
+}
+
+void test_read_in_pieces() {
+    reset();
+    const uint32_t pcs[] = { 0x11111111, 0x22222222, 0x33333333 };
+    profile.add(0, profile.taskSlot(&profile, "IDLE0"), pcs, 3);
+    profile.add(1, profile.taskSlot(&buffer, "IDLE1"), pcs, 2);
+    std::vector<uint8_t> whole = dump();
+    const size_t steps[] = { 1, 5, 16, 27, 64 };
+    for (size_t step : steps) {
+        std::vector<uint8_t> pieces;
+        uint8_t chunk[64];
+        size_t n;
+        while ((n = profile.read(pieces.size(), chunk, step)) > 0) pieces.insert(pieces.end(), chunk, chunk + n);
+        TEST_ASSERT_EQUAL(whole.size(), pieces.size());
+        TEST_ASSERT_EQUAL_MEMORY(whole.data(), pieces.data(), whole.size());
+    }
+}
+
+void test_hex_lines_cover_dump() {
+    reset();
+    const uint32_t pcs[PROFILE_DEPTH] = { 0xdeadbeef };
+    for (uint8_t i = 0; i < 5; i++) profile.add(0, profile.taskSlot(&profile, "loopTask"), pcs, PROFILE_DEPTH);
+    std::vector<uint8_t> whole = dump();
+    std::string hex;
+    char line[PROFILE_HEX_LEN];
+    size_t offset = 0;
+    while (offset < whole.size()) {
+        size_t n = profile.hexLine(offset, line);
+        TEST_ASSERT_GREATER_THAN(0, n);
+        TEST_ASSERT_LESS_OR_EQUAL(PROFILE_DUMP_LINE, n);
+        TEST_ASSERT_EQUAL(offset, strtoul(line, nullptr, 16));
+        TEST_ASSERT_EQUAL(' ', line[8]);
+        TEST_ASSERT_EQUAL(9 + 2 * n, strlen(line));
+        hex += line + 9;
+        offset += n;
+    }
+    TEST_ASSERT_EQUAL(0, profile.hexLine(offset, line));
+    TEST_ASSERT_EQUAL(2 * whole.size(), hex.size());
+    for (size_t i = 0; i < whole.size(); i++) {
+        TEST_ASSERT_EQUAL_HEX8(whole[i], strtoul(hex.substr(2 * i, 2).c_str(), nullptr, 16));
+    }
+}
+
+void test_clear_keeps_rate() {
+    reset();
+    const uint32_t pcs[] = { 1 };
+    profile.add(0, profile.taskSlot(&profile, "loopTask"), pcs, 1);
+    profile.addDuration(10);
+    profile.clear();
+    TEST_ASSERT_EQUAL(997, profile.header().hz);
+    TEST_ASSERT_EQUAL(0, profile.header().samples);
+    TEST_ASSERT_EQUAL(0, profile.header().tasks);
+    TEST_ASSERT_EQUAL(0, profile.header().durationMs);
+    TEST_ASSERT_EQUAL(28, profile.dumpSize());
+    TEST_ASSERT_EQUAL(0, profile.taskSlot(&buffer, "other"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_dump_layout);
+    RUN_TEST(test_task_table_overflow);
+    RUN_TEST(test_long_names_are_cut);
+    RUN_TEST(test_full_log_drops);
+    RUN_TEST(test_next_walks_records);
+    RUN_TEST(test_read_in_pieces);
+    RUN_TEST(test_hex_lines_cover_dump);
+    RUN_TEST(test_clear_keeps_rate);
+    return UNITY_END();
+}
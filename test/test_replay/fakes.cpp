@@ -0,0 +1,109 @@
+#include "fakes.h"
+#include "modules/AudioManager.h"
+#include "modules/ThemeManager.h"
+#include "modules/WebPortal.h"
+#include "modules/LedController.h"
+#include "utils/LoopWatchdog.h"
+
+FakeHardware fake;
+
+static void setPlaying(AudioStateCallback& callback, bool playing) {
+    fake.playing = playing;
+    if (callback) callback(playing);
+}
+
+AudioManager::AudioManager()
+    : _currentVolume(10), _trackIndex(0), _isBtMode(false), _btInitialized(false), _stateCallback(nullptr) {}
+void AudioManager::begin() {}
+bool AudioManager::beginWarmCache() { return true; }
+void AudioManager::loop() {}
+void AudioManager::playFile(String filename) {
+    fake.tracksStarted++;
+    setPlaying(_stateCallback, true);
+}
+void AudioManager::playFolder(String folderPath) {
+    fake.folder = folderPath;
+    fake.tracksStarted++;
+    setPlaying(_stateCallback, true);
+}
+void AudioManager::playNext() {
+    if (_isBtMode) return;
+    fake.tracksStarted++;
+    setPlaying(_stateCallback, true);
+}
+void AudioManager::playStream() { setPlaying(_stateCallback, true); }
+JitterBuffer* AudioManager::getStreamBuffer() { return &_stream; }
+void AudioManager::stop() {
+    if (!_isBtMode) setPlaying(_stateCallback, false);
+}
+void AudioManager::pause() { setPlaying(_stateCallback, false); }
+void AudioManager::resume() { setPlaying(_stateCallback, true); }
+void AudioManager::togglePause() { setPlaying(_stateCallback, !fake.playing); }
+bool AudioManager::isPlaying() { return fake.playing; }
+const char* AudioManager::getCurrentTrack() { return fake.folder.c_str(); }
+uint32_t AudioManager::getPosition() { return 0; }
+bool AudioManager::preloadCue(const char* path) { return false; }
+bool AudioManager::preloadEmbeddedCue(const char* path) { return false; }
+bool AudioManager::playCue(const char* path) { return false; }
+bool AudioManager::isCuePlaying() { return false; }
+void AudioManager::setVolume(int volume) { _currentVolume = volume; }
+int AudioManager::getVolume() { return _currentVolume; }
+void AudioManager::setSpeed(uint8_t percent) {}
+uint8_t AudioManager::getSpeed() { return 100; }
+void AudioManager::startBluetooth() {
+    _isBtMode = true;
+    fake.playing = false;
+}
+void AudioManager::stopBluetooth() { _isBtMode = false; }
+void AudioManager::btNext() {}
+void AudioManager::setWifiActive(bool active) {}
+void AudioManager::setVisualizer(bool enabled) {}
+uint8_t AudioManager::getVisualLevel() { return 0; }
+void AudioManager::onStateChange(AudioStateCallback cb) { _stateCallback = cb; }
+bool AudioManager::handleCommand(const char* line) { return false; }
+
+NfcManager::NfcManager(uint8_t pinSda, uint8_t pinScl) : _pinSda(pinSda), _pinScl(pinScl), _nfc(pinSda, pinScl) {}
+void NfcManager::begin() {}
+void NfcManager::onTagDetected(std::function<void(String, String)> callback) { fake.tagCallback = callback; }
+void NfcManager::onPresenceChange(std::function<void(NfcPresenceEvent)> callback) {
+    fake.presenceCallback = callback;
+}
+uint32_t NfcManager::getLastSeenMs() { return millis(); }
+void NfcManager::forgetTag() {}
+void NfcManager::cancelWrite() {}
+
+void ThemeManager::begin() {}
+void ThemeManager::apply(String eventName, AudioManager& audio, LedController& led) {}
+void ThemeManager::setLed(String eventName, LedController& led) {}
+void ThemeManager::preloadSounds(AudioManager& audio) {}
+
+void LedController::begin() {}
+void LedController::setColor(uint8_t r, uint8_t g, uint8_t b) {}
+void LedController::setLoading(bool active) {}
+void LedController::blinkError(int count) {}
+void LedController::setVisualizer(bool enabled) {}
+void LedController::setVisualLevel(uint8_t level) {}
+void LedController::loop() {}
+
+void WebPortal::begin() {}
+void WebPortal::stop() {}
+void WebPortal::loop() {}
+bool WebPortal::isClientConnected() { return false; }
+void WebPortal::onVolumeChange(std::function<void(int)> callback) {}
+void WebPortal::onSpeedChange(std::function<void(int)> callback) {}
+void WebPortal::onLedChange(std::function<void(int, int, int)> callback) {}
+void WebPortal::onUploadComplete(std::function<void(const char*)> callback) {}
+void WebPortal::setStreamSink(JitterBuffer* sink) {}
+void WebPortal::onStreamStart(std::function<void()> callback) {}
+void WebPortal::setRecordingStore(RecordingStore* store) {}
+void WebPortal::setUploadTarget(const char* uid) {}
+void WebPortal::setContentSync(ContentSync* sync) {}
+void WebPortal::setPackExtractor(TarExtractor* extractor) {}
+void WebPortal::setTagWriter(NfcManager* nfc) {}
+void WebPortal::setCardScanner(CardScanner* scanner) {}
+void WebPortal::publishStatus(const char* state, int volume, int speed, const char* track, uint32_t position) {}
+
+void LoopWatchdog::begin() {}
+bool LoopWatchdog::handleCommand(const char* line) { return false; }
+LoopScope::LoopScope(LoopModule module, const char* file, uint16_t line) : _module(module), _startUs(micros()) {}
+LoopScope::~LoopScope() {}
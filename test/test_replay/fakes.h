@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+#include "modules/NfcManager.h"
+
+// What the fake hardware modules linked into test_replay hold. Audio
+// reports state changes the way AudioManager does: play, resume and a
+// toggle into playback report true, pause and stop report false. A track
+// that runs out only stops isPlaying(); the main loop has to notice.
+struct FakeHardware {
+    bool playing = false;
+    String folder;
+    uint32_t tracksStarted = 0;
+    std::function<void(String, String)> tagCallback;
+    std::function<void(NfcPresenceEvent)> presenceCallback;
+};
+
+extern FakeHardware fake;
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <vector>
+#include "fakes.h"
+#include "main.cpp"
+
+void setUp() {}
+void tearDown() {}
+
+// A live session is driven through main.cpp's handlers against the SD,
+// NVS and serial fakes in test/stubs and the hardware fakes in fakes.cpp,
+// the board is rebooted and the session replayed from the serial console.
+// The replay has to take the state machine through the same transitions
+// and post the same commands. At 20x the two interleave differently (a
+// replayed audio event can land before the command that caused it live),
+// so each sequence is compared on its own.
+#define REPLAY_SPEED 20
+
+struct Record {
+    uint8_t type;
+    uint8_t arg;
+    uint32_t value;
+};
+
+static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms / 10; i++) {
+        stubMicros += 10 * 1000;
+        loop();
+    }
+}
+
+static void hold(uint8_t pin, uint32_t ms) {
+    stubPins[pin] = HIGH;
+    run(ms);
+    stubPins[pin] = LOW;
+    run(300);
+}
+
+// Everything a reset clears; the card, NVS and the clock carry over.
+static void reboot() {
+    currentState = STATE_IDLE;
+    lastScannedTag = "";
+    stateEnterTime = lastNfcTime = trackEndTime = 0;
+    isCustomFigurineActive = nfcEventPending = pendingCustomPlayback = false;
+    pendingPresence = -1;
+    pausedByRemoval = isComboMode = ignoreButtonsUntilRelease = false;
+    pendingUid = pendingContent = "";
+    currentFigurine[0] = uploadedFigurine[0] = '\0';
+    tagRouter = TagRouter();
+    fake = FakeHardware();
+    setup();
+}
+
+static std::vector<Record> readLog() {
+    std::vector<Record> records;
+    auto data = SD.data(SESSION_LOG_FILE);
+    TEST_ASSERT_TRUE(data != nullptr);
+    const uint8_t* p = data->data();
+    for (size_t pos = 0; pos + 11 <= data->size(); pos += 11 + p[pos + 10]) {
+        const uint8_t* h = p + pos;
+        records.push_back({ h[8], h[9], (uint32_t)(h[4] | h[5] << 8 | h[6] << 16 | (uint32_t)h[7] << 24) });
+    }
+    return records;
+}
+
+static std::vector<uint8_t> args(const std::vector<Record>& records, size_t from, size_t to, uint8_t type) {
+    std::vector<uint8_t> out;
+    for (size_t i = from; i < to; i++) {
+        if (records[i].type == type) out.push_back(records[i].arg);
+    }
+    return out;
+}
+
+static void assertSame(const std::vector<uint8_t>& live, const std::vector<uint8_t>& replayed) {
+    TEST_ASSERT_EQUAL(live.size(), replayed.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(live.data(), replayed.data(), live.size());
+}
+
+static uint8_t transition(AppState from, AppState to) {
+    return (from << 4) | to;
+}
+
+void test_replay_repeats_live_session() {
+    SD.reset();
+    stubPreferencesReset();
+    stubMicros = 1000 * 1000;
+    reboot();
+    run(1000);
+
+    fake.tagCallback("04A1B2C3", TAG_CMD_TALE "bunny");
+    run(1000);
+    TEST_ASSERT_EQUAL(STATE_PLAYING, currentState);
+    TEST_ASSERT_EQUAL_STRING(DIR_TALES "/bunny", fake.folder.c_str());
+
+    fake.presenceCallback(NFC_TAG_REMOVED);
+    run(500);
+    TEST_ASSERT_EQUAL(STATE_PAUSED, currentState);
+    fake.presenceCallback(NFC_TAG_RETURNED);
+    run(500);
+    TEST_ASSERT_EQUAL(STATE_PLAYING, currentState);
+
+    hold(Board::pinBtnCtrl, 200);
+    TEST_ASSERT_EQUAL(STATE_PAUSED, currentState);
+    hold(Board::pinBtnCtrl, 200);
+    TEST_ASSERT_EQUAL(STATE_PLAYING, currentState);
+
+    fake.playing = false;
+    run(1000);
+    TEST_ASSERT_TRUE(fake.playing);
+    TEST_ASSERT_EQUAL(2, fake.tracksStarted);
+
+    hold(Board::pinBtnVol, 1000);
+    TEST_ASSERT_EQUAL(STATE_BT_MODE, currentState);
+    hold(Board::pinBtnVol, 1000);
+    TEST_ASSERT_EQUAL(STATE_IDLE, currentState);
+    run(SESSION_FLUSH_MS + 10);
+
+    reboot();
+    run(1000);
+    char command[16];
+    snprintf(command, sizeof(command), "replay %d\n", REPLAY_SPEED);
+    Serial.stubInput(command);
+    run(10);
+    TEST_ASSERT_TRUE(sessionLog.isReplaying());
+    for (int i = 0; i < 1000 && sessionLog.isReplaying(); i++) run(10);
+    TEST_ASSERT_FALSE(sessionLog.isReplaying());
+    run(SESSION_FLUSH_MS + 10);
+    TEST_ASSERT_EQUAL(STATE_IDLE, currentState);
+    TEST_ASSERT_EQUAL(2, fake.tracksStarted);
+
+    std::vector<Record> records = readLog();
+    size_t boot2 = 0, replayStart = 0, replayEnd = 0;
+    for (size_t i = 1; i < records.size(); i++) {
+        if (records[i].type == SES_BOOT && !boot2) boot2 = i;
+        if (records[i].type == SES_REPLAY && records[i].arg == 1) replayStart = i;
+        if (records[i].type == SES_REPLAY && records[i].arg == 0) replayEnd = i;
+    }
+    TEST_ASSERT_EQUAL(SES_BOOT, records[0].type);
+    TEST_ASSERT_GREATER_THAN(0, boot2);
+    TEST_ASSERT_GREATER_THAN(boot2, replayStart);
+    TEST_ASSERT_GREATER_THAN(replayStart, replayEnd);
+    TEST_ASSERT_EQUAL(REPLAY_SPEED, records[replayStart].value);
+
+    size_t inputs = 0;
+    for (size_t i = 1; i < boot2; i++) {
+        uint8_t type = records[i].type;
+        if (type == SES_TAG || type == SES_PRESENCE || type == SES_BUTTON || type == SES_AUDIO) inputs++;
+    }
+    TEST_ASSERT_EQUAL(inputs, records[replayEnd].value);
+
+    std::vector<uint8_t> liveStates = args(records, 0, boot2, SES_STATE);
+    const uint8_t expected[] = {
+        transition(STATE_IDLE, STATE_PLAYING),    transition(STATE_PLAYING, STATE_PAUSED),
+        transition(STATE_PAUSED, STATE_PLAYING),  transition(STATE_PLAYING, STATE_PAUSED),
+        transition(STATE_PAUSED, STATE_PLAYING),  transition(STATE_PLAYING, STATE_BT_MODE),
+        transition(STATE_BT_MODE, STATE_IDLE),
+    };
+    TEST_ASSERT_EQUAL(sizeof(expected), liveStates.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, liveStates.data(), sizeof(expected));
+    assertSame(liveStates, args(records, replayStart, records.size(), SES_STATE));
+    assertSame(args(records, 0, boot2, SES_COMMAND), args(records, replayStart, records.size(), SES_COMMAND));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_repeats_live_session);
+    return UNITY_END();
+}
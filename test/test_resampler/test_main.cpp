@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "modules/Resampler.h"
+
+void setUp() {}
+void tearDown() {}
+
+typedef std::vector<int16_t> Pcm;
+
+static Resampler resampler;
+
+// Stereo sine, the right channel at half the amplitude.
+static Pcm sine(uint32_t rate, float hz, size_t frames) {
+    Pcm pcm(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        float v = 16000.0f * sinf(2.0f * (float)M_PI * hz * i / rate);
+        pcm[2 * i] = (int16_t)lroundf(v);
+        pcm[2 * i + 1] = (int16_t)lroundf(v / 2);
+    }
+    return pcm;
+}
+
+// Feeds `in` in pieces of at most `step` frames with `room` frames of
+// output per call, carrying over what a call did not take, then collects
+// what the resampler still holds.
+static Pcm convert(const Pcm& in, size_t step, size_t room) {
+    Pcm out;
+    Pcm block(room * 2);
+    size_t frames = in.size() / 2;
+    size_t pos = 0;
+    while (true) {
+        size_t take = std::min(step, frames - pos);
+        size_t used = 0;
+        size_t produced = resampler.process(in.data() + 2 * pos, take, block.data(), room, &used);
+        out.insert(out.end(), block.begin(), block.begin() + produced * 2);
+        pos += used;
+        if (pos == frames && !produced) break;
+    }
+    return out;
+}
+
+// Signal to error of the left channel against the ideal sine, skipping a
+// filter length at each end.
+static float snrDb(const Pcm& out, uint32_t rate, float hz) {
+    double signal = 0, noise = 0;
+    size_t frames = out.size() / 2;
+    for (size_t i = RESAMPLE_MAX_TAPS; i + RESAMPLE_MAX_TAPS < frames; i++) {
+        double ideal = 16000.0 * sin(2.0 * M_PI * hz * i / rate);
+        double e = out[2 * i] - ideal;
+        signal += ideal * ideal;
+        noise += e * e;
+    }
+    return 10.0f * log10f((float)(signal / (noise + 1e-9)));
+}
+
+void test_equal_rates_pass_through() {
+    TEST_ASSERT_TRUE(resampler.begin());
+    resampler.configure(44100, 44100, RESAMPLE_MEDIUM);
+    TEST_ASSERT_TRUE(resampler.isBypass());
+    Pcm in = sine(44100, 1000, 300);
+    Pcm out = convert(in, 300, 256);
+    TEST_ASSERT_EQUAL(in.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(in.data(), out.data(), in.size() * sizeof(int16_t));
+}
+
+void test_snr_per_quality() {
+    struct Case {
+        uint32_t rate;
+        ResampleQuality quality;
+        float minDb;
+    };
+    // 16 and 32 kHz need 441 branches, more than the table holds.
+    const Case cases[] = {
+        { 22050, RESAMPLE_LOW, 40 },    { 22050, RESAMPLE_MEDIUM, 60 }, { 22050, RESAMPLE_HIGH, 75 },
+        { 48000, RESAMPLE_MEDIUM, 60 }, { 16000, RESAMPLE_MEDIUM, 50 }, { 32000, RESAMPLE_MEDIUM, 50 },
+    };
+    for (const Case& c : cases) {
+        resampler.configure(c.rate, 44100, c.quality);
+        TEST_ASSERT_FALSE(resampler.isBypass());
+        Pcm out = convert(sine(c.rate, 1000, c.rate / 4), resampler.maxInput(256), 256);
+        // The last half window stays buffered.
+        TEST_ASSERT_INT_WITHIN(2 * RESAMPLE_MAX_TAPS, 44100 / 4, out.size() / 2);
+        float db = snrDb(out, 44100, 1000);
+        printf("  %5u Hz %-6s %u phases: %.1f dB\n", (unsigned)c.rate, Resampler::qualityName(c.quality),
+               resampler.getPhases(), db);
+        TEST_ASSERT_GREATER_THAN(c.minDb, db);
+    }
+}
+
+void test_chunking_does_not_change_output() {
+    const uint32_t rates[] = { 22050, 48000, 32000 };
+    for (uint32_t rate : rates) {
+        Pcm in = sine(rate, 440, 5000);
+        resampler.configure(rate, 44100, RESAMPLE_MEDIUM);
+        Pcm whole = convert(in, in.size(), in.size() * 3);
+        const size_t steps[] = { 1, 7, 100, 255 };
+        for (size_t step : steps) {
+            resampler.reset();
+            Pcm out = convert(in, step, 4096);
+            TEST_ASSERT_EQUAL(whole.size(), out.size());
+            TEST_ASSERT_EQUAL_MEMORY(whole.data(), out.data(), whole.size() * sizeof(int16_t));
+        }
+    }
+}
+
+void test_small_output_room_keeps_input() {
+    Pcm in = sine(22050, 440, 3000);
+    resampler.configure(22050, 44100, RESAMPLE_MEDIUM);
+    Pcm whole = convert(in, in.size(), in.size() * 3);
+    resampler.reset();
+    // More input per call than the output room allows; what is left over
+    // has to come back in the next call.
+    Pcm out = convert(in, 256, 64);
+    TEST_ASSERT_EQUAL(whole.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(whole.data(), out.data(), whole.size() * sizeof(int16_t));
+}
+
+void test_max_input_is_taken_whole() {
+    const uint32_t rates[] = { 8000, 22050, 32000, 48000, 96000 };
+    for (uint32_t rate : rates) {
+        resampler.configure(rate, 44100, RESAMPLE_HIGH);
+        size_t block = std::min(resampler.maxInput(256), (size_t)256);
+        Pcm in = sine(rate, 300, block);
+        Pcm out(256 * 2);
+        for (int i = 0; i < 200; i++) {
+            size_t used = 0;
+            resampler.process(in.data(), block, out.data(), 256, &used);
+            TEST_ASSERT_EQUAL(block, used);
+        }
+    }
+}
+
+// Multiply-accumulates per output frame are two per tap; the host time is
+// printed for comparison with "resample bench" on the board.
+void test_cost_per_quality() {
+    const uint8_t taps[] = { 8, 16, 32 };
+    Pcm in = sine(22050, 1000, 22050);
+    for (uint8_t q = 0; q < RESAMPLE_QUALITY_COUNT; q++) {
+        resampler.configure(22050, 44100, (ResampleQuality)q);
+        TEST_ASSERT_EQUAL(taps[q], resampler.getTaps());
+        auto start = std::chrono::steady_clock::now();
+        Pcm out = convert(in, resampler.maxInput(256), 256);
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        printf("  %-6s %u MACs per frame, %.0f ns per frame on this host\n",
+               Resampler::qualityName((ResampleQuality)q), 2u * resampler.getTaps(), (double)ns / (out.size() / 2));
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_equal_rates_pass_through);
+    RUN_TEST(test_snr_per_quality);
+    RUN_TEST(test_chunking_does_not_change_output);
+    RUN_TEST(test_small_output_room_keeps_input);
+    RUN_TEST(test_max_input_is_taken_whole);
+    RUN_TEST(test_cost_per_quality);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+#include <unity.h>
+#include <string>
+#include "modules/CardScanner.h"
+
+void setUp() {}
+void tearDown() {}
+
+// MPEG-1 layer III, 128 kbps, 44.1 kHz: 417-byte frames.
+static const uint8_t FRAME_HEADER[] = { 0xFF, 0xFB, 0x90, 0x00 };
+#define FRAME_BYTES 417
+
+static void putMp3(const char* path, int frames, size_t cut = 0) {
+    std::string data;
+    for (int i = 0; i < frames; i++) {
+        data.append((const char*)FRAME_HEADER, 4);
+        data.append(FRAME_BYTES - 4, '\0');
+    }
+    data.resize(data.size() - cut);
+    File file = SD.open(path, FILE_WRITE);
+    file.write((const uint8_t*)data.data(), data.size());
+    file.close();
+}
+
+static void fresh() {
+    SD.reset();
+    SD.mkdir(DIR_TALES);
+    SD.mkdir(DIR_RECORDS);
+    SD.mkdir("/system");
+    stubMicros = 100 * 1000 * 1000;
+}
+
+static unsigned field(CardScanner& scanner, const char* key) {
+    static char json[2048];
+    if (!scanner.writeJson(json, sizeof(json))) return 0xFFFF;
+    std::string needle = std::string("\"") + key + "\":";
+    const char* at = strstr(json, needle.c_str());
+    return at ? atoi(at + needle.size()) : 0xFFFF;
+}
+
+static bool inState(CardScanner& scanner, const char* state) {
+    static char json[2048];
+    scanner.writeJson(json, sizeof(json));
+    return strstr(json, (std::string("\"state\":\"") + state + "\"").c_str()) != nullptr;
+}
+
+// Idle long enough for the scanner to start, then one loop() per ms.
+static void runUntil(CardScanner& scanner, const char* state, int calls = 10000) {
+    scanner.loop(true);
+    stubMicros += SCAN_IDLE_DELAY_MS * 1000UL;
+    for (int i = 0; i < calls && !inState(scanner, state); i++) {
+        scanner.loop(true);
+        stubMicros += 1000;
+    }
+}
+
+static CardScanner damaged;
+static CardScanner budgeted;
+static CardScanner cached;
+
+void test_pass_finds_damage_in_nested_folders() {
+    fresh();
+    SD.mkdir(DIR_TALES "/fox");
+    SD.mkdir(DIR_TALES "/fox/extra");
+    putMp3(DIR_TALES "/fox/01.mp3", 20);
+    putMp3(DIR_TALES "/fox/extra/02.mp3", 20, 100);
+    File wav = SD.open(DIR_RECORDS "/a.wav", FILE_WRITE);
+    wav.print("not a riff file");
+    wav.close();
+    TEST_ASSERT_TRUE(damaged.begin());
+    runUntil(damaged, "checking");
+    runUntil(damaged, "waiting");
+    TEST_ASSERT_EQUAL(3, field(damaged, "files"));
+    TEST_ASSERT_EQUAL(2, field(damaged, "damaged"));
+}
+
+void test_listing_keeps_to_budget_and_resumes() {
+    fresh();
+    char path[64];
+    for (int i = 0; i < 40; i++) {
+        snprintf(path, sizeof(path), DIR_TALES "/%02d.mp3", 39 - i);
+        putMp3(path, 3);
+    }
+    SD.openMicros = 1000;
+    TEST_ASSERT_TRUE(budgeted.begin());
+    runUntil(budgeted, "listing");
+    budgeted.loop(true);
+    unsigned listed = field(budgeted, "files");
+    TEST_ASSERT_GREATER_THAN(0, listed);
+    TEST_ASSERT_LESS_OR_EQUAL(SCAN_BUDGET_MS + 1, listed);
+
+    // Playback takes the card mid-directory; listing carries on after it.
+    budgeted.loop(false);
+    runUntil(budgeted, "checking");
+    TEST_ASSERT_EQUAL(40, field(budgeted, "files"));
+    TEST_ASSERT_EQUAL(40, field(budgeted, "pending"));
+}
+
+void test_next_pass_reads_only_changed_files() {
+    fresh();
+    char path[64];
+    for (int i = 0; i < 30; i++) {
+        snprintf(path, sizeof(path), DIR_TALES "/t%02d.mp3", (i * 7) % 30);
+        putMp3(path, 3);
+    }
+    TEST_ASSERT_TRUE(cached.begin());
+    runUntil(cached, "checking");
+    TEST_ASSERT_EQUAL(30, field(cached, "pending"));
+    runUntil(cached, "waiting");
+
+    putMp3(DIR_TALES "/t11.mp3", 4);
+    putMp3(DIR_TALES "/new.mp3", 4);
+    stubMicros += SCAN_INTERVAL_MS * 1000;
+    runUntil(cached, "checking");
+    TEST_ASSERT_EQUAL(31, field(cached, "files"));
+    TEST_ASSERT_EQUAL(2, field(cached, "pending"));
+    runUntil(cached, "waiting");
+    TEST_ASSERT_EQUAL(0, field(cached, "damaged"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_pass_finds_damage_in_nested_folders);
+    RUN_TEST(test_listing_keeps_to_budget_and_resumes);
+    RUN_TEST(test_next_pass_reads_only_changed_files);
+    return UNITY_END();
+}
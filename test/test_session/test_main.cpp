@@ -0,0 +1,117 @@
+#include <unity.h>
+#include <vector>
+#include "modules/SessionLog.h"
+
+void setUp() {}
+void tearDown() {}
+
+static SessionLog sessionLog;
+static std::vector<SessionEvent> replayed;
+
+static void boot() {
+    sessionLog.begin();
+    sessionLog.onReplay([](const SessionEvent& event) { replayed.push_back(event); });
+}
+
+static void fresh() {
+    SD.reset();
+    stubMicros = 1000 * 1000;
+    replayed.clear();
+    boot();
+}
+
+static void advance(uint32_t ms) {
+    for (uint32_t i = 0; i < ms / 10; i++) {
+        stubMicros += 10 * 1000;
+        sessionLog.loop();
+    }
+}
+
+static size_t fileSize(const char* path) {
+    auto data = SD.data(path);
+    return data ? data->size() : 0;
+}
+
+// Button presses numbered by their arg, flushed as the buffer fills.
+static void press(uint32_t count, uint8_t firstArg = 0) {
+    for (uint32_t i = 0; i < count; i++) {
+        sessionLog.record(SES_BUTTON, (uint8_t)(firstArg + i));
+        stubMicros += 1000;
+        sessionLog.loop();
+    }
+}
+
+static void replayAll(uint8_t bootsBack) {
+    TEST_ASSERT_TRUE(sessionLog.startReplay(255, bootsBack));
+    for (int i = 0; i < 100000 && sessionLog.isReplaying(); i++) advance(10);
+    TEST_ASSERT_FALSE(sessionLog.isReplaying());
+}
+
+void test_rotation_keeps_history_through_replay() {
+    fresh();
+    press(SESSION_MAX_FILE_BYTES / 11 + 200);
+    advance(SESSION_FLUSH_MS + 10);
+    TEST_ASSERT_TRUE(SD.exists(SESSION_HISTORY_FILE));
+    size_t history = fileSize(SESSION_HISTORY_FILE);
+    TEST_ASSERT_GREATER_THAN(SESSION_MAX_FILE_BYTES / 2, history);
+
+    TEST_ASSERT_TRUE(sessionLog.startReplay(255, 0));
+    TEST_ASSERT_EQUAL(history, fileSize(SESSION_HISTORY_FILE));
+    TEST_ASSERT_GREATER_THAN(history, fileSize(SESSION_REPLAY_FILE));
+    sessionLog.stopReplay();
+}
+
+// A boot cut by the rotation is replayed whole: the part in the history,
+// then the part in the live log.
+void test_replay_spans_rotation() {
+    fresh();
+    const uint32_t presses = SESSION_MAX_FILE_BYTES / 11 + 500;
+    press(presses);
+    advance(SESSION_FLUSH_MS + 10);
+    TEST_ASSERT_TRUE(SD.exists(SESSION_HISTORY_FILE));
+    TEST_ASSERT_GREATER_THAN(0, fileSize(SESSION_LOG_FILE));
+
+    boot();
+    replayAll(1);
+    TEST_ASSERT_EQUAL(presses, replayed.size());
+    for (uint32_t i = 0; i < presses; i++) {
+        TEST_ASSERT_EQUAL(SES_BUTTON, replayed[i].type);
+        TEST_ASSERT_EQUAL((uint8_t)i, replayed[i].arg);
+    }
+}
+
+// The history starts in the middle of a boot, so there is no SES_BOOT to
+// time the replay from; its first record is used instead.
+void test_replay_paced_from_first_record() {
+    fresh();
+    advance(SESSION_FLUSH_MS + 10);
+    SD.remove(SESSION_LOG_FILE);
+    stubMicros = 500 * 1000 * 1000;
+    sessionLog.record(SES_STATE, 0x01);
+    advance(1000);
+    sessionLog.record(SES_BUTTON, 7);
+    advance(1000);
+    sessionLog.record(SES_BUTTON, 8);
+    advance(SESSION_FLUSH_MS + 10);
+    TEST_ASSERT_TRUE(SD.rename(SESSION_LOG_FILE, SESSION_HISTORY_FILE));
+
+    boot();
+    TEST_ASSERT_TRUE(sessionLog.startReplay(1, 1));
+    advance(900);
+    TEST_ASSERT_EQUAL(0, replayed.size());
+    advance(200);
+    TEST_ASSERT_EQUAL(1, replayed.size());
+    TEST_ASSERT_EQUAL(7, replayed[0].arg);
+    advance(1000);
+    TEST_ASSERT_EQUAL(2, replayed.size());
+    TEST_ASSERT_EQUAL(8, replayed[1].arg);
+    sessionLog.stopReplay();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_rotation_keeps_history_through_replay);
+    RUN_TEST(test_replay_spans_rotation);
+    RUN_TEST(test_replay_paced_from_first_record);
+    return UNITY_END();
+}
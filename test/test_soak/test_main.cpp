@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <random>
+#include <vector>
+#include <esp_heap_caps.h>
+#include "utils/HeapMonitor.h"
+
+void setUp() {}
+void tearDown() {}
+
+// A week of taps replayed against a model of the internal heap. Block sizes
+// follow what the firmware keeps on the heap around a tap: the UID and NDEF
+// Strings, the tale path, the playlist vector<String> that lives until the
+// next tap, and on WiFi entry the web server, WebSocket and route handlers.
+// The default build creates the server on every WiFi entry and deletes it
+// on exit; the static build takes it from MemoryArena once at boot.
+#define SOAK_HEAP_BYTES     (96 * 1024)
+#define SOAK_DAYS           7
+#define SOAK_TAPS_PER_DAY   40
+#define SOAK_WIFI_PER_DAY   3
+#define SOAK_ROUTES         27
+
+struct SoakResult {
+    size_t free;
+    size_t largest;
+    size_t minFree;
+    size_t minLargest;
+    double worstFragmentation;
+    size_t firstDayFree;
+};
+
+static std::mt19937 rng;
+static size_t failedAllocs;
+
+static size_t pick(size_t lo, size_t hi) {
+    return std::uniform_int_distribution<size_t>(lo, hi)(rng);
+}
+
+static void* take(size_t bytes) {
+    void* p = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!p) failedAllocs++;
+    return p;
+}
+
+static void release(std::vector<void*>& blocks) {
+    for (void* p : blocks) heap_caps_free(p);
+    blocks.clear();
+}
+
+static void openPortal(std::vector<void*>& server) {
+    server.push_back(take(180));
+    server.push_back(take(150));
+    for (int i = 0; i < SOAK_ROUTES; i++) server.push_back(take(pick(80, 120)));
+}
+
+// The NFC task's UID and NDEF Strings are gone once the tag is queued. The
+// old playlist is freed and the new one built while the tale path is still
+// alive; the vector grows by doubling like std::vector does.
+static void tap(std::vector<void*>& playlist) {
+    {
+        HEAP_SCOPE(MEM_NFC);
+        std::vector<void*> strings;
+        strings.push_back(take(16));
+        strings.push_back(take(pick(24, 200)));
+        release(strings);
+    }
+    HEAP_SCOPE(MEM_MAIN);
+    void* path = take(pick(24, 48));
+    {
+        HEAP_SCOPE(MEM_AUDIO);
+        release(playlist);
+        size_t tracks = pick(1, 24);
+        void* storage = nullptr;
+        for (size_t i = 0, cap = 0; i < tracks; i++) {
+            if (i == cap) {
+                cap = cap ? cap * 2 : 1;
+                void* grown = take(cap * 16);
+                if (storage) heap_caps_free(storage);
+                storage = grown;
+            }
+            playlist.push_back(take(pick(28, 64)));
+        }
+        playlist.push_back(storage);
+    }
+    heap_caps_free(path);
+}
+
+static void webRequests() {
+    HEAP_SCOPE(MEM_WEB);
+    for (size_t n = pick(1, 4); n > 0; n--) {
+        std::vector<void*> request;
+        request.push_back(take(pick(900, 1600)));
+        request.push_back(take(pick(300, 3000)));
+        release(request);
+    }
+}
+
+static void runWeek(bool bootOnce, SoakResult& result) {
+    stubHeapBegin(SOAK_HEAP_BYTES);
+    rng.seed(31);
+    failedAllocs = 0;
+    result.minLargest = SOAK_HEAP_BYTES;
+    result.worstFragmentation = 0.0;
+    std::vector<void*> server;
+    std::vector<void*> playlist;
+    if (bootOnce) {
+        server.push_back(MemoryArena::alloc(ARENA_INTERNAL, 180, MEM_WEB));
+        server.push_back(MemoryArena::alloc(ARENA_INTERNAL, 150, MEM_WEB));
+        for (int i = 0; i < SOAK_ROUTES; i++) server.push_back(take(pick(80, 120)));
+    }
+
+    for (int day = 0; day < SOAK_DAYS; day++) {
+        int wifiLeft = 0;
+        for (int t = 0; t < SOAK_TAPS_PER_DAY; t++) {
+            if (wifiLeft == 0 && pick(0, SOAK_TAPS_PER_DAY - 1) < SOAK_WIFI_PER_DAY) {
+                wifiLeft = (int)pick(1, 5);
+                if (!bootOnce) {
+                    HEAP_SCOPE(MEM_WEB);
+                    openPortal(server);
+                }
+            }
+            tap(playlist);
+            size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+            double fragmentation = 1.0 - (double)largest / heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+            if (largest < result.minLargest) result.minLargest = largest;
+            if (fragmentation > result.worstFragmentation) result.worstFragmentation = fragmentation;
+            if (wifiLeft > 0) {
+                webRequests();
+                if (--wifiLeft == 0 && !bootOnce) {
+                    HEAP_SCOPE(MEM_WEB);
+                    release(server);
+                }
+            }
+        }
+        // The portal times out overnight.
+        if (wifiLeft > 0 && !bootOnce) release(server);
+        if (day == 0) result.firstDayFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    }
+
+    result.free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    result.largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    result.minFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    printf("  %-9s free=%u min=%u largest=%u lowest largest=%u worst fragmentation=%.1f%%\n",
+           bootOnce ? "boot-once" : "per-entry", (unsigned)result.free, (unsigned)result.minFree,
+           (unsigned)result.largest, (unsigned)result.minLargest, 100.0 * result.worstFragmentation);
+    release(playlist);
+    if (!bootOnce) release(server);
+}
+
+// Fragmentation is 1 - largest free block / free heap, sampled after every
+// tap. Nothing a tap allocates outlives the next one, so the free heap at the
+// end of the week matches the end of the first day to within one playlist.
+static void checkWeek(const SoakResult& result) {
+    TEST_ASSERT_EQUAL(0, failedAllocs);
+    TEST_ASSERT_FLOAT_WITHIN(0.10f, 0.0f, (float)result.worstFragmentation);
+    TEST_ASSERT_INT_WITHIN(24 * 72 + 400, (int)result.firstDayFree, (int)result.free);
+}
+
+void test_week_per_entry_server() {
+    SoakResult result;
+    runWeek(false, result);
+    checkWeek(result);
+}
+
+// HeapMonitor's totals cover both weeks.
+void test_week_boot_once_server() {
+    SoakResult result;
+    runWeek(true, result);
+    checkWeek(result);
+    HeapMonitor::report(Serial);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_week_per_entry_server);
+    RUN_TEST(test_week_boot_once_server);
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <math.h>
+#include <chrono>
+#include "modules/SpectrumAnalyzer.h"
+
+void setUp() {}
+void tearDown() {}
+
+static SpectrumAnalyzer spectrum;
+
+// Arms a capture, taps a sine in `chunk`-frame pieces and analyzes it.
+static void capture(uint32_t rate, float hz, float amplitude, size_t chunk, uint16_t* bands) {
+    int16_t stereo[SPECTRUM_FFT_SIZE * 2 * 2];
+    for (int i = 0; i < SPECTRUM_FFT_SIZE * 2; i++) {
+        int16_t s = (int16_t)(amplitude * sinf(2.0f * (float)M_PI * hz * i / rate));
+        stereo[2 * i] = s;
+        stereo[2 * i + 1] = s;
+    }
+    spectrum.begin();
+    spectrum.arm();
+    for (size_t pos = 0; pos < SPECTRUM_FFT_SIZE * 2; pos += chunk) spectrum.tap(stereo + 2 * pos, chunk);
+    TEST_ASSERT_TRUE(spectrum.captured());
+    spectrum.analyze(rate, bands);
+}
+
+static int loudest(const uint16_t* bands) {
+    int best = 0;
+    for (int b = 1; b < SPECTRUM_BANDS; b++) {
+        if (bands[b] > bands[best]) best = b;
+    }
+    return best;
+}
+
+// analyze() disarms; taps are ignored until the next arm().
+void test_capture_waits_for_arm() {
+    spectrum.begin();
+    spectrum.arm();
+    uint16_t bands[SPECTRUM_BANDS];
+    spectrum.analyze(44100, bands);
+    TEST_ASSERT_FALSE(spectrum.captured());
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) spectrum.tap(1000, 1000);
+    TEST_ASSERT_FALSE(spectrum.captured());
+    spectrum.arm();
+    for (int i = 0; i < SPECTRUM_FFT_SIZE - 1; i++) spectrum.tap(1000, 1000);
+    TEST_ASSERT_FALSE(spectrum.captured());
+    spectrum.tap(1000, 1000);
+    TEST_ASSERT_TRUE(spectrum.captured());
+}
+
+void test_tone_lands_in_its_band() {
+    const float tones[SPECTRUM_BANDS] = { 172.0f, 600.0f, 2000.0f, 8000.0f };
+    const uint32_t rates[] = { 44100, 48000 };
+    for (uint32_t rate : rates) {
+        for (int b = 0; b < SPECTRUM_BANDS; b++) {
+            uint16_t bands[SPECTRUM_BANDS];
+            capture(rate, tones[b], 16000.0f, 64, bands);
+            TEST_ASSERT_EQUAL(b, loudest(bands));
+        }
+    }
+}
+
+void test_silence_is_zero() {
+    uint16_t bands[SPECTRUM_BANDS];
+    capture(44100, 440.0f, 0.0f, 256, bands);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) TEST_ASSERT_EQUAL(0, bands[b]);
+}
+
+// Power is log2 in Q4, so 6 dB more amplitude is two units (32) more.
+void test_level_tracks_amplitude() {
+    uint16_t quiet[SPECTRUM_BANDS];
+    uint16_t loud[SPECTRUM_BANDS];
+    capture(44100, 2000.0f, 4000.0f, 256, quiet);
+    capture(44100, 2000.0f, 8000.0f, 256, loud);
+    TEST_ASSERT_INT_WITHIN(4, 32, loud[2] - quiet[2]);
+}
+
+void test_full_scale_does_not_wrap() {
+    uint16_t bands[SPECTRUM_BANDS];
+    capture(44100, 600.0f, 32767.0f, 1, bands);
+    TEST_ASSERT_EQUAL(1, loudest(bands));
+    TEST_ASSERT_LESS_THAN(32 * 16, bands[1]);
+}
+
+// Only analyze() is timed; a frame is one SPECTRUM_FFT_SIZE window. The
+// host time is printed for comparison with the board.
+void test_analyze_cost() {
+    const int runs = 2000;
+    int16_t mono[SPECTRUM_FFT_SIZE];
+    for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) mono[i] = (int16_t)(16000.0f * sinf(2.0f * (float)M_PI * 2000.0f * i / 44100));
+    uint16_t bands[SPECTRUM_BANDS];
+    long long ns = 0;
+    spectrum.begin();
+    for (int run = 0; run < runs; run++) {
+        spectrum.arm();
+        for (int i = 0; i < SPECTRUM_FFT_SIZE; i++) spectrum.tap(mono[i], mono[i]);
+        TEST_ASSERT_TRUE(spectrum.captured());
+        auto start = std::chrono::steady_clock::now();
+        spectrum.analyze(44100, bands);
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    TEST_ASSERT_EQUAL(2, loudest(bands));
+    printf("  analyze() %.0f ns per %d-sample frame on this host\n", (double)ns / runs, SPECTRUM_FFT_SIZE);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_capture_waits_for_arm);
+    RUN_TEST(test_tone_lands_in_its_band);
+    RUN_TEST(test_silence_is_zero);
+    RUN_TEST(test_level_tracks_amplitude);
+    RUN_TEST(test_full_scale_does_not_wrap);
+    RUN_TEST(test_analyze_cost);
+    return UNITY_END();
+}
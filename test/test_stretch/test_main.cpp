@@ -0,0 +1,152 @@
+#include <unity.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "modules/TimeStretch.h"
+
+void setUp() {}
+void tearDown() {}
+
+typedef std::vector<int16_t> Pcm;
+
+static Pcm sine(uint32_t rate, float hz, size_t frames) {
+    Pcm pcm(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        int16_t s = (int16_t)(12000 * sinf(2.0f * (float)M_PI * hz * i / rate));
+        pcm[2 * i] = s;
+        pcm[2 * i + 1] = s;
+    }
+    return pcm;
+}
+
+// Buffers are allocated once for the firmware's lifetime, so every test
+// reuses the same instance.
+static TimeStretch ts;
+
+// Feeds `in` in pieces of `step` frames and drains every sequence, the way
+// AudioManager does from loop(). Time spent in process() is added to
+// `processNs` when given.
+static Pcm stretch(const Pcm& in, size_t step, long long* processNs = nullptr) {
+    Pcm out;
+    int16_t block[256 * 2];
+    size_t frames = in.size() / 2;
+    size_t pos = 0;
+    while (pos < frames) {
+        size_t want = step < frames - pos ? step : frames - pos;
+        pos += ts.put(in.data() + 2 * pos, want);
+        while (true) {
+            if (ts.available() == 0) {
+                if (!ts.ready()) break;
+                auto begin = std::chrono::steady_clock::now();
+                ts.process();
+                if (processNs) {
+                    *processNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+                }
+            }
+            size_t n = ts.get(block, 256);
+            out.insert(out.end(), block, block + 2 * n);
+        }
+    }
+    return out;
+}
+
+// Upward zero crossings per second of the left channel, skipping the fade-in.
+static float frequency(const Pcm& pcm, uint32_t rate) {
+    size_t frames = pcm.size() / 2;
+    size_t from = rate / 10;
+    int crossings = 0;
+    for (size_t i = from + 1; i < frames; i++) {
+        if (pcm[2 * (i - 1)] < 0 && pcm[2 * i] >= 0) crossings++;
+    }
+    return crossings * (float)rate / (frames - from - 1);
+}
+
+static void start(uint32_t rate, uint8_t percent) {
+    TEST_ASSERT_TRUE(ts.begin());
+    ts.configure(rate);
+    ts.setSpeed(percent);
+}
+
+void test_inactive_at_normal_speed() {
+    start(44100, 100);
+    TEST_ASSERT_FALSE(ts.isActive());
+    ts.setSpeed(150);
+    TEST_ASSERT_TRUE(ts.isActive());
+    ts.setSpeed(10);
+    TEST_ASSERT_EQUAL(STRETCH_MIN_PERCENT, ts.getSpeed());
+    ts.setSpeed(255);
+    TEST_ASSERT_EQUAL(STRETCH_MAX_PERCENT, ts.getSpeed());
+}
+
+void test_duration_follows_speed() {
+    const uint32_t rate = 44100;
+    const uint8_t speeds[] = { 75, 90, 125, 150 };
+    Pcm in = sine(rate, 440.0f, rate * 4);
+    for (uint8_t percent : speeds) {
+        start(rate, percent);
+        Pcm out = stretch(in, 256);
+        float expected = 4.0f * rate * 100 / percent;
+        // The input still buffered at the end is at most one window.
+        TEST_ASSERT_FLOAT_WITHIN(STRETCH_IN_FRAMES * 100.0f / percent, expected, out.size() / 2.0f);
+    }
+}
+
+void test_pitch_is_kept() {
+    const uint32_t rate = 22050;
+    Pcm in = sine(rate, 330.0f, rate * 3);
+    const uint8_t speeds[] = { 75, 150 };
+    for (uint8_t percent : speeds) {
+        start(rate, percent);
+        Pcm out = stretch(in, 200);
+        TEST_ASSERT_FLOAT_WITHIN(330.0f * 0.03f, 330.0f, frequency(out, rate));
+    }
+}
+
+void test_chunking_does_not_change_output() {
+    const uint32_t rate = 32000;
+    Pcm in = sine(rate, 523.0f, rate);
+    start(rate, 125);
+    Pcm expected = stretch(in, in.size() / 2);
+    const size_t steps[] = { 1, 17, 256, 4608 };
+    for (size_t step : steps) {
+        start(rate, 125);
+        Pcm out = stretch(in, step);
+        TEST_ASSERT_EQUAL(expected.size(), out.size());
+        TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), out.data(), expected.size());
+    }
+}
+
+void test_silence_stays_silent() {
+    const uint32_t rate = 48000;
+    Pcm in(rate * 2, 0);
+    start(rate, 80);
+    Pcm out = stretch(in, 512);
+    TEST_ASSERT_GREATER_THAN(0, out.size());
+    for (int16_t s : out) TEST_ASSERT_EQUAL_INT16(0, s);
+}
+
+// Only process() is timed; the host time per output frame is printed for
+// comparison with the board.
+void test_process_cost_per_speed() {
+    const uint32_t rate = 44100;
+    const uint8_t speeds[] = { 75, 90, 110, 125, 150 };
+    Pcm in = sine(rate, 440.0f, rate * 4);
+    for (uint8_t percent : speeds) {
+        start(rate, percent);
+        long long ns = 0;
+        Pcm out = stretch(in, 256, &ns);
+        TEST_ASSERT_GREATER_THAN(0, out.size());
+        printf("  %3u%% process() %.0f ns per output frame on this host\n", percent, (double)ns / (out.size() / 2));
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_inactive_at_normal_speed);
+    RUN_TEST(test_duration_follows_speed);
+    RUN_TEST(test_pitch_is_kept);
+    RUN_TEST(test_chunking_does_not_change_output);
+    RUN_TEST(test_silence_stays_silent);
+    RUN_TEST(test_process_cost_per_speed);
+    return UNITY_END();
+}
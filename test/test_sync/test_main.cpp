@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <string>
+#include <rom/crc.h>
+#include "modules/ContentSync.h"
+
+void setUp() {}
+void tearDown() {}
+
+static ContentSync contentSync;
+static ContentSync rebooted;
+
+static const char* PATH = DIR_TALES "/bunny/01.mp3";
+
+static std::string bytes(const char* path) {
+    auto data = SD.data(path);
+    return data ? std::string(data->begin(), data->end()) : std::string("<missing>");
+}
+
+static void put(const char* path, const std::string& text) {
+    File file = SD.open(path, FILE_WRITE);
+    file.write((const uint8_t*)text.data(), text.size());
+    file.close();
+}
+
+static SyncStatus upload(ContentSync& s, const std::string& chunk, uint32_t offset, const std::string& whole,
+                         const char* path = PATH) {
+    const uint8_t* data = (const uint8_t*)chunk.data();
+    s.chunkData(data, chunk.size(), 0, chunk.size());
+    return s.commitChunk(path, whole.size(), crc32_le(0, (const uint8_t*)whole.data(), whole.size()), offset,
+                         crc32_le(0, data, chunk.size()));
+}
+
+static void settle(ContentSync& s) {
+    stubMicros += 3000 * 1000;
+    for (int i = 0; i < 10 && !s.isReady(); i++) s.loop();
+}
+
+static void fresh() {
+    SD.reset();
+    SD.mkdir(DIR_TALES);
+    stubMicros = 100 * 1000 * 1000;
+}
+
+void test_manifest_uses_zlib_crc() {
+    fresh();
+    SD.mkdir(DIR_TALES "/a");
+    put(DIR_TALES "/a/check.txt", "123456789");
+    TEST_ASSERT_TRUE(contentSync.begin());
+    contentSync.refresh();
+    settle(contentSync);
+    TEST_ASSERT_TRUE(contentSync.isReady());
+    std::string manifest = bytes(SYNC_MANIFEST_FILE);
+    TEST_ASSERT_EQUAL_STRING("cbf43926 9 ", manifest.substr(0, 11).c_str());
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, manifest.find(" /tales/a/check.txt\n"));
+}
+
+void test_chunks_resume_and_install() {
+    fresh();
+    std::string whole = "once upon a time there was a bunny";
+    TEST_ASSERT_EQUAL(SYNC_OK, upload(contentSync, whole.substr(0, 10), 0, whole));
+    TEST_ASSERT_EQUAL(10, contentSync.partOffset(PATH));
+    TEST_ASSERT_EQUAL(SYNC_BAD_OFFSET, upload(contentSync, whole.substr(20), 20, whole));
+    TEST_ASSERT_EQUAL(SYNC_OK, upload(contentSync, whole.substr(10, 10), 10, whole));
+    TEST_ASSERT_EQUAL(SYNC_DONE, upload(contentSync, whole.substr(20), 20, whole));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.pcrc"));
+    settle(contentSync);
+    TEST_ASSERT_EQUAL_STRING(whole.c_str(), bytes(PATH).c_str());
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, bytes(SYNC_MANIFEST_FILE).find(" /tales/bunny/01.mp3\n"));
+}
+
+void test_corrupt_chunk_is_not_written() {
+    fresh();
+    std::string whole = "0123456789abcdef";
+    contentSync.chunkData((const uint8_t*)"01234567", 8, 0, 8);
+    TEST_ASSERT_EQUAL(SYNC_BAD_CHUNK, contentSync.commitChunk(PATH, whole.size(), 0, 0, 0x12345678));
+    TEST_ASSERT_EQUAL(0, contentSync.partOffset(PATH));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.part"));
+}
+
+void test_dropped_chunk_is_not_committed() {
+    fresh();
+    std::string whole = "01234567";
+    contentSync.chunkData((const uint8_t*)whole.data(), whole.size(), 0, whole.size());
+    contentSync.dropChunk();
+    uint32_t crc = crc32_le(0, (const uint8_t*)whole.data(), whole.size());
+    TEST_ASSERT_EQUAL(SYNC_BAD_CHUNK, contentSync.commitChunk(PATH, whole.size(), crc, 0, crc));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.part"));
+}
+
+void test_whole_file_crc_mismatch_drops_part() {
+    fresh();
+    std::string whole = "0123456789abcdef";
+    TEST_ASSERT_EQUAL(SYNC_OK, upload(contentSync, "01234567", 0, whole));
+    TEST_ASSERT_EQUAL(SYNC_BAD_FILE, upload(contentSync, "XXXXXXXX", 8, whole));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.part"));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.pcrc"));
+}
+
+// A reboot picks the running CRC up from the .pcrc file, and rebuilds it
+// from the part when the two disagree.
+static void resumeAfterReboot(const char* path, bool keepCrc) {
+    fresh();
+    std::string part = std::string(path) + ".part";
+    std::string partCrc = std::string(path) + ".pcrc";
+    std::string whole = "the fox and the moon, a story for the night";
+    TEST_ASSERT_EQUAL(SYNC_OK, upload(contentSync, whole.substr(0, 16), 0, whole, path));
+    TEST_ASSERT_EQUAL_STRING(whole.substr(0, 16).c_str(), bytes(part.c_str()).c_str());
+    TEST_ASSERT_EQUAL(8, SD.data(partCrc.c_str())->size());
+    if (!keepCrc) put(partCrc.c_str(), "stale");
+
+    TEST_ASSERT_TRUE(rebooted.begin());
+    TEST_ASSERT_EQUAL(16, rebooted.partOffset(path));
+    TEST_ASSERT_EQUAL(SYNC_DONE, upload(rebooted, whole.substr(16), 16, whole, path));
+    settle(rebooted);
+    TEST_ASSERT_EQUAL_STRING(whole.c_str(), bytes(path).c_str());
+}
+
+void test_resume_after_reboot() {
+    resumeAfterReboot(DIR_TALES "/fox/01.mp3", true);
+}
+
+void test_resume_rehashes_without_saved_crc() {
+    resumeAfterReboot(DIR_TALES "/fox/02.mp3", false);
+}
+
+void test_rejects_paths_outside_tales() {
+    TEST_ASSERT_FALSE(ContentSync::validPath("/system/manifest.idx"));
+    TEST_ASSERT_FALSE(ContentSync::validPath(DIR_TALES "/../x"));
+    TEST_ASSERT_FALSE(ContentSync::validPath(DIR_TALES "/a//b"));
+    TEST_ASSERT_TRUE(ContentSync::validPath(DIR_TALES "/a/b.mp3"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_manifest_uses_zlib_crc);
+    RUN_TEST(test_chunks_resume_and_install);
+    RUN_TEST(test_corrupt_chunk_is_not_written);
+    RUN_TEST(test_dropped_chunk_is_not_committed);
+    RUN_TEST(test_whole_file_crc_mismatch_drops_part);
+    RUN_TEST(test_resume_after_reboot);
+    RUN_TEST(test_resume_rehashes_without_saved_crc);
+    RUN_TEST(test_rejects_paths_outside_tales);
+    return UNITY_END();
+}
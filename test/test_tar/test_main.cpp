@@ -0,0 +1,171 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "modules/TarExtractor.h"
+
+void setUp() {}
+void tearDown() {}
+
+typedef std::vector<uint8_t> Bytes;
+
+static ContentSync contentSync;
+static TarExtractor pack;
+
+static void addMember(Bytes& tar, const char* name, const std::string& data, char type = '0') {
+    uint8_t header[TAR_BLOCK] = {};
+    snprintf((char*)header, 100, "%s", name);
+    snprintf((char*)header + 100, 8, "%07o", 0644);
+    snprintf((char*)header + 124, 12, "%011o", (unsigned)data.size());
+    header[156] = type;
+    memcpy(header + 257, "ustar\0" "00", 8);
+    memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (uint8_t b : header) sum += b;
+    snprintf((char*)header + 148, 8, "%06o", sum);
+    tar.insert(tar.end(), header, header + TAR_BLOCK);
+    tar.insert(tar.end(), data.begin(), data.end());
+    tar.resize((tar.size() + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK, 0);
+}
+
+static void endArchive(Bytes& tar) {
+    tar.resize(tar.size() + 2 * TAR_BLOCK, 0);
+}
+
+static Bytes gzip(const Bytes& in) {
+    z_stream z = {};
+    deflateInit2(&z, 9, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY);
+    Bytes out(deflateBound(&z, in.size()) + 32);
+    z.next_in = (Bytef*)in.data();
+    z.avail_in = in.size();
+    z.next_out = out.data();
+    z.avail_out = out.size();
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+
+// Noise that deflate cannot shrink much, so the stream spans many blocks.
+static std::string story(size_t len, uint32_t seed) {
+    std::string s(len, ' ');
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        s[i] = 'a' + (seed >> 16) % 26;
+    }
+    return s;
+}
+
+static Bytes library() {
+    Bytes tar;
+    addMember(tar, "tales/", "", '5');
+    addMember(tar, "tales/bunny/01.mp3", story(40000, 1));
+    addMember(tar, "./fox/02.mp3", story(700, 2));
+    addMember(tar, "empty.txt", "");
+    addMember(tar, "../escape.mp3", "nope");
+    endArchive(tar);
+    return tar;
+}
+
+static std::string installed(const char* path) {
+    std::string done = std::string(path) + ".done";
+    auto data = SD.data(done.c_str());
+    return data ? std::string(data->begin(), data->end()) : std::string("<missing>");
+}
+
+// Feeds `cuts` as the end offsets of the pieces, then the rest.
+static bool extract(const Bytes& archive, const std::vector<size_t>& cuts) {
+    SD.reset();
+    SD.mkdir(DIR_TALES);
+    pack.start();
+    size_t pos = 0;
+    for (size_t cut : cuts) {
+        pack.write(archive.data() + pos, cut - pos);
+        pos = cut;
+    }
+    pack.write(archive.data() + pos, archive.size() - pos);
+    return pack.finish();
+}
+
+static std::vector<size_t> steps(size_t total, size_t step) {
+    std::vector<size_t> cuts;
+    for (size_t pos = step; pos < total; pos += step) cuts.push_back(pos);
+    return cuts;
+}
+
+static void checkLibrary() {
+    TEST_ASSERT_EQUAL_STRING(story(40000, 1).c_str(), installed(DIR_TALES "/bunny/01.mp3").c_str());
+    TEST_ASSERT_EQUAL_STRING(story(700, 2).c_str(), installed(DIR_TALES "/fox/02.mp3").c_str());
+    TEST_ASSERT_EQUAL_STRING("", installed(DIR_TALES "/empty.txt").c_str());
+    TEST_ASSERT_FALSE(SD.exists("/escape.mp3.done"));
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/escape.mp3.done"));
+}
+
+void test_plain_tar() {
+    TEST_ASSERT_TRUE(contentSync.begin());
+    TEST_ASSERT_TRUE(pack.begin(&contentSync));
+    Bytes tar = library();
+    const size_t sizes[] = { 1, 100, 512, 4096, tar.size() };
+    for (size_t step : sizes) {
+        TEST_ASSERT_TRUE(extract(tar, steps(tar.size(), step)));
+        checkLibrary();
+    }
+}
+
+void test_gzip_in_any_chunking() {
+    Bytes gz = gzip(library());
+    const size_t sizes[] = { 1, 7, 1460, 4096, gz.size() };
+    for (size_t step : sizes) {
+        TEST_ASSERT_TRUE(extract(gz, steps(gz.size(), step)));
+        checkLibrary();
+    }
+}
+
+// The deflate data ends a few bytes before, at, or after a write() boundary,
+// so part of the trailer is read ahead in an earlier call.
+void test_gzip_member_ending_on_buffer_boundary() {
+    Bytes gz = gzip(library());
+    for (size_t back = 0; back <= 12; back++) {
+        TEST_ASSERT_TRUE(extract(gz, { gz.size() - back }));
+        checkLibrary();
+    }
+}
+
+void test_gzip_trailer_mismatch_fails() {
+    Bytes gz = gzip(library());
+    gz[gz.size() - 8] ^= 0x01;
+    TEST_ASSERT_FALSE(extract(gz, steps(gz.size(), 4096)));
+    TEST_ASSERT_EQUAL_STRING("gzip CRC mismatch", pack.error());
+}
+
+void test_truncated_stream_leaves_no_part() {
+    Bytes gz = gzip(library());
+    gz.resize(gz.size() / 2);
+    TEST_ASSERT_FALSE(extract(gz, steps(gz.size(), 1460)));
+    TEST_ASSERT_EQUAL_STRING("gzip stream truncated", pack.error());
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.part"));
+
+    Bytes tar = library();
+    tar.resize(TAR_BLOCK + 1000);
+    TEST_ASSERT_FALSE(extract(tar, {}));
+    TEST_ASSERT_EQUAL_STRING("archive truncated", pack.error());
+    TEST_ASSERT_FALSE(SD.exists(DIR_TALES "/bunny/01.mp3.part"));
+}
+
+void test_bad_header_checksum_fails() {
+    Bytes tar = library();
+    tar[TAR_BLOCK * 1 + 10] ^= 0x20;
+    TEST_ASSERT_FALSE(extract(tar, {}));
+    TEST_ASSERT_EQUAL_STRING("bad tar header", pack.error());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_tar);
+    RUN_TEST(test_gzip_in_any_chunking);
+    RUN_TEST(test_gzip_member_ending_on_buffer_boundary);
+    RUN_TEST(test_gzip_trailer_mismatch_fails);
+    RUN_TEST(test_truncated_stream_leaves_no_part);
+    RUN_TEST(test_bad_header_checksum_fails);
+    return UNITY_END();
+}